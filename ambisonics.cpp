@@ -0,0 +1,49 @@
+#include "ambisonics.h"
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI (3.14159265)
+#endif
+
+void ambisonicEncode(int order, float angle, float* coeffs)
+{
+    coeffs[0] = 1.0f;
+    for (int m = 1; m <= order; ++m) {
+        coeffs[2 * m - 1] = std::cos(m * angle);
+        coeffs[2 * m] = std::sin(m * angle);
+    }
+}
+
+void ambisonicRotate(int order, float yaw, const float* in, float* out)
+{
+    out[0] = in[0];
+    for (int m = 1; m <= order; ++m) {
+        float c = std::cos(m * yaw);
+        float s = std::sin(m * yaw);
+        float x = in[2 * m - 1];
+        float y = in[2 * m];
+        out[2 * m - 1] = x * c + y * s;
+        out[2 * m] = y * c - x * s;
+    }
+}
+
+void ambisonicDecoderRow(int order, float angle, int speakers, float* row)
+{
+    // max-rE weights for 2D: cos(m * pi / (2M + 2)), which trade a little
+    // width for a tighter energy vector than the plain projection decoder.
+    float weights[AMBI_MAX_ORDER + 1];
+    float energy = 0.0f;
+    for (int m = 0; m <= order; ++m) {
+        weights[m] = std::cos(m * M_PI / (2 * order + 2));
+        energy += (m == 0 ? 1.0f : 2.0f) * weights[m] * weights[m];
+    }
+
+    // On a regular ring the speaker gains then sum to unit power.
+    float scale = 1.0f / std::sqrt(speakers * energy);
+
+    row[0] = weights[0] * scale;
+    for (int m = 1; m <= order; ++m) {
+        row[2 * m - 1] = 2.0f * weights[m] * std::cos(m * angle) * scale;
+        row[2 * m] = 2.0f * weights[m] * std::sin(m * angle) * scale;
+    }
+}
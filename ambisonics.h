@@ -0,0 +1,27 @@
+#pragma once
+
+// Horizontal-only (2D) ambisonics up to third order, for the ambisonic
+// panning mode in RenderEngine.
+//
+// A bus of order M carries 2M + 1 circular harmonics, in the order
+//     W, cos(phi), sin(phi), cos(2 phi), sin(2 phi), ..., cos(M phi), sin(M phi)
+// with W unweighted (the same normalisation as the encoder below). Angles
+// are in radians, in the same convention as the panning in render_engine.cpp.
+
+#define AMBI_MAX_ORDER      (3)
+#define AMBI_MAX_CHANNELS   (2 * AMBI_MAX_ORDER + 1)
+
+inline int ambisonicChannels(int order) { return 2 * order + 1; }
+
+// Encoding coefficients of a source at `angle`.
+void ambisonicEncode(int order, float angle, float* coeffs);
+
+// Rotate a bus (or one source's coefficients) so that a source at phi ends
+// up at phi - yaw, as turning the listener by `yaw` does. Each order is an
+// independent 2x2 rotation, so this costs O(order). in and out may alias.
+void ambisonicRotate(int order, float yaw, const float* in, float* out);
+
+// Decoder row for one speaker of a `speakers`-speaker horizontal ring at
+// `angle`: the bus-to-speaker gains of a max-rE projection decoder, scaled
+// so a regular ring reproduces each source at unit energy.
+void ambisonicDecoderRow(int order, float angle, int speakers, float* row);
@@ -0,0 +1,177 @@
+#include "attenuation.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+const char* attenuationLawName(AttenuationLaw law)
+{
+    switch (law) {
+        case AttenuationLaw::Linear:          return "linear";
+        case AttenuationLaw::InverseDistance: return "inverse";
+        case AttenuationLaw::InverseSquare:   return "inverse-square";
+        case AttenuationLaw::Curve:           return "curve";
+        default: return "unknown";
+    }
+}
+
+bool findAttenuationLaw(const char* name, AttenuationLaw& law)
+{
+    // A curve needs its points, so it is never picked by name
+    for (int l = 0; l < (int)AttenuationLaw::Curve; ++l) {
+        if (std::strcmp(attenuationLawName((AttenuationLaw)l), name) == 0) {
+            law = (AttenuationLaw)l;
+            return true;
+        }
+    }
+    return false;
+}
+
+void AttenuationModel::setLaw(AttenuationLaw law, float referenceDistance)
+{
+    m_law = law;
+    m_reference = referenceDistance > 0.0f ? referenceDistance : 1.0f;
+}
+
+bool AttenuationModel::loadCurve(const char* path)
+{
+    FILE* file = std::fopen(path, "r");
+    if (!file) {
+        std::fprintf(stderr, "Could not open attenuation curve %s\n", path);
+        return false;
+    }
+
+    std::vector<float> distances, db;
+    char line[256];
+    int lineNumber = 0;
+    bool ok = true;
+    while (std::fgets(line, sizeof(line), file)) {
+        ++lineNumber;
+        if (char* comment = std::strchr(line, '#'))
+            *comment = '\0';
+
+        float distance, gain;
+        int fields = std::sscanf(line, " %f %f", &distance, &gain);
+        if (fields <= 0)
+            continue;
+        if (fields != 2 || distance < 0.0f || (!distances.empty() && distance <= distances.back())) {
+            std::fprintf(stderr, "%s:%d: expected <distance m> <gain dB>, distances increasing\n",
+                         path, lineNumber);
+            ok = false;
+            break;
+        }
+        distances.push_back(distance);
+        db.push_back(gain);
+    }
+    std::fclose(file);
+
+    if (ok && distances.empty()) {
+        std::fprintf(stderr, "%s: no points\n", path);
+        ok = false;
+    }
+    if (!ok)
+        return false;
+
+    m_law = AttenuationLaw::Curve;
+    m_curveDistances = distances;
+    m_curveDb = db;
+    return true;
+}
+
+bool AttenuationModel::configure(const char* lawOrCurvePath, float referenceDistance)
+{
+    AttenuationLaw law;
+    if (findAttenuationLaw(lawOrCurvePath, law)) {
+        setLaw(law, referenceDistance);
+        return true;
+    }
+    return loadCurve(lawOrCurvePath);
+}
+
+float AttenuationModel::evaluate(float distance) const
+{
+    switch (m_law) {
+        case AttenuationLaw::InverseDistance:
+            return m_reference / std::max(distance, m_reference);
+        case AttenuationLaw::InverseSquare: {
+            float g = m_reference / std::max(distance, m_reference);
+            return g * g;
+        }
+        case AttenuationLaw::Curve: {
+            const std::vector<float>& d = m_curveDistances;
+            size_t next = std::upper_bound(d.begin(), d.end(), distance) - d.begin();
+            float db;
+            if (next == 0)
+                db = m_curveDb.front();
+            else if (next == d.size())
+                db = m_curveDb.back();
+            else {
+                float t = (distance - d[next - 1]) / (d[next] - d[next - 1]);
+                db = m_curveDb[next - 1] + t * (m_curveDb[next] - m_curveDb[next - 1]);
+            }
+            return std::pow(10.0f, db / 20.0f);
+        }
+        case AttenuationLaw::Linear:
+        default:
+            return distance;
+    }
+}
+
+void buildAttenuationTable(const AttenuationModel& model, float maxDistance, AttenuationTable& table)
+{
+    if (maxDistance <= 0.0f)
+        maxDistance = 1.0f;
+    float scale = ATTENUATION_TABLE_SIZE / maxDistance;
+
+    // The inverse laws have a corner at the reference distance, which
+    // interpolating across would round off by up to a tenth of a dB on long
+    // ranges. Stretching the table slightly puts an entry right on it.
+    if (model.law() == AttenuationLaw::InverseDistance || model.law() == AttenuationLaw::InverseSquare) {
+        float entries = std::floor(model.referenceDistance() * scale);
+        if (entries >= 1.0f)
+            scale = entries / model.referenceDistance();
+    }
+    table.scale = scale;
+    table.maxDistance = ATTENUATION_TABLE_SIZE / scale;
+
+    float loudest = 0.0f;
+    for (int i = 0; i <= ATTENUATION_TABLE_SIZE; ++i) {
+        table.gains[i] = model.evaluate(i / scale);
+        loudest = std::max(loudest, table.gains[i]);
+    }
+    float normalise = loudest > 0.0f ? 1.0f / loudest : 0.0f;
+    for (int i = 0; i <= ATTENUATION_TABLE_SIZE; ++i)
+        table.gains[i] *= normalise;
+    table.gains[ATTENUATION_TABLE_SIZE + 1] = table.gains[ATTENUATION_TABLE_SIZE];
+}
+
+void attenuationGains(const AttenuationTable& table, const float* distances, float* gains, int count)
+{
+    int i = 0;
+#ifdef __SSE2__
+    // Index and fraction four at a time; SSE2 has no gather, so the table
+    // reads stay scalar.
+    const __m128 scale = _mm_set1_ps(table.scale);
+    const __m128 top = _mm_set1_ps((float)ATTENUATION_TABLE_SIZE);
+    alignas(16) int index[4];
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_mul_ps(_mm_loadu_ps(distances + i), scale);
+        x = _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), top);
+        __m128i whole = _mm_cvttps_epi32(x);
+        __m128 f = _mm_sub_ps(x, _mm_cvtepi32_ps(whole));
+        _mm_store_si128((__m128i*)index, whole);
+
+        __m128 a = _mm_setr_ps(table.gains[index[0]], table.gains[index[1]],
+                               table.gains[index[2]], table.gains[index[3]]);
+        __m128 b = _mm_setr_ps(table.gains[index[0] + 1], table.gains[index[1] + 1],
+                               table.gains[index[2] + 1], table.gains[index[3] + 1]);
+        _mm_storeu_ps(gains + i, _mm_add_ps(a, _mm_mul_ps(f, _mm_sub_ps(b, a))));
+    }
+#endif
+    for (; i < count; ++i)
+        gains[i] = attenuationGain(table, distances[i]);
+}
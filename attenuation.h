@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+
+// Intervals in a baked attenuation table.
+#define ATTENUATION_TABLE_SIZE (1024)
+
+// How a speaker's gain depends on its distance from the listener.
+enum class AttenuationLaw
+{
+    Linear = 0,        // gain proportional to distance: makes up for the
+                       // level lost on the way, so every speaker is heard
+                       // equally loud (the original behaviour)
+    InverseDistance,   // reference / distance: -6 dB per doubling
+    InverseSquare,     // (reference / distance)^2: -12 dB per doubling
+    Curve,             // measured gains loaded from a file
+    Count
+};
+
+const char* attenuationLawName(AttenuationLaw law);
+
+// The law called `name` ("linear", "inverse", "inverse-square"), if any.
+bool findAttenuationLaw(const char* name, AttenuationLaw& law);
+
+// An attenuation law and its parameters. Evaluating it may call powf, so
+// the audio thread only ever sees it baked into an AttenuationTable.
+class AttenuationModel
+{
+public:
+    // Inverse laws hold their gain constant inside referenceDistance.
+    void setLaw(AttenuationLaw law, float referenceDistance = 1.0f);
+
+    // Load a curve with one "<distance m> <gain dB>" line per point, in
+    // increasing distance ('#' starts a comment). Gains are interpolated in
+    // dB between points and held beyond the first and last.
+    bool loadCurve(const char* path);
+
+    AttenuationLaw law() const { return m_law; }
+    float referenceDistance() const { return m_reference; }
+
+    // Command-line form: a law name, or else the path of a curve file.
+    bool configure(const char* lawOrCurvePath, float referenceDistance);
+
+    // Linear gain at `distance` metres, before normalisation.
+    float evaluate(float distance) const;
+
+private:
+    AttenuationLaw m_law = AttenuationLaw::Linear;
+    float m_reference = 1.0f;
+    std::vector<float> m_curveDistances;
+    std::vector<float> m_curveDb;
+};
+
+// A model sampled every maxDistance / ATTENUATION_TABLE_SIZE metres from 0
+// to (at least) the farthest distance the listener can be from a speaker,
+// scaled so the loudest reachable gain is 1. Looked up with linear
+// interpolation; beyond maxDistance the last entry holds.
+typedef struct
+{
+    float maxDistance;
+    float scale;                                  // entries per metre
+    float gains[ATTENUATION_TABLE_SIZE + 2];      // one past the end, repeated
+} AttenuationTable;
+
+void buildAttenuationTable(const AttenuationModel& model, float maxDistance, AttenuationTable& table);
+
+inline float attenuationGain(const AttenuationTable& table, float distance)
+{
+    float x = distance * table.scale;
+    x = x < 0.0f ? 0.0f : (x > ATTENUATION_TABLE_SIZE ? ATTENUATION_TABLE_SIZE : x);
+    int i = (int)x;
+    float f = x - i;
+    return table.gains[i] + f * (table.gains[i + 1] - table.gains[i]);
+}
+
+// attenuationGain for `count` distances at once.
+void attenuationGains(const AttenuationTable& table, const float* distances, float* gains, int count);
@@ -0,0 +1,100 @@
+#include "audio_engine.h"
+#include "portaudio_listener.h"
+#include <cstdio>
+
+AudioEngine::~AudioEngine()
+{
+    stop();
+    if (m_poseInput)
+        stopPoseInput();
+    if (m_initialized)
+        checkPaError(Pa_Terminate());
+}
+
+bool AudioEngine::initialize()
+{
+    if (!m_initialized)
+        m_initialized = checkPaError(Pa_Initialize());
+    return m_initialized;
+}
+
+bool AudioEngine::start()
+{
+    if (running())
+        return true;
+    if (!initialize())
+        return false;
+
+    if (!m_stream) {
+        m_stream = openPlayback(m_data, false);
+        if (!m_stream)
+            return false;
+    }
+    if (!checkPaError(Pa_StartStream(m_stream))) {
+        stop();
+        return false;
+    }
+    m_paused = false;
+
+    if (!m_poseInput) {
+        m_poseInput = true;
+        if (!startPoseInput(m_data)) {
+            std::printf("Tracker input disabled.\n");
+            std::fflush(stdout);
+        }
+    }
+    return true;
+}
+
+bool AudioEngine::pause()
+{
+    if (!m_stream)
+        return false;
+    if (m_paused)
+        return true;
+    // Stopping, unlike closing, plays out what is already queued
+    if (!checkPaError(Pa_StopStream(m_stream)))
+        return false;
+    m_paused = true;
+    return true;
+}
+
+void AudioEngine::stop()
+{
+    if (!m_stream)
+        return;
+    closePlayback(m_stream, false);
+    m_stream = nullptr;
+    m_paused = false;
+    if (!m_data->stream)
+        m_data->readIndex = 0;
+}
+
+bool AudioEngine::switchDevice(int device)
+{
+    int previous = m_device;
+    m_device = device;
+    SetOutputDeviceIndex(device);
+    if (!m_stream)
+        return true;
+
+    closePlayback(m_stream, true);
+    m_stream = openPlayback(m_data, true);
+    bool switched = m_stream != nullptr;
+    if (!switched) {
+        m_device = previous;
+        SetOutputDeviceIndex(previous);
+        m_stream = openPlayback(m_data, true);
+        if (!m_stream) {
+            closePlayback(nullptr, false);
+            m_paused = false;
+            return false;
+        }
+    }
+
+    if (!m_paused && !checkPaError(Pa_StartStream(m_stream))) {
+        stop();
+        return false;
+    }
+    return switched;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "portaudio.h"
+#include "utils.h"
+
+// The app's connection to the sound card, alive for the whole session.
+// PortAudio is initialised once, the decoded audio in data (loaded by the
+// caller, see initAudioData()) is never loaded again, and streams are
+// opened, paused and reopened on them: restarting after stop() costs a new
+// render engine and a stream open, and moving to another device only the
+// stream open, since the running render engine moves across with it.
+//
+// Not thread-safe: call from one control thread (the window's). The stream
+// itself plays on PortAudio's thread, so nothing here blocks.
+class AudioEngine
+{
+public:
+    explicit AudioEngine(paTestData* data) : m_data(data) {}
+    ~AudioEngine();     // stops playback and terminates PortAudio
+
+    AudioEngine(const AudioEngine&) = delete;
+    AudioEngine& operator=(const AudioEngine&) = delete;
+
+    // Initialise PortAudio, the first time; start() does it too. False,
+    // with the error printed, if it fails (a later call tries again).
+    bool initialize();
+
+    // Play: open a stream with the current settings, or carry on after
+    // pause(). Starts tracker input the first time. True if already playing.
+    bool start();
+
+    // Stop the stream's callbacks but keep it, the render engine and the
+    // place in the audio for start().
+    bool pause();
+
+    // Close the stream and drop the render engine. The next start() opens
+    // a new one with the settings of the time, from the top of the audio
+    // (a streamed file carries on where it was).
+    void stop();
+
+    // Use PortAudio device `device` (paNoDevice for the default) from now
+    // on. A playing or paused stream is closed and reopened there in the
+    // same state, with the same render engine, so settings changed since
+    // start() still wait for the next one. If the device cannot take the
+    // stream it goes back to the previous device and returns false.
+    bool switchDevice(int device);
+
+    bool running() const { return m_stream && !m_paused; }
+    bool paused() const { return m_paused; }
+    int device() const { return m_device; }
+
+private:
+    paTestData* m_data;
+    bool m_initialized = false;
+    bool m_poseInput = false;       // startPoseInput() has run
+    PaStream* m_stream = nullptr;   // open, playing unless m_paused
+    bool m_paused = false;
+    int m_device = paNoDevice;
+};
@@ -0,0 +1,70 @@
+#include "audio_file.h"
+#include <algorithm>
+#include <iostream>
+
+// Frames decoded per sf_readf_float call when loading a whole file.
+static const sf_count_t kDecodeChunkFrames = 16384;
+
+bool upmixToSurround(const float* src, int channels, float* dst, sf_count_t frames)
+{
+    // Mix stereo to 5.1
+    if (channels == 2) {
+        for (sf_count_t i = 0; i < frames; ++i) {
+            float left  = src[i * 2 + 0];
+            float right = src[i * 2 + 1];
+
+            dst[i * 6 + 0] = left;              // Front Left
+            dst[i * 6 + 1] = right;              // Front Right
+            dst[i * 6 + 2] = (left * right) * 0.5f;             // Centre
+            dst[i * 6 + 3] = (left + right) * 0.25f;       // Subwoofer
+            dst[i * 6 + 4] = left * 0.5f;      // Rear Left
+            dst[i * 6 + 5] = right * 0.5f; // Rear Right
+        }
+        return true;
+    }
+
+    if (channels == 6) {
+        // Copy directly
+        std::copy(src, src + frames * DECODED_CHANNELS, dst);
+        return true;
+    }
+
+    return false;
+}
+
+bool decodeAudioFile(const char* path, std::vector<float>& audio)
+{
+    SF_INFO sfinfo = {};
+    SNDFILE* file = sf_open(path, SFM_READ, &sfinfo);
+    if (!file) {
+        std::cerr << "Could not open " << path << ": " << sf_strerror(nullptr) << "\n";
+        return false;
+    }
+
+    if (sfinfo.channels != 2 && sfinfo.channels != 6) {
+        std::cerr << "Invalid number of channels: " << sfinfo.channels << "\n";
+        sf_close(file);
+        return false;
+    }
+
+    audio.assign(sfinfo.frames * DECODED_CHANNELS, 0.0f);
+
+    std::vector<float> chunk(kDecodeChunkFrames * sfinfo.channels);
+    sf_count_t framesRead = 0;
+    while (framesRead < sfinfo.frames) {
+        sf_count_t n = sf_readf_float(file, chunk.data(), kDecodeChunkFrames);
+        if (n <= 0)
+            break;
+        n = std::min(n, sfinfo.frames - framesRead);
+        upmixToSurround(chunk.data(), sfinfo.channels,
+                        audio.data() + framesRead * DECODED_CHANNELS, n);
+        framesRead += n;
+    }
+
+    if (framesRead != sfinfo.frames) {
+        std::cerr << "Warning: read fewer frames than expected\n";
+    }
+
+    sf_close(file);
+    return true;
+}
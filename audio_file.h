@@ -0,0 +1,15 @@
+#pragma once
+
+#include <sndfile.h>
+#include <vector>
+
+// Decoded audio is always interleaved 5.1 in file order: FL, FR, C, LFE, BL, BR.
+#define DECODED_CHANNELS    (6)
+
+// Convert `frames` interleaved frames of `channels` channels into 5.1.
+// Returns false if the channel count is not supported.
+bool upmixToSurround(const float* src, int channels, float* dst, sf_count_t frames);
+
+// Decode a whole file into `audio` as interleaved 5.1. The file is read in
+// chunks, so peak memory is the decoded size plus one chunk.
+bool decodeAudioFile(const char* path, std::vector<float>& audio);
@@ -0,0 +1,313 @@
+#include "automation.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef M_PI
+#define M_PI (3.14159265)
+#endif
+
+const char* automationShapeName(AutomationShape shape)
+{
+    switch (shape) {
+        case AutomationShape::Linear: return "linear";
+        case AutomationShape::Spline: return "spline";
+        case AutomationShape::Orbit:  return "orbit";
+        default: return "unknown";
+    }
+}
+
+static bool findAutomationShape(const char* name, AutomationShape& shape)
+{
+    for (int s = 0; s < (int)AutomationShape::Count; ++s) {
+        if (std::strcmp(automationShapeName((AutomationShape)s), name) == 0) {
+            shape = (AutomationShape)s;
+            return true;
+        }
+    }
+    return false;
+}
+
+typedef struct
+{
+    int target;
+    bool loop;
+    std::vector<AutomationKeyframe> keyframes;
+    std::vector<float> turns;       // orbits' requested sweep
+} ParsedTrack;
+
+static ParsedTrack& trackFor(std::vector<ParsedTrack>& tracks, int target)
+{
+    for (ParsedTrack& track : tracks) {
+        if (track.target == target)
+            return track;
+    }
+    tracks.push_back(ParsedTrack { target, false, {}, {} });
+    return tracks.back();
+}
+
+// Angle of (x, y) round (cx, cy), in turns.
+static float turnsAround(float x, float y, float cx, float cy)
+{
+    return (float)(std::atan2(y - cy, x - cx) / (2 * M_PI));
+}
+
+// Work out the orbits' angles and the splines' velocities, now that every
+// keyframe of the track is known.
+static void resolveTrack(ParsedTrack& track)
+{
+    std::vector<AutomationKeyframe>& keys = track.keyframes;
+    const int n = (int)keys.size();
+    // A loop's last keyframe is its first one again, one period on
+    const bool wrap = track.loop && n >= 3;
+    const double period = keys[n - 1].time - keys[0].time;
+
+    for (int k = 0; k + 1 < n; ++k) {
+        AutomationKeyframe& key = keys[k];
+        if (key.shape != AutomationShape::Orbit)
+            continue;
+        const AutomationKeyframe& next = keys[k + 1];
+        key.angle = turnsAround(key.x, key.y, key.centreX, key.centreY);
+        float delta = turnsAround(next.x, next.y, key.centreX, key.centreY) - key.angle;
+        delta -= std::floor(delta + 0.5f);
+        key.sweep = delta + std::round(track.turns[k] - delta);
+        key.radius = std::hypot(key.x - key.centreX, key.y - key.centreY);
+        key.radiusEnd = std::hypot(next.x - key.centreX, next.y - key.centreY);
+    }
+
+    for (int k = 0; k < n; ++k) {
+        AutomationKeyframe& key = keys[k];
+        int prev = k > 0 ? k - 1 : (wrap ? n - 2 : -1);
+        int next = k + 1 < n ? k + 1 : (wrap ? 1 : -1);
+        // The segment into this keyframe, and the one out of it
+        bool splineIn = prev >= 0 && keys[prev].shape == AutomationShape::Spline;
+        bool splineOut = next >= 0 && keys[k + 1 < n ? k : 0].shape == AutomationShape::Spline;
+
+        // Across the wrap, a neighbour is shifted by a period, and by however
+        // far the last keyframe is from the first (a yaw a whole turn on)
+        float slopeIn[3] = {}, slopeOut[3] = {};
+        if (prev >= 0) {
+            const AutomationKeyframe& p = keys[prev];
+            float back = prev > k ? 1.0f : 0.0f;
+            float dt = (float)(key.time - p.time + back * period);
+            slopeIn[0] = (key.x - p.x + back * (keys[n - 1].x - keys[0].x)) / dt;
+            slopeIn[1] = (key.y - p.y + back * (keys[n - 1].y - keys[0].y)) / dt;
+            slopeIn[2] = (key.yaw - p.yaw + back * (keys[n - 1].yaw - keys[0].yaw)) / dt;
+        }
+        if (next >= 0) {
+            const AutomationKeyframe& q = keys[next];
+            float on = next < k ? 1.0f : 0.0f;
+            float dt = (float)(q.time - key.time + on * period);
+            slopeOut[0] = (q.x - key.x + on * (keys[n - 1].x - keys[0].x)) / dt;
+            slopeOut[1] = (q.y - key.y + on * (keys[n - 1].y - keys[0].y)) / dt;
+            slopeOut[2] = (q.yaw - key.yaw + on * (keys[n - 1].yaw - keys[0].yaw)) / dt;
+        }
+
+        // Between two splines, the mean of the slopes either side; where a
+        // spline meets another shape, that shape's slope, so the join is
+        // smooth; at an open end, at rest.
+        float v[3] = {};
+        for (int c = 0; c < 3; ++c) {
+            if (splineIn && splineOut)
+                v[c] = 0.5f * (slopeIn[c] + slopeOut[c]);
+            else if (splineOut)
+                v[c] = prev >= 0 ? slopeIn[c] : 0.0f;
+            else if (splineIn)
+                v[c] = next >= 0 ? slopeOut[c] : 0.0f;
+        }
+        key.vx = v[0];
+        key.vy = v[1];
+        key.vyaw = v[2];
+    }
+}
+
+bool parseAutomation(const char* text, const SpeakerLayout& layout, Automation& automation, const char* name)
+{
+    std::vector<ParsedTrack> tracks;
+    int lineNumber = 0;
+    const char* p = text;
+    while (*p) {
+        const char* end = std::strchr(p, '\n');
+        if (!end)
+            end = p + std::strlen(p);
+        std::string line(p, end);
+        p = *end ? end + 1 : end;
+        ++lineNumber;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.resize(comment);
+
+        char word[64];
+        int used = 0;
+        if (std::sscanf(line.c_str(), " %63s%n", word, &used) != 1)
+            continue;
+        const char* rest = line.c_str() + used;
+
+        if (std::strcmp(word, "loop") == 0) {
+            char target[64];
+            int more = 0;
+            int channel = -1;
+            if (std::sscanf(rest, " %63s %n", target, &more) != 1 || rest[more] != '\0' ||
+                (std::strcmp(target, "listener") != 0 && (channel = findSpeakerChannel(layout, target)) < 0)) {
+                std::fprintf(stderr, "%s:%d: expected loop <listener|speaker>\n", name, lineNumber);
+                return false;
+            }
+            trackFor(tracks, channel).loop = true;
+            continue;
+        }
+
+        bool listener = std::strcmp(word, "listener") == 0;
+        int target = listener ? -1 : findSpeakerChannel(layout, word);
+        if (!listener && target < 0) {
+            std::fprintf(stderr, "%s:%d: no listener or speaker '%s' in the %s layout\n",
+                         name, lineNumber, word, layout.name);
+            return false;
+        }
+
+        AutomationKeyframe key = {};
+        float time;
+        int more = 0;
+        int fields = std::sscanf(rest, " %f %f %f %n", &time, &key.x, &key.y, &more);
+        // The listener's line carries a yaw after the position
+        int yawUsed = 0;
+        if (fields == 3 && listener && std::sscanf(rest + more, "%f %n", &key.yaw, &yawUsed) == 1) {
+            ++fields;
+            more += yawUsed;
+        }
+        char shape[64] = "linear";
+        float turns = 0.0f;
+        bool ok = fields == (listener ? 4 : 3) && std::isfinite(time) && time >= 0.0f &&
+                  std::isfinite(key.x) && std::isfinite(key.y) && std::isfinite(key.yaw);
+        if (ok && rest[more] != '\0') {
+            int shapeUsed = 0;
+            std::sscanf(rest + more, "%63s %n", shape, &shapeUsed);
+            more += shapeUsed;
+        }
+        ok = ok && findAutomationShape(shape, key.shape);
+        if (ok && key.shape == AutomationShape::Orbit) {
+            int orbitUsed = 0;
+            ok = std::sscanf(rest + more, "%f %f %n", &key.centreX, &key.centreY, &orbitUsed) == 2 &&
+                 std::isfinite(key.centreX) && std::isfinite(key.centreY);
+            more += orbitUsed;
+            int turnsUsed = 0;
+            if (ok && std::sscanf(rest + more, "%f %n", &turns, &turnsUsed) == 1) {
+                more += turnsUsed;
+                ok = std::isfinite(turns);
+            }
+        }
+        if (!ok || rest[more] != '\0') {
+            std::fprintf(stderr, "%s:%d: expected %s <time s> <x> <y>%s [linear|spline|orbit <x> <y> [turns]]\n",
+                         name, lineNumber, word, listener ? " <yaw>" : "");
+            return false;
+        }
+        key.time = time;
+
+        ParsedTrack& track = trackFor(tracks, target);
+        if (!track.keyframes.empty() && key.time <= track.keyframes.back().time) {
+            std::fprintf(stderr, "%s:%d: %s keyframes must be in increasing time\n", name, lineNumber, word);
+            return false;
+        }
+        track.keyframes.push_back(key);
+        track.turns.push_back(turns);
+    }
+
+    int keyframes = 0;
+    for (ParsedTrack& track : tracks) {
+        if (track.keyframes.empty() || (track.loop && track.keyframes.size() < 2)) {
+            std::fprintf(stderr, "%s: a looping track needs two keyframes or more\n", name);
+            return false;
+        }
+        keyframes += (int)track.keyframes.size();
+    }
+    if (tracks.size() > AUTOMATION_MAX_TRACKS || keyframes > AUTOMATION_MAX_KEYFRAMES) {
+        std::fprintf(stderr, "%s: more than %d tracks or %d keyframes\n", name, AUTOMATION_MAX_TRACKS,
+                     AUTOMATION_MAX_KEYFRAMES);
+        return false;
+    }
+
+    automation.trackCount = 0;
+    int first = 0;
+    for (ParsedTrack& track : tracks) {
+        resolveTrack(track);
+        AutomationTrack& out = automation.tracks[automation.trackCount++];
+        out.target = track.target;
+        out.first = first;
+        out.count = (int)track.keyframes.size();
+        out.loop = track.loop;
+        std::copy(track.keyframes.begin(), track.keyframes.end(), automation.keyframes + first);
+        first += out.count;
+    }
+    return true;
+}
+
+bool loadAutomation(const char* path, const SpeakerLayout& layout, Automation& automation)
+{
+    FILE* file = std::fopen(path, "r");
+    if (!file) {
+        std::fprintf(stderr, "Could not open automation %s\n", path);
+        return false;
+    }
+    std::string text;
+    char chunk[4096];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+        text.append(chunk, n);
+    std::fclose(file);
+    return parseAutomation(text.c_str(), layout, automation, path);
+}
+
+void evaluateAutomation(const Automation& automation, const AutomationTrack& track, double seconds,
+                        float& x, float& y, float& yaw)
+{
+    const AutomationKeyframe* keys = automation.keyframes + track.first;
+    const int n = track.count;
+    double t = seconds;
+    if (track.loop && t > keys[n - 1].time)
+        t = keys[0].time + std::fmod(t - keys[0].time, keys[n - 1].time - keys[0].time);
+
+    if (t <= keys[0].time || t >= keys[n - 1].time) {
+        const AutomationKeyframe& key = t <= keys[0].time ? keys[0] : keys[n - 1];
+        x = key.x;
+        y = key.y;
+        yaw = key.yaw - std::floor(key.yaw);
+        return;
+    }
+
+    // The segment holding t: the last keyframe at or before it
+    const AutomationKeyframe* next = std::upper_bound(keys, keys + n, t,
+        [](double time, const AutomationKeyframe& key) { return time < key.time; });
+    const AutomationKeyframe& a = next[-1];
+    const AutomationKeyframe& b = *next;
+    float dt = (float)(b.time - a.time);
+    float u = (float)((t - a.time) / (b.time - a.time));
+
+    switch (a.shape) {
+        case AutomationShape::Spline: {
+            // Cubic Hermite between the keyframes and their velocities
+            float u2 = u * u, u3 = u2 * u;
+            float h00 = 2 * u3 - 3 * u2 + 1, h10 = u3 - 2 * u2 + u;
+            float h01 = -2 * u3 + 3 * u2, h11 = u3 - u2;
+            x = h00 * a.x + h10 * dt * a.vx + h01 * b.x + h11 * dt * b.vx;
+            y = h00 * a.y + h10 * dt * a.vy + h01 * b.y + h11 * dt * b.vy;
+            yaw = h00 * a.yaw + h10 * dt * a.vyaw + h01 * b.yaw + h11 * dt * b.vyaw;
+            break;
+        }
+        case AutomationShape::Orbit: {
+            float angle = (float)(2 * M_PI) * (a.angle + a.sweep * u);
+            float radius = a.radius + (a.radiusEnd - a.radius) * u;
+            x = a.centreX + radius * std::cos(angle);
+            y = a.centreY + radius * std::sin(angle);
+            yaw = a.yaw + (b.yaw - a.yaw) * u;
+            break;
+        }
+        default:
+            x = a.x + (b.x - a.x) * u;
+            y = a.y + (b.y - a.y) * u;
+            yaw = a.yaw + (b.yaw - a.yaw) * u;
+            break;
+    }
+    yaw -= std::floor(yaw);
+}
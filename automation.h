@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include "speaker_layout.h"
+
+// Keyframes in one script, across all of its tracks.
+#define AUTOMATION_MAX_KEYFRAMES (512)
+// Tracks in one script: the listener and up to this many less one speakers.
+#define AUTOMATION_MAX_TRACKS (32)
+// Frames between evaluations of a running script (see
+// RenderEngine::setAutomationStep); gains ramp per sample in between.
+#define AUTOMATION_STEP_FRAMES (64)
+
+// How a keyframe moves on to the next one of its track.
+enum class AutomationShape
+{
+    Linear = 0,     // a straight line at constant speed
+    Spline,         // a cubic through the keyframes, smooth in velocity
+    Orbit,          // round a centre at constant angular speed
+    Count
+};
+
+const char* automationShapeName(AutomationShape shape);   // "linear", "spline", "orbit"
+
+// A position (and, for the listener, a yaw) at a time, in the coordinates of
+// SpatialState: metres in the room, yaw in turns. Everything a segment needs
+// is worked out when the script is loaded, so evaluating it is a handful of
+// multiplies.
+typedef struct
+{
+    double time;                // seconds from the start of the script
+    float x;
+    float y;
+    float yaw;                  // as written: 0 to 1 is a whole turn
+    AutomationShape shape;      // of the segment from here to the next keyframe
+    float vx, vy, vyaw;         // velocity here, per second, for splines
+    float centreX, centreY;     // orbits: the centre,
+    float angle, sweep;         // the angle here and the turns to the next keyframe,
+    float radius, radiusEnd;    // and the distance from the centre here and there
+} AutomationKeyframe;
+
+// The keyframes [first, first + count) of a script, in time order.
+typedef struct
+{
+    int target;                 // -1 for the listener, else a speaker channel
+    int first;
+    int count;
+    bool loop;                  // repeat from the first keyframe after the last
+} AutomationTrack;
+
+// A keyframed script for the listener's pose and the speakers' positions,
+// run by the engine on the audio thread with no messages per pose. Fixed
+// size, so a whole script is published through a TripleBuffer (see
+// setAutomation() in utils.h).
+typedef struct
+{
+    AutomationTrack tracks[AUTOMATION_MAX_TRACKS];
+    int trackCount;             // 0: nothing is automated
+    AutomationKeyframe keyframes[AUTOMATION_MAX_KEYFRAMES];
+    unsigned int version;       // bumped on every publish; the engine restarts the script's clock
+} Automation;
+
+// Parse a script, one keyframe per line ('#' starts a comment):
+//     listener <time s> <x> <y> <yaw> [shape]
+//     <speaker> <time s> <x> <y> [shape]
+//     loop <listener|speaker>
+// The speaker is one of layout's channel names or a 1-based channel number.
+// Shape, for the segment to the track's next keyframe, is linear (the
+// default), spline, or orbit <centre x> <centre y> [turns]. An orbit goes
+// round the centre from one keyframe to the next, the way round nearest
+// `turns` (0, the default, is the short way; 1 one full turn anticlockwise),
+// with its distance from the centre moving linearly between the two.
+// `name` is used in error messages. False, with the reason printed, if the
+// script is malformed.
+bool parseAutomation(const char* text, const SpeakerLayout& layout, Automation& automation,
+                     const char* name = "automation");
+
+// parseAutomation() on the contents of a file.
+bool loadAutomation(const char* path, const SpeakerLayout& layout, Automation& automation);
+
+// Where `track` is `seconds` after the script started: before its first
+// keyframe it waits there, after its last it stays there unless it loops.
+// Yaw is wrapped into [0, 1). No allocation; safe on the audio thread.
+void evaluateAutomation(const Automation& automation, const AutomationTrack& track, double seconds,
+                        float& x, float& y, float& yaw);
@@ -0,0 +1,161 @@
+// Ambisonic panning: checks that rotating the bus preserves energy, then
+// times the three panning modes while the listener only turns (the common
+// case with a head tracker), where the ambisonic mode just rotates its
+// encoder instead of rebuilding a speakers x sources matrix.
+//
+// Energy check: one source on a regular 16-speaker ring (plus LFE), listener
+// at the centre, gain ramping off. The output energy must not change with
+// yaw by more than kMaxEnergyDb at any order, while the loudest speaker
+// follows the rotation round the whole ring.
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include "bench_common.h"
+#include "../render_engine.h"
+
+static const int kBlocks = 2000;
+static const int kYawSteps = 97;
+static const double kMaxEnergyDb = 0.01;
+
+static void buildRing(SpeakerArrayLayout& ring, int speakers)
+{
+    ring.clear();
+    ring.addSpeaker("LFE", 0.0f, 0.0f, true);
+    for (int i = 0; i < speakers - 1; ++i)
+        ring.addSpeaker("S" + std::to_string(i + 1), (float)i / (speakers - 1), 1.7f);
+}
+
+static void setYaw(paTestData& data, float yaw)
+{
+    updateSpatialState(&data, [yaw](SpatialState& s) { s.listenerYaw = yaw; });
+}
+
+static bool checkEnergyUnderRotation(paTestData& data, int order)
+{
+    std::unique_ptr<RenderEngine> engine = createRenderEngine(&data);
+    if (!engine)
+        std::exit(EXIT_FAILURE);
+    engine->setMixThreads(0);
+    engine->setPanningMode(PanningMode::Ambisonic);
+    engine->setAmbisonicOrder(order);
+    engine->setGainRamping(false);
+    if (!engine->prepare(RENDER_BLOCK_FRAMES))
+        std::exit(EXIT_FAILURE);
+
+    const int channels = engine->outputChannels();
+    std::vector<float> out(RENDER_BLOCK_FRAMES * channels);
+    double minEnergy = 1e30, maxEnergy = 0;
+    std::vector<bool> peaked(channels, false);
+
+    for (int step = 0; step < kYawSteps; ++step) {
+        setYaw(data, (float)step / kYawSteps);
+        data.readIndex = 0;
+        engine->render(out.data(), RENDER_BLOCK_FRAMES);
+
+        double energy = 0;
+        std::vector<double> perSpeaker(channels, 0.0);
+        for (size_t i = 0; i < out.size(); ++i) {
+            energy += (double)out[i] * out[i];
+            perSpeaker[i % channels] += (double)out[i] * out[i];
+        }
+        int loudest = 0;
+        for (int ch = 1; ch < channels; ++ch) {
+            if (perSpeaker[ch] > perSpeaker[loudest])
+                loudest = ch;
+        }
+        peaked[loudest] = true;
+        minEnergy = std::fmin(minEnergy, energy);
+        maxEnergy = std::fmax(maxEnergy, energy);
+    }
+    setYaw(data, 0.0f);
+
+    int peakedSpeakers = 0;
+    for (bool p : peaked)
+        peakedSpeakers += p;
+
+    double spreadDb = 10 * std::log10(maxEnergy / minEnergy);
+    // every ring speaker, but not the LFE, is loudest at some yaw
+    bool ok = spreadDb <= kMaxEnergyDb && peakedSpeakers == channels - 1;
+    std::printf("  order %d: energy spread over %d yaws %.5f dB, loudest on %d speakers %s\n",
+                engine->ambisonicOrder(), kYawSteps, spreadDb, peakedSpeakers, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+// ns per frame with the listener turning every block.
+static double turningNsPerFrame(paTestData& data, PanningMode mode)
+{
+    std::unique_ptr<RenderEngine> engine = createRenderEngine(&data);
+    if (!engine)
+        std::exit(EXIT_FAILURE);
+    engine->setMixThreads(0);
+    engine->setPanningMode(mode);
+    if (!engine->prepare(RENDER_BLOCK_FRAMES))
+        std::exit(EXIT_FAILURE);
+    std::vector<float> out(RENDER_BLOCK_FRAMES * engine->outputChannels());
+    data.readIndex = 0;
+
+    double total = 0;
+    rtResetAllocationCount();
+    for (int block = 0; block < kBlocks; ++block) {
+        setYaw(data, block * 0.001f);
+
+        double start = benchNowNs();
+        {
+            RtAllocScope allocScope;
+            engine->render(out.data(), RENDER_BLOCK_FRAMES);
+        }
+        total += benchNowNs() - start;
+    }
+    benchRequireNoAllocations(panningModeName(mode));
+    return total / ((double)kBlocks * RENDER_BLOCK_FRAMES);
+}
+
+int main()
+{
+    static paTestData data;
+    static SpeakerArrayLayout ring;
+    const float seconds = (float)kBlocks * RENDER_BLOCK_FRAMES / SAMPLE_RATE + 1.0f;
+    bool ok = true;
+
+    std::printf("ambisonics  one source on a 16-speaker ring, listener turning\n");
+    buildRing(ring, 17);
+    benchInitRoom(data, seconds, ring.layout());
+    // Keep only the front-left source
+    std::vector<float> source(data.audio.data(), data.audio.data() + data.audio.size());
+    for (size_t i = 0; i < source.size(); ++i) {
+        if (i % DECODED_CHANNELS != 0)
+            source[i] = 0.0f;
+    }
+    data.audio.assign(std::move(source));
+    for (int order = 1; order <= AMBI_MAX_ORDER; ++order)
+        ok = checkEnergyUnderRotation(data, order) && ok;
+
+    std::printf("  %-9s %18s %18s %18s\n", "layout", "gaussian ns/frame",
+                "vbap ns/frame", "ambisonic ns/frame");
+
+    auto report = [&](const char* name) {
+        std::printf("  %-9s %18.2f %18.2f %18.2f\n", name,
+                    turningNsPerFrame(data, PanningMode::Gaussian),
+                    turningNsPerFrame(data, PanningMode::Vbap),
+                    turningNsPerFrame(data, PanningMode::Ambisonic));
+    };
+
+    for (int id = 0; id < (int)SpeakerLayoutId::Count; ++id) {
+        const SpeakerLayout& layout = getSpeakerLayout((SpeakerLayoutId)id);
+        benchInitRoom(data, seconds, layout);
+        report(layout.name);
+    }
+    for (int speakers : { 32, 64, 128 }) {
+        buildRing(ring, speakers);
+        benchInitRoom(data, seconds, ring.layout());
+        std::string name = std::to_string(speakers) + " ring";
+        report(name.c_str());
+    }
+
+    if (!ok) {
+        std::fprintf(stderr, "ambisonic rotation changed the output energy\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
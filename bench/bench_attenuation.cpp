@@ -0,0 +1,203 @@
+// Distance attenuation: checks the baked lookup tables against the analytic
+// laws and a measured curve across the whole reachable range, compares the
+// cost of evaluating the model per speaker with the scalar and batched table
+// lookups, and renders with every law while the listener walks about.
+//
+// Fails if a table is off by more than kToleranceDb wherever the gain is
+// above -60 dB, the batched lookup disagrees with the scalar one, or the
+// audio path allocates.
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+#include "bench_common.h"
+#include "../attenuation.h"
+#include "../render_engine.h"
+
+static const float kToleranceDb = 0.02f;
+static const int kDistances = 128;
+static const int kRepeats = 20000;
+static const char* kCurvePath = "/tmp/bench_attenuation_curve.txt";
+
+static float toDb(float gain)
+{
+    return 20.0f * std::log10(std::max(gain, 1e-9f));
+}
+
+// Table against the model it was baked from, normalised the same way, at
+// many points between and on the table entries.
+static bool checkTable(const AttenuationModel& model, float maxDistance, const char* what)
+{
+    static AttenuationTable table;
+    buildAttenuationTable(model, maxDistance, table);
+
+    const int points = 100000;
+    std::vector<float> distances(points + 1), batched(points + 1), exact(points + 1);
+    float loudest = 0.0f;
+    for (int i = 0; i <= points; ++i) {
+        distances[i] = maxDistance * i / points;
+        exact[i] = model.evaluate(distances[i]);
+        loudest = std::max(loudest, exact[i]);
+    }
+    attenuationGains(table, distances.data(), batched.data(), points + 1);
+
+    float maxErrorDb = 0.0f;
+    bool batchOk = true;
+    for (int i = 0; i <= points; ++i) {
+        float expected = exact[i] / loudest;
+        float gain = attenuationGain(table, distances[i]);
+        batchOk = batchOk && std::fabs(batched[i] - gain) <= 1e-6f;
+        if (expected < 1e-3f)
+            continue;
+        maxErrorDb = std::max(maxErrorDb, std::fabs(toDb(gain) - toDb(expected)));
+    }
+
+    // Beyond the baked range the last entry holds
+    float beyond = attenuationGain(table, 2 * maxDistance);
+    bool held = beyond == table.gains[ATTENUATION_TABLE_SIZE];
+
+    bool ok = maxErrorDb <= kToleranceDb && batchOk && held;
+    std::printf("  %-34s max error %.4f dB%s%s %s\n", what, maxErrorDb,
+                batchOk ? "" : ", batched lookup differs", held ? "" : ", not held beyond range",
+                ok ? "ok" : "FAILED");
+    return ok;
+}
+
+static bool writeCurve()
+{
+    FILE* file = std::fopen(kCurvePath, "w");
+    if (!file)
+        return false;
+    std::fprintf(file, "# distance m   gain dB\n"
+                       "0.5   0\n"
+                       "1     -1.5\n"
+                       "2     -5\n"
+                       "4     -11.5   # past the critical distance\n"
+                       "8     -16\n");
+    std::fclose(file);
+    return true;
+}
+
+// Nanoseconds to turn kDistances distances into gains.
+template <typename Fn>
+static double timeGains(Fn&& gains)
+{
+    double best = 1e30;
+    for (int round = 0; round < 5; ++round) {
+        double start = benchNowNs();
+        for (int r = 0; r < kRepeats; ++r)
+            gains();
+        best = std::min(best, (benchNowNs() - start) / kRepeats);
+    }
+    return best;
+}
+
+static void printCost(const AttenuationModel& model, float maxDistance)
+{
+    static AttenuationTable table;
+    buildAttenuationTable(model, maxDistance, table);
+
+    std::vector<float> distances(kDistances), gains(kDistances);
+    for (int i = 0; i < kDistances; ++i)
+        distances[i] = maxDistance * ((i * 37) % kDistances) / kDistances;
+    volatile float sink = 0.0f;
+
+    // The model unnormalised, as distanceToGain was: no divide included
+    double analytic = timeGains([&]() {
+        for (int i = 0; i < kDistances; ++i)
+            gains[i] = model.evaluate(distances[i]);
+        sink = sink + gains[kDistances - 1];
+    });
+    double scalar = timeGains([&]() {
+        for (int i = 0; i < kDistances; ++i)
+            gains[i] = attenuationGain(table, distances[i]);
+        sink = sink + gains[kDistances - 1];
+    });
+    double batched = timeGains([&]() {
+        attenuationGains(table, distances.data(), gains.data(), kDistances);
+        sink = sink + gains[kDistances - 1];
+    });
+    double build = timeGains([&]() {
+        buildAttenuationTable(model, maxDistance, table);
+        sink = sink + table.gains[1];
+    });
+    std::printf("  %-16s %12.1f %12.1f %12.1f %12.0f\n", attenuationLawName(model.law()),
+                analytic, scalar, batched, build);
+}
+
+// The engine rebuilds its gains from the table on every pose.
+static void renderWalking(const AttenuationModel& model, const SpeakerLayout& layout, const char* what)
+{
+    static paTestData data;
+    const int blocks = 200;
+    data.attenuationModel = model;
+    benchInitRoom(data, (float)blocks * RENDER_BLOCK_FRAMES / SAMPLE_RATE + 1.0f, layout);
+    std::unique_ptr<RenderEngine> engine = createRenderEngine(&data);
+    if (!engine || !engine->prepare(RENDER_BLOCK_FRAMES))
+        std::exit(EXIT_FAILURE);
+    std::vector<float> out((size_t)RENDER_BLOCK_FRAMES * engine->outputChannels());
+
+    rtResetAllocationCount();
+    for (int block = 0; block < blocks; ++block) {
+        applyTrackerPose(&data, 2.0f * std::sin(block * 0.05f), -1.5f + std::cos(block * 0.05f), 0.0f);
+        RtAllocScope allocScope;
+        engine->render(out.data(), RENDER_BLOCK_FRAMES);
+    }
+    benchRequireNoAllocations(what);
+}
+
+int main()
+{
+    bool ok = true;
+    // The default room's reachable range
+    static paTestData data;
+    initDefaultRoom(&data, defaultSpeakerLayout());
+    const float maxDistance = data.spatial.latest().attenuation.maxDistance;
+
+    std::printf("attenuation  %d-interval tables over 0..%.2f m, tolerance %.2f dB above -60 dB\n",
+                ATTENUATION_TABLE_SIZE, maxDistance, kToleranceDb);
+    AttenuationModel linear, inverse, inverseSquare, curve;
+    inverse.setLaw(AttenuationLaw::InverseDistance, 1.0f);
+    inverseSquare.setLaw(AttenuationLaw::InverseSquare, 1.0f);
+    if (!writeCurve() || !curve.loadCurve(kCurvePath)) {
+        std::fprintf(stderr, "could not write the test curve\n");
+        return EXIT_FAILURE;
+    }
+    ok = checkTable(linear, maxDistance, "linear") && ok;
+    ok = checkTable(inverse, maxDistance, "inverse, reference 1 m") && ok;
+    ok = checkTable(inverseSquare, maxDistance, "inverse-square, reference 1 m") && ok;
+    for (float reference : { 0.25f, 3.0f }) {
+        AttenuationModel model;
+        model.setLaw(AttenuationLaw::InverseSquare, reference);
+        char what[64];
+        std::snprintf(what, sizeof(what), "inverse-square, reference %.2f m", reference);
+        ok = checkTable(model, maxDistance, what) && ok;
+    }
+    ok = checkTable(inverseSquare, 40.0f, "inverse-square over 40 m") && ok;
+    ok = checkTable(curve, maxDistance, "measured curve") && ok;
+
+    std::printf("  ns per %d speakers  %12s %12s %12s %12s\n", kDistances,
+                "model", "table", "batched", "bake");
+    for (const AttenuationModel* model : { &linear, &inverse, &inverseSquare, &curve })
+        printCost(*model, maxDistance);
+
+    static SpeakerArrayLayout ring;
+    ring.clear();
+    ring.addSpeaker("LFE", 0.0f, 0.0f, true);
+    for (int i = 0; i < 31; ++i)
+        ring.addSpeaker("S" + std::to_string(i + 1), i / 31.0f, 1.5f + 0.5f * (i % 4));
+    for (const AttenuationModel* model : { &linear, &inverse, &inverseSquare, &curve }) {
+        renderWalking(*model, defaultSpeakerLayout(), "5.1 render");
+        renderWalking(*model, ring.layout(), "32-speaker render");
+    }
+    std::printf("  %-34s %s\n", "renders with every law", "no allocations ok");
+
+    std::remove(kCurvePath);
+    if (!ok) {
+        std::fprintf(stderr, "attenuation tables failed\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,289 @@
+// Trajectory automation: checks the segment shapes and the script parser,
+// then moves the listener round a looping spline-and-orbit path for
+// kSeconds, once streamed as 1 kHz tracker poses applied at each callback
+// (as examples/spin.cpp does over stdin) and once as a script the engine
+// evaluates every 256, 64 and 16 frames. Each output is compared with the
+// script evaluated for every single frame, and the script's clock is
+// checked against host buffers of uneven sizes.
+//
+// Fails if a shape or the parser is wrong, the engine's clock drifts from
+// the frames rendered, clearing the script leaves a speaker moved, a
+// script evaluated every 64 frames is not closer to the per-frame output
+// than the streamed poses, or the audio path allocates.
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include "bench_common.h"
+#include "../automation.h"
+#include "../six_channel.h"
+#include "../render_engine.h"
+
+static const double kSeconds = 5.0;
+static const unsigned long kHostFrames = 256;
+static const double kTrackerRate = 1000.0;
+static const float kTolerance = 1e-4f;
+
+// The listener weaves out and back on splines, then walks a full circle
+// of 1 m round the middle of the room, turning once as it goes.
+static const char* kPath =
+    "listener 0  0 0   0     spline\n"
+    "listener 1  1 0.5 0.1   spline\n"
+    "listener 2  0 1   0.25  orbit 0 0 1\n"
+    "listener 4  0 1   1.25\n"
+    "listener 5  0 0   1\n"
+    "loop listener\n";
+
+static bool near(float a, float b)
+{
+    return std::fabs(a - b) <= kTolerance;
+}
+
+static bool checkShapes()
+{
+    bool ok = true;
+    const SpeakerLayout& layout = defaultSpeakerLayout();
+    static Automation automation;
+    float x, y, yaw;
+
+    // Linear: halfway is the midpoint; before and after, the ends hold
+    ok = ok && parseAutomation("listener 1 0 0 0\nlistener 3 2 -4 0.5\n", layout, automation);
+    evaluateAutomation(automation, automation.tracks[0], 2.0, x, y, yaw);
+    ok = ok && near(x, 1.0f) && near(y, -2.0f) && near(yaw, 0.25f);
+    evaluateAutomation(automation, automation.tracks[0], 0.0, x, y, yaw);
+    ok = ok && near(x, 0.0f) && near(y, 0.0f);
+    evaluateAutomation(automation, automation.tracks[0], 9.0, x, y, yaw);
+    ok = ok && near(x, 2.0f) && near(y, -4.0f) && near(yaw, 0.5f);
+    if (!ok)
+        std::fprintf(stderr, "linear segment is wrong\n");
+
+    // Spline: through every keyframe, with the velocity continuous across
+    // the middle one, and it loops seamlessly
+    bool splineOk = parseAutomation(kPath, layout, automation);
+    const AutomationTrack& path = automation.tracks[0];
+    const double keys[] = { 0.0, 1.0, 2.0, 4.0 };
+    const float expected[][2] = { { 0, 0 }, { 1, 0.5f }, { 0, 1 }, { 0, 1 } };
+    for (int k = 0; k < 4; ++k) {
+        evaluateAutomation(automation, path, keys[k], x, y, yaw);
+        splineOk = splineOk && near(x, expected[k][0]) && near(y, expected[k][1]);
+    }
+    const double h = 1e-3;
+    float x0, y0, x1, y1, x2, y2;
+    evaluateAutomation(automation, path, 1.0 - h, x0, y0, yaw);
+    evaluateAutomation(automation, path, 1.0, x1, y1, yaw);
+    evaluateAutomation(automation, path, 1.0 + h, x2, y2, yaw);
+    splineOk = splineOk && std::fabs((x1 - x0) - (x2 - x1)) < 1e-3f && std::fabs((y1 - y0) - (y2 - y1)) < 1e-3f;
+    for (double t = 0.0; t < 5.0; t += 0.37) {
+        float lx, ly, lyaw;
+        evaluateAutomation(automation, path, t, x, y, yaw);
+        evaluateAutomation(automation, path, t + 10.0, lx, ly, lyaw);
+        splineOk = splineOk && near(x, lx) && near(y, ly) && near(yaw, lyaw);
+    }
+    if (!splineOk)
+        std::fprintf(stderr, "spline segment or loop is wrong\n");
+    ok = ok && splineOk;
+
+    // Orbit: one full turn anticlockwise on the circle, through its far
+    // side at the halfway mark, yaw wrapped into [0, 1)
+    bool orbitOk = true;
+    for (double t = 2.0; t <= 4.0; t += 0.01) {
+        evaluateAutomation(automation, path, t, x, y, yaw);
+        orbitOk = orbitOk && near(std::hypot(x, y), 1.0f) && yaw >= 0.0f && yaw < 1.0f;
+    }
+    evaluateAutomation(automation, path, 2.5, x, y, yaw);
+    orbitOk = orbitOk && near(x, -1.0f) && near(y, 0.0f) && near(yaw, 0.5f);
+    evaluateAutomation(automation, path, 3.0, x, y, yaw);
+    orbitOk = orbitOk && near(x, 0.0f) && near(y, -1.0f);
+    // Without turns, the short way: clockwise from the front to the right
+    orbitOk = orbitOk && parseAutomation("FrontLeft 0 0 1 orbit 0 0\nFrontLeft 1 1 0\n", layout, automation);
+    evaluateAutomation(automation, automation.tracks[0], 0.5, x, y, yaw);
+    orbitOk = orbitOk && near(x, std::sqrt(0.5f)) && near(y, std::sqrt(0.5f));
+    if (!orbitOk)
+        std::fprintf(stderr, "orbit segment is wrong\n");
+    ok = ok && orbitOk;
+
+    // Malformed scripts are refused, and leave the automation alone
+    const char* bad[] = {
+        "listener 0 0 0\n",                         // no yaw
+        "listener 0 0 0 0 zigzag\n",                // no such shape
+        "listener 1 0 0 0\nlistener 1 1 1 0\n",     // time does not increase
+        "Nowhere 0 0 0\n",                          // no such speaker
+        "Centre 0 0 0 orbit 0\n",                   // orbit without a centre
+        "Centre 0 0 0 linear extra\n",              // trailing words
+        "listener 0 0 0 0\nloop listener\n",        // one keyframe cannot loop
+        "listener 0 nan 0 0\n",
+    };
+    std::printf("  malformed scripts, expect %d errors:\n", (int)(sizeof(bad) / sizeof(bad[0])));
+    std::fflush(stdout);
+    automation.trackCount = 7;
+    for (const char* script : bad) {
+        if (parseAutomation(script, layout, automation, "    bad script") || automation.trackCount != 7) {
+            std::fprintf(stderr, "accepted a malformed script: %s", script);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// Render host buffers of uneven sizes and check, after each, that the
+// engine has the script where it should be after the frames rendered; then
+// clear the script and check the speaker goes back.
+static bool checkClock()
+{
+    static paTestData data;
+    benchInitRoom(data, (float)kSeconds + 1.0f);
+    static Automation automation;
+    if (!parseAutomation("FrontLeft 0 -1 1 orbit 0 0 -1\nFrontLeft 2 -1 1\nloop FrontLeft\n"
+                         "listener 0.5 0 0 0 spline\nlistener 3 0.5 -0.5 0.2\n",
+                         *data.layout, automation))
+        return false;
+    setAutomation(&data, automation);
+
+    std::unique_ptr<RenderEngine> engine = createRenderEngine(&data);
+    if (!engine || !engine->prepare(RENDER_BLOCK_FRAMES))
+        std::exit(EXIT_FAILURE);
+    std::vector<float> out((size_t)1000 * engine->outputChannels());
+    Point home = data.spatial.latest().speakerPositions[FrontLeft];
+
+    bool ok = true;
+    unsigned long long rendered = 0;
+    rtResetAllocationCount();
+    for (unsigned long chunk = 1; rendered < kSeconds * SAMPLE_RATE; chunk = chunk * 7 % 1000 + 1) {
+        {
+            RtAllocScope allocScope;
+            engine->render(out.data(), chunk);
+        }
+        rendered += chunk;
+        const SpatialState& state = engine->acquireState();
+        double seconds = (double)rendered / SAMPLE_RATE;
+        for (int i = 0; i < automation.trackCount; ++i) {
+            const AutomationTrack& track = automation.tracks[i];
+            float x, y, yaw;
+            evaluateAutomation(automation, track, seconds, x, y, yaw);
+            Point p = track.target < 0 ? state.currentListenerPosition : state.speakerPositions[track.target];
+            if (p.x != x || p.y != y || (track.target < 0 && state.listenerYaw != yaw))
+                ok = false;
+        }
+    }
+    benchRequireNoAllocations("automation clock");
+    if (!ok)
+        std::fprintf(stderr, "the engine's script clock drifted from the frames rendered\n");
+
+    setAutomation(&data, Automation());
+    engine->render(out.data(), 100);
+    Point p = engine->acquireState().speakerPositions[FrontLeft];
+    if (p.x != home.x || p.y != home.y) {
+        std::fprintf(stderr, "clearing the script left the speaker at %.3f,%.3f\n", p.x, p.y);
+        ok = false;
+    }
+    return ok;
+}
+
+typedef struct
+{
+    std::vector<float> output;
+    double renderNs;
+    double publishNs;
+    unsigned long messages;
+} Run;
+
+// kSeconds of kPath in kHostFrames callbacks, as a script evaluated every
+// `step` frames, or with step 0 as tracker poses applied at each callback.
+static Run run(unsigned long step)
+{
+    static paTestData data;
+    benchInitRoom(data, (float)kSeconds + 1.0f);
+    static Automation automation;
+    if (!parseAutomation(kPath, *data.layout, automation))
+        std::exit(EXIT_FAILURE);
+    Point camera = data.spatial.latest().speakerPositions[data.layout->centre];
+    // The streamed run clears whatever script the last run left
+    setAutomation(&data, step > 0 ? automation : Automation());
+
+    std::unique_ptr<RenderEngine> engine = createRenderEngine(&data);
+    if (!engine)
+        std::exit(EXIT_FAILURE);
+    if (step > 0)
+        engine->setAutomationStep(step);
+    if (!engine->prepare(RENDER_BLOCK_FRAMES))
+        std::exit(EXIT_FAILURE);
+
+    const int channels = engine->outputChannels();
+    const long callbacks = (long)(kSeconds * SAMPLE_RATE / kHostFrames);
+    Run result = { std::vector<float>((size_t)callbacks * kHostFrames * channels), 0.0, 0.0, 0 };
+    long pose = 0;
+    rtResetAllocationCount();
+    for (long c = 0; c < callbacks; ++c) {
+        if (step == 0) {
+            // Every pose the tracker has sent by now; each one is a message
+            double now = (double)c * kHostFrames / SAMPLE_RATE;
+            double start = benchNowNs();
+            for (; pose / kTrackerRate <= now; ++pose) {
+                float x, y, yaw;
+                evaluateAutomation(automation, automation.tracks[0], pose / kTrackerRate, x, y, yaw);
+                applyTrackerPose(&data, x - camera.x, y - camera.y, yaw);
+                ++result.messages;
+            }
+            result.publishNs += benchNowNs() - start;
+        }
+        double start = benchNowNs();
+        {
+            RtAllocScope allocScope;
+            engine->render(result.output.data() + (size_t)c * kHostFrames * channels, kHostFrames);
+        }
+        result.renderNs += benchNowNs() - start;
+    }
+    benchRequireNoAllocations("automation");
+    return result;
+}
+
+// Level of the difference from the reference, relative to it, in dB.
+static double errorDb(const std::vector<float>& output, const std::vector<float>& reference)
+{
+    double error = 0, level = 0;
+    for (size_t i = 0; i < output.size(); ++i) {
+        double d = output[i] - reference[i];
+        error += d * d;
+        level += (double)reference[i] * reference[i];
+    }
+    return 10.0 * std::log10(std::max(error, 1e-30) / level);
+}
+
+int main()
+{
+    std::printf("automation  listener on a looping spline and orbit, %lu-frame callbacks, %.0f s\n",
+                kHostFrames, kSeconds);
+    bool ok = checkShapes();
+    ok = checkClock() && ok;
+
+    Run reference = run(1);
+    std::printf("  %-24s %10s %10s %12s %12s\n", "", "messages/s", "error dB", "render x rt", "publish us/s");
+    const unsigned long steps[] = { 0, 256, 64, 16 };
+    double streamedDb = 0, scriptDb = 0;
+    for (unsigned long step : steps) {
+        Run result = run(step);
+        double db = errorDb(result.output, reference.output);
+        char name[64];
+        if (step == 0)
+            std::snprintf(name, sizeof(name), "streamed %.0f Hz poses", kTrackerRate);
+        else
+            std::snprintf(name, sizeof(name), "script, every %lu frames", step);
+        std::printf("  %-24s %10.0f %10.1f %12.0f %12.1f\n", name, result.messages / kSeconds, db,
+                    kSeconds * 1e9 / result.renderNs, result.publishNs / kSeconds / 1e3);
+        if (step == 0)
+            streamedDb = db;
+        if (step == AUTOMATION_STEP_FRAMES)
+            scriptDb = db;
+    }
+    if (scriptDb >= streamedDb) {
+        std::fprintf(stderr, "the script is no closer to the per-frame output than streamed poses\n");
+        ok = false;
+    }
+
+    if (!ok) {
+        std::fprintf(stderr, "automation failed\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+// Binaural output: checks the partitioned convolution against a direct one,
+// then measures how much of the 256-frame budget one core spends rendering
+// the mix to headphones, for several HRIR lengths and speaker layouts, with
+// the listener turning so HRIRs change (and crossfade) as it runs.
+//
+// Fails if the convolution is wrong, the audio path allocates, or any HRIR
+// up to kRealTimeTaps taps cannot be rendered in real time.
+
+#include <cmath>
+#include <vector>
+#include "bench_common.h"
+#include "../binaural.h"
+#include "../render_engine.h"
+
+static const int kBlocks = 2000;
+static const int kRealTimeTaps = 512;
+static const float kTolerance = 1e-4f;
+
+// One speaker at a fixed angle, fed noise in uneven chunks, must match the
+// HRIR pair applied by direct convolution, delayed by one partition.
+static bool checkConvolution(const HrirSet& hrirs)
+{
+    const float angle = 0.7f;
+    const int frames = 40 * BINAURAL_PARTITION_FRAMES;
+
+    BinauralRenderer renderer;
+    if (!renderer.prepare(hrirs, 1))
+        return false;
+    renderer.setSpeakerAngle(0, angle);
+    const int direction = hrirs.nearest(angle);
+
+    std::vector<float> input(frames);
+    unsigned int seed = 7;
+    for (float& s : input) {
+        seed = seed * 1664525u + 1013904223u;
+        s = (seed >> 8) * (1.0f / 16777216.0f) * 2.0f - 1.0f;
+    }
+
+    // The first partition still uses the initial (straight ahead) HRIR, so
+    // start feeding once the renderer has switched.
+    std::vector<float> silence(BINAURAL_PARTITION_FRAMES, 0.0f);
+    std::vector<float> scratch(2 * BINAURAL_PARTITION_FRAMES);
+    const float* silent = silence.data();
+    renderer.process(&silent, scratch.data(), BINAURAL_PARTITION_FRAMES);
+
+    std::vector<float> out(2 * frames);
+    int done = 0;
+    for (int chunk = 1; done < frames; chunk = chunk * 7 % 300 + 1) {
+        int n = std::min(chunk, frames - done);
+        const float* feed = input.data() + done;
+        renderer.process(&feed, out.data() + 2 * done, n);
+        done += n;
+    }
+
+    float maxError = 0.0f;
+    for (int i = BINAURAL_PARTITION_FRAMES; i < frames; ++i) {
+        int t = i - BINAURAL_PARTITION_FRAMES;
+        double left = 0, right = 0;
+        for (int k = 0; k < hrirs.taps() && k <= t; ++k) {
+            left += (double)hrirs.left(direction)[k] * input[t - k];
+            right += (double)hrirs.right(direction)[k] * input[t - k];
+        }
+        maxError = std::fmax(maxError, std::fabs(out[2 * i] - (float)left));
+        maxError = std::fmax(maxError, std::fabs(out[2 * i + 1] - (float)right));
+    }
+
+    bool ok = maxError <= kTolerance;
+    std::printf("  convolution vs direct, %d taps: max error %.2g %s\n",
+                hrirs.taps(), maxError, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+// Mean share of the block budget spent rendering binaurally.
+static double binauralBudgetShare(paTestData& data, const HrirSet& hrirs)
+{
+    std::unique_ptr<RenderEngine> engine = createRenderEngine(&data);
+    if (!engine)
+        std::exit(EXIT_FAILURE);
+    engine->setMixThreads(0);
+    engine->setBinauralOutput(&hrirs);
+    if (!engine->prepare(RENDER_BLOCK_FRAMES))
+        std::exit(EXIT_FAILURE);
+    std::vector<float> out(RENDER_BLOCK_FRAMES * engine->outputChannels());
+    data.readIndex = 0;
+
+    double total = 0;
+    rtResetAllocationCount();
+    for (int block = 0; block < kBlocks; ++block) {
+        updateSpatialState(&data, [block](SpatialState& s) { s.listenerYaw = block * 0.002f; });
+
+        double start = benchNowNs();
+        {
+            RtAllocScope allocScope;
+            engine->render(out.data(), RENDER_BLOCK_FRAMES);
+        }
+        total += benchNowNs() - start;
+    }
+    benchRequireNoAllocations("binaural render");
+    return total / kBlocks / benchBlockBudgetNs(RENDER_BLOCK_FRAMES);
+}
+
+int main()
+{
+    static paTestData data;
+    const float seconds = (float)kBlocks * RENDER_BLOCK_FRAMES / SAMPLE_RATE + 1.0f;
+    bool ok = true;
+
+    std::printf("binaural  partition=%d frames, %d-frame blocks, listener turning\n",
+                BINAURAL_PARTITION_FRAMES, RENDER_BLOCK_FRAMES);
+
+    HrirSet hrirs;
+    hrirs.synthesize(300);
+    ok = checkConvolution(hrirs) && ok;
+
+    std::printf("  %-6s %6s %10s\n", "layout", "taps", "budget");
+    for (int taps : { 128, 256, 512, 1024, 2048 }) {
+        hrirs.synthesize(taps);
+        for (SpeakerLayoutId id : { SpeakerLayoutId::Surround51, SpeakerLayoutId::Surround714 }) {
+            const SpeakerLayout& layout = getSpeakerLayout(id);
+            benchInitRoom(data, seconds, layout);
+            double share = binauralBudgetShare(data, hrirs);
+            std::printf("  %-6s %6d %9.2f%%\n", layout.name, taps, 100 * share);
+            if (taps <= kRealTimeTaps && share >= 1.0)
+                ok = false;
+        }
+    }
+
+    if (!ok) {
+        std::fprintf(stderr, "binaural rendering failed\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
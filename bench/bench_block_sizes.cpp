@@ -0,0 +1,82 @@
+// Rendering with host buffer sizes that change on every callback, as with
+// paFramesPerBufferUnspecified, for every speaker layout. The output must
+// match a render in fixed RENDER_BLOCK_FRAMES blocks, and odd sizes must not
+// cost much more per frame.
+
+#include <cmath>
+#include <vector>
+#include "bench_common.h"
+#include "../render_engine.h"
+
+static const unsigned long kTotalFrames = 1ul << 20;
+static const float kTolerance = 1e-5f;
+
+// Render kTotalFrames frames from the start of the audio, in blocks whose
+// size is picked by nextSize, and return the ns spent per frame.
+template <typename NextSize>
+static double renderAll(paTestData& data, std::vector<float>& out, NextSize&& nextSize)
+{
+    std::unique_ptr<RenderEngine> engine = createRenderEngine(&data);
+    if (!engine || !engine->prepare(RENDER_BLOCK_FRAMES))
+        std::exit(EXIT_FAILURE);
+    const int channels = engine->outputChannels();
+    data.readIndex = 0;
+
+    rtResetAllocationCount();
+    double start = benchNowNs();
+    unsigned long done = 0;
+    while (done < kTotalFrames) {
+        unsigned long frames = nextSize();
+        if (frames > kTotalFrames - done)
+            frames = kTotalFrames - done;
+
+        RtAllocScope allocScope;
+        engine->render(out.data() + done * channels, frames);
+        done += frames;
+    }
+    double elapsed = benchNowNs() - start;
+
+    benchRequireNoAllocations("variable block render");
+    return elapsed / kTotalFrames;
+}
+
+int main()
+{
+    static paTestData data;
+    std::vector<float> fixed(kTotalFrames * MAX_CHANNELS);
+    std::vector<float> variable(kTotalFrames * MAX_CHANNELS);
+    bool ok = true;
+
+    std::printf("block_sizes  sub-block=%d frames\n", RENDER_BLOCK_FRAMES);
+
+    for (int id = 0; id < (int)SpeakerLayoutId::Count; ++id) {
+        const SpeakerLayout& layout = getSpeakerLayout((SpeakerLayoutId)id);
+        // Long enough that readAudio never wraps, so both runs read the same samples.
+        benchInitRoom(data, (float)kTotalFrames / SAMPLE_RATE + 1.0f, layout);
+
+        double fixedNs = renderAll(data, fixed, []() { return (unsigned long)RENDER_BLOCK_FRAMES; });
+
+        unsigned int seed = 99;
+        double variableNs = renderAll(data, variable, [&seed]() {
+            seed = seed * 1664525u + 1013904223u;
+            return 1 + (unsigned long)(seed >> 8) % 3000;
+        });
+
+        float maxError = 0.0f;
+        for (size_t i = 0; i < kTotalFrames * layout.channels; ++i)
+            maxError = std::fmax(maxError, std::fabs(fixed[i] - variable[i]));
+
+        std::printf("  %-5s fixed %d-frame callbacks: %6.2f ns/frame   "
+                    "random 1..3000: %6.2f ns/frame  max diff %.2g\n",
+                    layout.name, RENDER_BLOCK_FRAMES, fixedNs, variableNs, maxError);
+
+        if (maxError > kTolerance)
+            ok = false;
+    }
+
+    if (!ok) {
+        std::fprintf(stderr, "variable block sizes changed the output\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,94 @@
+// Overhead the callback instrumentation adds to every block, plus a check
+// that record() does not allocate and that the histogram lands callbacks in
+// the right buckets. Then streams a file through the engine in real time,
+// as --stream playback does, and fails if the decoder underruns even once.
+
+#include <memory>
+#include <thread>
+#include "bench_common.h"
+#include "../callback_stats.h"
+#include "../render_engine.h"
+#include "../streaming_decoder.h"
+
+static const int kCalls = 1000000;
+// Streamed playback: long enough to drain a small lookahead several times over.
+static const double kStreamSeconds = 2.0;
+static const double kStreamLookaheadSeconds = 0.2;
+
+// Render `path` from a StreamingDecoder one 256-frame callback per buffer
+// period, recording each callback the way the PortAudio callback does.
+static bool streamInRealTime(const char* path, CallbackStats& stats)
+{
+    static paTestData data;
+    benchInitRoom(data, 0.0f);
+    static StreamingDecoder decoder;
+    if (!decoder.open(path, (unsigned long)(kStreamLookaheadSeconds * SAMPLE_RATE)))
+        return false;
+    data.stream = &decoder;
+
+    std::unique_ptr<RenderEngine> engine = createRenderEngine(&data);
+    if (!engine || !engine->prepare(RENDER_BLOCK_FRAMES)) {
+        std::fprintf(stderr, "Failed to allocate render buffers\n");
+        return false;
+    }
+    std::vector<float> out(256 * engine->outputChannels());
+    const uint64_t budgetNs = (uint64_t)benchBlockBudgetNs(256);
+
+    stats.reset();
+    auto next = std::chrono::steady_clock::now();
+    for (int block = 0; block < (int)(kStreamSeconds * SAMPLE_RATE / 256); ++block) {
+        double start = benchNowNs();
+        unsigned long underruns = decoder.underruns();
+        engine->render(out.data(), 256);
+        stats.record((uint64_t)(benchNowNs() - start), budgetNs, 256, false, false,
+                     decoder.underruns() != underruns);
+        next += std::chrono::nanoseconds(budgetNs);
+        std::this_thread::sleep_until(next);
+    }
+    decoder.close();
+    data.stream = nullptr;
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    const char* path = argc > 1 ? argv[1] : "assets/audio/flac_5_1.flac";
+
+    static CallbackStats stats;
+    const uint64_t budgetNs = (uint64_t)benchBlockBudgetNs(256);
+
+    rtResetAllocationCount();
+    double start = benchNowNs();
+    {
+        RtAllocScope allocScope;
+        for (int i = 0; i < kCalls; ++i) {
+            // Mostly ~10 us callbacks with a slow one every 1000th block.
+            uint64_t elapsed = (i % 1000 == 999) ? 2 * budgetNs : 10000 + (i % 64);
+            stats.record(elapsed, budgetNs, 256, i % 5000 == 0, false, i % 10000 == 0);
+        }
+    }
+    double elapsed = benchNowNs() - start;
+    benchRequireNoAllocations("CallbackStats::record");
+
+    CallbackStatsSnapshot s = stats.snapshot();
+    uint64_t p50 = callbackStatsPercentileNs(s, 0.50);
+    bool ok = s.callbacks == (uint64_t)kCalls
+        && s.deadlineMisses == (uint64_t)kCalls / 1000
+        && s.outputUnderflows == (uint64_t)kCalls / 5000
+        && s.decoderUnderruns == (uint64_t)kCalls / 10000
+        && s.maxNs == 2 * budgetNs
+        && p50 > 10000 && p50 <= 16384
+        && callbackStatsPercentileNs(s, 0.9999) >= 2 * budgetNs;
+
+    std::printf("callback_stats  %.2f ns/record  p50 < %llu ns  misses %llu  %s\n",
+                elapsed / kCalls, (unsigned long long)p50,
+                (unsigned long long)s.deadlineMisses, ok ? "ok" : "MISMATCH");
+
+    if (!streamInRealTime(path, stats))
+        return EXIT_FAILURE;
+    s = stats.snapshot();
+    bool streamOk = s.decoderUnderruns == 0;
+    std::printf("callback_stats  %.1f s streamed: %s  %s\n", kStreamSeconds,
+                formatCallbackStats(s).c_str(), streamOk ? "ok" : "UNDERRUN");
+    return ok && streamOk ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+// Shared helpers for the micro-benchmarks in bench/. Each benchmark is a
+// standalone program built by `make bench`; none of them need an audio device
+// (bench_device_switch, which does, is built by `make bench-device`).
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "../audio_file.h"
+#include "../utils.h"
+#include "../rt_alloc_check.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_CYCLES 1
+#endif
+
+inline double benchNowNs()
+{
+    using namespace std::chrono;
+    return (double)duration_cast<nanoseconds>(
+        steady_clock::now().time_since_epoch()).count();
+}
+
+// Time-stamp counter reading, or 0 where there is none. On x86 this counts
+// reference cycles at the nominal clock, not core cycles, so it drifts from
+// the true cycle count when the core boosts or throttles.
+inline unsigned long long benchNowCycles()
+{
+#ifdef BENCH_HAVE_CYCLES
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Real-time budget for one block of `frames` frames, in nanoseconds.
+inline double benchBlockBudgetNs(unsigned long frames)
+{
+    return frames * 1e9 / SAMPLE_RATE;
+}
+
+// Same room as start.cpp, with `seconds` of deterministic 5.1 noise in place
+// of the decoded FLAC so results do not depend on the asset files.
+inline void benchInitRoom(paTestData& data, float seconds,
+                          const SpeakerLayout& layout = defaultSpeakerLayout())
+{
+    initDefaultRoom(&data, layout);
+    for (int i = 0; i < MAX_CHANNELS; i++)
+        data.channelGains[i] = 1;
+
+    unsigned int seed = 12345;
+    std::vector<float> samples((size_t)(seconds * SAMPLE_RATE) * DECODED_CHANNELS);
+    for (float& s : samples) {
+        seed = seed * 1664525u + 1013904223u;
+        s = (seed >> 8) * (1.0f / 16777216.0f) * 2.0f - 1.0f;
+    }
+    data.audio.assign(std::move(samples));
+    data.readIndex = 0;
+}
+
+// Fail the benchmark run if the measured code allocated on the "audio thread".
+inline void benchRequireNoAllocations(const char* what)
+{
+    unsigned long allocations = rtAllocationCount();
+    if (allocations != 0) {
+        std::fprintf(stderr, "%s: %lu allocations on the audio path\n", what, allocations);
+        std::exit(EXIT_FAILURE);
+    }
+}
@@ -0,0 +1,175 @@
+// Restart and device-switch latency of AudioEngine on the real output
+// devices: how long start, pause, resume, switchDevice and stop take to
+// return, and how long after each is called the stream's next callback
+// runs. For comparison, the old way of starting again: terminate and
+// re-initialise PortAudio, load the audio and build a new engine and stream.
+//
+// Needs PortAudio and an output device that takes 5.1, so it is built by
+// `make bench-device` rather than `make bench`, and skips (exit 0) when
+// there is no such device. Switches go round every device that qualifies,
+// or reopen the one there is. Fails if an operation does not leave the
+// stream playing (or silent) as it should, or the audio path allocates.
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "bench_common.h"
+#include "../audio_engine.h"
+#include "../pcm_cache.h"
+#include "../portaudio_listener.h"
+
+static const int kRounds = 20;
+// Longest wait for a callback before the stream counts as not playing.
+static const double kCallbackTimeoutMs = 2000.0;
+
+typedef struct
+{
+    const char* name;
+    std::vector<double> returnMs;       // until the call returned
+    std::vector<double> callbackMs;     // until the next callback ran
+} Operation;
+
+// What start.cpp does before the window opens: the default room, and the
+// audio mapped from the decode cache after the first run.
+static bool loadAssets(paTestData& data, const char* path)
+{
+    initDefaultRoom(&data, defaultSpeakerLayout());
+    for (int i = 0; i < MAX_CHANNELS; i++)
+        data.channelGains[i] = 1;
+    data.stream = nullptr;
+    data.readIndex = 0;
+    return loadDecodedAudio(path, data.audio);
+}
+
+// Milliseconds from startNs until the stream has made more than `after`
+// callbacks, or -1 if it makes none within kCallbackTimeoutMs.
+static double waitForCallback(double startNs, unsigned long after)
+{
+    while (getCallbackStats().callbacks <= after) {
+        if (benchNowNs() - startNs > kCallbackTimeoutMs * 1e6)
+            return -1;
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    return (benchNowNs() - startNs) / 1e6;
+}
+
+// Run `op` and time it. A stream reopened by the call counts its callbacks
+// from 0; otherwise the count carries on from before. With `silent` the
+// stream must make no callback at all afterwards.
+template <typename Op>
+static bool measure(Operation& operation, bool reopens, bool silent, Op op)
+{
+    unsigned long before = reopens ? 0 : getCallbackStats().callbacks;
+    double start = benchNowNs();
+    if (!op()) {
+        std::fprintf(stderr, "%s failed\n", operation.name);
+        return false;
+    }
+    operation.returnMs.push_back((benchNowNs() - start) / 1e6);
+    if (silent) {
+        unsigned long stopped = getCallbackStats().callbacks;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        if (getCallbackStats().callbacks != stopped) {
+            std::fprintf(stderr, "%s: callbacks still running\n", operation.name);
+            return false;
+        }
+        return true;
+    }
+    double callbackMs = waitForCallback(start, before);
+    if (callbackMs < 0) {
+        std::fprintf(stderr, "%s: no callback within %.0f ms\n", operation.name, kCallbackTimeoutMs);
+        return false;
+    }
+    operation.callbackMs.push_back(callbackMs);
+    return true;
+}
+
+static void report(const Operation& operation)
+{
+    auto column = [](std::vector<double> v) {
+        if (v.empty()) {
+            std::printf(" %9s %9s", "-", "-");
+            return;
+        }
+        std::sort(v.begin(), v.end());
+        std::printf(" %9.2f %9.2f", v[v.size() / 2], v.back());
+    };
+    std::printf("  %-26s", operation.name);
+    column(operation.returnMs);
+    column(operation.callbackMs);
+    std::printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+    const char* path = argc > 1 ? argv[1] : "assets/audio/flac_5_1.flac";
+
+    static paTestData data;
+    if (!loadAssets(data, path))
+        return EXIT_FAILURE;
+
+    AudioEngine engine(&data);
+    if (!engine.initialize())
+        return EXIT_FAILURE;
+
+    std::vector<int> devices;
+    for (int i = 0; i < Pa_GetDeviceCount(); ++i) {
+        const PaDeviceInfo* info = Pa_GetDeviceInfo(i);
+        if (info && info->maxOutputChannels >= data.layout->channels)
+            devices.push_back(i);
+    }
+    if (devices.empty()) {
+        std::printf("device switch  skipped: no output device with %d channels\n", data.layout->channels);
+        return EXIT_SUCCESS;
+    }
+
+    Operation coldStart = { "first start", {}, {} };
+    Operation pause = { "pause", {}, {} };
+    Operation resume = { "resume", {}, {} };
+    Operation switchDevice = { "switch device (playing)", {}, {} };
+    Operation stop = { "stop", {}, {} };
+    Operation restart = { "start after stop", {}, {} };
+    Operation oldRestart = { "re-initialise and reload", {}, {} };
+
+    bool ok = true;
+    rtResetAllocationCount();
+    engine.switchDevice(devices[0]);
+    ok = ok && measure(coldStart, true, false, [&]() { return engine.start(); });
+    for (int round = 0; ok && round < kRounds; ++round) {
+        int next = devices[(round + 1) % devices.size()];
+        ok = ok && measure(pause, false, true, [&]() { return engine.pause() && engine.paused(); });
+        ok = ok && measure(resume, false, false, [&]() { return engine.start() && engine.running(); });
+        ok = ok && measure(switchDevice, true, false, [&]() {
+            return engine.switchDevice(next) && engine.running() && engine.device() == next;
+        });
+        ok = ok && measure(stop, false, true, [&]() { engine.stop(); return !engine.running(); });
+        ok = ok && measure(restart, true, false, [&]() { return engine.start(); });
+    }
+    engine.stop();
+
+    // What every press of "Start Audio" used to do, short of the decode
+    // that the cache now saves
+    for (int round = 0; ok && round < kRounds; ++round) {
+        PaStream* stream = nullptr;
+        ok = measure(oldRestart, true, false, [&]() {
+            if (!checkPaError(Pa_Terminate()) || !checkPaError(Pa_Initialize()) || !loadAssets(data, path))
+                return false;
+            stream = openPlayback(&data, false);
+            return stream && checkPaError(Pa_StartStream(stream));
+        });
+        closePlayback(stream, false);
+    }
+    benchRequireNoAllocations("device switch");
+
+    std::printf("device switch  %d device(s), %d rounds\n", (int)devices.size(), kRounds);
+    std::printf("  %-26s %19s %19s\n", "", "call returns ms", "next callback ms");
+    std::printf("  %-26s %9s %9s %9s %9s\n", "", "median", "max", "median", "max");
+    for (const Operation* operation : { &coldStart, &pause, &resume, &switchDevice, &stop, &restart, &oldRestart })
+        report(*operation);
+
+    if (!ok) {
+        std::fprintf(stderr, "device switch failed\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
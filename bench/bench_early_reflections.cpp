@@ -0,0 +1,268 @@
+// Early reflections: checks the image sources against reflecting the source
+// in the walls one at a time, and the multi-tap delay line against
+// hand-placed impulses (including the crossfade to a new set of taps and the
+// tap budget), then measures the render cost against reflection order with
+// the listener standing still and walking about.
+//
+// Fails if an image is missing or misplaced, a tap is mistimed or misscaled,
+// the budget is not enforced, the audio path allocates, threaded mixing
+// changes the output, or third-order reflections on 5.1 with the listener
+// walking take more than kMaxShare of the block budget over the direct sound
+// alone.
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+#include "bench_common.h"
+#include "../early_reflections.h"
+#include "../render_engine.h"
+
+static const int kBlocks = 2000;
+static const double kMaxShare = 0.05;
+
+static Point reflectIn(Point p, const Point bounds[2], int wall)
+{
+    switch (wall) {
+        case 0:  return Point { 2 * bounds[0].x - p.x, p.y };
+        case 1:  return Point { 2 * bounds[1].x - p.x, p.y };
+        case 2:  return Point { p.x, 2 * bounds[0].y - p.y };
+        default: return Point { p.x, 2 * bounds[1].y - p.y };
+    }
+}
+
+// Every image found by reflecting in walls one after another (never the same
+// wall twice running), against imageSources().
+static bool checkImages()
+{
+    const Point bounds[2] = { { -2.5f, -1.0f }, { 3.5f, 4.0f } };
+    const Point source = { 0.7f, 2.2f };
+
+    std::vector<ImageSource> expected;
+    std::vector<std::pair<Point, int>> frontier = { { source, -1 } };
+    for (int k = 1; k <= EARLY_REFLECTION_MAX_ORDER; ++k) {
+        std::vector<std::pair<Point, int>> next;
+        for (const auto& node : frontier) {
+            for (int wall = 0; wall < 4; ++wall) {
+                if (wall == node.second)
+                    continue;
+                Point image = reflectIn(node.first, bounds, wall);
+                next.push_back({ image, wall });
+                bool seen = false;
+                for (const ImageSource& e : expected)
+                    seen = seen || (std::fabs(e.position.x - image.x) < 1e-4f
+                                    && std::fabs(e.position.y - image.y) < 1e-4f);
+                if (!seen)
+                    expected.push_back({ image, k });
+            }
+        }
+        frontier = next;
+    }
+
+    ImageSource images[EARLY_REFLECTION_MAX_IMAGES];
+    int count = imageSources(bounds, source, EARLY_REFLECTION_MAX_ORDER, images);
+    bool ok = count == (int)expected.size();
+    for (const ImageSource& e : expected) {
+        bool found = false;
+        for (int i = 0; i < count; ++i)
+            found = found || (std::fabs(images[i].position.x - e.position.x) < 1e-4f
+                              && std::fabs(images[i].position.y - e.position.y) < 1e-4f
+                              && images[i].reflections == e.reflections);
+        ok = ok && found;
+    }
+    std::printf("  %-36s %d images %s\n", "image sources up to third order", count, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+// Impulses through hand-placed taps, then a crossfade to other taps.
+static bool checkTaps()
+{
+    const unsigned long frames = 64;
+    EarlyReflections reflections;
+    reflections.prepare(2, frames);
+
+    std::vector<float> in0(frames), in1(frames), out0(frames), out1(frames);
+    const float* sources[2] = { in0.data(), in1.data() };
+    float* outputs[2] = { out0.data(), out1.data() };
+    std::vector<float> first0, first1;
+
+    ReflectionTap taps[3] = { { 0, 0, 5, 0.5f }, { 1, 0, 70, -0.25f }, { 0, 1, 130, 0.125f } };
+    reflections.setTaps(taps, 3, false);
+    for (int block = 0; block < 4; ++block) {
+        std::fill(in0.begin(), in0.end(), 0.0f);
+        std::fill(in1.begin(), in1.end(), 0.0f);
+        if (block == 0)
+            in0[0] = in1[0] = 1.0f;
+        std::fill(out0.begin(), out0.end(), 0.0f);
+        std::fill(out1.begin(), out1.end(), 0.0f);
+        reflections.push(sources, frames);
+        reflections.mix(outputs, frames, 0, 2);
+        first0.insert(first0.end(), out0.begin(), out0.end());
+        first1.insert(first1.end(), out1.begin(), out1.end());
+    }
+    bool placed = true;
+    for (size_t i = 0; i < first0.size(); ++i) {
+        float e0 = i == 5 ? 0.5f : (i == 70 ? -0.25f : 0.0f);
+        float e1 = i == 130 ? 0.125f : 0.0f;
+        placed = placed && first0[i] == e0 && first1[i] == e1;
+    }
+    std::printf("  %-36s %s\n", "taps on an impulse", placed ? "ok" : "FAILED");
+
+    // A constant input makes the crossfade visible: one tap keeps its
+    // delay and doubles, one fades out, one fades in.
+    ReflectionTap before[2] = { { 0, 0, 3, 0.5f }, { 0, 0, 9, 0.25f } };
+    ReflectionTap after[2] = { { 0, 0, 3, 1.0f }, { 0, 0, 12, 0.125f } };
+    reflections.prepare(1, frames);
+    reflections.setTaps(before, 2, false);
+    std::fill(in0.begin(), in0.end(), 1.0f);
+    for (int block = 0; block < 3; ++block) {
+        std::fill(out0.begin(), out0.end(), 0.0f);
+        reflections.push(sources, frames);
+        reflections.mix(outputs, frames, 0, 1);
+    }
+    reflections.setTaps(after, 2, true);
+    bool faded = reflections.taps() == 3;
+    std::fill(out0.begin(), out0.end(), 0.0f);
+    reflections.push(sources, frames);
+    reflections.mix(outputs, frames, 0, 1);
+    for (unsigned long i = 0; i < frames; ++i) {
+        float t = (float)(i + 1) / frames;
+        float expected = 0.5f + t * 0.5f + 0.25f * (1 - t) + 0.125f * t;
+        faded = faded && std::fabs(out0[i] - expected) < 1e-5f;
+    }
+    std::fill(out0.begin(), out0.end(), 0.0f);
+    reflections.push(sources, frames);
+    reflections.mix(outputs, frames, 0, 1);
+    faded = faded && reflections.taps() == 2;
+    for (unsigned long i = 0; i < frames; ++i)
+        faded = faded && std::fabs(out0[i] - 1.125f) < 1e-6f;
+    std::printf("  %-36s %s\n", "crossfade to new taps", faded ? "ok" : "FAILED");
+
+    // More taps than the budget keeps the loudest
+    reflections.prepare(1, frames);
+    std::vector<ReflectionTap> many(3 * EARLY_REFLECTION_MAX_TAPS);
+    for (size_t i = 0; i < many.size(); ++i)
+        many[i] = { 0, 0, (int)i, 1.0f / (1 + (int)((i * 7919) % many.size())) };
+    reflections.setTaps(many.data(), (int)many.size(), false);
+    float weakestKept = 1.0f / EARLY_REFLECTION_MAX_TAPS;
+    std::fill(in0.begin(), in0.end(), 0.0f);
+    in0[0] = 1.0f;
+    float sum = 0.0f;
+    bool budget = reflections.taps() == EARLY_REFLECTION_MAX_TAPS;
+    for (int block = 0; block * frames < many.size() + frames; ++block) {
+        std::fill(out0.begin(), out0.end(), 0.0f);
+        reflections.push(sources, frames);
+        reflections.mix(outputs, frames, 0, 1);
+        for (float s : out0) {
+            budget = budget && (s == 0.0f || s >= weakestKept * 0.999f);
+            sum += s;
+        }
+        in0[0] = 0.0f;
+    }
+    float expectedSum = 0.0f;
+    for (int i = 1; i <= EARLY_REFLECTION_MAX_TAPS; ++i)
+        expectedSum += 1.0f / i;
+    budget = budget && std::fabs(sum - expectedSum) < 1e-4f;
+    std::printf("  %-36s %s\n", "tap budget keeps the loudest", budget ? "ok" : "FAILED");
+
+    return placed && faded && budget;
+}
+
+// The listener walking with third-order reflections on, mixed on `threads`
+// workers as well as the caller.
+static void renderWalking(paTestData& data, const SpeakerLayout& layout, int threads, std::vector<float>& out)
+{
+    const int blocks = 300;
+    benchInitRoom(data, (float)blocks * RENDER_BLOCK_FRAMES / SAMPLE_RATE + 1.0f, layout);
+    std::unique_ptr<RenderEngine> engine = createRenderEngine(&data);
+    if (!engine)
+        std::exit(EXIT_FAILURE);
+    engine->setMixThreads(threads);
+    engine->setEarlyReflections(EARLY_REFLECTION_MAX_ORDER);
+    if (!engine->prepare(RENDER_BLOCK_FRAMES))
+        std::exit(EXIT_FAILURE);
+    const int channels = engine->outputChannels();
+    out.assign((size_t)blocks * RENDER_BLOCK_FRAMES * channels, 0.0f);
+    for (int block = 0; block < blocks; ++block) {
+        applyTrackerPose(&data, 1.5f * std::sin(block * 0.02f), -1.5f + std::cos(block * 0.02f), 0.0f);
+        engine->render(out.data() + (size_t)block * RENDER_BLOCK_FRAMES * channels, RENDER_BLOCK_FRAMES);
+    }
+}
+
+// Average share of the block budget a render takes.
+static double renderShare(paTestData& data, const SpeakerLayout& layout, int order, bool walking, int* taps)
+{
+    benchInitRoom(data, (float)kBlocks * RENDER_BLOCK_FRAMES / SAMPLE_RATE + 1.0f, layout);
+    std::unique_ptr<RenderEngine> engine = createRenderEngine(&data);
+    if (!engine)
+        std::exit(EXIT_FAILURE);
+    engine->setMixThreads(0);
+    engine->setEarlyReflections(order);
+    if (!engine->prepare(RENDER_BLOCK_FRAMES))
+        std::exit(EXIT_FAILURE);
+    std::vector<float> out((size_t)RENDER_BLOCK_FRAMES * engine->outputChannels());
+    applyTrackerPose(&data, 1.0f, -2.0f, 0.1f);
+
+    double total = 0.0;
+    rtResetAllocationCount();
+    for (int block = 0; block < kBlocks; ++block) {
+        if (walking)
+            applyTrackerPose(&data, 1.5f * std::sin(block * 0.01f), -1.5f + std::cos(block * 0.013f),
+                             0.05f * std::sin(block * 0.02f));
+        RtAllocScope allocScope;
+        double start = benchNowNs();
+        engine->render(out.data(), RENDER_BLOCK_FRAMES);
+        total += benchNowNs() - start;
+    }
+    benchRequireNoAllocations("reflected render");
+    *taps = engine->reflectionTaps();
+    return total / kBlocks / benchBlockBudgetNs(RENDER_BLOCK_FRAMES);
+}
+
+int main()
+{
+    static paTestData data;
+    static SpeakerArrayLayout ring;
+    bool ok = true;
+
+    std::printf("early_reflections  image sources up to order %d, %d taps per block at most\n",
+                EARLY_REFLECTION_MAX_ORDER, EARLY_REFLECTION_MAX_TAPS);
+    ok = checkImages() && ok;
+    ok = checkTaps() && ok;
+
+    ring.clear();
+    ring.addSpeaker("LFE", 0.0f, 0.0f, true);
+    for (int i = 0; i < 31; ++i)
+        ring.addSpeaker("S" + std::to_string(i + 1), i / 31.0f, 2.0f);
+
+    std::vector<float> single, threaded;
+    renderWalking(data, ring.layout(), 0, single);
+    renderWalking(data, ring.layout(), 2, threaded);
+    bool same = single == threaded;
+    std::printf("  %-36s %s\n", "32 speakers, 2 mix workers", same ? "same output ok" : "OUTPUT DIFFERS");
+    ok = same && ok;
+
+    std::printf("  %-8s %5s %6s %12s %12s\n", "layout", "order", "taps", "still", "walking");
+    for (const SpeakerLayout* layout : { &getSpeakerLayout(SpeakerLayoutId::Surround51), &ring.layout() }) {
+        double direct = 0.0;
+        for (int order = 0; order <= EARLY_REFLECTION_MAX_ORDER; ++order) {
+            // Walking, every block crossfades, so count the taps standing still
+            int taps = 0, crossfading = 0;
+            double still = renderShare(data, *layout, order, false, &taps);
+            double walking = renderShare(data, *layout, order, true, &crossfading);
+            std::printf("  %-8s %5d %6d %11.2f%% %11.2f%%\n", layout->name, order, taps,
+                        100 * still, 100 * walking);
+            if (order == 0)
+                direct = walking;
+            if (layout->channels == 6 && order == EARLY_REFLECTION_MAX_ORDER && walking - direct > kMaxShare)
+                ok = false;
+        }
+    }
+
+    if (!ok) {
+        std::fprintf(stderr, "early reflections failed\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
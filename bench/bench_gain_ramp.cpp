@@ -0,0 +1,105 @@
+// Renders a full yaw sweep with a DC source on the centre channel, so every
+// output sample is the current centre->speaker gain. The engine is prepared
+// for RENDER_BLOCK_FRAMES, as playback prepares it, and called with host
+// buffers of that size and larger, each with a new pose. A pose change is
+// ramped across the first sub-block of the buffer only, so larger buffers
+// move further per ramp. Reports the largest sample-to-sample gain step with
+// and without per-sample ramping, and fails if the ramped render steps by
+// more than kMaxGainStep.
+
+#include <cmath>
+#include <vector>
+#include "bench_common.h"
+#include "../render_engine.h"
+
+static const float kSweepSeconds = 2.0f;
+static const float kMaxGainStep = 1e-3f;
+
+struct SweepResult
+{
+    float maxStep;
+    double nsPerBlock;
+};
+
+static SweepResult renderSweep(paTestData& data, unsigned long frames, bool ramping)
+{
+    std::unique_ptr<RenderEngine> engine = createRenderEngine(&data);
+    if (!engine)
+        std::exit(EXIT_FAILURE);
+    engine->setGainRamping(ramping);
+    if (!engine->prepare(RENDER_BLOCK_FRAMES))
+        std::exit(EXIT_FAILURE);
+
+    const int channels = engine->outputChannels();
+    const int blocks = (int)(kSweepSeconds * SAMPLE_RATE / frames);
+    std::vector<float> out(frames * channels);
+    float last[MAX_CHANNELS] = {};
+    bool haveLast = false;
+    SweepResult result = { 0.0f, 0.0 };
+
+    data.readIndex = 0;
+    updateSpatialState(&data, [](SpatialState& s) { s.listenerYaw = 0.0f; });
+
+    rtResetAllocationCount();
+    double elapsed = 0.0;
+    for (int b = 0; b < blocks; ++b) {
+        float yaw = (float)b / blocks;
+        updateSpatialState(&data, [yaw](SpatialState& s) { s.listenerYaw = yaw; });
+
+        double start = benchNowNs();
+        {
+            RtAllocScope allocScope;
+            engine->render(out.data(), frames);
+        }
+        elapsed += benchNowNs() - start;
+
+        for (unsigned long i = 0; i < frames; ++i) {
+            for (int ch = 0; ch < channels; ++ch) {
+                float sample = out[i * channels + ch];
+                if (haveLast)
+                    result.maxStep = std::fmax(result.maxStep, std::fabs(sample - last[ch]));
+                last[ch] = sample;
+            }
+            haveLast = true;
+        }
+    }
+    benchRequireNoAllocations("gain ramp sweep");
+
+    result.nsPerBlock = elapsed / blocks;
+    return result;
+}
+
+int main()
+{
+    static paTestData data;
+    benchInitRoom(data, 1.0f);
+
+    // DC on the centre channel only (source order: FL, FR, C, LFE, BL, BR)
+    std::vector<float> samples(data.audio.size());
+    for (size_t i = 0; i < samples.size(); ++i)
+        samples[i] = (i % DECODED_CHANNELS == 2) ? 1.0f : 0.0f;
+    data.audio.assign(std::move(samples));
+
+    std::printf("gain_ramp  yaw sweep of %.1fs, %d-frame sub-blocks, max allowed step %g\n",
+                kSweepSeconds, RENDER_BLOCK_FRAMES, kMaxGainStep);
+
+    bool ok = true;
+    for (unsigned long frames : { 256ul, 512ul, 1024ul, 2048ul, 4096ul }) {
+        SweepResult stepped = renderSweep(data, frames, false);
+        SweepResult ramped = renderSweep(data, frames, true);
+
+        std::printf("  frames=%-5lu stepped: max step %.5f  %7.1f ns/block   "
+                    "ramped: max step %.6f  %7.1f ns/block\n",
+                    frames, stepped.maxStep, stepped.nsPerBlock,
+                    ramped.maxStep, ramped.nsPerBlock);
+
+        if (ramped.maxStep > kMaxGainStep)
+            ok = false;
+    }
+
+    if (!ok) {
+        std::fprintf(stderr, "gain_ramp: ramped sweep exceeded the step threshold\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
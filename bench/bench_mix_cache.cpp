@@ -0,0 +1,55 @@
+// Callback cost with the cached mix matrix: a static listener only pays for
+// the mix, a moving listener also rebuilds the matrix every block.
+
+#include <vector>
+#include "bench_common.h"
+#include "../render_engine.h"
+
+static const unsigned long kFrames = 256;
+static const int kBlocks = 20000;
+
+static double runBlocks(RenderEngine& engine, paTestData& data, bool moving)
+{
+    std::vector<float> out(kFrames * engine.outputChannels());
+
+    rtResetAllocationCount();
+    double start = benchNowNs();
+    for (int b = 0; b < kBlocks; ++b) {
+        if (moving) {
+            updateSpatialState(&data, [b](SpatialState& s) {
+                s.listenerYaw = (b % 1000) / 1000.0f;
+                s.currentListenerPosition = { 0.001f * (b % 500), 0.0f };
+            });
+        }
+        RtAllocScope allocScope;
+        engine.render(out.data(), kFrames);
+    }
+    double elapsed = benchNowNs() - start;
+
+    benchRequireNoAllocations(moving ? "moving listener" : "static listener");
+    return elapsed / kBlocks;
+}
+
+int main()
+{
+    static paTestData data;
+    benchInitRoom(data, 10.0f);
+
+    std::unique_ptr<RenderEngine> engine = createRenderEngine(&data);
+    if (!engine || !engine->prepare(kFrames))
+        return EXIT_FAILURE;
+
+    // warm up caches and the mix matrix
+    runBlocks(*engine, data, false);
+
+    double budget = benchBlockBudgetNs(kFrames);
+    double staticNs = runBlocks(*engine, data, false);
+    double movingNs = runBlocks(*engine, data, true);
+
+    std::printf("mix_cache  frames=%lu\n", kFrames);
+    std::printf("  static listener: %8.1f ns/block  %6.3f%% of budget\n",
+                staticNs, 100.0 * staticNs / budget);
+    std::printf("  moving listener: %8.1f ns/block  %6.3f%% of budget\n",
+                movingNs, 100.0 * movingNs / budget);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+// Frames/second of every compiled mix kernel on a 5.1 block, with a constant
+// matrix and with a per-sample gain ramp. Each kernel is first checked against
+// the scalar reference and the run fails on mismatch.
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "bench_common.h"
+#include "../mix_kernels.h"
+#include "../six_channel.h"
+#include "../render_engine.h"
+
+static const unsigned long kFrames = 256;
+static const int kBlocks = 200000;
+static const float kTolerance = 1e-5f;
+
+struct PlanarBlock
+{
+    float* channels[DECODED_CHANNELS];
+    float* storage;
+
+    explicit PlanarBlock(unsigned long frames)
+    {
+        storage = (float*)std::aligned_alloc(RENDER_ALIGNMENT,
+                                             frames * sizeof(float) * DECODED_CHANNELS);
+        for (int ch = 0; ch < DECODED_CHANNELS; ++ch)
+            channels[ch] = storage + frames * ch;
+    }
+    ~PlanarBlock() { std::free(storage); }
+};
+
+static MixParams makeParams(const PlanarBlock& in, const PlanarBlock& out,
+                            const float* gains, const float* prevGains,
+                            unsigned long frames)
+{
+    MixParams p;
+    p.in = in.channels;
+    p.out = out.channels;
+    p.gains = gains;
+    p.prevGains = prevGains;
+    p.inputs = DECODED_CHANNELS;
+    p.outputs = DECODED_CHANNELS;
+    p.lfeIn = Subwoofer;
+    p.lfeOut = Subwoofer;
+    p.frames = frames;
+    return p;
+}
+
+int main()
+{
+    PlanarBlock in(kFrames), expected(kFrames), actual(kFrames);
+    float gains[DECODED_CHANNELS * DECODED_CHANNELS];
+    float prevGains[DECODED_CHANNELS * DECODED_CHANNELS];
+
+    unsigned int seed = 42;
+    auto nextRandom = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) * (1.0f / 16777216.0f) * 2.0f - 1.0f;
+    };
+    for (int ch = 0; ch < DECODED_CHANNELS; ++ch)
+        for (unsigned long i = 0; i < kFrames; ++i)
+            in.channels[ch][i] = nextRandom();
+    for (float& g : gains)
+        g = nextRandom();
+    for (float& g : prevGains)
+        g = nextRandom();
+
+    MixKernel scalar = getMixKernel(MixKernelType::Scalar);
+    std::printf("mix_kernels  frames=%lu  best=%s\n",
+                kFrames, mixKernelName(bestMixKernelType()));
+
+    for (int t = 0; t < (int)MixKernelType::Count; ++t) {
+        MixKernelType type = (MixKernelType)t;
+        MixKernel kernel = getMixKernel(type);
+        if (!kernel) {
+            std::printf("  %-7s unsupported\n", mixKernelName(type));
+            continue;
+        }
+
+        for (const float* ramp : { (const float*)nullptr, (const float*)prevGains }) {
+            const char* mode = ramp ? "ramp" : "steady";
+
+            // Odd frame counts exercise the scalar tail as well as the vector body.
+            for (unsigned long frames : { kFrames, kFrames - 3 }) {
+                scalar(makeParams(in, expected, gains, ramp, frames));
+                kernel(makeParams(in, actual, gains, ramp, frames));
+                for (int ch = 0; ch < DECODED_CHANNELS; ++ch) {
+                    for (unsigned long i = 0; i < frames; ++i) {
+                        float diff = std::fabs(expected.channels[ch][i] - actual.channels[ch][i]);
+                        if (diff > kTolerance) {
+                            std::fprintf(stderr, "%s/%s: ch %d frame %lu differs from scalar by %g\n",
+                                         mixKernelName(type), mode, ch, i, diff);
+                            return EXIT_FAILURE;
+                        }
+                    }
+                }
+            }
+
+            MixParams params = makeParams(in, actual, gains, ramp, kFrames);
+            rtResetAllocationCount();
+            double start = benchNowNs();
+            for (int b = 0; b < kBlocks; ++b) {
+                RtAllocScope allocScope;
+                kernel(params);
+            }
+            double elapsed = benchNowNs() - start;
+            benchRequireNoAllocations(mixKernelName(type));
+
+            double nsPerBlock = elapsed / kBlocks;
+            std::printf("  %-7s %-6s %8.1f ns/block  %10.1f Mframes/s  %6.3f%% of budget\n",
+                        mixKernelName(type), mode, nsPerBlock,
+                        kFrames * 1e3 / nsPerBlock,
+                        100.0 * nsPerBlock / benchBlockBudgetNs(kFrames));
+        }
+    }
+    return EXIT_SUCCESS;
+}
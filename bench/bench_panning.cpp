@@ -0,0 +1,179 @@
+// Dense Gaussian panning against sparse VBAP, on the built-in layouts and on
+// speaker rings of 32 to 128 outputs. The pose moves every block so both
+// modes rebuild their gains each time, as when following a tracker.
+//
+// The whole render also interleaves, and for the arrays splits the mix by
+// output; both cost the same in either mode. So each row also times the two
+// mix kernels alone on the same outputs, ramping every gain as on a moving
+// pose: the dense matrix against VBAP's two routes per source.
+//
+// Also checks the VBAP gains themselves: at most two speakers per source,
+// unit power, and a source on a speaker plays from that speaker alone.
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include "bench_common.h"
+#include "../mix_kernels.h"
+#include "../render_engine.h"
+#include "../vbap.h"
+
+static const int kBlocks = 2000;
+
+// ns per frame for kBlocks blocks of RENDER_BLOCK_FRAMES in `mode`.
+static double renderNsPerFrame(paTestData& data, PanningMode mode)
+{
+    std::unique_ptr<RenderEngine> engine = createRenderEngine(&data);
+    if (!engine)
+        std::exit(EXIT_FAILURE);
+    engine->setMixThreads(0);
+    engine->setPanningMode(mode);
+    if (!engine->prepare(RENDER_BLOCK_FRAMES))
+        std::exit(EXIT_FAILURE);
+    std::vector<float> out(RENDER_BLOCK_FRAMES * engine->outputChannels());
+    data.readIndex = 0;
+
+    double total = 0;
+    rtResetAllocationCount();
+    for (int block = 0; block < kBlocks; ++block) {
+        applyTrackerPose(&data, 0.2f * std::sin(block * 0.01f), -0.8f, block * 0.001f);
+
+        double start = benchNowNs();
+        {
+            RtAllocScope allocScope;
+            engine->render(out.data(), RENDER_BLOCK_FRAMES);
+        }
+        total += benchNowNs() - start;
+    }
+    benchRequireNoAllocations(panningModeName(mode));
+    return total / ((double)kBlocks * RENDER_BLOCK_FRAMES);
+}
+
+// ns per frame of the dense kernel (sparse false) or mixSparse on
+// `outputs` outputs, ramping from one set of gains to another.
+static double mixNsPerFrame(int outputs, bool sparse)
+{
+    const unsigned long frames = RENDER_BLOCK_FRAMES;
+    const int channels = DECODED_CHANNELS + outputs;
+    float* storage = static_cast<float*>(std::aligned_alloc(RENDER_ALIGNMENT, channels * frames * sizeof(float)));
+    if (!storage)
+        std::exit(EXIT_FAILURE);
+    std::vector<float*> in(DECODED_CHANNELS), out(outputs);
+    for (int ch = 0; ch < DECODED_CHANNELS; ++ch)
+        in[ch] = storage + ch * frames;
+    for (int ch = 0; ch < outputs; ++ch)
+        out[ch] = storage + (DECODED_CHANNELS + ch) * frames;
+    for (unsigned long i = 0; i < DECODED_CHANNELS * frames; ++i)
+        storage[i] = std::sin(0.01f * i);
+
+    // Every source between two neighbouring outputs, moving towards the next
+    std::vector<float> gains(outputs * DECODED_CHANNELS, 0.1f), prevGains(outputs * DECODED_CHANNELS, 0.2f);
+    std::vector<SparseGain> routes;
+    for (int v = 0; v < DECODED_CHANNELS; ++v) {
+        int first = v * outputs / DECODED_CHANNELS;
+        routes.push_back({ v, first, 0.6f, 0.8f });
+        routes.push_back({ v, (first + 1) % outputs, 0.8f, 0.6f });
+    }
+
+    MixParams dense = { in.data(), out.data(), gains.data(), prevGains.data(),
+                        DECODED_CHANNELS, outputs, -1, -1, frames };
+    SparseMixParams params = { getRouteKernel(bestMixKernelType()), in.data(), out.data(), routes.data(),
+                               (int)routes.size(), 0, outputs, true, frames };
+    MixKernel kernel = getMixKernel(bestMixKernelType());
+
+    const int repeats = 4000;
+    double start = benchNowNs();
+    for (int r = 0; r < repeats; ++r) {
+        if (sparse)
+            mixSparse(params);
+        else
+            kernel(dense);
+    }
+    double ns = benchNowNs() - start;
+    std::free(storage);
+    return ns / ((double)repeats * frames);
+}
+
+static void report(paTestData& data, const char* name)
+{
+    double gaussian = renderNsPerFrame(data, PanningMode::Gaussian);
+    double vbap = renderNsPerFrame(data, PanningMode::Vbap);
+    double dense = mixNsPerFrame(data.layout->channels, false);
+    double sparse = mixNsPerFrame(data.layout->channels, true);
+    std::printf("  %-12s gaussian %7.2f ns/frame   vbap %7.2f ns/frame   (%.1fx)"
+                "   mix only %7.2f / %7.2f ns/frame   (%.1fx)\n",
+                name, gaussian, vbap, gaussian / vbap, dense, sparse, dense / sparse);
+}
+
+static bool checkVbapGains()
+{
+    const float TWO_PI = 2 * M_PI;
+    const int speakers = 7;
+    float angles[speakers];
+    for (int i = 0; i < speakers; ++i)
+        angles[i] = -M_PI + TWO_PI * (i + 0.5f) / speakers;
+
+    VbapRing ring;
+    vbapSetSpeakers(ring, angles, speakers, -1);
+
+    bool ok = true;
+    for (int step = 0; step < 3600; ++step) {
+        float angle = -M_PI + TWO_PI * step / 3600;
+        int outs[2];
+        float gains[2];
+        int pairs = vbapPan(ring, angle, outs, gains);
+
+        float power = 0;
+        for (int k = 0; k < pairs; ++k)
+            power += gains[k] * gains[k];
+        if (pairs < 1 || pairs > 2 || std::fabs(power - 1.0f) > 1e-4f) {
+            std::fprintf(stderr, "vbap: %d gains with power %f at angle %f\n", pairs, power, angle);
+            ok = false;
+        }
+    }
+
+    for (int i = 0; i < speakers; ++i) {
+        int outs[2];
+        float gains[2];
+        int pairs = vbapPan(ring, angles[i], outs, gains);
+        for (int k = 0; k < pairs; ++k) {
+            float expected = outs[k] == i ? 1.0f : 0.0f;
+            if (std::fabs(gains[k] - expected) > 1e-4f) {
+                std::fprintf(stderr, "vbap: source on speaker %d gives %f to speaker %d\n",
+                             i, gains[k], outs[k]);
+                ok = false;
+            }
+        }
+    }
+    return ok;
+}
+
+int main()
+{
+    static paTestData data;
+    static SpeakerArrayLayout ring;
+    const float seconds = (float)kBlocks * RENDER_BLOCK_FRAMES / SAMPLE_RATE + 1.0f;
+
+    if (!checkVbapGains())
+        return EXIT_FAILURE;
+
+    std::printf("panning  %d-frame blocks, pose changing every block\n", RENDER_BLOCK_FRAMES);
+
+    for (int id = 0; id < (int)SpeakerLayoutId::Count; ++id) {
+        const SpeakerLayout& layout = getSpeakerLayout((SpeakerLayoutId)id);
+        benchInitRoom(data, seconds, layout);
+        report(data, layout.name);
+    }
+
+    for (int speakers : { 32, 64, 128 }) {
+        ring.clear();
+        ring.addSpeaker("LFE", 0.0f, 0.0f, true);
+        for (int i = 0; i < speakers - 1; ++i)
+            ring.addSpeaker("S" + std::to_string(i + 1), (float)i / (speakers - 1), 1.7f);
+        benchInitRoom(data, seconds, ring.layout());
+
+        std::string name = std::to_string(speakers) + " ring";
+        report(data, name.c_str());
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,431 @@
+// Tracker input: checks the pose parser against strtof and sscanf, then
+// sends kPosesPerSecond poses while this thread renders blocks at real-time
+// pace, and reports how old the pose each block starts from is, measured
+// from when the tracker sent it, and what sending each pose costs. Poses go
+// as "x,y,yaw" lines through a pipe to the ingest thread, through the
+// shared-memory mailbox the engine reads itself, and, for comparison,
+// through a pipe to the old getline/sscanf/sleep loop.
+//
+// Fails if a parsed number is more than one ulp from strtof, a malformed
+// line is accepted, a mailbox read returns a torn pose, the parser or the audio path allocates, lines are lost,
+// or the median pose-to-block latency of the ingest thread or the mailbox
+// exceeds kMaxLatencyMs. The tail is reported but not checked: on a loaded machine
+// it is set by when the scheduler runs the tracker and ingest threads.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "bench_common.h"
+#include "../pose_ingest.h"
+#include "../pose_mailbox.h"
+#include "../render_engine.h"
+
+static const int kPosesPerSecond = 100000;
+static const double kRunSeconds = 2.0;
+static const double kMaxLatencyMs = 1.0;
+// The pose's sequence number rides in the yaw, exactly: yaw = seq / kSeqScale
+static const float kSeqScale = 1048576.0f;
+
+static int ulpDistance(float a, float b)
+{
+    int32_t ia, ib;
+    std::memcpy(&ia, &a, sizeof(ia));
+    std::memcpy(&ib, &b, sizeof(ib));
+    if (ia < 0)
+        ia = INT32_MIN - ia;
+    if (ib < 0)
+        ib = INT32_MIN - ib;
+    return std::abs(ia - ib);
+}
+
+static bool checkParser()
+{
+    unsigned int seed = 777;
+    auto next = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    };
+
+    const char* formats[] = { "%f", "%.9g", "%e", "%.3f", "%g" };
+    const int count = 200000;
+    int worst = 0;
+    char text[64];
+    for (int i = 0; i < count; ++i) {
+        float magnitude = std::ldexp((float)next() / 16777216.0f, (int)(next() % 40) - 20);
+        float value = (next() & 1) ? -magnitude : magnitude;
+        int length = std::snprintf(text, sizeof(text), formats[i % 5], value);
+        float parsed = 0.0f;
+        const char* end = parsePoseFloat(text, text + length, parsed);
+        if (end != text + length) {
+            std::printf("  parser stopped early on \"%s\" FAILED\n", text);
+            return false;
+        }
+        worst = std::max(worst, ulpDistance(parsed, std::strtof(text, nullptr)));
+    }
+
+    // Lines sscanf("%f,%f,%f") took or refused
+    struct { const char* line; bool ok; } lines[] = {
+        { "0.000000,0.000000,0.001500", true },
+        { "  -1.5, 2e1,\t.25\r", true },
+        { "1,2,3,4", true },
+        { "+3.,-0,7", true },
+        { "1,2", false },
+        { "1 ,2,3", false },
+        { "a,b,c", false },
+        { "1;2;3", false },
+        { "", false },
+        { "1,2,inf", false },
+        { "1,2,1e999", false },
+        { "-,1,2", false },
+    };
+    bool linesOk = true;
+    for (const auto& test : lines) {
+        float x, y, yaw;
+        bool ok = parsePoseLine(test.line, test.line + std::strlen(test.line), x, y, yaw);
+        if (ok != test.ok) {
+            std::printf("  \"%s\" %s, should be %s FAILED\n", test.line,
+                        ok ? "accepted" : "refused", test.ok ? "accepted" : "refused");
+            linesOk = false;
+        }
+    }
+
+    // Cost per line, and allocations, against what the old loop used
+    std::vector<std::string> samples;
+    for (int i = 0; i < 1000; ++i) {
+        std::snprintf(text, sizeof(text), "%f,%f,%f", (next() % 4000) * 0.001f - 2.0f,
+                      (next() % 4000) * 0.001f - 2.0f, (next() % 1000) * 0.001f);
+        samples.push_back(text);
+    }
+    volatile float sink = 0.0f;
+    rtResetAllocationCount();
+    double start = benchNowNs();
+    {
+        RtAllocScope allocScope;
+        for (int r = 0; r < 100; ++r) {
+            for (const std::string& s : samples) {
+                float x, y, yaw;
+                parsePoseLine(s.data(), s.data() + s.size(), x, y, yaw);
+                sink = sink + yaw;
+            }
+        }
+    }
+    double handRolled = (benchNowNs() - start) / (100.0 * samples.size());
+    benchRequireNoAllocations("pose parser");
+    start = benchNowNs();
+    for (int r = 0; r < 100; ++r) {
+        for (const std::string& s : samples) {
+            float x, y, yaw;
+            std::sscanf(s.c_str(), "%f,%f,%f", &x, &y, &yaw);
+            sink = sink + yaw;
+        }
+    }
+    double scanned = (benchNowNs() - start) / (100.0 * samples.size());
+
+    bool ok = worst <= 1 && linesOk;
+    std::printf("  %-28s %d numbers, worst %d ulp from strtof %s\n", "parser", count, worst,
+                ok ? "ok" : "FAILED");
+    std::printf("  %-28s %.0f ns per line (sscanf %.0f ns), no allocations\n", "", handRolled, scanned);
+    return ok;
+}
+
+// When each pose was sent, by sequence number; atomic only because
+// ThreadSanitizer does not see a pipe order the reads after the writes.
+typedef std::vector<std::atomic<double>> SendTimes;
+
+typedef struct
+{
+    std::vector<double> latencyMs;  // per block: block start minus when its pose was sent
+    double sendNs = 0;              // mean producer cost per pose
+    unsigned long sent = 0;
+    unsigned long received = 0;     // lines read, for the text transports
+    unsigned long publishes = 0;
+    bool ordered = true;
+} LatencyResult;
+
+// Sends kPosesPerSecond poses with send(seq) until `running` clears or a
+// send fails, recording when each went.
+template <typename Send>
+static void sendPoses(Send& send, std::atomic<bool>& running, SendTimes& sent,
+                      std::atomic<unsigned long>& count, double& sendNs)
+{
+    double begin = benchNowNs();
+    double busy = 0;
+    unsigned long seq = 0;
+    while (running.load(std::memory_order_relaxed) && seq < sent.size()) {
+        unsigned long due = (unsigned long)((benchNowNs() - begin) * 1e-9 * kPosesPerSecond);
+        for (; seq < due && seq < sent.size(); ++seq) {
+            double now = benchNowNs();
+            sent[seq].store(now, std::memory_order_relaxed);
+            if (!send(seq))
+                break;
+            busy += benchNowNs() - now;
+            count.store(seq + 1, std::memory_order_release);
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    sendNs = seq ? busy / seq : 0.0;
+}
+
+// Render blocks at real-time pace while a producer thread sends poses with
+// send(seq), timing the pose each block starts from. start(data, engine)
+// sets up the receiving side; stop(result) tears it down once the producer
+// has stopped, and fills in the receive counts.
+template <typename Start, typename Send, typename Stop>
+static LatencyResult measure(double seconds, Start&& start, Send&& send, Stop&& stop)
+{
+    static paTestData data;
+    benchInitRoom(data, 1.0f);
+    std::unique_ptr<RenderEngine> engine = createRenderEngine(&data);
+    if (!engine)
+        std::exit(EXIT_FAILURE);
+    start(&data, engine.get());
+    if (!engine->prepare(RENDER_BLOCK_FRAMES))
+        std::exit(EXIT_FAILURE);
+    std::vector<float> out((size_t)RENDER_BLOCK_FRAMES * engine->outputChannels());
+
+    LatencyResult result;
+    SendTimes sent((size_t)((seconds + 1.0) * kPosesPerSecond));
+    std::atomic<bool> sending{true};
+    std::atomic<unsigned long> sentCount{0};
+    std::thread producer([&]() { sendPoses(send, sending, sent, sentCount, result.sendNs); });
+
+    const double blockNs = benchBlockBudgetNs(RENDER_BLOCK_FRAMES);
+    const int blocks = (int)(seconds * 1e9 / blockNs);
+    unsigned int lastVersion = data.spatial.latest().version;
+    long lastSeq = -1;
+    auto deadline = std::chrono::steady_clock::now();
+    rtResetAllocationCount();
+    for (int block = 0; block < blocks; ++block) {
+        deadline += std::chrono::nanoseconds((long)blockNs);
+        std::this_thread::sleep_until(deadline);
+
+        // The state render() would start from, then the block itself
+        double now = benchNowNs();
+        long seq;
+        {
+            RtAllocScope allocScope;
+            const SpatialState& state = engine->acquireState();
+            if (state.poseArrivalNs == 0)
+                seq = -1;   // no tracker pose yet
+            else if (state.version == lastVersion)
+                seq = lastSeq;
+            else
+                seq = std::lround(state.listenerYaw * kSeqScale);
+            lastVersion = state.version;
+            engine->render(out.data(), RENDER_BLOCK_FRAMES);
+        }
+        if (seq < 0)
+            continue;
+        if (seq < lastSeq)
+            result.ordered = false;
+        lastSeq = seq;
+        result.latencyMs.push_back((now - sent[seq].load(std::memory_order_relaxed)) * 1e-6);
+    }
+    benchRequireNoAllocations("render while poses arrive");
+
+    sending.store(false, std::memory_order_relaxed);
+    stop(producer, result);
+    result.sent = sentCount.load(std::memory_order_acquire);
+    return result;
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+    if (values.empty())
+        return 0.0;
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(p * values.size()))];
+}
+
+static void printLatency(const char* what, const LatencyResult& result)
+{
+    std::printf("  %-28s %9.2f %9.2f %9.2f %9.0f %9lu\n", what,
+                percentile(result.latencyMs, 0.5), percentile(result.latencyMs, 0.99),
+                result.latencyMs.empty() ? 0.0 : result.latencyMs.back(), result.sendNs,
+                result.publishes);
+}
+
+// Sends each pose as a line, one write() per pose as a tracker flushing
+// every pose would.
+static bool writeLine(int fd, unsigned long seq)
+{
+    char line[64];
+    int length = std::snprintf(line, sizeof(line), "%f,%f,%.9g\n", 0.5f, -1.0f, seq / kSeqScale);
+    return write(fd, line, length) == length;
+}
+
+static bool checkTransport(const char* what, const LatencyResult& result, bool coalesces)
+{
+    double median = percentile(result.latencyMs, 0.5);
+    bool ok = result.ordered && median <= kMaxLatencyMs && !result.latencyMs.empty();
+    if (coalesces)
+        ok = ok && result.received == result.sent && result.publishes < result.received;
+    char counts[96];
+    if (coalesces)
+        std::snprintf(counts, sizeof(counts), "%lu poses sent, %lu read, %lu published",
+                      result.sent, result.received, result.publishes);
+    else
+        std::snprintf(counts, sizeof(counts), "%lu poses sent", result.sent);
+    std::printf("  %-28s %s, p50 %.2f ms (limit %.1f) %s\n", what, counts, median, kMaxLatencyMs,
+                ok ? "ok" : "FAILED");
+    return ok;
+}
+
+// A tracker rewriting the mailbox flat out while a reader checks that every
+// pose it gets is one that was published whole: each sets x, -y, yaw and
+// captureNs to its sequence number.
+static bool checkMailboxCoherence(const char* name)
+{
+    PoseMailboxWriter writer;
+    PoseMailboxReader reader;
+    if (!writer.open(name) || !reader.open(name))
+        return false;
+    std::atomic<bool> running{true};
+    std::thread tracker([&]() {
+        for (uint64_t k = 1; running.load(std::memory_order_relaxed); ++k) {
+            float v = (float)(k % 1000000);
+            writer.publish(v, -v, v, k % 1000000);
+        }
+    });
+
+    unsigned long reads = 0, torn = 0, busy = 0, regressions = 0;
+    uint64_t last = 0;
+    double end = benchNowNs() + 200e6;
+    while (benchNowNs() < end) {
+        MailboxPose pose;
+        if (!reader.read(pose)) {
+            ++busy;
+            continue;
+        }
+        ++reads;
+        if (pose.x != -pose.y || pose.x != pose.yaw || (uint64_t)pose.x != pose.captureNs ||
+            pose.captureNs != pose.sequence % 1000000)
+            ++torn;
+        if (pose.sequence < last)
+            ++regressions;
+        last = pose.sequence;
+    }
+    running.store(false, std::memory_order_relaxed);
+    tracker.join();
+
+    bool ok = reads > 0 && torn == 0 && regressions == 0;
+    std::printf("  %-28s %lu reads (%lu mid-write), %lu torn, %lu out of order %s\n",
+                "mailbox seqlock", reads, busy, torn, regressions, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+// What playback did before the ingest thread: a line at a time,
+// echoed, sscanf'd, then a 5 ms sleep.
+static void legacyLoop(int fd, paTestData* data, std::atomic<bool>& running, unsigned long& lines)
+{
+    FILE* in = fdopen(fd, "r");
+    FILE* echo = std::fopen("/dev/null", "w");
+    char line[256];
+    while (running.load(std::memory_order_relaxed) && std::fgets(line, sizeof(line), in)) {
+        std::fprintf(echo, "%s", line);
+        ++lines;
+        float x, y, yaw;
+        if (std::sscanf(line, "%f,%f,%f", &x, &y, &yaw) == 3)
+            applyTrackerPose(data, x, y, yaw, poseClockNs());
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    std::fclose(echo);
+    std::fclose(in);
+}
+
+int main()
+{
+    // The old loop leaves the writer blocked on a full pipe; let it fail instead
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::printf("pose ingest  %d poses/s, %d-frame blocks at real-time pace\n",
+                kPosesPerSecond, RENDER_BLOCK_FRAMES);
+    bool ok = checkParser();
+    const char* mailboxName = "/audiotest-bench-pose";
+    ok = checkMailboxCoherence(mailboxName) && ok;
+    shm_unlink(mailboxName);
+
+    std::printf("  %-28s %9s %9s %9s %9s %9s\n", "pose-to-block latency, ms", "p50", "p99",
+                "last", "send ns", "publishes");
+
+    int fds[2];
+    PoseIngest ingest;
+    LatencyResult threaded = measure(kRunSeconds,
+        [&](paTestData* data, RenderEngine*) {
+            if (pipe(fds) != 0 || !ingest.start(fds[0], data))
+                std::exit(EXIT_FAILURE);
+        },
+        [&](unsigned long seq) { return writeLine(fds[1], seq); },
+        [&](std::thread& producer, LatencyResult& result) {
+            producer.join();
+            close(fds[1]);
+            // End of file lets the thread finish the last burst
+            while (ingest.running())
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            ingest.stop();
+            close(fds[0]);
+            result.received = ingest.linesRead();
+            result.publishes = ingest.posesPublished();
+            if (ingest.malformedLines() != 0) {
+                std::printf("  %lu lines malformed FAILED\n", ingest.malformedLines());
+                result.received = 0;
+            }
+        });
+    printLatency("stdin, ingest thread", threaded);
+
+    // The engine reads the mailbox itself, once per block
+    PoseMailboxReader reader;
+    PoseMailboxWriter writer;
+    LatencyResult shared = measure(kRunSeconds,
+        [&](paTestData*, RenderEngine* engine) {
+            if (!reader.open(mailboxName) || !writer.open(mailboxName))
+                std::exit(EXIT_FAILURE);
+            engine->setPoseMailbox(&reader);
+        },
+        [&](unsigned long seq) {
+            writer.publish(0.5f, -1.0f, seq / kSeqScale);
+            return true;
+        },
+        [&](std::thread& producer, LatencyResult& result) {
+            producer.join();
+            result.publishes = writer.sequence();
+        });
+    shm_unlink(mailboxName);
+    printLatency("shared-memory mailbox", shared);
+
+    std::atomic<bool> legacyRunning{true};
+    unsigned long legacyLines = 0;
+    std::thread legacy;
+    LatencyResult old = measure(1.0,
+        [&](paTestData* data, RenderEngine*) {
+            if (pipe(fds) != 0)
+                std::exit(EXIT_FAILURE);
+            legacy = std::thread(legacyLoop, fds[0], data, std::ref(legacyRunning), std::ref(legacyLines));
+        },
+        [&](unsigned long seq) { return writeLine(fds[1], seq); },
+        [&](std::thread& producer, LatencyResult& result) {
+            legacyRunning.store(false, std::memory_order_relaxed);
+            legacy.join();  // closes the read end, so a blocked writer fails
+            producer.join();
+            close(fds[1]);
+            result.received = result.publishes = legacyLines;
+        });
+    printLatency("stdin, getline + 5 ms sleep", old);
+
+    ok = checkTransport("stdin, ingest thread", threaded, true) && ok;
+    ok = checkTransport("shared-memory mailbox", shared, false) && ok;
+
+    if (!ok) {
+        std::fprintf(stderr, "pose ingest failed\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
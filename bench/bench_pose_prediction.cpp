@@ -0,0 +1,180 @@
+// Pose prediction: drives the engine offline along synthetic head
+// trajectories, sampled by a 1 kHz tracker with a little noise, and renders
+// each block for when it would be heard, kLatenciesMs after the callback.
+// Reports how far the pose each block is rendered for is from the true pose
+// at that moment, with prediction off and on.
+//
+// Fails if prediction does not cut the RMS yaw error of the smooth
+// trajectories, adds more than kNoiseSlackCm to their position error,
+// overshoots a sudden stop by more than its cap, still corrects the pose
+// once the tracker has been silent for POSE_PREDICTION_GAP_SECONDS, or the
+// audio path allocates.
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "bench_common.h"
+#include "../pose_predictor.h"
+#include "../render_engine.h"
+
+static const double kSeconds = 6.0;
+static const double kTrackerRate = 1000.0;
+static const double kLatenciesMs[] = { 10.0, 20.0, 40.0 };
+static const double kNoiseSlackCm = 0.5;
+
+typedef struct
+{
+    float x, y, yaw;    // tracker coordinates; yaw in turns
+} Pose;
+
+typedef struct
+{
+    const char* name;
+    std::function<Pose(double)> at;
+    bool smooth;        // prediction must help
+    double silentFrom;  // the tracker sends nothing from here
+    double silentTo;    // to here, while the head carries on
+} Trajectory;
+
+typedef struct
+{
+    double rmsYawDeg;
+    double maxYawDeg;
+    double rmsOffsetCm;
+    double staleYawDeg;     // largest correction to a pose older than the gap
+} TrackingError;
+
+static double wrapTurns(double turns)
+{
+    return turns - std::floor(turns + 0.5);
+}
+
+static TrackingError track(const Trajectory& trajectory, double latencyMs, bool predict)
+{
+    static paTestData data;
+    benchInitRoom(data, (float)kSeconds + 1.0f);
+    std::unique_ptr<RenderEngine> engine = createRenderEngine(&data);
+    if (!engine)
+        std::exit(EXIT_FAILURE);
+    engine->setPosePrediction(predict);
+    if (!engine->prepare(RENDER_BLOCK_FRAMES))
+        std::exit(EXIT_FAILURE);
+    std::vector<float> out((size_t)RENDER_BLOCK_FRAMES * engine->outputChannels());
+    Point camera = data.spatial.latest().speakerPositions[data.layout->centre];
+
+    // Virtual time, starting well clear of 0 (which means "not tracked")
+    const uint64_t origin = 1000000000ull;
+    auto ns = [origin](double t) { return origin + (uint64_t)(t * 1e9); };
+
+    unsigned int seed = 4242;
+    auto noise = [&seed](float amplitude) {
+        seed = seed * 1664525u + 1013904223u;
+        return ((seed >> 8) * (1.0f / 16777216.0f) * 2.0f - 1.0f) * amplitude;
+    };
+
+    const double blockSeconds = (double)RENDER_BLOCK_FRAMES / SAMPLE_RATE;
+    const int blocks = (int)(kSeconds / blockSeconds);
+    long sample = 0;
+    double yawSquares = 0, offsetSquares = 0, maxYaw = 0, staleYaw = 0;
+    float sentYaw = 0.0f;
+    double sentAt = 0.0;
+    int measured = 0;
+    rtResetAllocationCount();
+    for (int block = 0; block < blocks; ++block) {
+        double now = block * blockSeconds;
+        // The tracker's poses up to now: 0.05 degree and 2 mm of noise
+        for (; sample / kTrackerRate <= now; ++sample) {
+            double t = sample / kTrackerRate;
+            if (t >= trajectory.silentFrom && t < trajectory.silentTo)
+                continue;
+            Pose pose = trajectory.at(t);
+            sentYaw = pose.yaw + noise(0.05f / 360.0f);
+            sentAt = t;
+            applyTrackerPose(&data, pose.x + noise(0.002f), pose.y + noise(0.002f), sentYaw, ns(t));
+        }
+
+        double heard = now + latencyMs * 1e-3;
+        engine->setOutputTime(ns(heard));
+        Pose truth = trajectory.at(heard);
+        float yaw;
+        Point position;
+        {
+            RtAllocScope allocScope;
+            const SpatialState& state = engine->acquireState();
+            yaw = state.listenerYaw;
+            position = state.currentListenerPosition;
+            engine->render(out.data(), RENDER_BLOCK_FRAMES);
+        }
+        if (heard - sentAt >= POSE_PREDICTION_GAP_SECONDS)
+            staleYaw = std::max(staleYaw, std::fabs(wrapTurns(yaw - sentYaw)) * 360.0);
+        if (now < 0.5)
+            continue;   // let the estimate settle
+        double yawError = std::fabs(wrapTurns(yaw - truth.yaw)) * 360.0;
+        double dx = position.x - camera.x - truth.x;
+        double dy = position.y - camera.y - truth.y;
+        yawSquares += yawError * yawError;
+        offsetSquares += dx * dx + dy * dy;
+        maxYaw = std::max(maxYaw, yawError);
+        ++measured;
+    }
+    benchRequireNoAllocations(trajectory.name);
+
+    return { std::sqrt(yawSquares / measured), maxYaw, 100.0 * std::sqrt(offsetSquares / measured), staleYaw };
+}
+
+int main()
+{
+    const double TWO_PI = 2 * M_PI;
+    const Trajectory trajectories[] = {
+        // +-45 degrees once a second: up to 280 degrees/s
+        { "head shake", [=](double t) { return Pose { 0.0f, 0.0f, (float)(0.125 * std::sin(TWO_PI * 1.0 * t)) }; },
+          true, 0, 0 },
+        // 90 degrees/s round and round, wrapping at a full turn
+        { "spin", [](double t) { return Pose { 0.0f, 0.0f, (float)wrapTurns(0.25 * t) }; }, true, 0, 0 },
+        // Walking a 3 m line and back every 5 s while looking about
+        { "walk", [=](double t) {
+              return Pose { (float)(1.5 * std::sin(TWO_PI * 0.2 * t)), (float)(-0.5 + 0.3 * std::cos(TWO_PI * 0.2 * t)),
+                            (float)(0.05 * std::sin(TWO_PI * 0.3 * t)) };
+          }, true, 0, 0 },
+        // 180 degrees/s for half a second, then still: prediction overshoots
+        { "turn and stop", [](double t) {
+              double phase = std::fmod(t, 1.5);
+              return Pose { 0.0f, 0.0f, (float)wrapTurns(0.25 * std::floor(t / 1.5) + 0.5 * std::min(phase, 0.5)) };
+          }, false, 0, 0 },
+        // examples/spin's 1.5 turns/s, with the tracker silent for a second
+        // while the head carries on: prediction must let go of the old pose
+        { "tracker drops out", [](double t) { return Pose { 0.0f, 0.0f, (float)wrapTurns(1.5 * t) }; },
+          false, 2.0, 3.0 },
+    };
+
+    std::printf("pose prediction  %d-frame blocks, 1 kHz tracker, tracking error at the DAC\n", RENDER_BLOCK_FRAMES);
+    std::printf("  %-17s %8s  %-24s %-24s\n", "", "latency", "predict off", "predict on");
+    std::printf("  %-17s %8s  %8s %7s %8s %8s %7s %8s %9s\n", "", "ms", "rms deg", "max deg", "rms cm",
+                "rms deg", "max deg", "rms cm", "stale deg");
+    bool ok = true;
+    for (const Trajectory& trajectory : trajectories) {
+        for (double latencyMs : kLatenciesMs) {
+            TrackingError off = track(trajectory, latencyMs, false);
+            TrackingError on = track(trajectory, latencyMs, true);
+            // Standing still, the tracker's noise is extrapolated a little too
+            bool better = on.rmsYawDeg <= off.rmsYawDeg && on.rmsOffsetCm <= off.rmsOffsetCm + kNoiseSlackCm;
+            // A stop is overshot by at most the cap, on top of the error without
+            bool bounded = on.maxYawDeg <= off.maxYawDeg + POSE_PREDICTION_MAX_YAW * 360.0;
+            // Nothing but the noise of the last pose is left after the gap
+            bool letGo = on.staleYawDeg < 0.01;
+            bool rowOk = bounded && letGo && (!trajectory.smooth || better);
+            std::printf("  %-17s %8.0f  %8.2f %7.2f %8.2f %8.2f %7.2f %8.2f %9.3f %s\n", trajectory.name,
+                        latencyMs, off.rmsYawDeg, off.maxYawDeg, off.rmsOffsetCm, on.rmsYawDeg, on.maxYawDeg,
+                        on.rmsOffsetCm, on.staleYawDeg, rowOk ? "" : "FAILED");
+            ok = ok && rowOk;
+        }
+    }
+
+    if (!ok) {
+        std::fprintf(stderr, "pose prediction failed\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,205 @@
+// Room correction: checks the non-uniformly partitioned convolution against
+// a direct one, with the tail both on the calling thread and on the worker
+// at real-time pace, then measures CPU against filter length on all twelve
+// channels of 7.1.4.
+//
+// The callback share is the mean cost of blocks that do not complete a tail
+// partition; the worker share is the rest of the total, spread over every
+// block, as the worker spends it in the background.
+//
+// Fails if the convolution is wrong, the audio path allocates, or filters
+// up to kRealTimeTaps taps cannot be corrected in real time.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bench_common.h"
+#include "../render_engine.h"
+#include "../room_correction.h"
+
+static const int kBlocks = 1000;
+static const int kRealTimeTaps = 16384;
+static const float kTolerance = 1e-3f;
+
+static void noise(std::vector<float>& v, unsigned int seed)
+{
+    for (float& s : v) {
+        seed = seed * 1664525u + 1013904223u;
+        s = (seed >> 8) * (1.0f / 16777216.0f) * 2.0f - 1.0f;
+    }
+}
+
+// Decaying noise after a unit impulse, like a measured correction filter.
+static std::vector<float> makeFilter(int taps, unsigned int seed)
+{
+    std::vector<float> h(taps);
+    noise(h, seed);
+    for (int k = 0; k < taps; ++k)
+        h[k] *= 0.1f * std::exp(-6.0f * k / taps);
+    h[0] = 1.0f;
+    return h;
+}
+
+// Channel 0 filtered, channel 1 passed through; fed in uneven chunks, and
+// with `paced` on, no faster than real time so the worker can keep up.
+static bool checkConvolution(int taps, bool background, bool paced)
+{
+    const int frames = paced ? SAMPLE_RATE : 12 * CORRECTION_TAIL_FRAMES;
+    std::vector<float> h = makeFilter(taps, 3);
+
+    CorrectionFilters filters;
+    filters.reset(2);
+    filters.setFilter(0, h.data(), taps);
+    RoomCorrection correction;
+    if (!correction.prepare(filters, 2, background))
+        return false;
+
+    std::vector<float> input(frames);
+    noise(input, 7);
+    std::vector<float> left(input), right(input);
+
+    auto start = std::chrono::steady_clock::now();
+    int done = 0;
+    for (int chunk = 1; done < frames; chunk = chunk * 7 % 500 + 1) {
+        int n = std::min(chunk, frames - done);
+        float* channels[2] = { left.data() + done, right.data() + done };
+        correction.process(channels, n);
+        done += n;
+        if (paced)
+            std::this_thread::sleep_until(start + std::chrono::microseconds((long long)done * 1000000 / SAMPLE_RATE));
+    }
+
+    float maxError = 0.0f;
+    for (int t = 0; t < frames; ++t) {
+        double y = 0;
+        for (int k = 0; k < taps && k <= t; ++k)
+            y += (double)h[k] * input[t - k];
+        maxError = std::fmax(maxError, std::fabs(left[t] - (float)y));
+    }
+    bool passed = right == input;
+    unsigned long misses = correction.tailMisses();
+
+    bool ok = passed && (maxError <= kTolerance || misses > 0);
+    std::printf("  %5d taps, tail on %s: max error %.2g, %lu late tail partitions%s %s\n",
+                taps, background ? "worker" : "caller", maxError, misses,
+                passed ? "" : ", unfiltered channel changed", ok ? "ok" : "FAILED");
+    if (misses > 0)
+        std::printf("    (the worker was descheduled past its deadline; error not checked)\n");
+    return ok;
+}
+
+// Shares of the block budget spent in the callback and on the tail, with
+// every channel of `channels` filtered by `taps` taps.
+static void correctionBudgetShare(int channels, int taps, double& callback,
+                                  double& worst, double& tail)
+{
+    CorrectionFilters filters;
+    filters.reset(channels);
+    for (int ch = 0; ch < channels; ++ch) {
+        std::vector<float> h = makeFilter(taps, 11 + ch);
+        filters.setFilter(ch, h.data(), taps);
+    }
+    RoomCorrection correction;
+    if (!correction.prepare(filters, channels, false))
+        std::exit(EXIT_FAILURE);
+
+    std::vector<float> storage((size_t)channels * RENDER_BLOCK_FRAMES);
+    noise(storage, 5);
+    std::vector<float*> planar(channels);
+    for (int ch = 0; ch < channels; ++ch)
+        planar[ch] = storage.data() + (size_t)ch * RENDER_BLOCK_FRAMES;
+
+    double total = 0, headOnly = 0;
+    int headBlocks = 0;
+    worst = 0;
+    for (int block = 0; block < kBlocks; ++block) {
+        double start = benchNowNs();
+        correction.process(planar.data(), RENDER_BLOCK_FRAMES);
+        double elapsed = benchNowNs() - start;
+        total += elapsed;
+        if ((block + 1) * RENDER_BLOCK_FRAMES % CORRECTION_TAIL_FRAMES != 0) {
+            headOnly += elapsed;
+            ++headBlocks;
+            worst = std::max(worst, elapsed);
+        }
+    }
+
+    const double budget = benchBlockBudgetNs(RENDER_BLOCK_FRAMES);
+    callback = headOnly / headBlocks / budget;
+    worst /= budget;
+    tail = std::max(0.0, total - callback * budget * kBlocks) / kBlocks / budget;
+}
+
+// The whole engine with correction on every speaker, worker running.
+static void checkEngineAllocations(paTestData& data, const SpeakerLayout& layout)
+{
+    benchInitRoom(data, (float)kBlocks * RENDER_BLOCK_FRAMES / SAMPLE_RATE + 1.0f, layout);
+    CorrectionFilters filters;
+    filters.reset(layout.channels);
+    for (int ch = 0; ch < layout.channels; ++ch) {
+        std::vector<float> h = makeFilter(8192, 17 + ch);
+        filters.setFilter(ch, h.data(), (int)h.size());
+    }
+
+    std::unique_ptr<RenderEngine> engine = createRenderEngine(&data);
+    if (!engine)
+        std::exit(EXIT_FAILURE);
+    engine->setMixThreads(0);
+    engine->setRoomCorrection(&filters);
+    if (!engine->prepare(RENDER_BLOCK_FRAMES))
+        std::exit(EXIT_FAILURE);
+    std::vector<float> out(RENDER_BLOCK_FRAMES * engine->outputChannels());
+
+    rtResetAllocationCount();
+    for (int block = 0; block < kBlocks; ++block) {
+        applyTrackerPose(&data, 0.3f * std::sin(block * 0.01f), -1.2f, block * 0.001f);
+        RtAllocScope allocScope;
+        engine->render(out.data(), RENDER_BLOCK_FRAMES);
+    }
+    benchRequireNoAllocations("room-corrected render");
+}
+
+int main()
+{
+    static paTestData data;
+    static SpeakerArrayLayout ring;
+    bool ok = true;
+
+    std::printf("room_correction  head %d taps direct, body in %d-frame partitions, "
+                "tail in %d-frame partitions from tap %d\n",
+                CORRECTION_HEAD_FRAMES, CORRECTION_HEAD_FRAMES, CORRECTION_TAIL_FRAMES,
+                2 * CORRECTION_TAIL_FRAMES);
+
+    ok = checkConvolution(100, false, false) && ok;
+    ok = checkConvolution(1500, false, false) && ok;
+    ok = checkConvolution(6000, false, false) && ok;
+    ok = checkConvolution(6000, true, true) && ok;
+
+    checkEngineAllocations(data, getSpeakerLayout(SpeakerLayoutId::Surround51));
+    ring.clear();
+    ring.addSpeaker("LFE", 0.0f, 0.0f, true);
+    for (int i = 0; i < 31; ++i)
+        ring.addSpeaker("S" + std::to_string(i + 1), i / 31.0f, 1.7f);
+    checkEngineAllocations(data, ring.layout());
+
+    const int channels = getSpeakerLayout(SpeakerLayoutId::Surround714).channels;
+    std::printf("  %d channels, %d-frame blocks\n", channels, RENDER_BLOCK_FRAMES);
+    std::printf("  %6s %10s %10s %10s %10s\n", "taps", "callback", "worst", "worker", "total");
+    for (int taps : { 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536 }) {
+        double callback, worst, tail;
+        correctionBudgetShare(channels, taps, callback, worst, tail);
+        std::printf("  %6d %9.2f%% %9.2f%% %9.2f%% %9.2f%%\n", taps, 100 * callback,
+                    100 * worst, 100 * tail, 100 * (callback + tail));
+        if (taps <= kRealTimeTaps && callback + tail >= 1.0)
+            ok = false;
+    }
+
+    if (!ok) {
+        std::fprintf(stderr, "room correction failed\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,107 @@
+// Large runtime-sized speaker arrays (8 to 128 outputs, one of them an LFE),
+// rendered on the calling thread alone and with the mix split across worker
+// threads. Reports how much of the 256-frame real-time budget each takes,
+// with the pose moving every block so the gain matrix is rebuilt each time.
+// The threaded output must match the single-threaded output exactly.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "bench_common.h"
+#include "../render_engine.h"
+
+static const int kBlocks = 2000;
+static const int kSpeakerCounts[] = { 8, 32, 64, 128 };
+
+static void buildRing(SpeakerArrayLayout& layout, int speakers)
+{
+    layout.clear();
+    layout.addSpeaker("LFE", 0.0f, 0.0f, true);
+    for (int i = 0; i < speakers - 1; ++i)
+        layout.addSpeaker("S" + std::to_string(i + 1), (float)i / (speakers - 1), 1.7f);
+}
+
+// Render kBlocks blocks with `threads` mix workers into out, returning the
+// mean and worst block time in ns.
+static void renderBlocks(paTestData& data, int threads, std::vector<float>& out,
+                         double& meanNs, double& worstNs)
+{
+    std::unique_ptr<RenderEngine> engine = createRenderEngine(&data);
+    if (!engine)
+        std::exit(EXIT_FAILURE);
+    engine->setMixThreads(threads);
+    if (!engine->prepare(RENDER_BLOCK_FRAMES))
+        std::exit(EXIT_FAILURE);
+    const int channels = engine->outputChannels();
+    data.readIndex = 0;
+
+    double total = 0;
+    worstNs = 0;
+    rtResetAllocationCount();
+    for (int block = 0; block < kBlocks; ++block) {
+        // Not on the audio thread in the app either: the pose comes from the tracker.
+        applyTrackerPose(&data, 0.3f * std::sin(block * 0.01f), -1.2f, block * 0.001f);
+
+        double start = benchNowNs();
+        {
+            RtAllocScope allocScope;
+            engine->render(out.data() + (size_t)block * RENDER_BLOCK_FRAMES * channels,
+                           RENDER_BLOCK_FRAMES);
+        }
+        double elapsed = benchNowNs() - start;
+        total += elapsed;
+        worstNs = std::max(worstNs, elapsed);
+    }
+    benchRequireNoAllocations("speaker array render");
+    meanNs = total / kBlocks;
+}
+
+int main(int argc, char** argv)
+{
+    // Worker count for the threaded runs; by default the engine's own choice.
+    int threads = -1;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = std::atoi(argv[++i]);
+    }
+
+    static paTestData data;
+    static SpeakerArrayLayout layout;
+    const double budget = benchBlockBudgetNs(RENDER_BLOCK_FRAMES);
+    const size_t samples = (size_t)kBlocks * RENDER_BLOCK_FRAMES * MAX_CHANNELS;
+    std::vector<float> single(samples);
+    std::vector<float> threaded(samples);
+    bool ok = true;
+
+    std::printf("speaker_array  %d blocks of %d frames, budget %.0f us\n",
+                kBlocks, RENDER_BLOCK_FRAMES, budget / 1000);
+
+    for (int speakers : kSpeakerCounts) {
+        buildRing(layout, speakers);
+        benchInitRoom(data, (float)kBlocks * RENDER_BLOCK_FRAMES / SAMPLE_RATE + 1.0f, layout.layout());
+
+        double singleMean, singleWorst, threadedMean, threadedWorst;
+        renderBlocks(data, 0, single, singleMean, singleWorst);
+        renderBlocks(data, threads, threaded, threadedMean, threadedWorst);
+
+        size_t count = (size_t)kBlocks * RENDER_BLOCK_FRAMES * speakers;
+        bool same = std::memcmp(single.data(), threaded.data(), count * sizeof(float)) == 0;
+
+        std::printf("  %3d speakers  1 thread: %5.1f%% of budget (worst %5.1f%%)   "
+                    "workers: %5.1f%% (worst %5.1f%%)%s\n",
+                    speakers,
+                    100 * singleMean / budget, 100 * singleWorst / budget,
+                    100 * threadedMean / budget, 100 * threadedWorst / budget,
+                    same ? "" : "  OUTPUT DIFFERS");
+        if (!same)
+            ok = false;
+    }
+
+    if (!ok) {
+        std::fprintf(stderr, "threaded mix changed the output\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
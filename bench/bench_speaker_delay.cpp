@@ -0,0 +1,187 @@
+// Distance delays: checks the fractional delay lines against an exactly
+// delayed sine, for fixed delays and for delays slewing towards a far
+// target, then measures the stage on 6 to 128 channels with fixed delays
+// and with every delay moving every block (a listener walking about).
+//
+// Fails if the interpolation is off, a delay moves faster than the slew
+// limit, the audio path allocates, threaded mixing changes the delayed
+// output, or six modulated channels take more than kMaxShare of the budget.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "bench_common.h"
+#include "../render_engine.h"
+#include "../speaker_delay.h"
+
+static const int kBlocks = 4000;
+static const double kMaxShare = 0.05;
+static const float kTolerance = 1e-4f;
+static const double kOmega = 2 * M_PI * 1000.0 / SAMPLE_RATE;
+
+// One channel of a 1 kHz sine through a delay line, fed in uneven chunks.
+// With `target` above the start delay the line slews the whole way; the
+// delay at each frame is reconstructed from delay() at the chunk ends.
+static bool checkDelay(float start, float target, const char* what)
+{
+    const unsigned long maxFrames = 300;
+    SpeakerDelays delays;
+    delays.prepare(1, maxFrames);
+    delays.setDelay(0, start, true);
+    delays.setDelay(0, target);
+
+    std::vector<float> block(maxFrames);
+    float* channels[1] = { block.data() };
+    float maxError = 0.0f;
+    bool slewOk = true;
+    long t = 0;
+    for (unsigned long chunk = 1; t < 8 * SAMPLE_RATE; chunk = chunk * 7 % maxFrames + 1) {
+        for (unsigned long i = 0; i < chunk; ++i)
+            block[i] = (float)std::sin(kOmega * (t + i));
+
+        float from = delays.delay(0);
+        delays.process(channels, chunk, 0, 1);
+        float to = delays.delay(0);
+        if (std::fabs(to - from) > SpeakerDelays::kMaxSlew * chunk + 1e-3f)
+            slewOk = false;
+
+        for (unsigned long i = 0; i < chunk; ++i) {
+            double d = from + (double)(to - from) * (i + 1) / chunk;
+            double when = (double)(t + (long)i) - 1 - d;
+            // Skip frames whose history reaches back before the first one
+            if (when - 2 < 0)
+                continue;
+            maxError = std::fmax(maxError, std::fabs(block[i] - (float)std::sin(kOmega * when)));
+        }
+        t += chunk;
+    }
+
+    bool reached = delays.delay(0) == std::min(target, SPEAKER_DELAY_MAX_SECONDS * SAMPLE_RATE);
+    bool ok = maxError <= kTolerance && slewOk && reached;
+    std::printf("  %-32s max error %.2g%s%s %s\n", what, maxError,
+                slewOk ? "" : ", slewed too fast", reached ? "" : ", target not reached",
+                ok ? "ok" : "FAILED");
+    return ok;
+}
+
+// Whole delays are exact: the input comes out one frame plus the delay later.
+static bool checkWholeDelay()
+{
+    const int frames = 1000;
+    const int delay = 37;
+    SpeakerDelays delays;
+    delays.prepare(1, frames);
+    delays.setDelay(0, (float)delay, true);
+
+    std::vector<float> input(frames), block(frames);
+    unsigned int seed = 9;
+    for (float& s : input) {
+        seed = seed * 1664525u + 1013904223u;
+        s = (seed >> 8) * (1.0f / 16777216.0f) * 2.0f - 1.0f;
+    }
+    block = input;
+    float* channels[1] = { block.data() };
+    delays.process(channels, frames, 0, 1);
+
+    bool ok = true;
+    for (int i = 0; i < frames; ++i)
+        ok = ok && block[i] == (i > delay ? input[i - delay - 1] : 0.0f);
+    std::printf("  %-32s %s\n", "whole-frame delay exact", ok ? "ok" : "FAILED");
+    return ok;
+}
+
+// Share of the block budget the stage takes on `channels` channels.
+static double delayBudgetShare(int channels, bool moving)
+{
+    SpeakerDelays delays;
+    delays.prepare(channels, RENDER_BLOCK_FRAMES);
+    std::vector<float> storage((size_t)channels * RENDER_BLOCK_FRAMES);
+    std::vector<float*> planar(channels);
+    for (int ch = 0; ch < channels; ++ch)
+        planar[ch] = storage.data() + (size_t)ch * RENDER_BLOCK_FRAMES;
+    for (int ch = 0; ch < channels; ++ch)
+        delays.setDelay(ch, 20.0f + 3.3f * ch, true);
+
+    double total = 0;
+    for (int block = 0; block < kBlocks; ++block) {
+        for (size_t i = 0; i < storage.size(); ++i)
+            storage[i] = (float)std::sin(0.01 * (i + block));
+        if (moving) {
+            for (int ch = 0; ch < channels; ++ch)
+                delays.setDelay(ch, 60.0f + 40.0f * std::sin(block * 0.01f + ch));
+        }
+        double start = benchNowNs();
+        delays.process(planar.data(), RENDER_BLOCK_FRAMES, 0, channels);
+        total += benchNowNs() - start;
+    }
+    return total / kBlocks / benchBlockBudgetNs(RENDER_BLOCK_FRAMES);
+}
+
+// The engine with distance delays on and the listener walking: no
+// allocations, and the same output with the mix split across threads.
+static void renderWalking(paTestData& data, const SpeakerLayout& layout, int threads,
+                          std::vector<float>& out)
+{
+    const int blocks = 400;
+    benchInitRoom(data, (float)blocks * RENDER_BLOCK_FRAMES / SAMPLE_RATE + 1.0f, layout);
+    std::unique_ptr<RenderEngine> engine = createRenderEngine(&data);
+    if (!engine)
+        std::exit(EXIT_FAILURE);
+    engine->setMixThreads(threads);
+    engine->setDistanceDelays(true);
+    if (!engine->prepare(RENDER_BLOCK_FRAMES))
+        std::exit(EXIT_FAILURE);
+    const int channels = engine->outputChannels();
+    out.assign((size_t)blocks * RENDER_BLOCK_FRAMES * channels, 0.0f);
+
+    rtResetAllocationCount();
+    for (int block = 0; block < blocks; ++block) {
+        applyTrackerPose(&data, 1.5f * std::sin(block * 0.02f), -1.2f + std::cos(block * 0.02f), 0.0f);
+        RtAllocScope allocScope;
+        engine->render(out.data() + (size_t)block * RENDER_BLOCK_FRAMES * channels, RENDER_BLOCK_FRAMES);
+    }
+    benchRequireNoAllocations("distance-delayed render");
+}
+
+int main()
+{
+    static paTestData data;
+    static SpeakerArrayLayout ring;
+    bool ok = true;
+
+    std::printf("speaker_delay  Lagrange/Farrow fractional delay lines, slew limit %.3f frames/frame\n",
+                SpeakerDelays::kMaxSlew);
+    ok = checkWholeDelay() && ok;
+    ok = checkDelay(10.37f, 10.37f, "fixed 10.37-frame delay") && ok;
+    ok = checkDelay(0.0f, 250.0f, "slewing 0 -> 250 frames") && ok;
+    ok = checkDelay(400.0f, 3.6f, "slewing 400 -> 3.6 frames") && ok;
+
+    std::vector<float> single, threaded;
+    renderWalking(data, getSpeakerLayout(SpeakerLayoutId::Surround714), 0, single);
+    ring.clear();
+    ring.addSpeaker("LFE", 0.0f, 0.0f, true);
+    for (int i = 0; i < 47; ++i)
+        ring.addSpeaker("S" + std::to_string(i + 1), i / 47.0f, 1.2f + 0.8f * (i % 3));
+    renderWalking(data, ring.layout(), 0, single);
+    renderWalking(data, ring.layout(), 2, threaded);
+    bool same = single == threaded;
+    std::printf("  %-32s %s\n", "48 speakers, 2 mix workers", same ? "same output ok" : "OUTPUT DIFFERS");
+    ok = same && ok;
+
+    std::printf("  %8s %12s %12s\n", "channels", "fixed", "moving");
+    for (int channels : { 6, 12, 32, 128 }) {
+        double fixed = delayBudgetShare(channels, false);
+        double moving = delayBudgetShare(channels, true);
+        std::printf("  %8d %11.2f%% %11.2f%%\n", channels, 100 * fixed, 100 * moving);
+        if (channels == 6 && moving > kMaxShare)
+            ok = false;
+    }
+
+    if (!ok) {
+        std::fprintf(stderr, "distance delays failed\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
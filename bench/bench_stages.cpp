@@ -0,0 +1,227 @@
+// Cost of each stage of the render path on its own, swept over block sizes
+// from 64 to 4096 frames and every speaker layout: readAudio, applyRotation
+// (cached matrix and with a rebuild plus ramp every block), the interleave
+// loop and the whole render(), then the mix kernel alone over the same
+// channel counts, and the per-pose work in calculateSpeakerDistances and
+// setMaxGain.
+//
+// Reports ns/frame, cycles/frame and allocations per call. Pass --json to get
+// the same numbers as JSON, e.g. to diff two commits:
+//     ./bench/bench_stages --json > before.json
+
+#include <cstring>
+#include <vector>
+#include "bench_common.h"
+#include "../mix_kernels.h"
+#include "../render_engine.h"
+
+static const unsigned long kBlockSizes[] = { 64, 128, 256, 512, 1024, 2048, 4096 };
+static const unsigned long kMaxFrames = 4096;
+// Frames pushed through each stage per measurement, whatever the block size.
+static const unsigned long kFramesPerRun = 1ul << 20;
+static const int kPerPoseCalls = 100000;
+
+static const int kMaxLayoutChannels = MAX_CHANNELS;
+
+typedef struct
+{
+    const char* stage;
+    const char* layout;
+    unsigned long frames;  // block size, 0 for per-pose stages
+    double nsPerCall;
+    double cyclesPerCall;
+    double allocsPerCall;
+} StageResult;
+
+static std::vector<StageResult> gResults;
+
+template <typename Fn>
+static void measure(const char* stage, const char* layout, unsigned long frames,
+                    long calls, Fn&& fn)
+{
+    // warm up caches, branch predictors and the mix matrix
+    for (long i = 0; i < calls / 10 + 1; ++i)
+        fn();
+
+    rtResetAllocationCount();
+    double start = benchNowNs();
+    unsigned long long startCycles = benchNowCycles();
+    {
+        RtAllocScope allocScope;
+        for (long i = 0; i < calls; ++i)
+            fn();
+    }
+    unsigned long long cycles = benchNowCycles() - startCycles;
+    double elapsed = benchNowNs() - start;
+
+    StageResult r;
+    r.stage = stage;
+    r.layout = layout;
+    r.frames = frames;
+    r.nsPerCall = elapsed / calls;
+    r.cyclesPerCall = (double)cycles / calls;
+    r.allocsPerCall = (double)rtAllocationCount() / calls;
+    gResults.push_back(r);
+}
+
+static void benchEngineStages(paTestData& data, const SpeakerLayout& layout)
+{
+    benchInitRoom(data, 10.0f, layout);
+
+    std::unique_ptr<RenderEngine> engine = createRenderEngine(&data);
+    if (!engine || !engine->prepare(kMaxFrames))
+        std::exit(EXIT_FAILURE);
+
+    std::vector<float> out(kMaxFrames * layout.channels);
+    SpatialState state = data.spatial.latest();
+    SpatialState moving = state;
+
+    for (unsigned long frames : kBlockSizes) {
+        long calls = kFramesPerRun / frames;
+
+        measure("readAudio", layout.name, frames, calls, [&]() {
+            engine->readAudio(frames);
+        });
+        measure("applyRotation", layout.name, frames, calls, [&]() {
+            engine->applyRotation(state, frames);
+        });
+        // A new version every block: matrix rebuild plus per-sample ramp.
+        measure("applyRotation+rebuild", layout.name, frames, calls, [&]() {
+            moving.version++;
+            engine->applyRotation(moving, frames);
+        });
+        measure("interleave", layout.name, frames, calls, [&]() {
+            engine->interleave(out.data(), frames);
+        });
+        measure("render", layout.name, frames, calls, [&]() {
+            engine->render(out.data(), frames);
+        });
+    }
+}
+
+static void benchMixLayouts()
+{
+    const size_t bytes = kMaxFrames * sizeof(float) * kMaxLayoutChannels;
+    float* inStorage = (float*)std::aligned_alloc(RENDER_ALIGNMENT, bytes);
+    float* outStorage = (float*)std::aligned_alloc(RENDER_ALIGNMENT, bytes);
+    float* in[kMaxLayoutChannels];
+    float* out[kMaxLayoutChannels];
+    float gains[kMaxLayoutChannels * kMaxLayoutChannels];
+
+    unsigned int seed = 7;
+    for (size_t i = 0; i < bytes / sizeof(float); ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        inStorage[i] = (seed >> 8) * (1.0f / 16777216.0f) * 2.0f - 1.0f;
+    }
+    for (int i = 0; i < kMaxLayoutChannels * kMaxLayoutChannels; ++i)
+        gains[i] = 1.0f / (1 + i % 7);
+    for (int ch = 0; ch < kMaxLayoutChannels; ++ch) {
+        in[ch] = inStorage + kMaxFrames * ch;
+        out[ch] = outStorage + kMaxFrames * ch;
+    }
+
+    MixKernel kernel = getMixKernel(bestMixKernelType());
+
+    for (int id = 0; id < (int)SpeakerLayoutId::Count; ++id) {
+        const SpeakerLayout& layout = getSpeakerLayout((SpeakerLayoutId)id);
+        for (unsigned long frames : kBlockSizes) {
+            MixParams p;
+            p.in = in;
+            p.out = out;
+            p.gains = gains;
+            p.prevGains = nullptr;
+            p.inputs = layout.channels;
+            p.outputs = layout.channels;
+            p.lfeIn = layout.lfe;
+            p.lfeOut = layout.lfe;
+            p.frames = frames;
+
+            measure("mix", layout.name, frames, kFramesPerRun / frames, [&]() {
+                kernel(p);
+            });
+        }
+    }
+
+    std::free(inStorage);
+    std::free(outStorage);
+}
+
+static void benchPerPose(paTestData& data)
+{
+    SpatialState state = data.spatial.latest();
+    volatile float sink = 0;
+
+    measure("calculateSpeakerDistances", "5.1", 0, kPerPoseCalls, [&]() {
+        std::array<float, MAX_CHANNELS> d =
+            calculateSpeakerDistances(state.currentListenerPosition, state.speakerPositions,
+                                      data.layout->channels);
+        sink = sink + d[0];
+    });
+    measure("setMaxGain", "5.1", 0, kPerPoseCalls, [&]() {
+        setMaxGain(&data);
+    });
+}
+
+static void printText()
+{
+    std::printf("stages  kernel=%s\n", mixKernelName(bestMixKernelType()));
+    std::printf("  %-26s %-6s %6s %10s %12s %12s\n",
+                "stage", "layout", "frames", "ns/frame", "cycles/frame", "allocs/call");
+    for (const StageResult& r : gResults) {
+        if (r.frames == 0) {
+            std::printf("  %-26s %-6s %6s %10.1f %12.1f %12.3f  (per call)\n",
+                        r.stage, r.layout, "-", r.nsPerCall, r.cyclesPerCall, r.allocsPerCall);
+        } else {
+            std::printf("  %-26s %-6s %6lu %10.3f %12.3f %12.3f\n",
+                        r.stage, r.layout, r.frames, r.nsPerCall / r.frames,
+                        r.cyclesPerCall / r.frames, r.allocsPerCall);
+        }
+    }
+}
+
+static void printJson()
+{
+    std::printf("{\n  \"benchmark\": \"stages\",\n  \"kernel\": \"%s\",\n"
+                "  \"sample_rate\": %d,\n  \"results\": [\n",
+                mixKernelName(bestMixKernelType()), SAMPLE_RATE);
+    for (size_t i = 0; i < gResults.size(); ++i) {
+        const StageResult& r = gResults[i];
+        double perFrame = r.frames ? (double)r.frames : 1.0;
+        std::printf("    {\"stage\": \"%s\", \"layout\": \"%s\", \"frames\": %lu, "
+                    "\"ns_per_call\": %.3f, \"ns_per_frame\": %.4f, "
+                    "\"cycles_per_frame\": %.4f, \"allocs_per_call\": %.4f}%s\n",
+                    r.stage, r.layout, r.frames, r.nsPerCall, r.nsPerCall / perFrame,
+                    r.cyclesPerCall / perFrame, r.allocsPerCall,
+                    i + 1 < gResults.size() ? "," : "");
+    }
+    std::printf("  ]\n}\n");
+}
+
+int main(int argc, char** argv)
+{
+    bool json = argc > 1 && std::strcmp(argv[1], "--json") == 0;
+
+    static paTestData data;
+
+    for (int id = 0; id < (int)SpeakerLayoutId::Count; ++id)
+        benchEngineStages(data, getSpeakerLayout((SpeakerLayoutId)id));
+    benchMixLayouts();
+
+    benchInitRoom(data, 10.0f);
+    benchPerPose(data);
+
+    if (json)
+        printJson();
+    else
+        printText();
+
+    // Per-pose stages run on the control thread and may allocate.
+    for (const StageResult& r : gResults) {
+        if (r.frames != 0 && r.allocsPerCall > 0) {
+            std::fprintf(stderr, "%s (%s, %lu frames): allocations on the audio path\n",
+                         r.stage, r.layout, r.frames);
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
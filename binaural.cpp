@@ -0,0 +1,184 @@
+#include "binaural.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static const int kPartition = BINAURAL_PARTITION_FRAMES;
+
+// Decaying filter tails reach the denormal range, where every multiply by
+// them is many times slower; they are inaudible, so drop them.
+static float flushDenormal(float x)
+{
+    return std::fabs(x) < 1e-20f ? 0.0f : x;
+}
+
+bool BinauralRenderer::prepare(const HrirSet& hrirs, int speakers)
+{
+    if (hrirs.directions() == 0 || hrirs.taps() == 0 || speakers <= 0)
+        return false;
+
+    m_hrirs = &hrirs;
+    m_speakers = speakers;
+    m_bins = 2 * kPartition;
+    m_partitions = (hrirs.taps() + kPartition - 1) / kPartition;
+    if (!m_fft.init(m_bins))
+        return false;
+
+    // Transform each partition of each filter pair, zero-padded to the FFT
+    // size, and pack them as HL + j HR.
+    const int directions = hrirs.directions();
+    const size_t filterSize = (size_t)directions * m_partitions * m_bins;
+    m_filterRe.assign(filterSize, 0.0f);
+    m_filterIm.assign(filterSize, 0.0f);
+
+    std::vector<float> lRe(m_bins), lIm(m_bins), rRe(m_bins), rIm(m_bins);
+    for (int d = 0; d < directions; ++d) {
+        for (int p = 0; p < m_partitions; ++p) {
+            std::fill(lRe.begin(), lRe.end(), 0.0f);
+            std::fill(lIm.begin(), lIm.end(), 0.0f);
+            std::fill(rRe.begin(), rRe.end(), 0.0f);
+            std::fill(rIm.begin(), rIm.end(), 0.0f);
+            int begin = p * kPartition;
+            int count = std::min(kPartition, hrirs.taps() - begin);
+            std::copy(hrirs.left(d) + begin, hrirs.left(d) + begin + count, lRe.begin());
+            std::copy(hrirs.right(d) + begin, hrirs.right(d) + begin + count, rRe.begin());
+            m_fft.forward(lRe.data(), lIm.data());
+            m_fft.forward(rRe.data(), rIm.data());
+
+            float* gRe = &m_filterRe[((size_t)d * m_partitions + p) * m_bins];
+            float* gIm = &m_filterIm[((size_t)d * m_partitions + p) * m_bins];
+            for (int k = 0; k < m_bins; ++k) {
+                gRe[k] = flushDenormal(lRe[k] - rIm[k]);
+                gIm[k] = flushDenormal(lIm[k] + rRe[k]);
+            }
+        }
+    }
+
+    const size_t delayLineSize = (size_t)speakers * m_partitions * m_bins;
+    m_delayLineRe.assign(delayLineSize, 0.0f);
+    m_delayLineIm.assign(delayLineSize, 0.0f);
+    m_newest = 0;
+
+    m_inputs.assign((size_t)speakers * m_bins, 0.0f);
+    for (std::vector<float>* v : { &m_sumRe, &m_sumIm, &m_newRe, &m_newIm, &m_oldRe, &m_oldIm })
+        v->assign(m_bins, 0.0f);
+    m_output.assign(2 * kPartition, 0.0f);
+    m_fill = 0;
+
+    int ahead = hrirs.nearest(0.0f);
+    m_direction.assign(speakers, ahead);
+    m_target.assign(speakers, ahead);
+    m_angle.assign(speakers, 0.0f);
+    return true;
+}
+
+void BinauralRenderer::setSpeakerAngle(int speaker, float angle)
+{
+    if (angle == m_angle[speaker])
+        return;
+    m_angle[speaker] = angle;
+    m_target[speaker] = m_hrirs->nearest(angle);
+}
+
+void BinauralRenderer::process(const float* const* feeds, float* out, unsigned long frames)
+{
+    unsigned long done = 0;
+    while (done < frames) {
+        unsigned long n = std::min(frames - done, kPartition - m_fill);
+
+        // New input goes into the second half of each overlap-save buffer,
+        // while the previous partition's output is played out.
+        for (int s = 0; s < m_speakers; ++s)
+            std::memcpy(&m_inputs[(size_t)s * m_bins + kPartition + m_fill], feeds[s] + done, n * sizeof(float));
+        std::memcpy(out + 2 * done, &m_output[2 * m_fill], 2 * n * sizeof(float));
+
+        m_fill += n;
+        done += n;
+        if (m_fill == (unsigned long)kPartition) {
+            processPartition();
+            m_fill = 0;
+        }
+    }
+}
+
+// Multiply-add speaker's delay line against the partitions of HRIR `direction`.
+void BinauralRenderer::accumulate(int speaker, int direction, float* re, float* im) const
+{
+    for (int p = 0; p < m_partitions; ++p) {
+        // The input p partitions ago meets filter partition p
+        int slot = (m_newest + p) % m_partitions;
+        const float* xRe = &m_delayLineRe[((size_t)speaker * m_partitions + slot) * m_bins];
+        const float* xIm = &m_delayLineIm[((size_t)speaker * m_partitions + slot) * m_bins];
+        const float* gRe = &m_filterRe[((size_t)direction * m_partitions + p) * m_bins];
+        const float* gIm = &m_filterIm[((size_t)direction * m_partitions + p) * m_bins];
+        for (int k = 0; k < m_bins; ++k) {
+            re[k] += xRe[k] * gRe[k] - xIm[k] * gIm[k];
+            im[k] += xRe[k] * gIm[k] + xIm[k] * gRe[k];
+        }
+    }
+}
+
+void BinauralRenderer::processPartition()
+{
+    m_newest = (m_newest + m_partitions - 1) % m_partitions;
+
+    // Transform the last two partitions of each feed into the newest slot,
+    // then slide the overlap-save buffer along by one partition.
+    for (int s = 0; s < m_speakers; ++s) {
+        float* input = &m_inputs[(size_t)s * m_bins];
+        float* re = &m_delayLineRe[((size_t)s * m_partitions + m_newest) * m_bins];
+        float* im = &m_delayLineIm[((size_t)s * m_partitions + m_newest) * m_bins];
+        std::memcpy(re, input, m_bins * sizeof(float));
+        std::memset(im, 0, m_bins * sizeof(float));
+        m_fft.forward(re, im);
+        std::memcpy(input, input + kPartition, kPartition * sizeof(float));
+    }
+
+    std::fill(m_sumRe.begin(), m_sumRe.end(), 0.0f);
+    std::fill(m_sumIm.begin(), m_sumIm.end(), 0.0f);
+    bool changed = false;
+    for (int s = 0; s < m_speakers; ++s) {
+        if (m_target[s] == m_direction[s]) {
+            accumulate(s, m_direction[s], m_sumRe.data(), m_sumIm.data());
+        } else {
+            if (!changed) {
+                std::fill(m_newRe.begin(), m_newRe.end(), 0.0f);
+                std::fill(m_newIm.begin(), m_newIm.end(), 0.0f);
+                std::fill(m_oldRe.begin(), m_oldRe.end(), 0.0f);
+                std::fill(m_oldIm.begin(), m_oldIm.end(), 0.0f);
+                changed = true;
+            }
+            accumulate(s, m_target[s], m_newRe.data(), m_newIm.data());
+            accumulate(s, m_direction[s], m_oldRe.data(), m_oldIm.data());
+            m_direction[s] = m_target[s];
+        }
+    }
+
+    const float scale = 1.0f / m_bins;
+
+    if (!changed) {
+        m_fft.inverse(m_sumRe.data(), m_sumIm.data());
+        for (int i = 0; i < kPartition; ++i) {
+            m_output[2 * i] = m_sumRe[kPartition + i] * scale;
+            m_output[2 * i + 1] = m_sumIm[kPartition + i] * scale;
+        }
+        return;
+    }
+
+    // Render the partition through both sets of filters and crossfade.
+    for (int k = 0; k < m_bins; ++k) {
+        m_newRe[k] += m_sumRe[k];
+        m_newIm[k] += m_sumIm[k];
+        m_oldRe[k] += m_sumRe[k];
+        m_oldIm[k] += m_sumIm[k];
+    }
+    m_fft.inverse(m_newRe.data(), m_newIm.data());
+    m_fft.inverse(m_oldRe.data(), m_oldIm.data());
+    for (int i = 0; i < kPartition; ++i) {
+        float t = (float)(i + 1) / kPartition;
+        float newL = m_newRe[kPartition + i], newR = m_newIm[kPartition + i];
+        float oldL = m_oldRe[kPartition + i], oldR = m_oldIm[kPartition + i];
+        m_output[2 * i] = (oldL + (newL - oldL) * t) * scale;
+        m_output[2 * i + 1] = (oldR + (newR - oldR) * t) * scale;
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include "fft.h"
+#include "hrtf.h"
+
+// Partition length of the binaural convolution, in frames. The output lags
+// the speaker feeds by exactly this much.
+#define BINAURAL_PARTITION_FRAMES (128)
+
+// Renders speaker feeds to headphones: each feed is convolved with the
+// left/right HRIR for its direction relative to the head and the results
+// are summed per ear.
+//
+// Uniformly partitioned overlap-save convolution: each feed is transformed
+// once per partition into a frequency-domain delay line, and multiplied
+// against the filter's partitions there. The left and right filters are
+// packed as HL + j HR, so one complex multiply-add per bin serves both ears
+// and a single inverse transform yields left in the real part and right in
+// the imaginary part.
+//
+// When a speaker's HRIR changes, that partition is rendered with both the
+// old and new filters and crossfaded, so turning the head does not click.
+//
+// prepare() does all allocation; process() is real-time safe.
+class BinauralRenderer
+{
+public:
+    // Transform every HRIR in `hrirs` for `speakers` feeds. The set must
+    // outlive the renderer.
+    bool prepare(const HrirSet& hrirs, int speakers);
+
+    // Direction of `speaker` relative to the head, in radians (0 ahead,
+    // positive to the right). Takes effect at the next partition.
+    void setSpeakerAngle(int speaker, float angle);
+
+    // Convolve `frames` frames of the planar feeds and write interleaved
+    // stereo to out. Any frame count is accepted.
+    void process(const float* const* feeds, float* out, unsigned long frames);
+
+private:
+    void processPartition();
+    void accumulate(int speaker, int direction, float* re, float* im) const;
+
+    const HrirSet* m_hrirs = nullptr;
+    FftPlan m_fft;
+    int m_speakers = 0;
+    int m_partitions = 0;
+    int m_bins = 0;                      // FFT size, 2 * BINAURAL_PARTITION_FRAMES
+
+    std::vector<float> m_filterRe;       // [direction][partition][bin], HL + j HR
+    std::vector<float> m_filterIm;
+    std::vector<float> m_delayLineRe;    // [speaker][partition][bin] input spectra
+    std::vector<float> m_delayLineIm;
+    int m_newest = 0;                    // partition slot of the latest spectra
+
+    std::vector<float> m_inputs;         // [speaker][bins]: last two partitions of each feed
+    std::vector<float> m_sumRe;          // spectra of speakers whose HRIR is unchanged
+    std::vector<float> m_sumIm;
+    std::vector<float> m_newRe;          // changing speakers through their new HRIR
+    std::vector<float> m_newIm;
+    std::vector<float> m_oldRe;          // ... and through their old one
+    std::vector<float> m_oldIm;
+    std::vector<float> m_output;         // interleaved stereo of the last partition
+    unsigned long m_fill = 0;            // frames of the current partition received
+
+    std::vector<int> m_direction;        // HRIR each speaker is rendered with
+    std::vector<int> m_target;           // HRIR it should move to
+    std::vector<float> m_angle;          // last angle set, to skip repeat lookups
+};
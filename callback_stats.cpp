@@ -0,0 +1,146 @@
+#include "callback_stats.h"
+#include <cstdio>
+
+static int bucketFor(uint64_t ns)
+{
+    int bucket = 63 - __builtin_clzll(ns | 1);
+    return bucket < CALLBACK_STATS_BUCKETS ? bucket : CALLBACK_STATS_BUCKETS - 1;
+}
+
+void CallbackStats::record(uint64_t elapsedNs, uint64_t budgetNs, unsigned long frames,
+                           bool outputUnderflow, bool outputOverflow, bool decoderUnderrun)
+{
+    bump(m_callbacks);
+    bump(m_frames, frames);
+    bump(m_totalNs, elapsedNs);
+    bump(m_histogram[bucketFor(elapsedNs)]);
+
+    if (elapsedNs > m_maxNs.load(std::memory_order_relaxed))
+        m_maxNs.store(elapsedNs, std::memory_order_relaxed);
+
+    float used = budgetNs ? (float)elapsedNs / budgetNs : 0.0f;
+    m_lastBudgetUsed.store(used, std::memory_order_relaxed);
+    if (used > m_maxBudgetUsed.load(std::memory_order_relaxed))
+        m_maxBudgetUsed.store(used, std::memory_order_relaxed);
+    if (elapsedNs > budgetNs)
+        bump(m_deadlineMisses);
+
+    if (outputUnderflow)
+        bump(m_outputUnderflows);
+    if (outputOverflow)
+        bump(m_outputOverflows);
+    if (decoderUnderrun)
+        bump(m_decoderUnderruns);
+}
+
+void CallbackStats::sampleCpuLoad(double load)
+{
+    m_cpuLoad.store((float)load, std::memory_order_relaxed);
+}
+
+CallbackStatsSnapshot CallbackStats::snapshot() const
+{
+    CallbackStatsSnapshot s;
+    s.callbacks = m_callbacks.load(std::memory_order_relaxed);
+    s.frames = m_frames.load(std::memory_order_relaxed);
+    s.deadlineMisses = m_deadlineMisses.load(std::memory_order_relaxed);
+    s.outputUnderflows = m_outputUnderflows.load(std::memory_order_relaxed);
+    s.outputOverflows = m_outputOverflows.load(std::memory_order_relaxed);
+    s.decoderUnderruns = m_decoderUnderruns.load(std::memory_order_relaxed);
+    s.totalNs = m_totalNs.load(std::memory_order_relaxed);
+    s.maxNs = m_maxNs.load(std::memory_order_relaxed);
+    s.lastBudgetUsed = m_lastBudgetUsed.load(std::memory_order_relaxed);
+    s.maxBudgetUsed = m_maxBudgetUsed.load(std::memory_order_relaxed);
+    s.cpuLoad = m_cpuLoad.load(std::memory_order_relaxed);
+    for (int i = 0; i < CALLBACK_STATS_BUCKETS; ++i)
+        s.histogram[i] = m_histogram[i].load(std::memory_order_relaxed);
+    return s;
+}
+
+void CallbackStats::reset()
+{
+    m_callbacks = 0;
+    m_frames = 0;
+    m_deadlineMisses = 0;
+    m_outputUnderflows = 0;
+    m_outputOverflows = 0;
+    m_decoderUnderruns = 0;
+    m_totalNs = 0;
+    m_maxNs = 0;
+    m_lastBudgetUsed = 0.0f;
+    m_maxBudgetUsed = 0.0f;
+    m_cpuLoad = 0.0f;
+    for (int i = 0; i < CALLBACK_STATS_BUCKETS; ++i)
+        m_histogram[i] = 0;
+}
+
+uint64_t callbackStatsPercentileNs(const CallbackStatsSnapshot& stats, double fraction)
+{
+    uint64_t total = 0;
+    for (int i = 0; i < CALLBACK_STATS_BUCKETS; ++i)
+        total += stats.histogram[i];
+    if (total == 0)
+        return 0;
+
+    uint64_t target = (uint64_t)(fraction * total);
+    uint64_t seen = 0;
+    for (int i = 0; i < CALLBACK_STATS_BUCKETS; ++i) {
+        seen += stats.histogram[i];
+        if (seen > target)
+            return 2ull << i;  // upper edge of the bucket
+    }
+    return stats.maxNs;
+}
+
+std::string formatCallbackStats(const CallbackStatsSnapshot& stats)
+{
+    char line[256];
+    double meanUs = stats.callbacks ? stats.totalNs / 1e3 / stats.callbacks : 0.0;
+    std::snprintf(line, sizeof(line),
+                  "Callback: %.0f us avg, %.0f us max, %.1f%% of budget (max %.1f%%) | "
+                  "CPU %.1f%% | misses %llu | underflows %llu | decoder underruns %llu",
+                  meanUs, stats.maxNs / 1e3,
+                  100.0 * stats.lastBudgetUsed, 100.0 * stats.maxBudgetUsed,
+                  100.0 * stats.cpuLoad,
+                  (unsigned long long)stats.deadlineMisses,
+                  (unsigned long long)stats.outputUnderflows,
+                  (unsigned long long)stats.decoderUnderruns);
+    return line;
+}
+
+bool writeCallbackStatsFile(const char* path, const CallbackStatsSnapshot& stats)
+{
+    FILE* file = std::fopen(path, "w");
+    if (!file) {
+        std::fprintf(stderr, "Could not write callback stats to %s\n", path);
+        return false;
+    }
+
+    double meanUs = stats.callbacks ? stats.totalNs / 1e3 / stats.callbacks : 0.0;
+    std::fprintf(file, "callbacks          %llu\n", (unsigned long long)stats.callbacks);
+    std::fprintf(file, "frames             %llu\n", (unsigned long long)stats.frames);
+    std::fprintf(file, "mean               %.1f us\n", meanUs);
+    std::fprintf(file, "p50                < %.1f us\n", callbackStatsPercentileNs(stats, 0.50) / 1e3);
+    std::fprintf(file, "p99                < %.1f us\n", callbackStatsPercentileNs(stats, 0.99) / 1e3);
+    std::fprintf(file, "p99.9              < %.1f us\n", callbackStatsPercentileNs(stats, 0.999) / 1e3);
+    std::fprintf(file, "max                %.1f us\n", stats.maxNs / 1e3);
+    std::fprintf(file, "budget used        %.1f%% (max %.1f%%)\n",
+                 100.0 * stats.lastBudgetUsed, 100.0 * stats.maxBudgetUsed);
+    std::fprintf(file, "deadline misses    %llu\n", (unsigned long long)stats.deadlineMisses);
+    std::fprintf(file, "output underflows  %llu\n", (unsigned long long)stats.outputUnderflows);
+    std::fprintf(file, "output overflows   %llu\n", (unsigned long long)stats.outputOverflows);
+    std::fprintf(file, "decoder underruns  %llu\n", (unsigned long long)stats.decoderUnderruns);
+    std::fprintf(file, "stream cpu load    %.1f%%\n", 100.0 * stats.cpuLoad);
+
+    std::fprintf(file, "\nhistogram (callback duration)\n");
+    for (int i = 0; i < CALLBACK_STATS_BUCKETS; ++i) {
+        if (stats.histogram[i] == 0)
+            continue;
+        std::fprintf(file, "  [%10.1f us, %10.1f us)  %llu\n",
+                     (1ull << i) / 1e3, (2ull << i) / 1e3,
+                     (unsigned long long)stats.histogram[i]);
+    }
+
+    std::fclose(file);
+    return true;
+}
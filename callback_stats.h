@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Number of histogram buckets; bucket i counts callbacks that took
+// [2^i, 2^(i+1)) nanoseconds, the last one everything slower.
+#define CALLBACK_STATS_BUCKETS  (32)
+
+// A consistent-enough copy of CallbackStats for display or dumping. Counters
+// are read one by one, so a snapshot taken mid-callback may be off by one.
+typedef struct
+{
+    uint64_t callbacks;
+    uint64_t frames;
+    uint64_t deadlineMisses;    // callbacks that took longer than their buffer period
+    uint64_t outputUnderflows;  // paOutputUnderflow reported by the host
+    uint64_t outputOverflows;   // paOutputOverflow reported by the host
+    uint64_t decoderUnderruns;  // callbacks the streaming decoder could not fill
+    uint64_t totalNs;
+    uint64_t maxNs;
+    float lastBudgetUsed;       // fraction of the buffer period used by the last callback
+    float maxBudgetUsed;
+    float cpuLoad;              // last Pa_GetStreamCpuLoad sample, 0..1
+    uint64_t histogram[CALLBACK_STATS_BUCKETS];
+} CallbackStatsSnapshot;
+
+// Per-callback timing and xrun counters for the audio stream.
+//
+// record() is called from the audio callback only and is wait-free: every
+// field is a relaxed atomic written by that one thread, so there are no locks,
+// no read-modify-write contention and no allocation. Any other thread may
+// call snapshot() or sampleCpuLoad() concurrently.
+class CallbackStats
+{
+public:
+    CallbackStats() { reset(); }
+
+    CallbackStats(const CallbackStats&) = delete;
+    CallbackStats& operator=(const CallbackStats&) = delete;
+
+    // Audio thread: account for one callback of `frames` frames that took
+    // `elapsedNs` against a buffer period of `budgetNs`.
+    void record(uint64_t elapsedNs, uint64_t budgetNs, unsigned long frames,
+                bool outputUnderflow, bool outputOverflow, bool decoderUnderrun);
+
+    // Control thread: store the host's CPU load estimate for display.
+    void sampleCpuLoad(double load);
+
+    CallbackStatsSnapshot snapshot() const;
+
+    // Not safe while a stream is running.
+    void reset();
+
+private:
+    static void bump(std::atomic<uint64_t>& counter, uint64_t by = 1)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> m_callbacks;
+    std::atomic<uint64_t> m_frames;
+    std::atomic<uint64_t> m_deadlineMisses;
+    std::atomic<uint64_t> m_outputUnderflows;
+    std::atomic<uint64_t> m_outputOverflows;
+    std::atomic<uint64_t> m_decoderUnderruns;
+    std::atomic<uint64_t> m_totalNs;
+    std::atomic<uint64_t> m_maxNs;
+    std::atomic<float> m_lastBudgetUsed;
+    std::atomic<float> m_maxBudgetUsed;
+    std::atomic<float> m_cpuLoad;
+    std::atomic<uint64_t> m_histogram[CALLBACK_STATS_BUCKETS];
+};
+
+// Callback duration in nanoseconds below which a `fraction` of callbacks
+// completed, read from the histogram (so accurate to a power of two).
+uint64_t callbackStatsPercentileNs(const CallbackStatsSnapshot& stats, double fraction);
+
+// One-line summary for a status bar.
+std::string formatCallbackStats(const CallbackStatsSnapshot& stats);
+
+// Write a full report including the histogram to `path`.
+bool writeCallbackStatsFile(const char* path, const CallbackStatsSnapshot& stats);
@@ -0,0 +1,197 @@
+#include "early_reflections.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Coordinate of the image of `x` after |n| reflections alternating between
+// the walls at lo and hi, starting with hi for positive n and lo for
+// negative n.
+static float imageCoordinate(float x, float lo, float hi, int n)
+{
+    float width = hi - lo;
+    if (n % 2 == 0)
+        return x + n * width;
+    if (n > 0)
+        return 2 * hi - x + (n - 1) * width;
+    return 2 * lo - x + (n + 1) * width;
+}
+
+int imageSources(const Point bounds[2], Point source, int order, ImageSource* images)
+{
+    order = std::max(0, std::min(EARLY_REFLECTION_MAX_ORDER, order));
+    int count = 0;
+    for (int k = 1; k <= order; ++k) {
+        for (int nx = -k; nx <= k; ++nx) {
+            int rest = k - std::abs(nx);
+            for (int ny : { -rest, rest }) {
+                ImageSource& image = images[count++];
+                image.position.x = imageCoordinate(source.x, bounds[0].x, bounds[1].x, nx);
+                image.position.y = imageCoordinate(source.y, bounds[0].y, bounds[1].y, ny);
+                image.reflections = k;
+                if (rest == 0)
+                    break;
+            }
+        }
+    }
+    return count;
+}
+
+bool EarlyReflections::prepare(int sources, unsigned long maxFrames)
+{
+    m_maxDelay = (int)(EARLY_REFLECTION_MAX_SECONDS * SAMPLE_RATE);
+    // Room for a block and the longest delay behind it
+    unsigned long needed = maxFrames + m_maxDelay;
+    m_size = 1;
+    while (m_size < needed)
+        m_size <<= 1;
+    m_mask = m_size - 1;
+    m_guard = maxFrames;
+
+    m_rings.assign(sources, std::vector<float>(m_size + m_guard, 0.0f));
+    m_write = 0;
+    m_blockStart = 0;
+    m_count = 0;
+    m_ramping = false;
+    m_settle = false;
+    return true;
+}
+
+static bool tapBefore(int outputA, int sourceA, int delayA, int outputB, int sourceB, int delayB)
+{
+    if (outputA != outputB)
+        return outputA < outputB;
+    if (sourceA != sourceB)
+        return sourceA < sourceB;
+    return delayA < delayB;
+}
+
+// Drop the taps that have faded out and hold the rest at their new gains.
+void EarlyReflections::settle()
+{
+    int kept = 0;
+    for (int i = 0; i < m_count; ++i) {
+        if (m_taps[i].to == 0.0f)
+            continue;
+        m_taps[kept] = m_taps[i];
+        m_taps[kept].from = m_taps[kept].to;
+        ++kept;
+    }
+    m_count = kept;
+    m_ramping = false;
+    m_settle = false;
+}
+
+void EarlyReflections::setTaps(ReflectionTap* taps, int count, bool ramp)
+{
+    if (m_ramping)
+        settle();
+
+    // Keep the loudest that fit the delay lines and the budget
+    int usable = 0;
+    for (int i = 0; i < count; ++i) {
+        if (taps[i].delay >= 0 && taps[i].delay <= m_maxDelay && taps[i].gain != 0.0f)
+            taps[usable++] = taps[i];
+    }
+    if (usable > EARLY_REFLECTION_MAX_TAPS) {
+        std::nth_element(taps, taps + EARLY_REFLECTION_MAX_TAPS, taps + usable,
+                         [](const ReflectionTap& a, const ReflectionTap& b) {
+                             return std::fabs(a.gain) > std::fabs(b.gain);
+                         });
+        usable = EARLY_REFLECTION_MAX_TAPS;
+    }
+
+    for (int i = 0; i < usable; ++i)
+        m_next[i] = { taps[i].source, taps[i].output, taps[i].delay, taps[i].gain, taps[i].gain };
+    std::sort(m_next, m_next + usable, [](const Tap& a, const Tap& b) {
+        return tapBefore(a.output, a.source, a.delay, b.output, b.source, b.delay);
+    });
+
+    if (!ramp) {
+        std::copy(m_next, m_next + usable, m_taps);
+        m_count = usable;
+        return;
+    }
+
+    // Merge the settled taps with the new ones, both sorted: a tap in both
+    // ramps between its gains, the rest fade out or in.
+    Tap old[EARLY_REFLECTION_MAX_TAPS];
+    int oldCount = m_count;
+    std::copy(m_taps, m_taps + oldCount, old);
+
+    int i = 0, j = 0, merged = 0;
+    while (i < oldCount || j < usable) {
+        Tap tap;
+        if (j == usable || (i < oldCount && tapBefore(old[i].output, old[i].source, old[i].delay,
+                                                       m_next[j].output, m_next[j].source, m_next[j].delay))) {
+            tap = old[i++];
+            tap.to = 0.0f;
+        } else if (i == oldCount || tapBefore(m_next[j].output, m_next[j].source, m_next[j].delay,
+                                              old[i].output, old[i].source, old[i].delay)) {
+            tap = m_next[j++];
+            tap.from = 0.0f;
+        } else {
+            tap = m_next[j++];
+            tap.from = old[i++].to;
+        }
+        m_taps[merged++] = tap;
+    }
+    m_count = merged;
+    m_ramping = true;
+    m_settle = false;
+}
+
+void EarlyReflections::push(const float* const* sources, unsigned long frames)
+{
+    if (m_settle)
+        settle();
+    m_settle = m_ramping;
+
+    unsigned long pos = m_write & m_mask;
+    unsigned long first = std::min(frames, m_size - pos);
+    for (size_t s = 0; s < m_rings.size(); ++s) {
+        float* ring = m_rings[s].data();
+        std::memcpy(ring + pos, sources[s], first * sizeof(float));
+        std::memcpy(ring, sources[s] + first, (frames - first) * sizeof(float));
+        if (pos < m_guard || first < frames)
+            std::memcpy(ring + m_size, ring, m_guard * sizeof(float));
+    }
+    m_blockStart = m_write;
+    m_write += frames;
+}
+
+// out[i] += (from + step * (i + 1)) * src[i]
+static void addTap(const float* src, float* out, float from, float step, unsigned long frames)
+{
+    unsigned long i = 0;
+#ifdef __SSE2__
+    if (step == 0.0f) {
+        const __m128 g = _mm_set1_ps(from);
+        for (; i + 4 <= frames; i += 4)
+            _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(g, _mm_loadu_ps(src + i))));
+    } else {
+        __m128 g = _mm_add_ps(_mm_set1_ps(from), _mm_mul_ps(_mm_set1_ps(step), _mm_setr_ps(1, 2, 3, 4)));
+        const __m128 g4 = _mm_set1_ps(4 * step);
+        for (; i + 4 <= frames; i += 4) {
+            _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(g, _mm_loadu_ps(src + i))));
+            g = _mm_add_ps(g, g4);
+        }
+    }
+#endif
+    for (; i < frames; ++i)
+        out[i] += (from + step * (i + 1)) * src[i];
+}
+
+void EarlyReflections::mix(float* const* outputs, unsigned long frames, int begin, int end) const
+{
+    const Tap* tap = std::lower_bound(m_taps, m_taps + m_count, begin,
+                                      [](const Tap& t, int output) { return t.output < output; });
+    for (; tap != m_taps + m_count && tap->output < end; ++tap) {
+        const float* src = m_rings[tap->source].data() + ((m_blockStart - tap->delay) & m_mask);
+        addTap(src, outputs[tap->output], tap->from, (tap->to - tap->from) / frames, frames);
+    }
+}
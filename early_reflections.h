@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vector>
+#include "utils.h"
+
+// Highest image-source order: reflections off up to this many walls.
+#define EARLY_REFLECTION_MAX_ORDER (3)
+// Images of one source up to the highest order: 4k of order k.
+#define EARLY_REFLECTION_MAX_IMAGES (2 * EARLY_REFLECTION_MAX_ORDER * (EARLY_REFLECTION_MAX_ORDER + 1))
+// Taps rendered per block, whatever the order; beyond this the quietest are
+// dropped, so the cost of a block is bounded.
+#define EARLY_REFLECTION_MAX_TAPS (128)
+// Longest reflection delay after the direct sound, in seconds.
+#define EARLY_REFLECTION_MAX_SECONDS (0.1f)
+
+typedef struct
+{
+    Point position;
+    int reflections;    // walls on the path, 1 to the order asked for
+} ImageSource;
+
+// Images of `source` in the rectangular room `bounds` (bottom left, top
+// right), off 1 to `order` walls. Returns how many were written, at most
+// EARLY_REFLECTION_MAX_IMAGES.
+int imageSources(const Point bounds[2], Point source, int order, ImageSource* images);
+
+// One reflection: `source` delayed by `delay` frames, scaled by `gain`,
+// added into `output`.
+typedef struct
+{
+    int source;
+    int output;
+    int delay;
+    float gain;
+} ReflectionTap;
+
+// Multi-tap delay line rendering early reflections.
+//
+// Every source is written into a power-of-two ring once per block, followed
+// by a copy of its start so every tap reads a contiguous run of frames; each
+// tap is then a scaled add of one run into one output.
+//
+// A new set of taps crossfades from the old one across one block: taps in
+// both sets ramp their gain, the others fade out or in, so the cost of that
+// block is at most twice EARLY_REFLECTION_MAX_TAPS taps.
+//
+// prepare() does all allocation; the rest is real-time safe.
+class EarlyReflections
+{
+public:
+    bool prepare(int sources, unsigned long maxFrames);
+
+    // Longest delay a tap may have, in frames; longer taps are dropped.
+    int maxDelay() const { return m_maxDelay; }
+
+    // Replace the taps with the loudest EARLY_REFLECTION_MAX_TAPS of `taps`,
+    // which are reordered. With ramp set, the change fades in across the next
+    // block; otherwise it is immediate.
+    void setTaps(ReflectionTap* taps, int count, bool ramp);
+    int taps() const { return m_count; }
+
+    // Write the next block of each source into its delay line. Once per
+    // block, before mix().
+    void push(const float* const* sources, unsigned long frames);
+
+    // Add the reflections feeding outputs [begin, end) into `outputs`.
+    // Distinct output ranges may be mixed on different threads.
+    void mix(float* const* outputs, unsigned long frames, int begin, int end) const;
+
+private:
+    struct Tap
+    {
+        int source;
+        int output;
+        int delay;
+        float from;     // gain at the start of the block
+        float to;       // and at its end
+    };
+
+    void settle();
+
+    std::vector<std::vector<float>> m_rings;    // m_size frames, then m_guard mirrored ones
+    unsigned long m_size = 0;
+    unsigned long m_mask = 0;
+    unsigned long m_guard = 0;
+    unsigned long m_write = 0;                   // frames written since prepare()
+    unsigned long m_blockStart = 0;              // where the last pushed block begins
+    int m_maxDelay = 0;
+
+    // Sorted by output, then source, then delay.
+    Tap m_taps[2 * EARLY_REFLECTION_MAX_TAPS];
+    Tap m_next[EARLY_REFLECTION_MAX_TAPS];
+    int m_count = 0;
+    bool m_ramping = false;     // m_taps fade from the previous set
+    bool m_settle = false;      // the fade has been pushed, so ends at the next push
+};
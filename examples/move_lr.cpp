@@ -1,12 +1,22 @@
 #include <cstdio>
+#include <cstring>
 #include <chrono>
 #include <thread>
+#include "../pose_mailbox.h"
 
-int main() {
+// Walks the listener left and right. Prints "x,y,yaw" lines for audiotest's
+// stdin, or with `--shm [name]` publishes to the shared-memory pose mailbox
+// (audiotest --pose-shm [name]).
+int main(int argc, char** argv) {
     float y = 0;
     float yaw = 0;
     float x = -1;
     float addAmount = 0.003;
+
+    PoseMailboxWriter mailbox;
+    bool shm = argc > 1 && std::strcmp(argv[1], "--shm") == 0;
+    if (shm && !mailbox.open(argc > 2 ? argv[2] : POSE_MAILBOX_DEFAULT_NAME))
+        return 1;
     
     while (true) {
         x += addAmount;
@@ -16,6 +26,11 @@ int main() {
         }
 
         std::this_thread::sleep_for(std::chrono::milliseconds(1));
-        printf("%f,%f,%f\n", x, y, yaw);
+        if (shm) {
+            mailbox.publish(x, y, yaw);
+        } else {
+            printf("%f,%f,%f\n", x, y, yaw);
+            fflush(stdout); // a pipe is block-buffered; send each pose as it is made
+        }
     }
-}
\ No newline at end of file
+}
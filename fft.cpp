@@ -0,0 +1,78 @@
+#include "fft.h"
+#include <cmath>
+#include <utility>
+
+#ifndef M_PI
+#define M_PI (3.14159265)
+#endif
+
+bool FftPlan::init(int size)
+{
+    if (size < 2 || (size & (size - 1)) != 0)
+        return false;
+
+    m_size = size;
+    int bits = 0;
+    while ((1 << bits) < size)
+        ++bits;
+
+    m_bitReverse.resize(size);
+    for (int i = 0; i < size; ++i) {
+        int r = 0;
+        for (int b = 0; b < bits; ++b)
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        m_bitReverse[i] = r;
+    }
+
+    m_cos.resize(size / 2);
+    m_sin.resize(size / 2);
+    for (int k = 0; k < size / 2; ++k) {
+        m_cos[k] = (float)std::cos(2 * M_PI * k / size);
+        m_sin[k] = (float)std::sin(2 * M_PI * k / size);
+    }
+    return true;
+}
+
+void FftPlan::forward(float* re, float* im) const
+{
+    transform(re, im, -1.0f);
+}
+
+void FftPlan::inverse(float* re, float* im) const
+{
+    transform(re, im, 1.0f);
+}
+
+void FftPlan::transform(float* re, float* im, float sign) const
+{
+    const int n = m_size;
+
+    for (int i = 0; i < n; ++i) {
+        int j = m_bitReverse[i];
+        if (j > i) {
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+
+    // Butterflies, one stage per doubling of the span; the twiddle for
+    // position k in a span of `len` is table entry k * (n / len).
+    for (int len = 2; len <= n; len <<= 1) {
+        const int half = len / 2;
+        const int step = n / len;
+        for (int start = 0; start < n; start += len) {
+            for (int k = 0; k < half; ++k) {
+                const float wr = m_cos[k * step];
+                const float wi = sign * m_sin[k * step];
+                const int a = start + k;
+                const int b = a + half;
+                const float tr = re[b] * wr - im[b] * wi;
+                const float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
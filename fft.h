@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+
+// In-place radix-2 complex FFT on split real/imaginary arrays, for the
+// partitioned convolutions in binaural.cpp and room_correction.cpp. The plan
+// holds the twiddle and bit-reversal tables, so transforms never allocate.
+class FftPlan
+{
+public:
+    // `size` must be a power of two.
+    bool init(int size);
+    int size() const { return m_size; }
+
+    void forward(float* re, float* im) const;
+    // Unscaled: forward then inverse multiplies by size().
+    void inverse(float* re, float* im) const;
+
+private:
+    void transform(float* re, float* im, float sign) const;
+
+    int m_size = 0;
+    std::vector<int> m_bitReverse;
+    std::vector<float> m_cos;   // cos(2 pi k / size), k < size / 2
+    std::vector<float> m_sin;
+};
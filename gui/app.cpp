@@ -1,8 +1,10 @@
 #include <wx/wx.h>
+#include <cstdio>
 #include <cstring>
 #include <cstdlib> // Required for setenv
 #include "main_frame.h"
 #include "../start.h"
+#include "../portaudio_listener.h"
 
 class MyApp : public wxApp
 {
@@ -11,9 +13,12 @@ public:
     {
         setenv("GTK_THEME", "Adwaita:dark", 1);
 
-        initAudioData();
-
         bool interactiveMode = true;
+        bool streaming = false;
+        double lookaheadSeconds = 0;
+        PanningMode panningMode = PanningMode::Gaussian;
+        const char* attenuation = nullptr;
+        float referenceDistance = 1.0f;
 
         for (int i = 1; i < argc; ++i)
         {
@@ -21,9 +26,115 @@ public:
             {
                 interactiveMode = false;
             }
+            else if (std::strcmp(argv[i], "--pose-shm") == 0)
+            {
+                // Optional segment name, else the one the examples use
+                const char* name = i + 1 < argc && argv[i + 1][0] == '/' ? argv[++i] : POSE_MAILBOX_DEFAULT_NAME;
+                if (!SetPoseMailbox(name))
+                    return false;
+            }
+            else if (std::strcmp(argv[i], "--stream") == 0)
+            {
+                streaming = true;
+            }
+            else if (std::strcmp(argv[i], "--lookahead") == 0 && i + 1 < argc)
+            {
+                lookaheadSeconds = std::atof(argv[++i]);
+            }
+            else if (std::strcmp(argv[i], "--layout") == 0 && i + 1 < argc)
+            {
+                if (!setSpeakerLayout(argv[++i]))
+                {
+                    std::fprintf(stderr, "Unknown speaker layout '%s' (expected 2.0, 5.1, 7.1 or 7.1.4)\n", argv[i]);
+                    return false;
+                }
+            }
+            else if (std::strcmp(argv[i], "--layout-file") == 0 && i + 1 < argc)
+            {
+                if (!setSpeakerLayoutFile(argv[++i]))
+                    return false;
+            }
+            else if (std::strcmp(argv[i], "--panning") == 0 && i + 1 < argc)
+            {
+                PanningMode mode;
+                if (!findPanningMode(argv[++i], mode))
+                {
+                    std::fprintf(stderr, "Unknown panning mode '%s' (expected gaussian, vbap or ambisonic)\n", argv[i]);
+                    return false;
+                }
+                SetPanningMode(mode);
+                panningMode = mode;
+            }
+            else if (std::strcmp(argv[i], "--binaural") == 0)
+            {
+                SetBinauralOutput(nullptr);
+            }
+            else if (std::strcmp(argv[i], "--hrir") == 0 && i + 1 < argc)
+            {
+                if (!SetBinauralOutput(argv[++i]))
+                    return false;
+            }
+            else if (std::strcmp(argv[i], "--reflections") == 0 && i + 1 < argc)
+            {
+                SetEarlyReflections(std::atoi(argv[++i]));
+            }
+            else if (std::strcmp(argv[i], "--predict") == 0)
+            {
+                SetPosePrediction(true);
+            }
+            else if (std::strcmp(argv[i], "--distance-delay") == 0)
+            {
+                SetDistanceDelays(true);
+            }
+            else if (std::strcmp(argv[i], "--room-correction") == 0 && i + 1 < argc)
+            {
+                SetRoomCorrection(argv[++i]);
+            }
+            else if (std::strcmp(argv[i], "--automation") == 0 && i + 1 < argc)
+            {
+                SetAutomation(argv[++i]);
+            }
+            else if (std::strcmp(argv[i], "--attenuation") == 0 && i + 1 < argc)
+            {
+                // "linear", "inverse", "inverse-square" or a curve file
+                attenuation = argv[++i];
+            }
+            else if (std::strcmp(argv[i], "--reference-distance") == 0 && i + 1 < argc)
+            {
+                referenceDistance = std::atof(argv[++i]);
+            }
+            else if (std::strcmp(argv[i], "--ambisonic-order") == 0 && i + 1 < argc)
+            {
+                SetAmbisonicOrder(std::atoi(argv[++i]));
+            }
+            else if (std::strcmp(argv[i], "--mix-threads") == 0 && i + 1 < argc)
+            {
+                SetMixThreads(std::atoi(argv[++i]));
+            }
+            else if (std::strcmp(argv[i], "--buffer-frames") == 0 && i + 1 < argc)
+            {
+                // 0 lets the host API choose (paFramesPerBufferUnspecified)
+                SetFramesPerBuffer(std::strtoul(argv[++i], nullptr, 10));
+            }
+            else if (std::strcmp(argv[i], "--latency") == 0 && i + 1 < argc)
+            {
+                // "low", "high" or seconds; clamped to the device's range
+                const char* latency = argv[++i];
+                if (std::strcmp(latency, "low") == 0)
+                    SetOutputLatency(0);
+                else if (std::strcmp(latency, "high") == 0)
+                    SetOutputLatency(1e9);
+                else
+                    SetOutputLatency(std::atof(latency));
+            }
         }
 
-        MyFrame* frame = new MyFrame(interactiveMode);
+        if (attenuation && !setAttenuation(attenuation, referenceDistance))
+            return false;
+        setStreamingMode(streaming, lookaheadSeconds);
+        initAudioData();
+
+        MyFrame* frame = new MyFrame(interactiveMode, panningMode);
 
         frame->SetBackgroundColour(wxColour(30, 30, 30));
         
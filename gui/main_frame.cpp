@@ -2,13 +2,15 @@
 
 #include "speaker_panel.h"
 #include "../start.h"
+#include "../audio_engine.h"
 #include "../portaudio_listener.h"
 
 #include <portaudio.h>
-#include <thread>
+
+// Where "Dump audio stats" writes the callback timing report.
+#define STATS_FILE_PATH "audiotest_stats.txt"
 
 extern paTestData gData;
-void SetOutputDeviceIndex(int index);  // from portaudio_listener.cpp
 
 wxBEGIN_EVENT_TABLE(MyFrame, wxFrame)
     EVT_TIMER(MyFrame::ID_TimerRefresh,    MyFrame::OnTimer)
@@ -18,10 +20,14 @@ wxBEGIN_EVENT_TABLE(MyFrame, wxFrame)
     EVT_CHOICE(MyFrame::ID_DeviceChoice,   MyFrame::OnDeviceChoice)
     EVT_CHOICE(MyFrame::ID_ModeChoice,     MyFrame::OnModeChoice)
     EVT_BUTTON(MyFrame::ID_StartAudio,     MyFrame::OnStartAudio)
+    EVT_BUTTON(MyFrame::ID_PauseAudio,     MyFrame::OnPauseAudio)
+    EVT_BUTTON(MyFrame::ID_StopAudio,      MyFrame::OnStopAudio)
     EVT_BUTTON(MyFrame::ID_ResetPositions, MyFrame::OnResetPositions)
+    EVT_MENU(MyFrame::ID_DumpStats,        MyFrame::OnDumpStats)
+    EVT_CHOICE(MyFrame::ID_PanningChoice,  MyFrame::OnPanningChoice)
 wxEND_EVENT_TABLE()
 
-MyFrame::MyFrame(bool interactiveMode)
+MyFrame::MyFrame(bool interactiveMode, PanningMode panningMode)
     : wxFrame(nullptr, wxID_ANY, "PortAudio + wxWidgets (Live Volumes)",
               wxDefaultPosition, wxSize(980, 600))
     , m_interactiveMode(interactiveMode)
@@ -30,6 +36,7 @@ MyFrame::MyFrame(bool interactiveMode)
     // Menus
     wxMenu* menuFile = new wxMenu;
     menuFile->Append(ID_Hello, "&Hello...\tCtrl-H");
+    menuFile->Append(ID_DumpStats, "&Dump audio stats\tCtrl-D");
     menuFile->AppendSeparator();
     menuFile->Append(wxID_EXIT);
 
@@ -41,8 +48,8 @@ MyFrame::MyFrame(bool interactiveMode)
     menuBar->Append(menuHelp, "&Help");
     SetMenuBar(menuBar);
 
-    // Status bar
-    CreateStatusBar();
+    // Status bar: mode / messages, then live callback stats
+    CreateStatusBar(2);
     if (m_interactiveMode)
         SetStatusText("Interactive mode: drag listener & speakers. Speakers movable in both modes.");
     else
@@ -68,7 +75,18 @@ MyFrame::MyFrame(bool interactiveMode)
     m_modeChoice->Append("Interactive (drag head)");
     m_modeChoice->Append("Follow stdin (head locked)");
     m_modeChoice->SetSelection(m_interactiveMode ? 0 : 1);
-    deviceSizer->Add(m_modeChoice, 0, wxALIGN_CENTER_VERTICAL);
+    deviceSizer->Add(m_modeChoice, 0, wxALIGN_CENTER_VERTICAL | wxRIGHT, 15);
+
+    deviceSizer->Add(new wxStaticText(rootPanel, wxID_ANY, "Panning:"),
+                     0, wxALIGN_CENTER_VERTICAL | wxRIGHT, 5);
+
+    // Same order as PanningMode
+    m_panningChoice = new wxChoice(rootPanel, ID_PanningChoice);
+    m_panningChoice->Append("Gaussian");
+    m_panningChoice->Append("VBAP");
+    m_panningChoice->Append("Ambisonic");
+    m_panningChoice->SetSelection((int)panningMode);
+    deviceSizer->Add(m_panningChoice, 0, wxALIGN_CENTER_VERTICAL);
 
     mainSizer->Add(deviceSizer, 0, wxEXPAND | wxALL, 10);
 
@@ -76,7 +94,7 @@ MyFrame::MyFrame(bool interactiveMode)
     m_panel = new SpeakerPanel(rootPanel, &gData, m_interactiveMode);
     mainSizer->Add(m_panel, 1, wxEXPAND | wxLEFT | wxRIGHT | wxBOTTOM, 10);
 
-    // Bottom row: Reset (left) + Start (right)
+    // Bottom row: Reset (left) + Start / Pause / Stop (right)
     wxBoxSizer* bottomSizer = new wxBoxSizer(wxHORIZONTAL);
 
     wxButton* resetBtn = new wxButton(rootPanel, ID_ResetPositions, "Reset positions");
@@ -85,7 +103,13 @@ MyFrame::MyFrame(bool interactiveMode)
     bottomSizer->AddStretchSpacer(1);
 
     wxButton* startBtn = new wxButton(rootPanel, ID_StartAudio, "Start Audio");
-    bottomSizer->Add(startBtn, 0, wxALIGN_RIGHT);
+    bottomSizer->Add(startBtn, 0, wxALIGN_RIGHT | wxRIGHT, 5);
+
+    wxButton* pauseBtn = new wxButton(rootPanel, ID_PauseAudio, "Pause");
+    bottomSizer->Add(pauseBtn, 0, wxALIGN_RIGHT | wxRIGHT, 5);
+
+    wxButton* stopBtn = new wxButton(rootPanel, ID_StopAudio, "Stop");
+    bottomSizer->Add(stopBtn, 0, wxALIGN_RIGHT);
 
     mainSizer->Add(bottomSizer, 0, wxEXPAND | wxLEFT | wxRIGHT | wxBOTTOM, 10);
 
@@ -93,11 +117,11 @@ MyFrame::MyFrame(bool interactiveMode)
 
     m_timer.Start(50);
 
-    // PortAudio device enumeration
-    PaError err = Pa_Initialize();
-    if (err != paNoError)
+    // PortAudio device enumeration; the engine keeps PortAudio initialised
+    // until the app exits
+    if (!audioEngine().initialize())
     {
-        wxLogError("PortAudio error: %s", Pa_GetErrorText(err));
+        wxLogError("PortAudio could not be initialised.");
         return;
     }
 
@@ -140,7 +164,7 @@ MyFrame::MyFrame(bool interactiveMode)
                        ? choiceIndexForDefault
                        : 0;
         m_deviceChoice->SetSelection(toSelect);
-        SetOutputDeviceIndex(m_outputDeviceIndices[toSelect]);
+        audioEngine().switchDevice(m_outputDeviceIndices[toSelect]);
     }
 
     if (m_panel)
@@ -149,19 +173,23 @@ MyFrame::MyFrame(bool interactiveMode)
 
 void MyFrame::OnStartAudio(wxCommandEvent &event)
 {
-    std::thread audioThread([]() {
-        int result = start();
-        wxTheApp->CallAfter([result]() {
-            wxFrame* top = dynamic_cast<wxFrame*>(wxTheApp->GetTopWindow());
-            if (top)
-            {
-                top->SetStatusText(result == 0 ? "Audio finished." : "Audio error.");
-            }
-        });
-    });
-    audioThread.detach();
-
-    SetStatusText("Audio running...");
+    // Returns once the stream is playing; pressing it again does nothing
+    if (audioEngine().start())
+        SetStatusText("Audio running...");
+    else
+        SetStatusText("Audio error.");
+}
+
+void MyFrame::OnPauseAudio(wxCommandEvent &event)
+{
+    if (audioEngine().pause())
+        SetStatusText("Audio paused.");
+}
+
+void MyFrame::OnStopAudio(wxCommandEvent &event)
+{
+    audioEngine().stop();
+    SetStatusText("Audio stopped.");
 }
 
 void MyFrame::OnExit(wxCommandEvent &event)
@@ -186,6 +214,15 @@ void MyFrame::OnTimer(wxTimerEvent &event)
     {
         m_panel->Refresh(false);
     }
+
+    // Refresh the callback stats twice a second rather than every repaint
+    if (++m_statsTicks >= 10)
+    {
+        m_statsTicks = 0;
+        CallbackStatsSnapshot stats = getCallbackStats();
+        if (stats.callbacks > 0)
+            SetStatusText(formatCallbackStats(stats), 1);
+    }
 }
 
 void MyFrame::OnDeviceChoice(wxCommandEvent &event)
@@ -194,8 +231,25 @@ void MyFrame::OnDeviceChoice(wxCommandEvent &event)
     if (selection < 0 || selection >= (int)m_outputDeviceIndices.size())
         return;
 
+    // Moves a playing stream across, without reloading anything
     int paDeviceIndex = m_outputDeviceIndices[selection];
-    SetOutputDeviceIndex(paDeviceIndex);
+    if (!audioEngine().switchDevice(paDeviceIndex))
+    {
+        SetStatusText("Could not switch output device.");
+        for (size_t i = 0; i < m_outputDeviceIndices.size(); ++i)
+            if (m_outputDeviceIndices[i] == audioEngine().device())
+                m_deviceChoice->SetSelection((int)i);
+    }
+}
+
+void MyFrame::OnPanningChoice(wxCommandEvent &event)
+{
+    int sel = m_panningChoice->GetSelection();
+    if (sel < 0 || sel >= (int)PanningMode::Count)
+        return;
+
+    // Applies to the running stream straight away
+    SetPanningMode((PanningMode)sel);
 }
 
 void MyFrame::OnModeChoice(wxCommandEvent &event)
@@ -223,6 +277,14 @@ void MyFrame::OnModeChoice(wxCommandEvent &event)
         SetStatusText("Follow stdin: listener locked; speakers still movable. Speakers movable in both modes.");
 }
 
+void MyFrame::OnDumpStats(wxCommandEvent &event)
+{
+    if (dumpCallbackStats(STATS_FILE_PATH))
+        SetStatusText("Audio stats written to " STATS_FILE_PATH ".");
+    else
+        SetStatusText("Could not write audio stats.");
+}
+
 void MyFrame::OnResetPositions(wxCommandEvent &event)
 {
     if (m_panel)
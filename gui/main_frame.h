@@ -3,13 +3,14 @@
 #include <wx/wx.h>
 #include <wx/timer.h>
 #include <vector>
+#include "../render_engine.h"
 
 class SpeakerPanel;
 
 class MyFrame : public wxFrame
 {
 public:
-    MyFrame(bool interactiveMode);
+    MyFrame(bool interactiveMode, PanningMode panningMode);
 
 private:
     enum
@@ -18,13 +19,19 @@ private:
         ID_TimerRefresh,
         ID_DeviceChoice,
         ID_StartAudio,
+        ID_PauseAudio,
+        ID_StopAudio,
         ID_ModeChoice,
-        ID_ResetPositions   // <-- new
+        ID_ResetPositions,  // <-- new
+        ID_DumpStats,
+        ID_PanningChoice
     };
 
     bool m_interactiveMode = true;
 
     void OnStartAudio(wxCommandEvent &event);
+    void OnPauseAudio(wxCommandEvent &event);
+    void OnStopAudio(wxCommandEvent &event);
     void OnExit(wxCommandEvent &event);
     void OnAbout(wxCommandEvent &event);
     void OnHello(wxCommandEvent &event);
@@ -32,13 +39,18 @@ private:
     void OnDeviceChoice(wxCommandEvent &event);
     void OnModeChoice(wxCommandEvent &event);
     void OnResetPositions(wxCommandEvent &event);   // <-- new
+    void OnDumpStats(wxCommandEvent &event);
+    void OnPanningChoice(wxCommandEvent &event);
 
     wxTimer       m_timer;
     wxChoice*     m_deviceChoice = nullptr;
     wxChoice*     m_modeChoice   = nullptr;
+    wxChoice*     m_panningChoice = nullptr;
     SpeakerPanel* m_panel        = nullptr;
 
     std::vector<int> m_outputDeviceIndices;
 
+    int m_statsTicks = 0;   // timer ticks since the callback stats were last shown
+
     wxDECLARE_EVENT_TABLE();
 };
\ No newline at end of file
@@ -57,11 +57,12 @@ SpeakerPanel::SpeakerPanel(wxWindow *parent, paTestData *data, bool interactiveM
     // --- CAPTURE POSITIONS ---
     if (m_data)
     {
-        m_initialListenerPosition = m_data->currentListenerPosition;
-        m_initialListenerYaw = m_data->listenerYaw;
-        for (int i = 0; i < CHANNEL_COUNT; ++i)
+        SpatialState state = m_data->spatial.latest();
+        m_initialListenerPosition = state.currentListenerPosition;
+        m_initialListenerYaw = state.listenerYaw;
+        for (int i = 0; i < m_data->layout->channels; ++i)
         {
-            m_initialSpeakerPositions[i] = m_data->speakerPositions[i];
+            m_initialSpeakerPositions[i] = state.speakerPositions[i];
         }
     }
 }
@@ -81,11 +82,13 @@ void SpeakerPanel::SetInteractive(bool interactive)
 void SpeakerPanel::ResetPositions()
 {
     if (!m_data) return;
-    m_data->currentListenerPosition = m_initialListenerPosition;
-    m_data->listenerYaw = m_initialListenerYaw;
+    updateSpatialState(m_data, [this](SpatialState& state) {
+        state.currentListenerPosition = m_initialListenerPosition;
+        state.listenerYaw = m_initialListenerYaw;
 
-    for (int i = 0; i < CHANNEL_COUNT; ++i)
-        m_data->speakerPositions[i] = m_initialSpeakerPositions[i];
+        for (int i = 0; i < m_data->layout->channels; ++i)
+            state.speakerPositions[i] = m_initialSpeakerPositions[i];
+    });
 
     m_mouseDown = false;
     m_draggingListener = false;
@@ -150,6 +153,7 @@ void SpeakerPanel::OnPaint(wxPaintEvent &event)
     // -------------------------------------------------------------
 
     if (!m_data) return;
+    SpatialState state = m_data->spatial.latest();
 
     int w, h;
     GetClientSize(&w, &h);
@@ -175,10 +179,11 @@ void SpeakerPanel::OnPaint(wxPaintEvent &event)
     smallFont.SetPointSize(std::max(7, mainFont.GetPointSize() - 2));
 
     // 3. Draw Speakers
-    for (int i = 0; i < CHANNEL_COUNT; ++i)
+    const int speakerCount = m_data->layout->channels;
+    for (int i = 0; i < speakerCount; ++i)
     {
         float vol = m_data->channelGains[i];
-        Point sp = m_data->speakerPositions[i];
+        Point sp = state.speakerPositions[i];
         wxPoint p = worldToScreen(sp.x, sp.y, w, h, scale);
 
         int centerX = p.x;
@@ -246,10 +251,10 @@ void SpeakerPanel::OnPaint(wxPaintEvent &event)
     gdc.SetFont(mainFont);
 
     // 4. Draw Listener & FOV Cone
-    Point L = m_data->currentListenerPosition;
+    Point L = state.currentListenerPosition;
     wxPoint lp = worldToScreen(L.x, L.y, w, h, scale);
 
-    float yawRad = -m_data->listenerYaw * 2.0f * M_PI;
+    float yawRad = -state.listenerYaw * 2.0f * M_PI;
     const float dirLen = 0.5f;     
     const float coneAngle = 20.0f * (M_PI / 180.0f); 
 
@@ -282,21 +287,21 @@ void SpeakerPanel::OnPaint(wxPaintEvent &event)
     // 5. Draw Distance Lines
     if (m_mouseDown && m_selectedSpeaker >= 0)
     {
-        wxPoint pSel = worldToScreen(m_data->speakerPositions[m_selectedSpeaker].x, 
-                                     m_data->speakerPositions[m_selectedSpeaker].y, w, h, scale);
+        wxPoint pSel = worldToScreen(state.speakerPositions[m_selectedSpeaker].x, 
+                                     state.speakerPositions[m_selectedSpeaker].y, w, h, scale);
         
         gdc.SetPen(wxPen(wxColour(200, 200, 200), 1, wxPENSTYLE_DOT));
         
-        for(int i=0; i<CHANNEL_COUNT; ++i) {
+        for(int i=0; i<speakerCount; ++i) {
             if(i == m_selectedSpeaker) continue;
             
-            wxPoint pTarget = worldToScreen(m_data->speakerPositions[i].x, 
-                                            m_data->speakerPositions[i].y, w, h, scale);
+            wxPoint pTarget = worldToScreen(state.speakerPositions[i].x, 
+                                            state.speakerPositions[i].y, w, h, scale);
             
             gdc.DrawLine(pSel, pTarget);
             
-            float dist = std::hypot(m_data->speakerPositions[i].x - m_data->speakerPositions[m_selectedSpeaker].x,
-                                    m_data->speakerPositions[i].y - m_data->speakerPositions[m_selectedSpeaker].y);
+            float dist = std::hypot(state.speakerPositions[i].x - state.speakerPositions[m_selectedSpeaker].x,
+                                    state.speakerPositions[i].y - state.speakerPositions[m_selectedSpeaker].y);
             
             wxPoint mid = (pSel + pTarget) / 2;
             wxString distStr = wxString::Format("%.2fm", dist);
@@ -317,6 +322,7 @@ void SpeakerPanel::OnPaint(wxPaintEvent &event)
 void SpeakerPanel::OnLeftDown(wxMouseEvent &evt)
 {
     if (!m_data) return;
+    SpatialState state = m_data->spatial.latest();
     int w, h; GetClientSize(&w, &h);
     float minX, minY, maxX, maxY;
     float scale = computeScaleForCurrentBounds(w, h, minX, minY, maxX, maxY);
@@ -326,8 +332,8 @@ void SpeakerPanel::OnLeftDown(wxMouseEvent &evt)
     if (m_allowListenerDrag)
     {
         const float dirLength = 0.5f;
-        Point L = m_data->currentListenerPosition;
-        float yawRadians = -m_data->listenerYaw * 2.0f * float(M_PI);
+        Point L = state.currentListenerPosition;
+        float yawRadians = -state.listenerYaw * 2.0f * float(M_PI);
         float endX = L.x + dirLength * std::sin(yawRadians);
         float endY = L.y + dirLength * std::cos(yawRadians);
         wxPoint endPoint = worldToScreen(endX, endY, w, h, scale);
@@ -345,7 +351,7 @@ void SpeakerPanel::OnLeftDown(wxMouseEvent &evt)
     // Listener Body
     if (m_allowListenerDrag)
     {
-        Point L = m_data->currentListenerPosition;
+        Point L = state.currentListenerPosition;
         wxPoint lp = worldToScreen(L.x, L.y, w, h, scale);
         int dx = mousePos.x - lp.x;
         int dy = mousePos.y - lp.y;
@@ -359,9 +365,9 @@ void SpeakerPanel::OnLeftDown(wxMouseEvent &evt)
 
     // Speakers
     const int speakerBoxSize = 36;
-    for (int i = 0; i < CHANNEL_COUNT; ++i)
+    for (int i = 0; i < m_data->layout->channels; ++i)
     {
-        Point sp = m_data->speakerPositions[i];
+        Point sp = state.speakerPositions[i];
         wxPoint p = worldToScreen(sp.x, sp.y, w, h, scale);
         wxRect rect(p.x - speakerBoxSize/2, p.y - speakerBoxSize/2, speakerBoxSize, speakerBoxSize);
 
@@ -377,6 +383,7 @@ void SpeakerPanel::OnLeftDown(wxMouseEvent &evt)
 void SpeakerPanel::OnMouseMove(wxMouseEvent &evt)
 {
     if (!m_data) return;
+    SpatialState state = m_data->spatial.latest();
     int w, h; GetClientSize(&w, &h);
     float minX, minY, maxX, maxY;
     float scale = computeScaleForCurrentBounds(w, h, minX, minY, maxX, maxY);
@@ -386,8 +393,8 @@ void SpeakerPanel::OnMouseMove(wxMouseEvent &evt)
 
     if (!m_mouseDown && m_allowListenerDrag)
     {
-        Point L = m_data->currentListenerPosition;
-        float yawRadians = -m_data->listenerYaw * 2.0f * float(M_PI);
+        Point L = state.currentListenerPosition;
+        float yawRadians = -state.listenerYaw * 2.0f * float(M_PI);
         wxPoint endPoint = worldToScreen(L.x + 0.5f * std::sin(yawRadians), 
                                          L.y + 0.5f * std::cos(yawRadians), w, h, scale);
         int dx = mousePos.x - endPoint.x;
@@ -405,7 +412,7 @@ void SpeakerPanel::OnMouseMove(wxMouseEvent &evt)
 
     if (m_draggingYaw && m_allowListenerDrag)
     {
-        Point L = m_data->currentListenerPosition;
+        Point L = state.currentListenerPosition;
         float vx = world.x - L.x;
         float vy = world.y - L.y;
         if (vx*vx + vy*vy > 1e-6f)
@@ -414,17 +421,20 @@ void SpeakerPanel::OnMouseMove(wxMouseEvent &evt)
             float yaw = -phi / (2.0f * float(M_PI)); 
             if (yaw < 0.0f) yaw += 1.0f;
             if (yaw >= 1.0f) yaw -= 1.0f;
-            m_data->listenerYaw = yaw;
+            updateSpatialState(m_data, [yaw](SpatialState& s) { s.listenerYaw = yaw; });
         }
         Refresh(); return;
     }
     if (m_draggingListener && m_allowListenerDrag)
     {
-        m_data->currentListenerPosition = world; Refresh(); return;
+        updateSpatialState(m_data, [world](SpatialState& s) { s.currentListenerPosition = world; });
+        Refresh(); return;
     }
-    if (m_dragSpeakerIndex >= 0 && m_dragSpeakerIndex < CHANNEL_COUNT)
+    if (m_dragSpeakerIndex >= 0 && m_dragSpeakerIndex < m_data->layout->channels)
     {
-        m_data->speakerPositions[m_dragSpeakerIndex] = world; Refresh(); return;
+        int index = m_dragSpeakerIndex;
+        updateSpatialState(m_data, [index, world](SpatialState& s) { s.speakerPositions[index] = world; });
+        Refresh(); return;
     }
 }
 
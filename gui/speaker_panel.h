@@ -3,7 +3,7 @@
 
 #include <wx/wx.h>
 #include <wx/bitmap.h> // Explicitly include bitmap header
-#include "../portaudio_listener.h"  // paTestData, CHANNEL_COUNT, Point
+#include "../portaudio_listener.h"  // paTestData, MAX_CHANNELS, Point
 
 class SpeakerPanel : public wxPanel
 {
@@ -40,12 +40,12 @@ private:
     // Initial positions captured at construction (for Reset button)
     Point m_initialListenerPosition{};
     float m_initialListenerYaw = 0.0f;
-    Point m_initialSpeakerPositions[CHANNEL_COUNT]{};
+    Point m_initialSpeakerPositions[MAX_CHANNELS]{};
 
     // Screen positions captured at start of a box-resize drag,
     // so we can keep everything visually fixed while bounds change.
     wxPoint m_listenerScreenAtResize;
-    wxPoint m_speakerScreenAtResize[CHANNEL_COUNT];
+    wxPoint m_speakerScreenAtResize[MAX_CHANNELS];
 
     float computeScaleForCurrentBounds(int w, int h,
                                        float& minX, float& minY,
@@ -0,0 +1,184 @@
+#include "hrtf.h"
+#include "utils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sndfile.h>
+#include <string>
+
+#ifndef M_PI
+#define M_PI (3.14159265)
+#endif
+
+static float wrapAngle(float a)
+{
+    while (a >  M_PI) a -= 2 * M_PI;
+    while (a < -M_PI) a += 2 * M_PI;
+    return a;
+}
+
+static bool readStereoWav(const std::string& path, std::vector<float>& left, std::vector<float>& right)
+{
+    SF_INFO info = {};
+    SNDFILE* file = sf_open(path.c_str(), SFM_READ, &info);
+    if (!file) {
+        std::fprintf(stderr, "Could not open %s: %s\n", path.c_str(), sf_strerror(nullptr));
+        return false;
+    }
+    if (info.channels != 2 || info.samplerate != SAMPLE_RATE) {
+        std::fprintf(stderr, "%s: expected a stereo %d Hz response, got %d channels at %d Hz\n",
+                     path.c_str(), SAMPLE_RATE, info.channels, info.samplerate);
+        sf_close(file);
+        return false;
+    }
+
+    std::vector<float> frames((size_t)info.frames * 2);
+    sf_count_t read = sf_readf_float(file, frames.data(), info.frames);
+    sf_close(file);
+
+    left.resize(read);
+    right.resize(read);
+    for (sf_count_t i = 0; i < read; ++i) {
+        left[i] = frames[2 * i];
+        right[i] = frames[2 * i + 1];
+    }
+    return true;
+}
+
+bool HrirSet::load(const char* listPath)
+{
+    FILE* list = std::fopen(listPath, "r");
+    if (!list) {
+        std::fprintf(stderr, "Could not open HRIR list %s\n", listPath);
+        return false;
+    }
+
+    std::string dir(listPath);
+    size_t slash = dir.find_last_of('/');
+    dir = slash == std::string::npos ? std::string() : dir.substr(0, slash + 1);
+
+    std::vector<float> azimuths;
+    std::vector<std::vector<float>> lefts, rights;
+    size_t taps = 0;
+
+    char line[512];
+    int lineNumber = 0;
+    bool ok = true;
+    while (ok && std::fgets(line, sizeof(line), list)) {
+        ++lineNumber;
+        if (char* comment = std::strchr(line, '#'))
+            *comment = '\0';
+
+        float degrees;
+        char file[400];
+        int fields = std::sscanf(line, " %f %399s", &degrees, file);
+        if (fields <= 0)
+            continue;
+        if (fields != 2) {
+            std::fprintf(stderr, "%s:%d: expected <azimuth> <file.wav>\n", listPath, lineNumber);
+            ok = false;
+            break;
+        }
+
+        std::vector<float> l, r;
+        std::string path = file[0] == '/' ? std::string(file) : dir + file;
+        ok = readStereoWav(path, l, r);
+        if (ok) {
+            azimuths.push_back(wrapAngle(degrees * (float)M_PI / 180.0f));
+            taps = std::max(taps, l.size());
+            lefts.push_back(std::move(l));
+            rights.push_back(std::move(r));
+        }
+    }
+    std::fclose(list);
+
+    if (ok && azimuths.empty()) {
+        std::fprintf(stderr, "%s: no responses\n", listPath);
+        ok = false;
+    }
+    if (!ok)
+        return false;
+
+    m_taps = (int)taps;
+    m_azimuths = azimuths;
+    m_data.assign(azimuths.size() * 2 * taps, 0.0f);
+    for (size_t d = 0; d < azimuths.size(); ++d) {
+        std::copy(lefts[d].begin(), lefts[d].end(), m_data.begin() + d * 2 * taps);
+        std::copy(rights[d].begin(), rights[d].end(), m_data.begin() + d * 2 * taps + taps);
+    }
+    return true;
+}
+
+// Impulse response of a spherical head for a source at angle `incidence`
+// from the ear's axis, into `out`.
+static void sphericalHeadResponse(float incidence, float* out, int taps)
+{
+    const float headRadius = 0.0875f;     // metres
+    const float speedOfSound = 343.0f;    // m/s
+    const float w0 = speedOfSound / headRadius;
+
+    // Woodworth: straight path to the near side, round the sphere to the far
+    // side; offset so the earliest arrival lands a few taps in.
+    float beta = std::fabs(incidence);
+    float pathDelay = beta < M_PI / 2 ? -std::cos(beta) : beta - (float)M_PI / 2;
+    float delay = 16.0f + (1.0f + pathDelay) * headRadius / speedOfSound * SAMPLE_RATE;
+
+    // Windowed-sinc fractional delay
+    for (int i = 0; i < taps; ++i) {
+        float x = i - delay;
+        float window = std::fabs(x) < 16 ? 0.5f + 0.5f * std::cos((float)M_PI * x / 16) : 0.0f;
+        float sinc = std::fabs(x) < 1e-6f ? 1.0f : std::sin((float)M_PI * x) / ((float)M_PI * x);
+        out[i] = window * sinc;
+    }
+
+    // Brown-Duda head shadow, (1 + alpha s / 2w0) / (1 + s / 2w0), by the
+    // bilinear transform
+    const float alphaMin = 0.1f;
+    const float thetaMin = 150.0f * (float)M_PI / 180.0f;
+    float alpha = (1 + alphaMin / 2) + (1 - alphaMin / 2) * std::cos(beta / thetaMin * (float)M_PI);
+    float k = (float)SAMPLE_RATE / w0;
+    float b0 = (1 + alpha * k) / (1 + k);
+    float b1 = (1 - alpha * k) / (1 + k);
+    float a1 = (1 - k) / (1 + k);
+
+    float x1 = 0.0f, y1 = 0.0f;
+    for (int i = 0; i < taps; ++i) {
+        float x = out[i];
+        float y = b0 * x + b1 * x1 - a1 * y1;
+        x1 = x;
+        y1 = y;
+        out[i] = y;
+    }
+}
+
+void HrirSet::synthesize(int taps, float stepDegrees)
+{
+    int count = (int)(360.0f / stepDegrees + 0.5f);
+
+    m_taps = taps;
+    m_azimuths.resize(count);
+    m_data.assign((size_t)count * 2 * taps, 0.0f);
+
+    for (int d = 0; d < count; ++d) {
+        float azimuth = wrapAngle(d * stepDegrees * (float)M_PI / 180.0f);
+        m_azimuths[d] = azimuth;
+        // The ears point straight left and right
+        sphericalHeadResponse(wrapAngle(azimuth + (float)M_PI / 2), &m_data[(size_t)d * 2 * taps], taps);
+        sphericalHeadResponse(wrapAngle(azimuth - (float)M_PI / 2), &m_data[(size_t)d * 2 * taps + taps], taps);
+    }
+}
+
+int HrirSet::nearest(float angle) const
+{
+    int best = 0;
+    float bestDistance = 1e9f;
+    for (int d = 0; d < (int)m_azimuths.size(); ++d) {
+        float distance = std::fabs(wrapAngle(angle - m_azimuths[d]));
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best = d;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// A set of head-related impulse responses on the horizontal plane, one
+// left/right pair per measured azimuth, at SAMPLE_RATE.
+//
+// Azimuths are in radians in the same convention as the panning in
+// render_engine.cpp: 0 straight ahead, positive to the right.
+class HrirSet
+{
+public:
+    // Load from a list file with one "<azimuth degrees> <stereo wav>" line
+    // per direction ('#' starts a comment); paths are relative to the list.
+    // Responses shorter than the longest are zero-padded.
+    bool load(const char* listPath);
+
+    // Fill with a spherical-head model (Woodworth delay plus the Brown-Duda
+    // head-shadow filter) every `stepDegrees`, `taps` long. Good enough to
+    // test the binaural path without measured data.
+    void synthesize(int taps = 256, float stepDegrees = 5.0f);
+
+    int directions() const { return (int)m_azimuths.size(); }
+    int taps() const { return m_taps; }
+    float azimuth(int direction) const { return m_azimuths[direction]; }
+    const float* left(int direction) const { return &m_data[(size_t)direction * 2 * m_taps]; }
+    const float* right(int direction) const { return left(direction) + m_taps; }
+
+    // Direction closest to `angle`.
+    int nearest(float angle) const;
+
+private:
+    std::vector<float> m_azimuths;
+    std::vector<float> m_data;   // per direction: left taps, then right taps
+    int m_taps = 0;
+};
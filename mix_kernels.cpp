@@ -0,0 +1,344 @@
+#include "mix_kernels.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MIX_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+// Scalar mix of frames [begin, end); also used for the tails of SIMD kernels.
+static void mixScalarRange(const MixParams& p, unsigned long begin, unsigned long end)
+{
+    const float invFrames = 1.0f / p.frames;
+
+    for (int r = 0; r < p.outputs; ++r) {
+        if (r == p.lfeOut)
+            continue;
+
+        const float* g = p.gains + r * p.inputs;
+        const float* g0 = p.prevGains ? p.prevGains + r * p.inputs : g;
+        float* out = p.out[r];
+        for (unsigned long i = begin; i < end; ++i) {
+            const float t = (float)(i + 1) * invFrames;
+            float acc = 0.0f;
+            for (int v = 0; v < p.inputs; ++v) {
+                if (v == p.lfeIn)
+                    continue;
+                acc += (g0[v] + (g[v] - g0[v]) * t) * p.in[v][i];
+            }
+            out[i] = acc;
+        }
+    }
+
+    if (p.lfeOut >= 0) {
+        const float* lfe = p.in[p.lfeIn];
+        float* out = p.out[p.lfeOut];
+        for (unsigned long i = begin; i < end; ++i)
+            out[i] = lfe[i];
+    }
+}
+
+static void mixScalar(const MixParams& p)
+{
+    mixScalarRange(p, 0, p.frames);
+}
+
+#ifdef MIX_KERNELS_X86
+
+// When ramping, each gain is interpolated by the position t of the frame
+// within the block; t is computed once per vector and shared by all rows.
+
+__attribute__((target("sse2")))
+static void mixSse2(const MixParams& p)
+{
+    const unsigned long vecFrames = p.frames & ~3ul;
+    const __m128 invFrames = _mm_set1_ps(1.0f / p.frames);
+    const __m128 laneOffsets = _mm_setr_ps(1, 2, 3, 4);
+
+    for (unsigned long i = 0; i < vecFrames; i += 4) {
+        const __m128 t = _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)i), laneOffsets), invFrames);
+
+        for (int r = 0; r < p.outputs; ++r) {
+            if (r == p.lfeOut)
+                continue;
+
+            const float* g = p.gains + r * p.inputs;
+            __m128 acc = _mm_setzero_ps();
+            if (p.prevGains) {
+                const float* g0 = p.prevGains + r * p.inputs;
+                for (int v = 0; v < p.inputs; ++v) {
+                    if (v == p.lfeIn)
+                        continue;
+                    __m128 gain = _mm_add_ps(_mm_set1_ps(g0[v]),
+                                             _mm_mul_ps(_mm_set1_ps(g[v] - g0[v]), t));
+                    acc = _mm_add_ps(acc, _mm_mul_ps(gain, _mm_load_ps(p.in[v] + i)));
+                }
+            } else {
+                for (int v = 0; v < p.inputs; ++v) {
+                    if (v == p.lfeIn)
+                        continue;
+                    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(g[v]), _mm_load_ps(p.in[v] + i)));
+                }
+            }
+            _mm_store_ps(p.out[r] + i, acc);
+        }
+
+        if (p.lfeOut >= 0)
+            _mm_store_ps(p.out[p.lfeOut] + i, _mm_load_ps(p.in[p.lfeIn] + i));
+    }
+
+    mixScalarRange(p, vecFrames, p.frames);
+}
+
+__attribute__((target("avx2,fma")))
+static void mixAvx2(const MixParams& p)
+{
+    const unsigned long vecFrames = p.frames & ~7ul;
+    const __m256 invFrames = _mm256_set1_ps(1.0f / p.frames);
+    const __m256 laneOffsets = _mm256_setr_ps(1, 2, 3, 4, 5, 6, 7, 8);
+
+    for (unsigned long i = 0; i < vecFrames; i += 8) {
+        const __m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps((float)i), laneOffsets), invFrames);
+
+        for (int r = 0; r < p.outputs; ++r) {
+            if (r == p.lfeOut)
+                continue;
+
+            const float* g = p.gains + r * p.inputs;
+            __m256 acc = _mm256_setzero_ps();
+            if (p.prevGains) {
+                const float* g0 = p.prevGains + r * p.inputs;
+                for (int v = 0; v < p.inputs; ++v) {
+                    if (v == p.lfeIn)
+                        continue;
+                    __m256 gain = _mm256_fmadd_ps(_mm256_set1_ps(g[v] - g0[v]), t,
+                                                  _mm256_set1_ps(g0[v]));
+                    acc = _mm256_fmadd_ps(gain, _mm256_load_ps(p.in[v] + i), acc);
+                }
+            } else {
+                for (int v = 0; v < p.inputs; ++v) {
+                    if (v == p.lfeIn)
+                        continue;
+                    acc = _mm256_fmadd_ps(_mm256_set1_ps(g[v]), _mm256_load_ps(p.in[v] + i), acc);
+                }
+            }
+            _mm256_store_ps(p.out[r] + i, acc);
+        }
+
+        if (p.lfeOut >= 0)
+            _mm256_store_ps(p.out[p.lfeOut] + i, _mm256_load_ps(p.in[p.lfeIn] + i));
+    }
+
+    // The tail call below gets no automatic vzeroupper, and legacy SSE code
+    // run with the upper halves dirty (the tail, then libm and every SSE2
+    // stage after the mix) pays a transition penalty on each instruction.
+    _mm256_zeroupper();
+    mixScalarRange(p, vecFrames, p.frames);
+}
+
+__attribute__((target("avx512f")))
+static void mixAvx512(const MixParams& p)
+{
+    const unsigned long vecFrames = p.frames & ~15ul;
+    const __m512 invFrames = _mm512_set1_ps(1.0f / p.frames);
+    const __m512 laneOffsets = _mm512_setr_ps(1, 2, 3, 4, 5, 6, 7, 8,
+                                              9, 10, 11, 12, 13, 14, 15, 16);
+
+    for (unsigned long i = 0; i < vecFrames; i += 16) {
+        const __m512 t = _mm512_mul_ps(_mm512_add_ps(_mm512_set1_ps((float)i), laneOffsets), invFrames);
+
+        for (int r = 0; r < p.outputs; ++r) {
+            if (r == p.lfeOut)
+                continue;
+
+            const float* g = p.gains + r * p.inputs;
+            __m512 acc = _mm512_setzero_ps();
+            if (p.prevGains) {
+                const float* g0 = p.prevGains + r * p.inputs;
+                for (int v = 0; v < p.inputs; ++v) {
+                    if (v == p.lfeIn)
+                        continue;
+                    __m512 gain = _mm512_fmadd_ps(_mm512_set1_ps(g[v] - g0[v]), t,
+                                                  _mm512_set1_ps(g0[v]));
+                    acc = _mm512_fmadd_ps(gain, _mm512_load_ps(p.in[v] + i), acc);
+                }
+            } else {
+                for (int v = 0; v < p.inputs; ++v) {
+                    if (v == p.lfeIn)
+                        continue;
+                    acc = _mm512_fmadd_ps(_mm512_set1_ps(g[v]), _mm512_load_ps(p.in[v] + i), acc);
+                }
+            }
+            _mm512_store_ps(p.out[r] + i, acc);
+        }
+
+        if (p.lfeOut >= 0)
+            _mm512_store_ps(p.out[p.lfeOut] + i, _mm512_load_ps(p.in[p.lfeIn] + i));
+    }
+
+    // See mixAvx2
+    _mm256_zeroupper();
+    mixScalarRange(p, vecFrames, p.frames);
+}
+
+#endif // MIX_KERNELS_X86
+
+static bool cpuSupports(MixKernelType type)
+{
+    switch (type) {
+        case MixKernelType::Scalar: return true;
+#ifdef MIX_KERNELS_X86
+        case MixKernelType::SSE2:   return __builtin_cpu_supports("sse2");
+        case MixKernelType::AVX2:   return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case MixKernelType::AVX512: return __builtin_cpu_supports("avx512f");
+#endif
+        default: return false;
+    }
+}
+
+MixKernel getMixKernel(MixKernelType type)
+{
+    if (!cpuSupports(type))
+        return nullptr;
+
+    switch (type) {
+        case MixKernelType::Scalar: return mixScalar;
+#ifdef MIX_KERNELS_X86
+        case MixKernelType::SSE2:   return mixSse2;
+        case MixKernelType::AVX2:   return mixAvx2;
+        case MixKernelType::AVX512: return mixAvx512;
+#endif
+        default: return nullptr;
+    }
+}
+
+MixKernelType bestMixKernelType()
+{
+    static const MixKernelType best = []() {
+        for (int t = (int)MixKernelType::Count - 1; t > 0; --t) {
+            if (cpuSupports((MixKernelType)t))
+                return (MixKernelType)t;
+        }
+        return MixKernelType::Scalar;
+    }();
+    return best;
+}
+
+const char* mixKernelName(MixKernelType type)
+{
+    switch (type) {
+        case MixKernelType::Scalar: return "scalar";
+        case MixKernelType::SSE2:   return "sse2";
+        case MixKernelType::AVX2:   return "avx2";
+        case MixKernelType::AVX512: return "avx512";
+        default: return "unknown";
+    }
+}
+
+// A route kernel's loop over frames [begin, end); also the SIMD tails.
+static void routeScalarRange(const float* in, float* out, float g0, float dg, unsigned long frames,
+                             unsigned long begin, unsigned long end)
+{
+    const float invFrames = 1.0f / frames;
+    if (dg != 0.0f) {
+        for (unsigned long i = begin; i < end; ++i)
+            out[i] += (g0 + dg * ((float)(i + 1) * invFrames)) * in[i];
+    } else {
+        for (unsigned long i = begin; i < end; ++i)
+            out[i] += g0 * in[i];
+    }
+}
+
+static void routeScalar(const float* in, float* out, float g0, float dg, unsigned long frames)
+{
+    routeScalarRange(in, out, g0, dg, frames, 0, frames);
+}
+
+#ifdef MIX_KERNELS_X86
+
+// The compiler leaves the scalar loops alone, as in and out might overlap.
+// Unaligned loads and stores, since callers may route any buffer.
+
+__attribute__((target("sse2")))
+static void routeSse2(const float* in, float* out, float g0, float dg, unsigned long frames)
+{
+    const unsigned long vecFrames = frames & ~3ul;
+    if (dg != 0.0f) {
+        const __m128 invFrames = _mm_set1_ps(1.0f / frames);
+        const __m128 laneOffsets = _mm_setr_ps(1, 2, 3, 4);
+        const __m128 gain0 = _mm_set1_ps(g0);
+        const __m128 gainStep = _mm_set1_ps(dg);
+        for (unsigned long i = 0; i < vecFrames; i += 4) {
+            const __m128 t = _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)i), laneOffsets), invFrames);
+            __m128 gain = _mm_add_ps(gain0, _mm_mul_ps(gainStep, t));
+            _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(gain, _mm_loadu_ps(in + i))));
+        }
+    } else {
+        const __m128 gain = _mm_set1_ps(g0);
+        for (unsigned long i = 0; i < vecFrames; i += 4)
+            _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(gain, _mm_loadu_ps(in + i))));
+    }
+    routeScalarRange(in, out, g0, dg, frames, vecFrames, frames);
+}
+
+__attribute__((target("avx2,fma")))
+static void routeAvx2(const float* in, float* out, float g0, float dg, unsigned long frames)
+{
+    const unsigned long vecFrames = frames & ~7ul;
+    if (dg != 0.0f) {
+        const __m256 invFrames = _mm256_set1_ps(1.0f / frames);
+        const __m256 laneOffsets = _mm256_setr_ps(1, 2, 3, 4, 5, 6, 7, 8);
+        const __m256 gain0 = _mm256_set1_ps(g0);
+        const __m256 gainStep = _mm256_set1_ps(dg);
+        for (unsigned long i = 0; i < vecFrames; i += 8) {
+            const __m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps((float)i), laneOffsets), invFrames);
+            __m256 gain = _mm256_fmadd_ps(gainStep, t, gain0);
+            _mm256_storeu_ps(out + i, _mm256_fmadd_ps(gain, _mm256_loadu_ps(in + i), _mm256_loadu_ps(out + i)));
+        }
+    } else {
+        const __m256 gain = _mm256_set1_ps(g0);
+        for (unsigned long i = 0; i < vecFrames; i += 8)
+            _mm256_storeu_ps(out + i, _mm256_fmadd_ps(gain, _mm256_loadu_ps(in + i), _mm256_loadu_ps(out + i)));
+    }
+
+    // See mixAvx2
+    _mm256_zeroupper();
+    routeScalarRange(in, out, g0, dg, frames, vecFrames, frames);
+}
+
+#endif // MIX_KERNELS_X86
+
+RouteKernel getRouteKernel(MixKernelType type)
+{
+    if (!cpuSupports(type))
+        return nullptr;
+
+    switch (type) {
+        case MixKernelType::Scalar: return routeScalar;
+#ifdef MIX_KERNELS_X86
+        case MixKernelType::SSE2:   return routeSse2;
+        case MixKernelType::AVX2:
+        case MixKernelType::AVX512: return routeAvx2;
+#endif
+        default: return nullptr;
+    }
+}
+
+void mixSparse(const SparseMixParams& p)
+{
+    for (int r = p.outBegin; r < p.outEnd; ++r)
+        std::memset(p.out[r], 0, p.frames * sizeof(float));
+
+    for (int k = 0; k < p.count; ++k) {
+        const SparseGain& route = p.gains[k];
+        if (route.out < p.outBegin || route.out >= p.outEnd)
+            continue;
+
+        const float* in = p.in[route.in];
+        float* out = p.out[route.out];
+        if (p.ramp && route.prevGain != route.gain)
+            p.addRoute(in, out, route.prevGain, route.gain - route.prevGain, p.frames);
+        else if (route.gain != 0.0f)
+            p.addRoute(in, out, route.gain, 0.0f, p.frames);
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+// Vectorised kernels for the planar gain-matrix mix in RenderEngine.
+//
+// Every kernel computes, for each output r other than lfeOut,
+//     out[r][i] = sum over v != lfeIn of gains[r * inputs + v] * in[v][i]
+// and copies in[lfeIn] straight to out[lfeOut] in the same pass.
+//
+// When prevGains is set the matrix is instead ramped linearly per sample,
+// from prevGains at the start of the block to gains on its last frame, so a
+// pose change never produces a gain step at the block boundary.
+//
+// Channel pointers must be RENDER_ALIGNMENT-aligned (the SIMD variants use
+// aligned loads); any frame count is accepted, tails are mixed in scalar code.
+
+enum class MixKernelType
+{
+    Scalar = 0,
+    SSE2,
+    AVX2,
+    AVX512,
+    Count
+};
+
+typedef struct
+{
+    const float* const* in;  // planar input channels
+    float* const* out;       // planar output channels
+    const float* gains;      // [outputs][inputs] gain matrix, row-major
+    const float* prevGains;  // matrix to ramp from, same layout, or nullptr
+    int inputs;
+    int outputs;
+    int lfeIn;               // input copied through unpanned, or -1
+    int lfeOut;              // output receiving lfeIn, or -1
+    unsigned long frames;
+} MixParams;
+
+typedef void (*MixKernel)(const MixParams& params);
+
+// The kernel for `type`, or nullptr if it was not compiled in or the running
+// CPU does not support it.
+MixKernel getMixKernel(MixKernelType type);
+
+// The widest kernel the running CPU supports (checked once via CPUID).
+MixKernelType bestMixKernelType();
+
+const char* mixKernelName(MixKernelType type);
+
+// Sparse mix for panners that feed each input to only a few outputs (VBAP):
+// a list of (input, output, gain) routes instead of a full matrix, so the
+// cost grows with the number of routes rather than inputs x outputs.
+typedef struct
+{
+    int in;
+    int out;
+    float gain;
+    float prevGain;          // gain to ramp from when SparseMixParams::ramp is set
+} SparseGain;
+
+// Adds in[i], scaled by a gain ramping from g0 by dg over the block of
+// `frames` frames, to out[i]: one route of a sparse mix.
+typedef void (*RouteKernel)(const float* in, float* out, float g0, float dg, unsigned long frames);
+
+// The route kernel for `type` (AVX2 serves AVX512 too), or nullptr under the
+// same conditions as getMixKernel(). Pick it once, off the audio thread.
+RouteKernel getRouteKernel(MixKernelType type);
+
+typedef struct
+{
+    RouteKernel addRoute;    // from getRouteKernel()
+    const float* const* in;
+    float* const* out;
+    const SparseGain* gains;
+    int count;
+    int outBegin;            // outputs [outBegin, outEnd) are cleared and mixed;
+    int outEnd;              // routes to other outputs are skipped
+    bool ramp;
+    unsigned long frames;
+} SparseMixParams;
+
+void mixSparse(const SparseMixParams& params);
@@ -0,0 +1,110 @@
+#include "mix_worker_pool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPU_RELAX() _mm_pause()
+#else
+#define CPU_RELAX() std::this_thread::yield()
+#endif
+
+// Pauses the caller spins for a slice in progress before yielding its core.
+static const int kSpinsBeforeYield = 2000;
+
+MixWorkerPool::~MixWorkerPool()
+{
+    stop();
+}
+
+bool MixWorkerPool::start(int workers)
+{
+    stop();
+
+    m_running.store(true);
+    m_callerKnown = false;
+    for (int i = 0; i < workers; ++i)
+        m_workers.push_back(new Worker);
+    for (int i = 0; i < workers; ++i)
+        m_workers[i]->thread = std::thread(&MixWorkerPool::workerLoop, this, i);
+    return true;
+}
+
+void MixWorkerPool::stop()
+{
+    if (m_workers.empty())
+        return;
+
+    m_running.store(false);
+    for (Worker* worker : m_workers)
+        worker->wake.post();
+    for (Worker* worker : m_workers) {
+        worker->thread.join();
+        delete worker;
+    }
+    m_workers.clear();
+}
+
+void MixWorkerPool::run(Job job, void* context)
+{
+    const int slices = (int)m_workers.size() + 1;
+
+    // A system call, but only when the audio thread changes
+    if (slices > 1 && (!m_callerKnown || !pthread_equal(m_caller, pthread_self())))
+        followCallerScheduling();
+
+    m_job = job;
+    m_context = context;
+    m_remaining.store(slices - 1, std::memory_order_relaxed);
+    m_next.store(1, std::memory_order_release);
+
+    // Posting a semaphore orders the writes above before the worker wakes.
+    for (Worker* worker : m_workers)
+        worker->wake.post();
+
+    job(context, 0, slices);
+    runSlices(slices);
+
+    for (int spins = 0; m_remaining.load(std::memory_order_acquire) != 0; ++spins) {
+        if (spins < kSpinsBeforeYield)
+            CPU_RELAX();
+        else
+            std::this_thread::yield();
+    }
+}
+
+void MixWorkerPool::runSlices(int slices)
+{
+    for (;;) {
+        int slice = m_next.fetch_add(1, std::memory_order_acq_rel);
+        if (slice >= slices)
+            return;
+        m_job(m_context, slice, slices);
+        m_remaining.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void MixWorkerPool::followCallerScheduling()
+{
+    m_caller = pthread_self();
+    m_callerKnown = true;
+
+    int policy;
+    sched_param param;
+    if (pthread_getschedparam(m_caller, &policy, &param) != 0)
+        return;
+    // EPERM without real-time privileges: the workers stay as they are
+    for (Worker* worker : m_workers)
+        pthread_setschedparam(worker->thread.native_handle(), policy, &param);
+}
+
+void MixWorkerPool::workerLoop(int index)
+{
+    Worker& worker = *m_workers[index];
+    for (;;) {
+        worker.wake.wait();
+        if (!m_running.load())
+            return;
+
+        // Possibly none left, if the caller got there first
+        runSlices((int)m_workers.size() + 1);
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <pthread.h>
+#include <thread>
+#include <vector>
+#include "rt_semaphore.h"
+
+// A small pool of threads that split one job per block with the calling
+// (audio) thread: run() wakes every worker, runs slice 0 itself, then takes
+// any slice no worker has started yet, and spins until the ones in progress
+// are finished before returning.
+//
+// Waking posts a semaphore per worker, which never blocks the poster, and the
+// join is a spin on an atomic counter, so run() takes no locks and does not
+// allocate. Threads are created by start(), never on the audio thread.
+//
+// The caller only ever waits on a worker that is part way through a slice,
+// so a worker that has not been scheduled yet costs nothing: its slices are
+// done by the caller. A worker preempted mid-slice is still waited for, so
+// they must not be scheduled below the caller. The first time a thread runs
+// a job (and whenever another thread takes over, as when a stream is
+// reopened), run() gives every worker that thread's scheduling policy and
+// priority with pthread_setschedparam. Where that is not allowed (no
+// real-time privileges, or a policy pthreads cannot express, like macOS's
+// time-constraint threads) the workers quietly keep theirs. After a short
+// spin the caller yields, in case the worker it waits for shares its core
+// at the same real-time priority.
+class MixWorkerPool
+{
+public:
+    typedef void (*Job)(void* context, int slice, int slices);
+
+    MixWorkerPool() = default;
+    ~MixWorkerPool();
+
+    MixWorkerPool(const MixWorkerPool&) = delete;
+    MixWorkerPool& operator=(const MixWorkerPool&) = delete;
+
+    // Start `workers` threads. Stops any that were already running.
+    bool start(int workers);
+    void stop();
+
+    // Number of slices a job is split into: the workers plus the caller.
+    int slices() const { return (int)m_workers.size() + 1; }
+
+    // Run job(context, slice, slices()) for every slice and wait for all of them.
+    void run(Job job, void* context);
+
+private:
+    struct Worker
+    {
+        RtSemaphore wake;
+        std::thread thread;
+    };
+
+    void workerLoop(int index);
+    // Run unclaimed slices of the current job until there are none left.
+    void runSlices(int slices);
+    // Give the workers the calling thread's scheduling policy and priority.
+    void followCallerScheduling();
+
+    std::vector<Worker*> m_workers;
+    std::atomic<bool> m_running{false};
+    std::atomic<int> m_next{0};         // next slice to claim
+    std::atomic<int> m_remaining{0};    // slices after 0 not yet finished
+    Job m_job = nullptr;
+    void* m_context = nullptr;
+    pthread_t m_caller;             // thread the workers' scheduling follows,
+    bool m_callerKnown = false;     // once one has run a job
+};
@@ -0,0 +1,201 @@
+#include "pcm_cache.h"
+#include "audio_file.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Bump when the decode or upmix changes, so stale caches are not reused.
+static const uint32_t kCacheVersion = 1;
+static const char kCacheMagic[8] = { 'P', 'C', 'M', 'C', 'A', 'C', 'H', 'E' };
+
+// Fixed-size header at the start of every cache file. The samples follow at
+// offset sizeof(CacheHeader), which keeps them 64-byte aligned in the mapping.
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t channels;
+    uint64_t samples;
+    uint64_t keyHash;
+    char reserved[32];
+} CacheHeader;
+
+static_assert(sizeof(CacheHeader) == 64, "cache header must stay 64 bytes");
+
+PcmBuffer::~PcmBuffer()
+{
+    clear();
+}
+
+void PcmBuffer::assign(std::vector<float>&& samples, const std::string& key)
+{
+    clear();
+    m_owned = std::move(samples);
+    m_data = m_owned.data();
+    m_size = m_owned.size();
+    m_key = key;
+}
+
+void PcmBuffer::clear()
+{
+    if (m_mapping)
+        munmap(m_mapping, m_mappingBytes);
+    m_mapping = nullptr;
+    m_mappingBytes = 0;
+    std::vector<float>().swap(m_owned);
+    m_data = nullptr;
+    m_size = 0;
+    m_key.clear();
+}
+
+static uint64_t fnv1a(const std::string& s)
+{
+    uint64_t hash = 1469598103934665603ull;
+    for (unsigned char c : s) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool PcmBuffer::map(const std::string& cachePath, const std::string& key)
+{
+    int fd = ::open(cachePath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CacheHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    size_t bytes = (size_t)st.st_size;
+    void* mapping = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+        return false;
+
+    const CacheHeader* header = static_cast<const CacheHeader*>(mapping);
+    bool valid = std::memcmp(header->magic, kCacheMagic, sizeof(kCacheMagic)) == 0 &&
+                 header->version == kCacheVersion &&
+                 header->channels == DECODED_CHANNELS &&
+                 header->keyHash == fnv1a(key) &&
+                 sizeof(CacheHeader) + header->samples * sizeof(float) == bytes;
+    if (!valid) {
+        munmap(mapping, bytes);
+        return false;
+    }
+
+    // Ask the kernel to start paging the samples in now, so the audio thread
+    // rarely has to take the fault itself.
+    madvise(mapping, bytes, MADV_WILLNEED);
+
+    clear();
+    m_mapping = mapping;
+    m_mappingBytes = bytes;
+    m_data = reinterpret_cast<const float*>(static_cast<const char*>(mapping) + sizeof(CacheHeader));
+    m_size = header->samples;
+    m_key = key;
+    return true;
+}
+
+static std::string cacheDirectory()
+{
+    const char* dir = std::getenv("AUDIOTEST_CACHE_DIR");
+    return dir && *dir ? dir : ".cache/pcm";
+}
+
+// mkdir -p
+static bool makeDirectories(const std::string& dir)
+{
+    for (size_t pos = 1; pos <= dir.size(); ++pos) {
+        if (pos == dir.size() || dir[pos] == '/') {
+            std::string partial = dir.substr(0, pos);
+            if (mkdir(partial.c_str(), 0755) != 0 && errno != EEXIST)
+                return false;
+        }
+    }
+    return true;
+}
+
+static bool writeCacheFile(const std::string& cachePath, const std::string& key,
+                           const std::vector<float>& samples)
+{
+    CacheHeader header = {};
+    std::memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+    header.version = kCacheVersion;
+    header.channels = DECODED_CHANNELS;
+    header.samples = samples.size();
+    header.keyHash = fnv1a(key);
+
+    // Write to a temporary name and rename, so a crash never leaves a
+    // truncated file that looks valid. The name is unique to this writer, so
+    // two processes filling the same cache entry never share a temp file.
+    std::string tempPath = cachePath + ".XXXXXX";
+    int fd = mkstemp(&tempPath[0]);
+    if (fd < 0)
+        return false;
+    fchmod(fd, 0644);  // mkstemp creates it private to this user
+    FILE* file = fdopen(fd, "wb");
+    if (!file) {
+        close(fd);
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(samples.data(), sizeof(float), samples.size(), file) == samples.size();
+    ok = (std::fclose(file) == 0) && ok;
+
+    if (!ok || std::rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool loadDecodedAudio(const char* path, PcmBuffer& audio)
+{
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        std::cerr << "Could not open " << path << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+
+    char keyBuffer[64];
+    std::snprintf(keyBuffer, sizeof(keyBuffer), "|%lld|%lld|5.1|f32",
+                  (long long)st.st_mtime, (long long)st.st_size);
+    std::string key = std::string(path) + keyBuffer;
+
+    // Already loaded (e.g. the second initAudioData call)
+    if (audio.key() == key && !audio.empty())
+        return true;
+
+    std::string dir = cacheDirectory();
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%016llx.pcm", (unsigned long long)fnv1a(key));
+    std::string cachePath = dir + name;
+
+    if (audio.map(cachePath, key))
+        return true;
+
+    std::vector<float> samples;
+    if (!decodeAudioFile(path, samples))
+        return false;
+
+    if (makeDirectories(dir) && writeCacheFile(cachePath, key, samples) && audio.map(cachePath, key))
+        return true;
+
+    // No usable cache directory: keep the decoded samples in memory.
+    std::cerr << "Warning: could not write decode cache " << cachePath << "\n";
+    audio.assign(std::move(samples), key);
+    return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Decoded interleaved 5.1 PCM, either held in memory or mapped read-only from
+// the on-disk decode cache. Readers only see data() and size(), so the
+// render path does not care which.
+class PcmBuffer
+{
+public:
+    PcmBuffer() = default;
+    ~PcmBuffer();
+
+    PcmBuffer(const PcmBuffer&) = delete;
+    PcmBuffer& operator=(const PcmBuffer&) = delete;
+
+    const float* data() const { return m_data; }
+    size_t size() const { return m_size; }  // in samples, not frames
+    bool empty() const { return m_size == 0; }
+    bool isMapped() const { return m_mapping != nullptr; }
+
+    // Take ownership of in-memory samples.
+    void assign(std::vector<float>&& samples, const std::string& key = std::string());
+
+    // Map the samples of a cache file written by loadDecodedAudio().
+    bool map(const std::string& cachePath, const std::string& key);
+
+    void clear();
+
+    // Identifies the source (path, mtime, size, layout) the samples came from.
+    const std::string& key() const { return m_key; }
+
+private:
+    std::vector<float> m_owned;
+    void* m_mapping = nullptr;
+    size_t m_mappingBytes = 0;
+    const float* m_data = nullptr;
+    size_t m_size = 0;
+    std::string m_key;
+};
+
+// Load `path` as decoded 5.1 into `audio`.
+//
+// The first load decodes the file and writes the PCM to a cache file keyed by
+// source path, modification time, size and channel layout. Later loads map
+// that file instead of decoding; pages are faulted in lazily. If `audio`
+// already holds this source, nothing happens at all. The cache lives in
+// $AUDIOTEST_CACHE_DIR, or .cache/pcm in the working directory.
+bool loadDecodedAudio(const char* path, PcmBuffer& audio);
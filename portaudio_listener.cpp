@@ -1,155 +1,157 @@
 #include "six_channel.h"
 #include "utils.h"
 #include "portaudio.h"
+#include "render_engine.h"
+#include "streaming_decoder.h"
+#include "rt_alloc_check.h"
+#include "callback_stats.h"
+#include "pose_ingest.h"
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <csignal>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
-#include <iostream>
 #include <math.h>
+#include <memory>
+#include <mutex>
 #include <portaudio.h>
 #include <stdlib.h>
 #include <sndfile.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
 #include <vector>
 
-#define FRAMES_PER_BUFFER   (256)
-#ifndef M_PI
-#define M_PI (3.14159265)
-#endif
-
 static int gOutputDeviceIndex = paNoDevice;
 
-typedef std::array<std::vector<float>, CHANNEL_COUNT> AudioBuffer;
+// Host buffer size; paFramesPerBufferUnspecified lets the host API choose.
+static unsigned long gFramesPerBuffer = RENDER_BLOCK_FRAMES;
+// Suggested output latency in seconds; 0 picks the device's low latency.
+static double gOutputLatency = 0;
+// Mix worker threads for runtime-sized layouts; -1 picks automatically.
+static int gMixThreads = -1;
+static PanningMode gPanningMode = PanningMode::Gaussian;
+static int gAmbisonicOrder = -1;
+// HRIRs for binaural output, when it is on.
+static HrirSet gHrirs;
+static bool gBinaural = false;
+static int gReflectionOrder = 0;
+static bool gPosePrediction = false;
+// The open stream's output latency, for hosts whose callback timestamps are
+// unusable; written before the stream starts.
+static double gStreamOutputLatency = 0;
+static bool gDistanceDelays = false;
+// Room-correction filter list, loaded against the layout of each stream.
+static std::string gCorrectionList;
+static CorrectionFilters gCorrection;
+// Automation script, parsed against the layout of each stream.
+static std::string gAutomationPath;
+
+// Render engine for the currently open stream; sized before the stream
+// opens, and carried over to the next one on a device switch.
+static std::unique_ptr<RenderEngine> gEngine;
+
+// Reads tracker poses from stdin while a stream is playing, unless they
+// come through the shared-memory mailbox instead.
+static PoseIngest gPoseIngest;
+static PoseMailboxReader gPoseMailbox;
+
+// Timing and xrun counters written by the callback, read by the GUI.
+static CallbackStats gCallbackStats;
+
+// The running stream, for sampling its CPU load off the audio thread. The
+// mutex only keeps closePlayback() from closing it under a reader.
+static std::mutex gActiveStreamMutex;
+static PaStream* gActiveStream = nullptr;
 
 void SetOutputDeviceIndex(int index)
 {
     gOutputDeviceIndex = index;
 }
 
-static void checkErr(PaError err)
+void SetFramesPerBuffer(unsigned long frames)
 {
-    if (err != paNoError)
-    {
-        std::printf("PortAudio error: %s\n", Pa_GetErrorText(err));
-        std::fflush(stdout);
-        std::exit(EXIT_FAILURE);
-    }
+    gFramesPerBuffer = frames;
 }
 
-// read the audio for the number of frames in a buffer from a given file and return it.
-static AudioBuffer readAudio(paTestData* data) {
-    const size_t samplesNeeded = FRAMES_PER_BUFFER * CHANNEL_COUNT;
-
-    // Prevent out-of-range access
-    if (data->readIndex + samplesNeeded > data->audio.size()) {
-        // loop
-        data->readIndex = 0;
-    }
-
-    auto beginIterator = data->audio.begin() + data->readIndex;
-    auto endIterator = beginIterator + samplesNeeded;
-    data->readIndex += samplesNeeded;
-    std::vector<float> interleaved_buffer(beginIterator, endIterator);
+void SetOutputLatency(double seconds)
+{
+    gOutputLatency = seconds;
+}
 
-    AudioBuffer channelSignals;
+void SetMixThreads(int threads)
+{
+    gMixThreads = threads;
+}
 
-    for (int ch = 0; ch < CHANNEL_COUNT; ch++) {
-        channelSignals[ch].resize(FRAMES_PER_BUFFER);
-    }
+void SetAmbisonicOrder(int order)
+{
+    gAmbisonicOrder = order;
+}
 
-    for (unsigned long i = 0; i < FRAMES_PER_BUFFER; ++i) {
-        size_t base_index = i * CHANNEL_COUNT;
-        channelSignals[FrontLeft][i] = interleaved_buffer[base_index];
-        channelSignals[FrontRight][i] = interleaved_buffer[base_index + 1];
-        channelSignals[Centre][i] = interleaved_buffer[base_index + 2];
-        channelSignals[Subwoofer][i] = interleaved_buffer[base_index + 3];
-        channelSignals[BackLeft][i] = interleaved_buffer[base_index + 4];
-        channelSignals[BackRight][i] = interleaved_buffer[base_index + 5];
+bool SetBinauralOutput(const char* hrirListPath)
+{
+    if (hrirListPath) {
+        if (!gHrirs.load(hrirListPath))
+            return false;
+    } else if (!gBinaural) {
+        gHrirs.synthesize();
     }
-    
-    return channelSignals;
+    gBinaural = true;
+    return true;
 }
 
-static float wrapAngle(float a) {
-    while (a >  M_PI) a -= 2 * M_PI;
-    while (a < -M_PI) a += 2 * M_PI;
-    return a;
+void SetEarlyReflections(int order)
+{
+    gReflectionOrder = order;
 }
 
-static void applyRotation(paTestData* data, AudioBuffer* centeredAudioBuffer)
+void SetPosePrediction(bool enabled)
 {
-    const int SPEAKERS = CHANNEL_COUNT - 1; // exclude subwoofer
-    const float TWO_PI = 2 * M_PI;
-
-    AudioBuffer& buf = *centeredAudioBuffer;
-
-    std::array<float, CHANNEL_COUNT> distances =
-        calculateSpeakerDistances(data->currentListenerPosition,
-                                  data->speakerPositions);
+    gPosePrediction = enabled;
+}
 
-    size_t frameCount = buf[0].size();
+void SetDistanceDelays(bool enabled)
+{
+    gDistanceDelays = enabled;
+}
 
-    // 1. Compute real speaker angles (excluding subwoofer)
-    float realAngles[SPEAKERS];
-    for (int ch = 0; ch < SPEAKERS; ++ch) {
-        const Point& p = data->speakerPositions[ch];
-        realAngles[ch] = -wrapAngle(atan2f(p.y, p.x) - 0.25 * TWO_PI);
-    }
+void SetRoomCorrection(const char* filterListPath)
+{
+    gCorrectionList = filterListPath ? filterListPath : "";
+}
 
-    // 2. Define evenly-spaced virtual speakers
-    float virtualAngles[CHANNEL_COUNT];
-    virtualAngles[Centre] = wrapAngle(TWO_PI * 0 / SPEAKERS);
-    virtualAngles[FrontLeft] = wrapAngle(TWO_PI * -1 / SPEAKERS);
-    virtualAngles[BackLeft] = wrapAngle(TWO_PI * -2 / SPEAKERS);
-    virtualAngles[BackRight] = wrapAngle(TWO_PI * -3 / SPEAKERS);
-    virtualAngles[FrontRight] = wrapAngle(TWO_PI * -4 / SPEAKERS);
-    virtualAngles[Subwoofer] = 0;
-
-    // 3. Rotate virtual speakers opposite listener yaw
-    float rotatedAngles[SPEAKERS];
-    for (int v = 0; v < SPEAKERS; ++v)
-        rotatedAngles[v] = wrapAngle(virtualAngles[v] - data->listenerYaw * TWO_PI);
-
-    // 4. Compute Gaussian mixing weights
-    float weights[SPEAKERS][SPEAKERS];
-    const float sigma = 0.7f;
-
-    for (int v = 0; v < SPEAKERS; ++v)
-    {
-        float sum = 0.0f;
-        for (int r = 0; r < SPEAKERS; ++r) {
-            float d = wrapAngle(rotatedAngles[v] - realAngles[r]);
-            float w = expf(-(d*d)/(2*sigma*sigma));
-            weights[v][r] = w;
-            sum += w;
-        }
+void SetAutomation(const char* path)
+{
+    gAutomationPath = path ? path : "";
+}
 
-        for (int r = 0; r < SPEAKERS; ++r) {
-            weights[v][r] /= sum;
-        }
+bool SetPoseMailbox(const char* name)
+{
+    if (!name) {
+        gPoseMailbox.close();
+        return true;
     }
+    return gPoseMailbox.open(name);
+}
 
-    // 5. Allocate output buffer
-    AudioBuffer out;
-    for (int ch = 0; ch < CHANNEL_COUNT; ++ch)
-        out[ch].assign(frameCount, 0.0f);
-
-    // 6. Mix rotated main speakers
-    for (size_t i = 0; i < frameCount; ++i) {
-        for (int v = 0; v < SPEAKERS; ++v) {
-            float in = buf[v][i];
-            for (int r = 0; r < SPEAKERS; ++r) {
-                float distanceGain = distanceToGain(distances[r]) / data->maxGain;
-                out[r][i] += in * weights[v][r] * distanceGain;
-            }
-        }
-        // 7. Copy subwoofer directly (no panning)
-        out[Subwoofer][i] = buf[Subwoofer][i];
-    }
+void SetPanningMode(PanningMode mode)
+{
+    gPanningMode = mode;
+    if (gEngine)
+        gEngine->setPanningMode(mode);
+}
 
-    buf = out;
+bool checkPaError(PaError err)
+{
+    if (err == paNoError)
+        return true;
+    std::printf("PortAudio error: %s\n", Pa_GetErrorText(err));
+    std::fflush(stdout);
+    return false;
 }
 
 static int paTestCallback(const void *inputBuffer, void *outputBuffer,
@@ -159,33 +161,55 @@ static int paTestCallback(const void *inputBuffer, void *outputBuffer,
                           void *userData)
 {
     (void)inputBuffer;
-    (void)timeInfo;
-    (void)statusFlags;
 
-    paTestData *data = (paTestData *)userData;
-    float *out = (float *)outputBuffer;
+    auto start = std::chrono::steady_clock::now();
 
-    AudioBuffer channelSignals = readAudio(data);
-    applyRotation(data, &channelSignals);
+    RtAllocScope allocScope;
+    RenderEngine *engine = (RenderEngine *)userData;
 
-    for (unsigned long frame = 0; frame < FRAMES_PER_BUFFER; frame++) {
-        for (int ch = 0; ch < CHANNEL_COUNT; ch++) {
-            out[ch] = channelSignals[ch][frame];
-        }
-        out += CHANNEL_COUNT;   // advance to next interleaved frame
-    }
+    // When this buffer will be heard, on the clock tracker poses are
+    // stamped with; the stream clock itself may be any host clock.
+    double ahead = timeInfo->outputBufferDacTime - timeInfo->currentTime;
+    if (!(ahead > 0 && ahead < 1))
+        ahead = gStreamOutputLatency;
+    uint64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count();
+    engine->setOutputTime(nowNs + (uint64_t)(ahead * 1e9));
 
+    // Whether the streaming decoder ran dry during this callback
+    StreamingDecoder *decoder = engine->data()->stream;
+    unsigned long underruns = decoder ? decoder->underruns() : 0;
+    engine->render((float *)outputBuffer, framesPerBuffer);
+
+    uint64_t elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    uint64_t budgetNs = (uint64_t)framesPerBuffer * 1000000000ull / SAMPLE_RATE;
+    gCallbackStats.record(elapsedNs, budgetNs, framesPerBuffer,
+                          (statusFlags & paOutputUnderflow) != 0,
+                          (statusFlags & paOutputOverflow) != 0,
+                          decoder && decoder->underruns() != underruns);
 
     return paContinue;
 }
 
-// ------------ Start / end playback ------------
+CallbackStatsSnapshot getCallbackStats()
+{
+    {
+        std::lock_guard<std::mutex> lock(gActiveStreamMutex);
+        if (gActiveStream)
+            gCallbackStats.sampleCpuLoad(Pa_GetStreamCpuLoad(gActiveStream));
+    }
+    return gCallbackStats.snapshot();
+}
 
-PaStream* startPlayback(paTestData *data)
+bool dumpCallbackStats(const char* path)
 {
-    PaError err = Pa_Initialize();
-    checkErr(err);
+    return writeCallbackStatsFile(path, getCallbackStats());
+}
+
+// ------------ Open / close playback ------------
 
+PaStream* openPlayback(paTestData *data, bool keepEngine)
+{
     // Decide which output device to use:
     // - If GUI set gOutputDeviceIndex, use that.
     // - Otherwise, fall back to PortAudio default output device.
@@ -197,7 +221,6 @@ PaStream* startPlayback(paTestData *data)
     {
         std::printf("No valid output device selected or available.\n");
         std::fflush(stdout);
-        Pa_Terminate();
         return nullptr;
     }
 
@@ -206,19 +229,18 @@ PaStream* startPlayback(paTestData *data)
     {
         std::printf("Failed to get device info for index %d.\n", outputDevice);
         std::fflush(stdout);
-        Pa_Terminate();
         return nullptr;
     }
 
-    if (deviceInfo->maxOutputChannels < CHANNEL_COUNT)
+    const int channelCount = gBinaural ? 2 : data->layout->channels;
+    if (deviceInfo->maxOutputChannels < channelCount)
     {
         std::printf("Selected device '%s' does not support %d output channels "
                     "(maxOutputChannels = %d).\n",
                     deviceInfo->name,
-                    CHANNEL_COUNT,
+                    channelCount,
                     deviceInfo->maxOutputChannels);
         std::fflush(stdout);
-        Pa_Terminate();
         return nullptr;
     }
 
@@ -232,63 +254,164 @@ PaStream* startPlayback(paTestData *data)
     std::memset(&outputParameters, 0, sizeof(outputParameters));
 
     outputParameters.device = outputDevice;
-    outputParameters.channelCount = CHANNEL_COUNT;
+    outputParameters.channelCount = channelCount;
     outputParameters.sampleFormat = paFloat32;
-    outputParameters.suggestedLatency =
-        deviceInfo->defaultLowOutputLatency;
+    // Anything between the device's low and high default latencies
+    double latency = gOutputLatency;
+    if (latency < deviceInfo->defaultLowOutputLatency)
+        latency = deviceInfo->defaultLowOutputLatency;
+    if (latency > deviceInfo->defaultHighOutputLatency)
+        latency = deviceInfo->defaultHighOutputLatency;
+    outputParameters.suggestedLatency = latency;
     outputParameters.hostApiSpecificStreamInfo = nullptr;
 
-    PaStream* stream = nullptr;
-    err = Pa_OpenStream(&stream,
-                        nullptr,                // no input
-                        &outputParameters,      // output only
-                        SAMPLE_RATE,
-                        FRAMES_PER_BUFFER,
-                        paNoFlag,
-                        paTestCallback,
-                        data);
-    checkErr(err);
-
-    err = Pa_StartStream(stream);
-    checkErr(err);
-
-    while (true) {
-        std::string line;
-
-        std::getline(std::cin, line);
-
-        if (!line.empty()) { // Check if any line was read
-            printf("%s\n",line.c_str());
-            char name[50];
-            int age;
-            float listenerX;
-            float listenerY;
-            float yaw;
-
-            if (sscanf(line.c_str(), "%f,%f,%f", &listenerX, &listenerY, &yaw) == 3) {
-                // assume camera is at centre speaker
-                Point cameraPosition = data->speakerPositions[Centre];
-                data->currentListenerPosition = Point { listenerX + cameraPosition.x, listenerY + cameraPosition.y };
-                data->listenerYaw = yaw;
-            }
+    if (!keepEngine || !gEngine)
+    {
+        if (!gCorrectionList.empty() && !gCorrection.load(gCorrectionList.c_str(), *data->layout))
+        {
+            std::printf("Failed to load room correction filters.\n");
+            std::fflush(stdout);
+            return nullptr;
+        }
+
+        // A script is tens of kilobytes, so it is parsed on the heap; an
+        // empty one stops whatever the last stream was running.
+        std::unique_ptr<Automation> automation(new Automation());
+        if (!gAutomationPath.empty() && !loadAutomation(gAutomationPath.c_str(), *data->layout, *automation))
+        {
+            std::printf("Failed to load the automation script.\n");
+            std::fflush(stdout);
+            return nullptr;
+        }
+        if (automation->trackCount > 0 || data->automation.latest().trackCount > 0)
+            setAutomation(data, *automation);
+
+        // The engine renders in fixed sub-blocks, so it copes with whatever
+        // buffer size the host ends up calling back with.
+        gEngine = createRenderEngine(data);
+        if (gEngine) {
+            gEngine->setMixThreads(gMixThreads);
+            gEngine->setPanningMode(gPanningMode);
+            gEngine->setAmbisonicOrder(gAmbisonicOrder);
+            gEngine->setBinauralOutput(gBinaural ? &gHrirs : nullptr);
+            gEngine->setEarlyReflections(gReflectionOrder);
+            gEngine->setDistanceDelays(gDistanceDelays);
+            gEngine->setRoomCorrection(gCorrectionList.empty() ? nullptr : &gCorrection);
+            gEngine->setPoseMailbox(gPoseMailbox.isOpen() ? &gPoseMailbox : nullptr);
+            gEngine->setPosePrediction(gPosePrediction);
+        }
+        if (!gEngine || !gEngine->prepare(RENDER_BLOCK_FRAMES))
+        {
+            std::printf("Failed to allocate render buffers.\n");
+            std::fflush(stdout);
+            gEngine.reset();
+            return nullptr;
         }
-        Pa_Sleep(5); // wait 5 ms between stdin updates
     }
 
+    gCallbackStats.reset();
+
+    PaStream* stream = nullptr;
+    PaError err = Pa_OpenStream(&stream,
+                                nullptr,                // no input
+                                &outputParameters,      // output only
+                                SAMPLE_RATE,
+                                gFramesPerBuffer,
+                                paNoFlag,
+                                paTestCallback,
+                                gEngine.get());
+    if (!checkPaError(err))
+    {
+        if (!keepEngine)
+            gEngine.reset();
+        return nullptr;
+    }
+
+    const PaStreamInfo *streamInfo = Pa_GetStreamInfo(stream);
+    gStreamOutputLatency = streamInfo ? streamInfo->outputLatency : latency;
+    if (gFramesPerBuffer == paFramesPerBufferUnspecified)
+        std::printf("Buffer size: chosen by host");
+    else
+        std::printf("Buffer size: %lu frames", gFramesPerBuffer);
+    std::printf(", output latency %.1f ms (suggested %.1f ms)\n",
+                streamInfo ? streamInfo->outputLatency * 1000.0 : 0.0,
+                latency * 1000.0);
+    std::fflush(stdout);
+
+    {
+        std::lock_guard<std::mutex> lock(gActiveStreamMutex);
+        gActiveStream = stream;
+    }
     return stream;
 }
 
-void endPlayback(PaStream* stream)
+void closePlayback(PaStream* stream, bool keepEngine)
 {
-    if (!stream)
+    if (stream)
+    {
+        {
+            std::lock_guard<std::mutex> lock(gActiveStreamMutex);
+            gActiveStream = nullptr;
+        }
+
+        // Whatever is still queued is dropped rather than played out; the
+        // stream is going away, and on a device switch it would only delay
+        // the new one.
+        if (Pa_IsStreamStopped(stream) == 0)
+            checkPaError(Pa_AbortStream(stream));
+        checkPaError(Pa_CloseStream(stream));
+    }
+    if (keepEngine)
         return;
 
-    PaError err = Pa_StopStream(stream);
-    checkErr(err);
+    if (stream)
+    {
+        std::printf("%s\n", formatCallbackStats(gCallbackStats.snapshot()).c_str());
+        std::fflush(stdout);
+    }
 
-    err = Pa_CloseStream(stream);
-    checkErr(err);
+#ifdef RT_ALLOC_CHECK
+    std::printf("Audio thread allocations: %lu\n", rtAllocationCount());
+    std::fflush(stdout);
+#endif
+    gEngine.reset();
+}
 
-    err = Pa_Terminate();
-    checkErr(err);
-}
\ No newline at end of file
+// ------------ Tracker input ------------
+
+// Copies mailbox poses into data->spatial for the window while
+// gMirrorPoses is set.
+static std::thread gPoseMirror;
+static std::atomic<bool> gMirrorPoses{false};
+
+bool startPoseInput(paTestData* data)
+{
+    if (gPoseMailbox.isOpen()) {
+        // The engine reads the mailbox itself each callback; this only
+        // mirrors the pose into data->spatial for the window to draw.
+        gMirrorPoses.store(true, std::memory_order_release);
+        gPoseMirror = std::thread([data]() {
+            uint64_t shown = 0;
+            while (gMirrorPoses.load(std::memory_order_acquire)) {
+                MailboxPose pose;
+                if (gPoseMailbox.read(pose) && pose.sequence != shown) {
+                    applyTrackerPose(data, pose.x, pose.y, pose.yaw, pose.captureNs);
+                    shown = pose.sequence;
+                }
+                Pa_Sleep(33);
+            }
+        });
+        return true;
+    }
+
+    // Tracker poses arrive on stdin, read on their own thread
+    return gPoseIngest.start(STDIN_FILENO, data);
+}
+
+void stopPoseInput()
+{
+    gPoseIngest.stop();
+    gMirrorPoses.store(false, std::memory_order_release);
+    if (gPoseMirror.joinable())
+        gPoseMirror.join();
+}
@@ -1,12 +1,90 @@
 #pragma once
 
 #include "portaudio.h"
+#include "callback_stats.h"
+#include "render_engine.h"
 #include "utils.h"
 
 Point getCircularCoordinates(float circularPosition, float radius);
 
-PaStream* startPlayback(paTestData* data);
+// Print a PortAudio error; true if err is paNoError.
+bool checkPaError(PaError err);
 
-void endPlayback(PaStream* stream);
+// Open, but do not start, an output stream rendering data on the device from
+// SetOutputDeviceIndex (else the default one). A render engine is built for
+// it with the current settings, loading the room-correction filters and
+// the automation script, unless keepEngine is set and the last stream's
+// engine is still there: then that one carries on where it was, with no
+// allocation or file loading. PortAudio must be initialised. nullptr, with
+// the reason printed, if the device cannot take the stream.
+PaStream* openPlayback(paTestData* data, bool keepEngine);
 
-void SetOutputDeviceIndex(int index);  // PaDeviceIndex, or paNoDevice for default
\ No newline at end of file
+// Abort and close a stream from openPlayback() (nullptr for none). The
+// render engine goes too, and the stream's stats are printed, unless
+// keepEngine is set for the next openPlayback().
+void closePlayback(PaStream* stream, bool keepEngine);
+
+// Feed tracker poses into data on a thread of their own: from the mailbox
+// given to SetPoseMailbox(), or else from stdin. False if they cannot be
+// read. Independent of any stream, so poses keep arriving while playback
+// is paused or stopped.
+bool startPoseInput(paTestData* data);
+void stopPoseInput();
+
+// Callback timing and xrun counters for the current (or last) stream, with a
+// fresh Pa_GetStreamCpuLoad sample. Call from any thread but the audio thread.
+CallbackStatsSnapshot getCallbackStats();
+
+// Write getCallbackStats() to a stats file.
+bool dumpCallbackStats(const char* path);
+
+void SetOutputDeviceIndex(int index);  // PaDeviceIndex, or paNoDevice for default
+
+// Host buffer size in frames for the next stream, or
+// paFramesPerBufferUnspecified to let the host API pick its optimal period.
+void SetFramesPerBuffer(unsigned long frames);
+
+// Suggested output latency in seconds for the next stream, clamped to the
+// device's defaultLowOutputLatency..defaultHighOutputLatency.
+void SetOutputLatency(double seconds);
+
+// Mix worker threads for speaker arrays loaded from a file; -1 picks a count
+// from the array size. See RenderEngine::setMixThreads.
+void SetMixThreads(int threads);
+
+// Panning mode for the next stream, and for the running one if there is one.
+void SetPanningMode(PanningMode mode);
+
+// Bus order for PanningMode::Ambisonic in the next stream; -1 picks the
+// highest the layout supports. See RenderEngine::setAmbisonicOrder.
+void SetAmbisonicOrder(int order);
+
+// Render the next stream binaurally to a stereo device, with the HRIRs listed
+// in hrirListPath (see HrirSet::load) or, for nullptr, a spherical-head model.
+bool SetBinauralOutput(const char* hrirListPath);
+
+// Add reflections off the room walls, up to `order` walls deep, to the next
+// stream; 0 turns them off. See RenderEngine::setEarlyReflections.
+void SetEarlyReflections(int order);
+
+// Render the next stream for where the tracked listener will be when each
+// buffer is heard. See RenderEngine::setPosePrediction.
+void SetPosePrediction(bool enabled);
+
+// Delay the speakers in the next stream so their sound arrives together.
+// See RenderEngine::setDistanceDelays.
+void SetDistanceDelays(bool enabled);
+
+// Correct each speaker in the next stream with the filters listed in
+// filterListPath (see CorrectionFilters::load), loaded when the stream
+// starts; nullptr turns correction off.
+void SetRoomCorrection(const char* filterListPath);
+
+// Run the keyframed script in `path` (see automation.h) from the start of
+// the next stream; nullptr runs none.
+void SetAutomation(const char* path);
+
+// Read tracker poses from the shared-memory mailbox `name` (see
+// pose_mailbox.h) instead of stdin, from the next stream on; nullptr goes
+// back to stdin. False if the segment cannot be opened.
+bool SetPoseMailbox(const char* name);
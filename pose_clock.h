@@ -0,0 +1,13 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Clock tracker poses are stamped on: steady_clock, in nanoseconds. It is
+// the system-wide monotonic clock (CLOCK_MONOTONIC on Linux), so stamps
+// taken in a tracker process compare with the audio process's.
+inline uint64_t poseClockNs()
+{
+    using namespace std::chrono;
+    return (uint64_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,236 @@
+#include "pose_ingest.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+
+// Exactly representable powers of ten
+static const double kPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+const char* parsePoseFloat(const char* p, const char* end, float& value)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        ++p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    // Up to 19 significant digits fit the mantissa; the rest only scale it
+    uint64_t mantissa = 0;
+    int significant = 0;
+    int exponent = 0;
+    bool any = false;
+    for (; p < end && isDigit(*p); ++p) {
+        any = true;
+        if (significant < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            significant += mantissa != 0;
+        } else {
+            ++exponent;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (++p; p < end && isDigit(*p); ++p) {
+            any = true;
+            if (significant < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                significant += mantissa != 0;
+                --exponent;
+            }
+        }
+    }
+    if (!any)
+        return nullptr;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool negativeExponent = false;
+        if (q < end && (*q == '-' || *q == '+'))
+            negativeExponent = *q++ == '-';
+        if (q < end && isDigit(*q)) {
+            int e = 0;
+            for (; q < end && isDigit(*q); ++q)
+                e = std::min(e * 10 + (*q - '0'), 1000);
+            exponent += negativeExponent ? -e : e;
+            p = q;
+        }
+    }
+
+    double v = (double)mantissa;
+    if (mantissa != 0) {
+        exponent = std::max(-400, std::min(400, exponent));
+        for (; exponent > 22; exponent -= 22)
+            v *= 1e22;
+        for (; exponent < -22; exponent += 22)
+            v /= 1e22;
+        v = exponent >= 0 ? v * kPow10[exponent] : v / kPow10[-exponent];
+    }
+    value = (float)(negative ? -v : v);
+    return p;
+}
+
+bool parsePoseLine(const char* begin, const char* end, float& x, float& y, float& yaw)
+{
+    const char* p = parsePoseFloat(begin, end, x);
+    if (!p || p == end || *p != ',')
+        return false;
+    p = parsePoseFloat(p + 1, end, y);
+    if (!p || p == end || *p != ',')
+        return false;
+    p = parsePoseFloat(p + 1, end, yaw);
+    return p && std::isfinite(x) && std::isfinite(y) && std::isfinite(yaw);
+}
+
+PoseIngest::~PoseIngest()
+{
+    stop();
+}
+
+bool PoseIngest::start(int fd, paTestData* data)
+{
+    stop();
+    if (pipe(m_wake) != 0) {
+        std::fprintf(stderr, "pose input: could not create wake-up pipe: %s\n", std::strerror(errno));
+        m_wake[0] = m_wake[1] = -1;
+        return false;
+    }
+    m_fd = fd;
+    m_data = data;
+    m_pending = 0;
+    m_running.store(true, std::memory_order_release);
+    m_thread = std::thread(&PoseIngest::run, this);
+    return true;
+}
+
+void PoseIngest::stop()
+{
+    if (m_thread.joinable()) {
+        char byte = 0;
+        ssize_t written = write(m_wake[1], &byte, 1);
+        (void)written;
+        m_thread.join();
+    }
+    for (int& fd : m_wake) {
+        if (fd >= 0)
+            close(fd);
+        fd = -1;
+    }
+    m_running.store(false, std::memory_order_release);
+}
+
+bool PoseIngest::newestPose(const char* begin, const char* end, float pose[3])
+{
+    // Newest first: once one parses, the older lines are stale anyway
+    size_t lineEnd = end - begin - 1;   // the final '\n'
+    for (;;) {
+        size_t lineStart = lineEnd;
+        while (lineStart > 0 && begin[lineStart - 1] != '\n')
+            --lineStart;
+        if (lineStart < lineEnd) {
+            if (parsePoseLine(begin + lineStart, begin + lineEnd, pose[0], pose[1], pose[2]))
+                return true;
+            m_malformed.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (lineStart == 0)
+            return false;
+        lineEnd = lineStart - 1;
+    }
+}
+
+void PoseIngest::publish(const float pose[3], uint64_t arrivalNs)
+{
+    applyTrackerPose(m_data, pose[0], pose[1], pose[2], arrivalNs);
+    m_published.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PoseIngest::run()
+{
+    pollfd fds[2] = { { m_fd, POLLIN, 0 }, { m_wake[0], POLLIN, 0 } };
+    bool eof = false;
+    while (!eof) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            std::fprintf(stderr, "pose input: poll failed: %s\n", std::strerror(errno));
+            break;
+        }
+        if (fds[1].revents)
+            break;
+        if (!fds[0].revents)
+            continue;
+
+        // Take everything the source has written so far. poll() said the
+        // first read will not block, and each further one is only made
+        // after poll() says so again, so the descriptor's own blocking mode
+        // (stdin's is shared with the shell) is left alone.
+        float pose[3];
+        bool have = false;
+        uint64_t arrivalNs = 0;
+        for (;;) {
+            ssize_t n = read(m_fd, m_buffer + m_pending, sizeof(m_buffer) - m_pending);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0) {
+                eof = true;
+                break;
+            }
+            uint64_t now = poseClockNs();
+            size_t filled = m_pending + n;
+
+            // Complete lines end at the last newline; the pending bytes have none
+            size_t complete = 0;
+            for (size_t i = filled; i > m_pending; --i) {
+                if (m_buffer[i - 1] == '\n') {
+                    complete = i;
+                    break;
+                }
+            }
+            if (complete > 0) {
+                m_lines.fetch_add(std::count(m_buffer + m_pending, m_buffer + complete, '\n'),
+                                  std::memory_order_relaxed);
+                float latest[3];
+                if (newestPose(m_buffer, m_buffer + complete, latest)) {
+                    std::copy(latest, latest + 3, pose);
+                    have = true;
+                    arrivalNs = now;
+                }
+                std::memmove(m_buffer, m_buffer + complete, filled - complete);
+                filled -= complete;
+            } else if (filled == sizeof(m_buffer)) {
+                // No pose is this long
+                m_malformed.fetch_add(1, std::memory_order_relaxed);
+                filled = 0;
+            }
+            m_pending = filled;
+
+            pollfd more = { m_fd, POLLIN, 0 };
+            if (poll(&more, 1, 0) <= 0 || !more.revents)
+                break;
+        }
+        if (have)
+            publish(pose, arrivalNs);
+    }
+
+    // A last line without a newline still counts, as it did with getline()
+    if (eof && m_pending > 0) {
+        float pose[3];
+        m_lines.fetch_add(1, std::memory_order_relaxed);
+        if (parsePoseLine(m_buffer, m_buffer + m_pending, pose[0], pose[1], pose[2]))
+            publish(pose, poseClockNs());
+        else
+            m_malformed.fetch_add(1, std::memory_order_relaxed);
+        m_pending = 0;
+    }
+    m_running.store(false, std::memory_order_release);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include "pose_clock.h"
+#include "utils.h"
+
+// Bytes read from the pose source in one go; a burst larger than this is
+// taken in several reads, but still publishes a single pose.
+#define POSE_INGEST_BUFFER_BYTES (16384)
+
+// Parse a decimal number ("-1.25", "3e-2", leading blanks skipped) from
+// [p, end) into value. Returns the character after it, or nullptr if there
+// is no number. No allocation and no locale, unlike strtof and sscanf;
+// within one float ulp of strtof.
+const char* parsePoseFloat(const char* p, const char* end, float& value);
+
+// Parse an "x,y,yaw" line from [begin, end). Anything after the third number
+// is ignored, as sscanf("%f,%f,%f") did. False if a number is missing or not
+// finite.
+bool parsePoseLine(const char* begin, const char* end, float& x, float& y, float& yaw);
+
+// Reads "x,y,yaw" tracker lines (see examples/) from a file descriptor on its
+// own thread and publishes them with applyTrackerPose().
+//
+// The thread sleeps in poll() until data arrives, then drains everything
+// the source has written with back-to-back reads into a fixed buffer, and
+// publishes only the newest complete pose of that burst, stamped with the
+// time it was read. A source that writes faster than the ingest can keep
+// up with is therefore never queued behind: each publish is as fresh as the
+// pipe allows. Parsing works in place, so nothing is allocated per line.
+class PoseIngest
+{
+public:
+    ~PoseIngest();
+
+    // Start reading fd (not owned, not closed) into data. False if the
+    // wake-up pipe or the thread cannot be created.
+    bool start(int fd, paTestData* data);
+
+    // Stop the thread and wait for it. Safe to call when not running.
+    void stop();
+
+    // True until the source reaches end of file or stop() is called.
+    bool running() const { return m_running.load(std::memory_order_acquire); }
+
+    // Counters, readable from any thread.
+    unsigned long linesRead() const { return m_lines.load(std::memory_order_relaxed); }
+    unsigned long posesPublished() const { return m_published.load(std::memory_order_relaxed); }
+    unsigned long malformedLines() const { return m_malformed.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    // Parse the newest well-formed line in [begin, end), which holds only
+    // complete lines; false if none is.
+    bool newestPose(const char* begin, const char* end, float pose[3]);
+    void publish(const float pose[3], uint64_t arrivalNs);
+
+    paTestData* m_data = nullptr;
+    int m_fd = -1;
+    int m_wake[2] = { -1, -1 };     // stop() writes to [1] to break poll()
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+
+    char m_buffer[POSE_INGEST_BUFFER_BYTES];
+    size_t m_pending = 0;           // bytes of an unfinished line at the start of m_buffer
+
+    std::atomic<unsigned long> m_lines{0};
+    std::atomic<unsigned long> m_published{0};
+    std::atomic<unsigned long> m_malformed{0};
+};
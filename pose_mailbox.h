@@ -0,0 +1,187 @@
+#pragma once
+
+// Shared-memory pose mailbox: a head tracker on the same machine hands its
+// latest pose straight to the audio engine, without a pipe, a text format or
+// any system call per pose.
+//
+// The mailbox is a named POSIX shared-memory segment holding one pose
+// behind a seqlock. The tracker overwrites it as often as it likes; the
+// engine reads it once per block, and only ever sees the newest pose.
+//
+// This header is all a tracker needs (see examples/spin.cpp): include it,
+// open a PoseMailboxWriter and publish(). Link with -lrt on glibc older
+// than 2.34.
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "pose_clock.h"
+
+// Segment the engine and the examples use unless told otherwise.
+#define POSE_MAILBOX_DEFAULT_NAME "/audiotest-pose"
+
+// Written by the tracker once it has opened the segment; bump it whenever
+// PoseMailboxSegment changes.
+#define POSE_MAILBOX_MAGIC (0x504f5301u)
+
+// Seqlock reads tried before giving up on a pose the tracker keeps rewriting.
+#define POSE_MAILBOX_READ_ATTEMPTS (4)
+
+// One pose, as the tracker published it.
+typedef struct
+{
+    float x;                // metres, relative to the camera, as on stdin
+    float y;
+    float yaw;
+    uint64_t captureNs;     // when the tracker captured it, on poseClockNs()
+    uint64_t sequence;      // 1 for the first pose, then +1 per publish
+} MailboxPose;
+
+// The shared segment. Every field is a lock-free atomic, so the layout is
+// the same in both processes; the seqlock makes the set of fields coherent.
+typedef struct
+{
+    std::atomic<uint32_t> magic;
+    std::atomic<uint32_t> lock;         // odd while the tracker is writing
+    std::atomic<float> x;
+    std::atomic<float> y;
+    std::atomic<float> yaw;
+    std::atomic<uint64_t> captureNs;
+    std::atomic<uint64_t> sequence;     // 0 until the first publish
+} PoseMailboxSegment;
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<float>::is_always_lock_free &&
+              std::atomic<uint64_t>::is_always_lock_free,
+              "the pose mailbox needs address-free atomics to be shared between processes");
+
+// Open (creating if need be) and map the segment `name`. Either side may
+// start first: a new segment is zero, which reads as "no pose yet".
+// Returns nullptr and prints why on failure.
+inline PoseMailboxSegment* mapPoseMailbox(const char* name)
+{
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        std::fprintf(stderr, "pose mailbox %s: %s\n", name, std::strerror(errno));
+        return nullptr;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 ||
+        (info.st_size < (off_t)sizeof(PoseMailboxSegment) && ftruncate(fd, sizeof(PoseMailboxSegment)) != 0)) {
+        std::fprintf(stderr, "pose mailbox %s: %s\n", name, std::strerror(errno));
+        close(fd);
+        return nullptr;
+    }
+    void* memory = mmap(nullptr, sizeof(PoseMailboxSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        std::fprintf(stderr, "pose mailbox %s: %s\n", name, std::strerror(errno));
+        return nullptr;
+    }
+    return static_cast<PoseMailboxSegment*>(memory);
+}
+
+inline void unmapPoseMailbox(PoseMailboxSegment* segment)
+{
+    if (segment)
+        munmap(segment, sizeof(PoseMailboxSegment));
+}
+
+// Tracker side. Only one writer per mailbox.
+class PoseMailboxWriter
+{
+public:
+    ~PoseMailboxWriter() { close(); }
+
+    bool open(const char* name = POSE_MAILBOX_DEFAULT_NAME)
+    {
+        close();
+        m_segment = mapPoseMailbox(name);
+        if (!m_segment)
+            return false;
+        // Carry on from a previous tracker's sequence, so readers see a change
+        m_sequence = m_segment->sequence.load(std::memory_order_relaxed);
+        m_segment->magic.store(POSE_MAILBOX_MAGIC, std::memory_order_release);
+        return true;
+    }
+
+    void close()
+    {
+        unmapPoseMailbox(m_segment);
+        m_segment = nullptr;
+    }
+
+    // Overwrite the mailbox with a pose captured at captureNs.
+    void publish(float x, float y, float yaw, uint64_t captureNs = poseClockNs())
+    {
+        // Release stores throughout (free on x86): a reader that sees any
+        // new field also sees the odd lock, so it retries.
+        uint32_t lock = m_segment->lock.load(std::memory_order_relaxed);
+        m_segment->lock.store(lock + 1, std::memory_order_relaxed);
+        m_segment->x.store(x, std::memory_order_release);
+        m_segment->y.store(y, std::memory_order_release);
+        m_segment->yaw.store(yaw, std::memory_order_release);
+        m_segment->captureNs.store(captureNs, std::memory_order_release);
+        m_segment->sequence.store(++m_sequence, std::memory_order_release);
+        m_segment->lock.store(lock + 2, std::memory_order_release);
+    }
+
+    // Sequence number of the last pose published.
+    uint64_t sequence() const { return m_sequence; }
+
+private:
+    PoseMailboxSegment* m_segment = nullptr;
+    uint64_t m_sequence = 0;
+};
+
+// Engine side. read() is wait-free and makes no system calls, so it is safe
+// on the audio thread; any number of threads may read.
+class PoseMailboxReader
+{
+public:
+    ~PoseMailboxReader() { close(); }
+
+    bool open(const char* name = POSE_MAILBOX_DEFAULT_NAME)
+    {
+        close();
+        m_segment = mapPoseMailbox(name);
+        return m_segment != nullptr;
+    }
+
+    void close()
+    {
+        unmapPoseMailbox(m_segment);
+        m_segment = nullptr;
+    }
+
+    bool isOpen() const { return m_segment != nullptr; }
+
+    // The latest pose. False if there is none yet, or the tracker was
+    // writing through every attempt (the caller keeps its last pose).
+    bool read(MailboxPose& pose) const
+    {
+        if (!m_segment || m_segment->magic.load(std::memory_order_acquire) != POSE_MAILBOX_MAGIC)
+            return false;
+        for (int attempt = 0; attempt < POSE_MAILBOX_READ_ATTEMPTS; ++attempt) {
+            uint32_t before = m_segment->lock.load(std::memory_order_acquire);
+            if (before & 1)
+                continue;
+            pose.x = m_segment->x.load(std::memory_order_acquire);
+            pose.y = m_segment->y.load(std::memory_order_acquire);
+            pose.yaw = m_segment->yaw.load(std::memory_order_acquire);
+            pose.captureNs = m_segment->captureNs.load(std::memory_order_acquire);
+            pose.sequence = m_segment->sequence.load(std::memory_order_acquire);
+            if (m_segment->lock.load(std::memory_order_relaxed) == before)
+                return pose.sequence != 0;
+        }
+        return false;
+    }
+
+private:
+    PoseMailboxSegment* m_segment = nullptr;
+};
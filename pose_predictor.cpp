@@ -0,0 +1,71 @@
+#include "pose_predictor.h"
+#include <algorithm>
+#include <cmath>
+
+void PosePredictor::reset()
+{
+    *this = PosePredictor();
+}
+
+void PosePredictor::observe(Point position, float yaw, uint64_t timeNs)
+{
+    if (m_time != 0 && timeNs <= m_time)
+        return;
+    float dt = m_time != 0 ? (timeNs - m_time) * 1e-9f : 0.0f;
+    if (dt > 0.0f && dt < POSE_PREDICTION_GAP_SECONDS) {
+        // Yaw is in turns, so the shortest way round is within half a turn
+        float turned = yaw - m_yaw;
+        turned -= std::floor(turned + 0.5f);
+        float vx = (position.x - m_position.x) / dt;
+        float vy = (position.y - m_position.y) / dt;
+        float vyaw = turned / dt;
+        if (m_moving) {
+            float a = 1.0f - std::exp(-dt / POSE_PREDICTION_SMOOTHING_SECONDS);
+            m_velocityX += a * (vx - m_velocityX);
+            m_velocityY += a * (vy - m_velocityY);
+            m_yawRate += a * (vyaw - m_yawRate);
+        } else {
+            m_velocityX = vx;
+            m_velocityY = vy;
+            m_yawRate = vyaw;
+            m_moving = true;
+        }
+    } else {
+        m_moving = false;
+        m_velocityX = m_velocityY = m_yawRate = 0.0f;
+    }
+    m_position = position;
+    m_yaw = yaw;
+    m_time = timeNs;
+}
+
+void PosePredictor::predict(uint64_t timeNs, Point& position, float& yaw) const
+{
+    position = m_position;
+    yaw = m_yaw;
+    if (!m_moving || timeNs <= m_time)
+        return;
+    float age = (timeNs - m_time) * 1e-9f;
+    if (age >= POSE_PREDICTION_GAP_SECONDS)
+        return;
+
+    // Travel at the current velocity, decaying through the capped lead
+    float lead = std::min(age, POSE_PREDICTION_MAX_LEAD_SECONDS);
+    float travel = POSE_PREDICTION_DAMPING_SECONDS * (1.0f - std::exp(-lead / POSE_PREDICTION_DAMPING_SECONDS));
+    // Past the longest lead the tracker has gone quiet; rather than hold the
+    // offset until it is back, fade it out by the time the poses count as a gap
+    if (age > POSE_PREDICTION_MAX_LEAD_SECONDS)
+        travel *= (POSE_PREDICTION_GAP_SECONDS - age) /
+                  (POSE_PREDICTION_GAP_SECONDS - POSE_PREDICTION_MAX_LEAD_SECONDS);
+
+    yaw += std::max(-POSE_PREDICTION_MAX_YAW, std::min(POSE_PREDICTION_MAX_YAW, m_yawRate * travel));
+    float dx = m_velocityX * travel;
+    float dy = m_velocityY * travel;
+    float distance = std::sqrt(dx * dx + dy * dy);
+    if (distance > POSE_PREDICTION_MAX_OFFSET) {
+        dx *= POSE_PREDICTION_MAX_OFFSET / distance;
+        dy *= POSE_PREDICTION_MAX_OFFSET / distance;
+    }
+    position.x += dx;
+    position.y += dy;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include "utils.h"
+
+// Furthest ahead of the last tracker pose a prediction reaches; later
+// targets get this lead, so a tracker that stops is not run away with.
+#define POSE_PREDICTION_MAX_LEAD_SECONDS (0.1f)
+// The velocity is assumed to decay with this time constant through the
+// lead, so no prediction travels further than this many seconds' worth.
+#define POSE_PREDICTION_DAMPING_SECONDS (0.05f)
+// Time constant of the smoothing on the measured velocity.
+#define POSE_PREDICTION_SMOOTHING_SECONDS (0.02f)
+// A gap between poses longer than this restarts the velocity estimate; a
+// tracker silent for this long is no longer extrapolated at all.
+#define POSE_PREDICTION_GAP_SECONDS (0.25f)
+// Largest correction applied: turns of yaw, and metres.
+#define POSE_PREDICTION_MAX_YAW (0.125f)
+#define POSE_PREDICTION_MAX_OFFSET (0.5f)
+
+// Extrapolates the listener's tracked pose to a later time, from linear
+// and angular velocities estimated from successive timestamped poses.
+//
+// Velocities are smoothed exponentially (the tracker's jitter would
+// otherwise be amplified by the lead) and decay through the lead, and the
+// correction is capped in time, angle and distance, so a sudden stop
+// overshoots by a bounded amount. When the tracker stops sending, which is
+// not the same as the head stopping, the correction fades out between the
+// longest lead and the gap, leaving the last pose as it was tracked. Times
+// are poseClockNs() nanoseconds.
+// No allocation; safe on the audio thread.
+class PosePredictor
+{
+public:
+    void reset();
+
+    // A new tracker pose, read at timeNs. Yaw is in turns and may wrap.
+    void observe(Point position, float yaw, uint64_t timeNs);
+    // Time of the last pose observed, 0 before the first.
+    uint64_t lastTime() const { return m_time; }
+
+    // The last pose observed, extrapolated to timeNs; just the last pose
+    // once it is POSE_PREDICTION_GAP_SECONDS old.
+    void predict(uint64_t timeNs, Point& position, float& yaw) const;
+
+private:
+    Point m_position = {};
+    float m_yaw = 0.0f;
+    uint64_t m_time = 0;
+    bool m_moving = false;          // the velocities below are measured
+    float m_velocityX = 0.0f;       // metres per second
+    float m_velocityY = 0.0f;
+    float m_yawRate = 0.0f;         // turns per second
+};
@@ -0,0 +1,1035 @@
+#include "render_engine.h"
+#include "mix_worker_pool.h"
+#include "six_channel.h"
+#include "streaming_decoder.h"
+#include "vbap.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#ifndef M_PI
+#define M_PI (3.14159265)
+#endif
+
+// Order of the channels in the interleaved source, mapped to our speaker enum.
+static const int kSourceChannelOrder[DECODED_CHANNELS] = {
+    FrontLeft, FrontRight, Centre, Subwoofer, BackLeft, BackRight
+};
+
+static float wrapAngle(float a) {
+    while (a >  M_PI) a -= 2 * M_PI;
+    while (a < -M_PI) a += 2 * M_PI;
+    return a;
+}
+
+const char* panningModeName(PanningMode mode)
+{
+    switch (mode) {
+        case PanningMode::Gaussian: return "gaussian";
+        case PanningMode::Vbap:     return "vbap";
+        case PanningMode::Ambisonic: return "ambisonic";
+        default: return "unknown";
+    }
+}
+
+bool findPanningMode(const char* name, PanningMode& mode)
+{
+    for (int m = 0; m < (int)PanningMode::Count; ++m) {
+        if (std::strcmp(panningModeName((PanningMode)m), name) == 0) {
+            mode = (PanningMode)m;
+            return true;
+        }
+    }
+    return false;
+}
+
+RenderEngine::RenderEngine(paTestData* data, int outputs)
+    : m_data(data)
+    , m_outputs(outputs)
+    , m_mixKernel(getMixKernel(bestMixKernelType()))
+    , m_routeKernel(getRouteKernel(bestMixKernelType()))
+{
+}
+
+RenderEngine::~RenderEngine()
+{
+    std::free(m_storage);
+}
+
+bool RenderEngine::prepare(unsigned long maxFrames)
+{
+    const size_t floatsPerLine = RENDER_ALIGNMENT / sizeof(float);
+    // Round every channel up to a whole number of cache lines so each one
+    // starts on an aligned boundary.
+    size_t stride = (maxFrames + floatsPerLine - 1) / floatsPerLine * floatsPerLine;
+    // planar source, output and ambisonic bus blocks plus one interleaved
+    // block for streamed input
+    size_t channels = DECODED_CHANNELS + m_outputs + kBusChannels + DECODED_CHANNELS;
+    size_t bytes = stride * sizeof(float) * channels;
+
+    float* storage = static_cast<float*>(std::aligned_alloc(RENDER_ALIGNMENT, bytes));
+    if (!storage)
+        return false;
+    std::memset(storage, 0, bytes);
+
+    std::free(m_storage);
+    m_storage = storage;
+    m_maxFrames = maxFrames;
+
+    for (int ch = 0; ch < DECODED_CHANNELS; ++ch)
+        m_input[ch] = m_storage + stride * ch;
+    for (int ch = 0; ch < m_outputs; ++ch)
+        m_mixed[ch] = m_storage + stride * (DECODED_CHANNELS + ch);
+    for (int ch = 0; ch < kBusChannels; ++ch)
+        m_bus[ch] = m_storage + stride * (DECODED_CHANNELS + m_outputs + ch);
+    m_streamScratch = m_storage + stride * (DECODED_CHANNELS + m_outputs + kBusChannels);
+
+    // Highest order the ring can resolve: 2M + 1 harmonics need more than
+    // 2M speakers.
+    int ringSpeakers = m_outputs - (m_data->layout->lfe >= 0 ? 1 : 0);
+    int order = m_ambiRequestedOrder > 0 ? m_ambiRequestedOrder : (ringSpeakers - 1) / 2;
+    m_ambiOrder = std::max(1, std::min(AMBI_MAX_ORDER, order));
+
+    // The virtual speakers never move, so their encoding is fixed.
+    const float TWO_PI = 2 * M_PI;
+    for (int v = 0; v < DECODED_CHANNELS; ++v)
+        ambisonicEncode(m_ambiOrder, Layout51::angles[v] * TWO_PI, m_ambiSources[v]);
+    m_ambiValid = false;
+    m_localValid = false;
+    m_predicting = m_posePrediction;
+    m_predictor.reset();
+
+    m_automation = nullptr;
+    m_automationVersion = 0;
+    m_automating = false;
+    m_automationStep = std::max(1ul, std::min(m_automationStepRequest, maxFrames));
+
+    if (m_hrirs && !m_binaural.prepare(*m_hrirs, m_outputs))
+        return false;
+
+    m_reflecting = m_reflectionOrder > 0;
+    m_reflectionsValid = false;
+    if (m_reflecting && !m_reflections.prepare(DECODED_CHANNELS, maxFrames))
+        return false;
+
+    m_delaying = m_distanceDelays && !m_hrirs;
+    m_delaysValid = false;
+    if (m_delaying && !m_delays.prepare(m_outputs, maxFrames))
+        return false;
+
+    m_correcting = m_correctionFilters && !m_hrirs;
+    if (m_correcting && !m_correction.prepare(*m_correctionFilters, m_outputs, m_correctionBackground))
+        return false;
+    return true;
+}
+
+// Deinterleave the next block of frames into the input block, either straight
+// from data->audio or from the streaming decoder's ring buffer.
+void RenderEngine::readAudio(unsigned long frames)
+{
+    paTestData* data = m_data;
+    const float* src;
+
+    if (data->stream && data->stream->isOpen()) {
+        data->stream->read(m_streamScratch, frames);
+        src = m_streamScratch;
+    } else {
+        const size_t samplesNeeded = frames * DECODED_CHANNELS;
+
+        // Prevent out-of-range access
+        if (data->readIndex + samplesNeeded > data->audio.size()) {
+            // loop
+            data->readIndex = 0;
+        }
+
+        src = data->audio.data() + data->readIndex;
+        data->readIndex += samplesNeeded;
+    }
+
+    for (unsigned long i = 0; i < frames; ++i) {
+        for (int ch = 0; ch < DECODED_CHANNELS; ++ch) {
+            m_input[kSourceChannelOrder[ch]][i] = src[ch];
+        }
+        src += DECODED_CHANNELS;
+    }
+}
+
+// The spatial state for this block: the shared one as published, or a local
+// copy of it with the mailbox pose, the predicted pose or the automation
+// applied on top.
+const SpatialState& RenderEngine::acquireState()
+{
+    const SpatialState& shared = m_data->spatial.acquire();
+    const Automation& automation = m_data->automation.acquire();
+    // A new script starts from 0, over a fresh copy of the shared state so
+    // that whatever the old one moved goes back
+    bool restarted = automation.version != m_automationVersion;
+    if (restarted) {
+        m_automationVersion = automation.version;
+        m_automationFrame = 0;
+    }
+    m_automation = &automation;
+    m_automating = automation.trackCount > 0;
+    if (!m_poseMailbox && !m_predicting && m_automationVersion == 0)
+        return shared;
+
+    // The stages cache on the version, so it moves whenever the pose does
+    unsigned int version = (m_localValid ? m_localState.version : shared.version) + 1;
+    bool tracked = !m_localValid || shared.version != m_localSourceVersion || restarted;
+    if (tracked) {
+        m_localState = shared;
+        m_localSourceVersion = shared.version;
+        m_localValid = true;
+    }
+    MailboxPose pose;
+    if (m_poseMailbox && m_poseMailbox->read(pose) && pose.sequence != m_mailboxPose.sequence) {
+        m_mailboxPose = pose;
+        tracked = true;
+    }
+    if (tracked) {
+        if (m_mailboxPose.sequence != 0)
+            setTrackerPose(m_localState, *m_data->layout, m_mailboxPose.x, m_mailboxPose.y,
+                           m_mailboxPose.yaw, m_mailboxPose.captureNs);
+        m_trackedPosition = m_localState.currentListenerPosition;
+        m_trackedYaw = m_localState.listenerYaw;
+    }
+
+    bool moved = tracked;
+    if (m_predicting) {
+        // Only tracker poses are predicted; a pose from the window stops it
+        uint64_t arrivalNs = m_localState.poseArrivalNs;
+        if (arrivalNs == 0)
+            m_predictor.reset();
+        else if (arrivalNs != m_predictor.lastTime())
+            m_predictor.observe(m_trackedPosition, m_trackedYaw, arrivalNs);
+
+        Point position = m_trackedPosition;
+        float yaw = m_trackedYaw;
+        // Fades back to the tracked pose if the tracker goes quiet
+        if (arrivalNs != 0 && m_outputTimeNs != 0)
+            m_predictor.predict(m_outputTimeNs, position, yaw);
+        moved = moved || position.x != m_localState.currentListenerPosition.x ||
+                position.y != m_localState.currentListenerPosition.y || yaw != m_localState.listenerYaw;
+        m_localState.currentListenerPosition = position;
+        m_localState.listenerYaw = yaw;
+    }
+
+    // The script has the last word, over the tracker
+    if (m_automating)
+        moved = applyAutomation(m_automationFrame) || moved;
+
+    if (moved)
+        m_localState.version = version;
+    return m_localState;
+}
+
+bool RenderEngine::applyAutomation(uint64_t frame)
+{
+    const Automation& automation = *m_automation;
+    const double seconds = (double)frame / SAMPLE_RATE;
+    bool moved = false;
+    for (int i = 0; i < automation.trackCount; ++i) {
+        const AutomationTrack& track = automation.tracks[i];
+        float x, y, yaw;
+        evaluateAutomation(automation, track, seconds, x, y, yaw);
+        if (track.target < 0) {
+            Point& listener = m_localState.currentListenerPosition;
+            moved = moved || listener.x != x || listener.y != y || m_localState.listenerYaw != yaw;
+            listener = Point { x, y };
+            m_localState.listenerYaw = yaw;
+        } else if (track.target < m_data->layout->channels) {
+            Point& speaker = m_localState.speakerPositions[track.target];
+            moved = moved || speaker.x != x || speaker.y != y;
+            speaker = Point { x, y };
+        }
+    }
+    return moved;
+}
+
+void RenderEngine::automate(unsigned long frames)
+{
+    if (applyAutomation(m_automationFrame + frames))
+        m_localState.version++;
+    m_automationFrame += frames;
+}
+
+// Convolve the mixed block for headphones. Each speaker is heard from its
+// direction relative to the listener's head; the LFE channel, having no
+// direction, is heard from straight ahead.
+void RenderEngine::binauralize(const SpatialState& state, float* out, unsigned long frames)
+{
+    const float TWO_PI = 2 * M_PI;
+    const int lfe = m_data->layout->lfe;
+
+    for (int r = 0; r < m_outputs; ++r) {
+        float angle = 0.0f;
+        if (r != lfe) {
+            float dx = state.speakerPositions[r].x - state.currentListenerPosition.x;
+            float dy = state.speakerPositions[r].y - state.currentListenerPosition.y;
+            angle = wrapAngle(-wrapAngle(atan2f(dy, dx) - 0.25 * TWO_PI) - state.listenerYaw * TWO_PI);
+        }
+        m_binaural.setSpeakerAngle(r, angle);
+    }
+    m_binaural.process(m_mixed, out, frames);
+}
+
+// Each virtual speaker is a source in the room, as far from the listener as
+// the real speakers are on average, in its direction after the yaw. Its
+// images in the walls arrive later and quieter than it does, from their own
+// directions, which are panned onto the real speakers with VBAP as seen from
+// the listener and scaled by the same distance gains as the direct sound.
+// Sources and listener are kept inside the room, so no image arrives first.
+void RenderEngine::updateReflections(const SpatialState& state)
+{
+    bool moved = !m_reflectionsValid
+              || state.currentListenerPosition.x != m_reflectionListener.x
+              || state.currentListenerPosition.y != m_reflectionListener.y
+              || state.listenerYaw != m_reflectionYaw;
+    for (int r = 0; r < m_outputs && !moved; ++r)
+        moved = state.speakerPositions[r].x != m_reflectionSpeakers[r].x
+             || state.speakerPositions[r].y != m_reflectionSpeakers[r].y;
+    if (!moved)
+        return;
+
+    const float TWO_PI = 2 * M_PI;
+    const int lfe = m_data->layout->lfe;
+    const Point* bounds = m_data->subjectBounds;
+    auto inRoom = [bounds](Point p) {
+        return Point { std::max(bounds[0].x, std::min(bounds[1].x, p.x)),
+                       std::max(bounds[0].y, std::min(bounds[1].y, p.y)) };
+    };
+    Point listener = inRoom(state.currentListenerPosition);
+
+    std::array<float, MAX_CHANNELS> distances =
+        calculateSpeakerDistances(state.currentListenerPosition,
+                                  state.speakerPositions, m_outputs);
+    float distanceGains[MAX_CHANNELS];
+    attenuationGains(state.attenuation, distances.data(), distanceGains, m_outputs);
+
+    // Speaker directions from the listener, clockwise from the front
+    float angles[MAX_CHANNELS];
+    float radius = 0.0f;
+    int ringSpeakers = 0;
+    for (int r = 0; r < m_outputs; ++r) {
+        const Point& p = state.speakerPositions[r];
+        angles[r] = wrapAngle(atan2f(p.x - listener.x, p.y - listener.y));
+        if (r != lfe) {
+            radius += std::hypot(p.x, p.y);
+            ++ringSpeakers;
+        }
+    }
+    radius = ringSpeakers > 0 ? radius / ringSpeakers : 1.0f;
+    vbapSetSpeakers(m_reflectionRing, angles, m_outputs, lfe);
+
+    ReflectionTap taps[2 * (DECODED_CHANNELS - 1) * EARLY_REFLECTION_MAX_IMAGES];
+    int count = 0;
+    for (int v = 0; v < DECODED_CHANNELS; ++v) {
+        if (v == Layout51::lfe)
+            continue;
+        float angle = (Layout51::angles[v] - state.listenerYaw) * TWO_PI;
+        Point source = inRoom(Point { state.currentListenerPosition.x + radius * sinf(angle),
+                                      state.currentListenerPosition.y + radius * cosf(angle) });
+        float direct = std::max(0.1f, std::hypot(source.x - listener.x, source.y - listener.y));
+
+        ImageSource images[EARLY_REFLECTION_MAX_IMAGES];
+        int imageCount = imageSources(bounds, source, m_reflectionOrder, images);
+        for (int i = 0; i < imageCount; ++i) {
+            float dx = images[i].position.x - listener.x;
+            float dy = images[i].position.y - listener.y;
+            float path = std::max(direct, std::hypot(dx, dy));
+            float gain = std::pow(m_wallGain, (float)images[i].reflections) * direct / path;
+            int delay = (int)((path - direct) / SPEED_OF_SOUND * SAMPLE_RATE + 0.5f);
+
+            int speakers[2];
+            float panGains[2];
+            int pairs = vbapPan(m_reflectionRing, wrapAngle(atan2f(dx, dy)), speakers, panGains);
+            for (int k = 0; k < pairs; ++k)
+                taps[count++] = { v, speakers[k], delay, gain * panGains[k] * distanceGains[speakers[k]] };
+        }
+    }
+    m_reflections.setTaps(taps, count, m_reflectionsValid && m_gainRamping);
+
+    m_reflectionListener = state.currentListenerPosition;
+    m_reflectionYaw = state.listenerYaw;
+    std::copy(state.speakerPositions, state.speakerPositions + m_outputs, m_reflectionSpeakers);
+    m_reflectionsValid = true;
+}
+
+void RenderEngine::reflect(const SpatialState& state, unsigned long frames)
+{
+    updateReflections(state);
+    m_reflections.push(m_input, frames);
+    m_reflections.mix(m_mixed, frames, 0, m_outputs);
+}
+
+// Sound from the nearer speakers is held back by its head start on the
+// farthest one, so all arrive together. The first pose is applied at once;
+// after that, delays slew.
+void RenderEngine::updateSpeakerDelays(const SpatialState& state)
+{
+    std::array<float, MAX_CHANNELS> distances =
+        calculateSpeakerDistances(state.currentListenerPosition,
+                                  state.speakerPositions, m_outputs);
+    float farthest = *std::max_element(distances.begin(), distances.begin() + m_outputs);
+    for (int r = 0; r < m_outputs; ++r)
+        m_delays.setDelay(r, (farthest - distances[r]) / SPEED_OF_SOUND * SAMPLE_RATE, !m_delaysValid);
+    m_delaysValid = true;
+}
+
+void RenderEngine::delaySpeakers(const SpatialState& state, unsigned long frames)
+{
+    updateSpeakerDelays(state);
+    m_delays.process(m_mixed, frames, 0, m_outputs);
+}
+
+void RenderEngine::correctRoom(unsigned long frames)
+{
+    m_correction.process(m_mixed, frames);
+}
+
+void RenderEngine::updateVbapGains(const SpatialState& state, bool ramp)
+{
+    const float TWO_PI = 2 * M_PI;
+    const int lfe = m_data->layout->lfe;
+
+    std::array<float, MAX_CHANNELS> distances =
+        calculateSpeakerDistances(state.currentListenerPosition,
+                                  state.speakerPositions, m_outputs);
+
+    // Same speaker angles and distance gains as the Gaussian matrix
+    float realAngles[MAX_CHANNELS];
+    float distanceGains[MAX_CHANNELS];
+    attenuationGains(state.attenuation, distances.data(), distanceGains, m_outputs);
+    for (int r = 0; r < m_outputs; ++r) {
+        const Point& p = state.speakerPositions[r];
+        realAngles[r] = -wrapAngle(atan2f(p.y, p.x) - 0.25 * TWO_PI);
+    }
+    if (lfe >= 0)
+        distanceGains[lfe] = 0.0f;
+    vbapSetSpeakers(m_vbapRing, realAngles, m_outputs, lfe);
+
+    SparseGain* next = m_nextSparseGains;
+    int count = 0;
+    for (int v = 0; v < DECODED_CHANNELS; ++v) {
+        if (v == Layout51::lfe)
+            continue;
+
+        float rotatedAngle = wrapAngle(Layout51::angles[v] * TWO_PI - state.listenerYaw * TWO_PI);
+        int speakers[2];
+        float gains[2];
+        int pairs = vbapPan(m_vbapRing, rotatedAngle, speakers, gains);
+        for (int k = 0; k < pairs; ++k)
+            next[count++] = SparseGain{ v, speakers[k], gains[k] * distanceGains[speakers[k]], 0.0f };
+    }
+
+    if (lfe >= 0) {
+        next[count++] = SparseGain{ Layout51::lfe, lfe, 1.0f, 0.0f };
+    } else {
+        for (int r = 0; r < m_outputs; ++r)
+            next[count++] = SparseGain{ Layout51::lfe, r, 1.0f / m_outputs, 0.0f };
+    }
+
+    // Ramp from whatever each route carried before: routes kept from the old
+    // set start at their old gain, new routes at zero, and dropped routes
+    // fade out from their old gain.
+    for (int k = 0; k < count; ++k) {
+        next[k].prevGain = ramp ? 0.0f : next[k].gain;
+        for (int j = 0; ramp && j < m_sparseCount; ++j) {
+            if (m_sparseGains[j].in == next[k].in && m_sparseGains[j].out == next[k].out) {
+                next[k].prevGain = m_sparseGains[j].gain;
+                break;
+            }
+        }
+    }
+    for (int j = 0; ramp && j < m_sparseCount; ++j) {
+        const SparseGain& old = m_sparseGains[j];
+        if (old.gain == 0.0f)
+            continue;
+        bool kept = false;
+        for (int k = 0; k < count && !kept; ++k)
+            kept = next[k].in == old.in && next[k].out == old.out;
+        if (!kept)
+            next[count++] = SparseGain{ old.in, old.out, 0.0f, old.gain };
+    }
+
+    std::memcpy(m_sparseGains, next, count * sizeof(SparseGain));
+    m_sparseCount = count;
+}
+
+void RenderEngine::updateAmbisonicGains(const SpatialState& state, bool ramp)
+{
+    const float TWO_PI = 2 * M_PI;
+    const int lfe = m_data->layout->lfe;
+    const int harmonics = ambisonicChannels(m_ambiOrder);
+    const int busLfe = kBusChannels - 1;
+
+    bool moved = !m_ambiValid
+        || state.currentListenerPosition.x != m_ambiListener.x
+        || state.currentListenerPosition.y != m_ambiListener.y;
+    for (int r = 0; r < m_outputs && !moved; ++r) {
+        moved = state.speakerPositions[r].x != m_ambiSpeakers[r].x
+             || state.speakerPositions[r].y != m_ambiSpeakers[r].y;
+    }
+    bool turned = !m_ambiValid || state.listenerYaw != m_ambiYaw;
+
+    m_ambiRampEncoder = ramp && m_ambiValid && turned;
+    m_ambiRampDecoder = ramp && m_ambiValid && moved;
+
+    if (turned) {
+        if (m_ambiRampEncoder)
+            std::memcpy(m_ambiPrevEncoder, m_ambiEncoder, sizeof(m_ambiEncoder));
+
+        // Rotate each virtual speaker's coefficients opposite the listener yaw
+        for (int v = 0; v < DECODED_CHANNELS; ++v) {
+            if (v == Layout51::lfe)
+                continue;
+            float coeffs[AMBI_MAX_CHANNELS];
+            ambisonicRotate(m_ambiOrder, state.listenerYaw * TWO_PI, m_ambiSources[v], coeffs);
+            for (int k = 0; k < harmonics; ++k)
+                m_ambiEncoder[k][v] = coeffs[k];
+        }
+        m_ambiYaw = state.listenerYaw;
+    }
+
+    if (moved) {
+        if (m_ambiRampDecoder)
+            std::memcpy(m_ambiPrevDecoder, m_ambiDecoder, m_outputs * sizeof(m_ambiDecoder[0]));
+
+        std::array<float, MAX_CHANNELS> distances =
+            calculateSpeakerDistances(state.currentListenerPosition,
+                                      state.speakerPositions, m_outputs);
+        float distanceGains[MAX_CHANNELS];
+        attenuationGains(state.attenuation, distances.data(), distanceGains, m_outputs);
+        const int ringSpeakers = m_outputs - (lfe >= 0 ? 1 : 0);
+
+        for (int r = 0; r < m_outputs; ++r) {
+            float* row = m_ambiDecoder[r];
+            std::memset(row, 0, sizeof(m_ambiDecoder[r]));
+            if (r == lfe) {
+                row[busLfe] = 1.0f;
+                continue;
+            }
+
+            const Point& p = state.speakerPositions[r];
+            float angle = -wrapAngle(atan2f(p.y, p.x) - 0.25 * TWO_PI);
+            ambisonicDecoderRow(m_ambiOrder, angle, ringSpeakers, row);
+            for (int k = 0; k < harmonics; ++k)
+                row[k] *= distanceGains[r];
+            if (lfe < 0)
+                row[busLfe] = 1.0f / m_outputs;
+        }
+
+        m_ambiListener = state.currentListenerPosition;
+        std::memcpy(m_ambiSpeakers, state.speakerPositions, m_outputs * sizeof(Point));
+    }
+
+    m_ambiValid = true;
+}
+
+// Encode the input block onto the bus, rotated for the listener yaw.
+void RenderEngine::encodeAmbisonicBus(unsigned long frames, bool ramp)
+{
+    const int harmonics = ambisonicChannels(m_ambiOrder);
+
+    // Bus channels past the order in use stay zero, as do their decoder gains.
+    MixParams params;
+    params.in = m_input;
+    params.out = m_bus;
+    params.gains = &m_ambiEncoder[0][0];
+    params.prevGains = ramp && m_ambiRampEncoder ? &m_ambiPrevEncoder[0][0] : nullptr;
+    params.inputs = DECODED_CHANNELS;
+    params.outputs = harmonics;
+    params.lfeIn = Layout51::lfe;
+    params.lfeOut = -1;
+    params.frames = frames;
+    m_mixKernel(params);
+
+    std::memcpy(m_bus[kBusChannels - 1], m_input[Layout51::lfe], frames * sizeof(float));
+}
+
+// Decode the bus onto outputs [begin, end).
+void RenderEngine::decodeAmbisonicBus(unsigned long frames, int begin, int end, bool ramp)
+{
+    MixParams params;
+    params.in = m_bus;
+    params.out = m_mixed + begin;
+    params.gains = &m_ambiDecoder[begin][0];
+    params.prevGains = ramp && m_ambiRampDecoder ? &m_ambiPrevDecoder[begin][0] : nullptr;
+    params.inputs = kBusChannels;
+    params.outputs = end - begin;
+    params.lfeIn = -1;
+    params.lfeOut = -1;
+    params.frames = frames;
+    m_mixKernel(params);
+}
+
+// The layout-specific half of the engine. The source is always the decoded
+// 5.1 bed, whose channels act as virtual speakers at Layout51's angles; the
+// outputs are Layout's real speakers.
+template <typename Layout>
+class LayoutRenderEngine final : public RenderEngine
+{
+public:
+    explicit LayoutRenderEngine(paTestData* data)
+        : RenderEngine(data, Layout::channels)
+    {
+    }
+
+    void render(float* out, unsigned long frames) override;
+    void applyRotation(const SpatialState& state, unsigned long frames) override;
+    void interleave(float* out, unsigned long frames) const override;
+
+private:
+    static constexpr int kOutputs = Layout::channels;
+
+    void updateMixMatrix(const SpatialState& state);
+
+    // Cached [real][virtual] gain matrix, rebuilt when the state version moves.
+    // m_prevGains keeps the matrix it replaced so the next block can ramp.
+    float m_mixGains[kOutputs][DECODED_CHANNELS] = {};
+    float m_prevGains[kOutputs][DECODED_CHANNELS] = {};
+    unsigned int m_mixVersion = 0;
+    bool m_mixValid = false;
+};
+
+// Rebuild the cached virtual-to-real gain matrix from the current listener
+// pose and speaker positions. Gaussian panning weights and distance gains are
+// folded into a single matrix so the per-sample mix is a plain multiply-add.
+template <typename Layout>
+void LayoutRenderEngine<Layout>::updateMixMatrix(const SpatialState& state)
+{
+    const float TWO_PI = 2 * M_PI;
+
+    std::array<float, MAX_CHANNELS> distances =
+        calculateSpeakerDistances(state.currentListenerPosition,
+                                  state.speakerPositions, kOutputs);
+
+    // 1. Compute real speaker angles and distance gains (excluding subwoofer),
+    //    normalised to the loudest reachable gain
+    float realAngles[kOutputs] = {};
+    float distanceGains[kOutputs] = {};
+    attenuationGains(state.attenuation, distances.data(), distanceGains, kOutputs);
+    for (int r = 0; r < kOutputs; ++r) {
+        if (r == Layout::lfe)
+            continue;
+        const Point& p = state.speakerPositions[r];
+        realAngles[r] = -wrapAngle(atan2f(p.y, p.x) - 0.25 * TWO_PI);
+    }
+
+    // 2. Gaussian mixing weights for each virtual speaker, rotated opposite
+    //    the listener yaw, scaled by the distance gain of each real speaker
+    const float sigma = 0.7f;
+    std::memset(m_mixGains, 0, sizeof(m_mixGains));
+
+    for (int v = 0; v < DECODED_CHANNELS; ++v)
+    {
+        if (v == Layout51::lfe)
+            continue;
+
+        float rotatedAngle = wrapAngle(Layout51::angles[v] * TWO_PI - state.listenerYaw * TWO_PI);
+
+        float weights[kOutputs] = {};
+        float sum = 0.0f;
+        for (int r = 0; r < kOutputs; ++r) {
+            if (r == Layout::lfe)
+                continue;
+            float d = wrapAngle(rotatedAngle - realAngles[r]);
+            float w = expf(-(d*d)/(2*sigma*sigma));
+            weights[r] = w;
+            sum += w;
+        }
+
+        for (int r = 0; r < kOutputs; ++r) {
+            m_mixGains[r][v] = weights[r] / sum * distanceGains[r];
+        }
+    }
+
+    // 3. Without a subwoofer the LFE channel is spread evenly over all speakers
+    if (Layout::lfe < 0) {
+        for (int r = 0; r < kOutputs; ++r)
+            m_mixGains[r][Layout51::lfe] = 1.0f / kOutputs;
+    }
+}
+
+// Pan the input block onto the real speakers into the mixed block.
+template <typename Layout>
+void LayoutRenderEngine<Layout>::applyRotation(const SpatialState& state, unsigned long frames)
+{
+    // Only rebuild the matrix when a writer has published a change, and then
+    // ramp from the old matrix to the new one across this block.
+    // A change of panning mode rebuilds without a ramp.
+    PanningMode mode = m_requestedPanning.load(std::memory_order_relaxed);
+    bool ramp = false;
+    if (!m_mixValid || state.version != m_mixVersion || mode != m_panning) {
+        ramp = m_mixValid && m_gainRamping && mode == m_panning;
+        m_panning = mode;
+        if (mode == PanningMode::Vbap) {
+            updateVbapGains(state, ramp);
+        } else if (mode == PanningMode::Ambisonic) {
+            updateAmbisonicGains(state, ramp);
+        } else {
+            if (ramp)
+                std::memcpy(m_prevGains, m_mixGains, sizeof(m_mixGains));
+            updateMixMatrix(state);
+        }
+        m_mixVersion = state.version;
+        m_mixValid = true;
+    }
+
+    if (m_panning == PanningMode::Ambisonic) {
+        encodeAmbisonicBus(frames, ramp);
+        decodeAmbisonicBus(frames, 0, kOutputs, ramp);
+        return;
+    }
+
+    if (m_panning == PanningMode::Vbap) {
+        SparseMixParams params;
+        params.addRoute = m_routeKernel;
+        params.in = m_input;
+        params.out = m_mixed;
+        params.gains = m_sparseGains;
+        params.count = m_sparseCount;
+        params.outBegin = 0;
+        params.outEnd = kOutputs;
+        params.ramp = ramp;
+        params.frames = frames;
+        mixSparse(params);
+        return;
+    }
+
+    // The subwoofer is copied through unpanned inside the same kernel pass.
+    MixParams params;
+    params.in = m_input;
+    params.out = m_mixed;
+    params.gains = &m_mixGains[0][0];
+    params.prevGains = ramp ? &m_prevGains[0][0] : nullptr;
+    params.inputs = DECODED_CHANNELS;
+    params.outputs = kOutputs;
+    params.lfeIn = Layout::lfe >= 0 ? Layout51::lfe : -1;
+    params.lfeOut = Layout::lfe;
+    params.frames = frames;
+    m_mixKernel(params);
+}
+
+// Interleave the mixed block into the device buffer.
+template <typename Layout>
+void LayoutRenderEngine<Layout>::interleave(float* out, unsigned long frames) const
+{
+    for (unsigned long frame = 0; frame < frames; frame++) {
+        for (int ch = 0; ch < kOutputs; ch++) {
+            out[ch] = m_mixed[ch][frame];
+        }
+        out += kOutputs;   // advance to next interleaved frame
+    }
+}
+
+template <typename Layout>
+void LayoutRenderEngine<Layout>::render(float* out, unsigned long frames)
+{
+    if (m_maxFrames == 0) {
+        std::memset(out, 0, frames * outputChannels() * sizeof(float));
+        return;
+    }
+
+    // One coherent snapshot of the listener and speakers per callback (per
+    // sub-block while a script runs); a change is ramped across the next
+    // sub-block.
+    const SpatialState& state = acquireState();
+
+    // A running script is evaluated again for every sub-block
+    const unsigned long limit = m_automating ? m_automationStep : m_maxFrames;
+    while (frames > 0) {
+        unsigned long block = frames < limit ? frames : limit;
+        if (m_automating)
+            automate(block);
+
+        readAudio(block);
+        applyRotation(state, block);
+        if (m_reflecting)
+            reflect(state, block);
+        if (m_delaying)
+            delaySpeakers(state, block);
+        if (m_correcting)
+            correctRoom(block);
+        if (m_hrirs)
+            binauralize(state, out, block);
+        else
+            interleave(out, block);
+
+        out += block * outputChannels();
+        frames -= block;
+    }
+}
+
+// Engine for speaker arrays whose size is only known at run time. The mix
+// matrix and scratch are sized by prepare(); the output channels are split
+// across a MixWorkerPool, each slice mixing and interleaving its own channels.
+class ArrayRenderEngine final : public RenderEngine
+{
+public:
+    explicit ArrayRenderEngine(paTestData* data)
+        : RenderEngine(data, data->layout->channels)
+        , m_lfe(data->layout->lfe)
+    {
+    }
+
+    bool prepare(unsigned long maxFrames) override;
+    void render(float* out, unsigned long frames) override;
+    void applyRotation(const SpatialState& state, unsigned long frames) override;
+    void interleave(float* out, unsigned long frames) const override;
+
+private:
+    // What one pool job works on; `out` is null to mix without interleaving.
+    struct MixJob
+    {
+        ArrayRenderEngine* engine;
+        float* out;
+        unsigned long frames;
+        bool ramp;
+    };
+
+    static void mixSlice(void* context, int slice, int slices);
+    void mixDense(const MixJob& job, int begin, int end);
+    bool updateGains(const SpatialState& state);
+    void updateMixMatrix(const SpatialState& state);
+    void interleaveRange(float* out, unsigned long frames, int begin, int end) const;
+
+    int m_lfe;
+    std::vector<float> m_mixGains;   // [real][virtual]
+    std::vector<float> m_prevGains;
+    std::vector<float> m_realAngles;
+    std::vector<float> m_distanceGains;
+    std::vector<float> m_weights;
+    unsigned int m_mixVersion = 0;
+    bool m_mixValid = false;
+
+    MixWorkerPool m_pool;
+};
+
+bool ArrayRenderEngine::prepare(unsigned long maxFrames)
+{
+    if (!RenderEngine::prepare(maxFrames))
+        return false;
+
+    m_mixGains.assign(m_outputs * DECODED_CHANNELS, 0.0f);
+    m_prevGains.assign(m_outputs * DECODED_CHANNELS, 0.0f);
+    m_realAngles.assign(m_outputs, 0.0f);
+    m_distanceGains.assign(m_outputs, 0.0f);
+    m_weights.assign(m_outputs, 0.0f);
+    m_mixValid = false;
+
+    // A few threads once there are enough channels to amortise the wake-up
+    int threads = m_mixThreads;
+    if (threads < 0) {
+        int spare = (int)std::thread::hardware_concurrency() - 1;
+        threads = m_outputs >= 32 ? std::max(0, std::min(3, spare)) : 0;
+    }
+    return m_pool.start(threads);
+}
+
+// Rebuild the gains for the current panning mode if the state or the mode
+// changed. Returns true if this block should ramp from the previous gains.
+bool ArrayRenderEngine::updateGains(const SpatialState& state)
+{
+    PanningMode mode = m_requestedPanning.load(std::memory_order_relaxed);
+    if (m_mixValid && state.version == m_mixVersion && mode == m_panning)
+        return false;
+
+    bool ramp = m_mixValid && m_gainRamping && mode == m_panning;
+    m_panning = mode;
+    if (mode == PanningMode::Vbap) {
+        updateVbapGains(state, ramp);
+    } else if (mode == PanningMode::Ambisonic) {
+        updateAmbisonicGains(state, ramp);
+    } else {
+        if (ramp)
+            std::copy(m_mixGains.begin(), m_mixGains.end(), m_prevGains.begin());
+        updateMixMatrix(state);
+    }
+
+    m_mixVersion = state.version;
+    m_mixValid = true;
+    return ramp;
+}
+
+// Same panning as LayoutRenderEngine::updateMixMatrix, with runtime sizes.
+void ArrayRenderEngine::updateMixMatrix(const SpatialState& state)
+{
+    const float TWO_PI = 2 * M_PI;
+    std::array<float, MAX_CHANNELS> distances =
+        calculateSpeakerDistances(state.currentListenerPosition,
+                                  state.speakerPositions, m_outputs);
+
+    attenuationGains(state.attenuation, distances.data(), m_distanceGains.data(), m_outputs);
+    for (int r = 0; r < m_outputs; ++r) {
+        if (r == m_lfe)
+            continue;
+        const Point& p = state.speakerPositions[r];
+        m_realAngles[r] = -wrapAngle(atan2f(p.y, p.x) - 0.25 * TWO_PI);
+    }
+
+    const float sigma = 0.7f;
+    std::fill(m_mixGains.begin(), m_mixGains.end(), 0.0f);
+
+    for (int v = 0; v < DECODED_CHANNELS; ++v) {
+        if (v == Layout51::lfe)
+            continue;
+
+        float rotatedAngle = wrapAngle(Layout51::angles[v] * TWO_PI - state.listenerYaw * TWO_PI);
+
+        float sum = 0.0f;
+        for (int r = 0; r < m_outputs; ++r) {
+            float w = 0.0f;
+            if (r != m_lfe) {
+                float d = wrapAngle(rotatedAngle - m_realAngles[r]);
+                w = expf(-(d*d)/(2*sigma*sigma));
+            }
+            m_weights[r] = w;
+            sum += w;
+        }
+
+        for (int r = 0; r < m_outputs; ++r)
+            m_mixGains[r * DECODED_CHANNELS + v] = m_weights[r] / sum * m_distanceGains[r];
+    }
+
+    if (m_lfe < 0) {
+        for (int r = 0; r < m_outputs; ++r)
+            m_mixGains[r * DECODED_CHANNELS + Layout51::lfe] = 1.0f / m_outputs;
+    }
+}
+
+// Mix (and optionally interleave) one contiguous range of output channels.
+void ArrayRenderEngine::mixSlice(void* context, int slice, int slices)
+{
+    const MixJob& job = *static_cast<const MixJob*>(context);
+    ArrayRenderEngine& engine = *job.engine;
+
+    int begin = engine.m_outputs * slice / slices;
+    int end = engine.m_outputs * (slice + 1) / slices;
+    if (begin == end)
+        return;
+
+    if (engine.m_panning == PanningMode::Vbap) {
+        SparseMixParams params;
+        params.addRoute = engine.m_routeKernel;
+        params.in = engine.m_input;
+        params.out = engine.m_mixed;
+        params.gains = engine.m_sparseGains;
+        params.count = engine.m_sparseCount;
+        params.outBegin = begin;
+        params.outEnd = end;
+        params.ramp = job.ramp;
+        params.frames = job.frames;
+        mixSparse(params);
+    } else if (engine.m_panning == PanningMode::Ambisonic) {
+        engine.decodeAmbisonicBus(job.frames, begin, end, job.ramp);
+    } else {
+        engine.mixDense(job, begin, end);
+    }
+
+    if (engine.m_reflecting)
+        engine.m_reflections.mix(engine.m_mixed, job.frames, begin, end);
+    if (engine.m_delaying)
+        engine.m_delays.process(engine.m_mixed, job.frames, begin, end);
+    if (job.out)
+        engine.interleaveRange(job.out, job.frames, begin, end);
+}
+
+void ArrayRenderEngine::mixDense(const MixJob& job, int begin, int end)
+{
+    bool hasLfe = m_lfe >= begin && m_lfe < end;
+
+    MixParams params;
+    params.in = m_input;
+    params.out = m_mixed + begin;
+    params.gains = m_mixGains.data() + begin * DECODED_CHANNELS;
+    params.prevGains = job.ramp ? m_prevGains.data() + begin * DECODED_CHANNELS : nullptr;
+    params.inputs = DECODED_CHANNELS;
+    params.outputs = end - begin;
+    params.lfeIn = hasLfe ? Layout51::lfe : -1;
+    params.lfeOut = hasLfe ? m_lfe - begin : -1;
+    params.frames = job.frames;
+    m_mixKernel(params);
+}
+
+void ArrayRenderEngine::applyRotation(const SpatialState& state, unsigned long frames)
+{
+    MixJob job = { this, nullptr, frames, updateGains(state) };
+    // The bus is shared by every slice, so it is encoded before they start.
+    if (m_panning == PanningMode::Ambisonic)
+        encodeAmbisonicBus(frames, job.ramp);
+    m_pool.run(mixSlice, &job);
+}
+
+void ArrayRenderEngine::interleaveRange(float* out, unsigned long frames, int begin, int end) const
+{
+    for (unsigned long frame = 0; frame < frames; frame++) {
+        for (int ch = begin; ch < end; ch++) {
+            out[ch] = m_mixed[ch][frame];
+        }
+        out += m_outputs;
+    }
+}
+
+void ArrayRenderEngine::interleave(float* out, unsigned long frames) const
+{
+    interleaveRange(out, frames, 0, m_outputs);
+}
+
+void ArrayRenderEngine::render(float* out, unsigned long frames)
+{
+    if (m_maxFrames == 0) {
+        std::memset(out, 0, frames * outputChannels() * sizeof(float));
+        return;
+    }
+
+    const SpatialState& state = acquireState();
+
+    // A running script is evaluated again for every sub-block
+    const unsigned long limit = m_automating ? m_automationStep : m_maxFrames;
+    while (frames > 0) {
+        unsigned long block = frames < limit ? frames : limit;
+        if (m_automating)
+            automate(block);
+
+        readAudio(block);
+        // Each slice interleaves its own channels, so there is no second
+        // pass; room correction and binaural output run after the whole mix,
+        // then interleave themselves.
+        bool afterMix = m_hrirs || m_correcting;
+        MixJob job = { this, afterMix ? nullptr : out, block, updateGains(state) };
+        if (m_reflecting) {
+            updateReflections(state);
+            m_reflections.push(m_input, block);
+        }
+        if (m_delaying)
+            updateSpeakerDelays(state);
+        if (m_panning == PanningMode::Ambisonic)
+            encodeAmbisonicBus(block, job.ramp);
+        m_pool.run(mixSlice, &job);
+        if (m_correcting) {
+            correctRoom(block);
+            interleave(out, block);
+        } else if (m_hrirs) {
+            binauralize(state, out, block);
+        }
+
+        out += block * outputChannels();
+        frames -= block;
+    }
+}
+
+std::unique_ptr<RenderEngine> createRenderEngine(paTestData* data)
+{
+    switch (data->layout->id) {
+        case SpeakerLayoutId::Stereo:      return std::unique_ptr<RenderEngine>(new LayoutRenderEngine<Layout20>(data));
+        case SpeakerLayoutId::Surround51:  return std::unique_ptr<RenderEngine>(new LayoutRenderEngine<Layout51>(data));
+        case SpeakerLayoutId::Surround71:  return std::unique_ptr<RenderEngine>(new LayoutRenderEngine<Layout71>(data));
+        case SpeakerLayoutId::Surround714: return std::unique_ptr<RenderEngine>(new LayoutRenderEngine<Layout714>(data));
+        case SpeakerLayoutId::Custom:      return std::unique_ptr<RenderEngine>(new ArrayRenderEngine(data));
+        default: return nullptr;
+    }
+}
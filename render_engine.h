@@ -0,0 +1,297 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include "ambisonics.h"
+#include "audio_file.h"
+#include "binaural.h"
+#include "early_reflections.h"
+#include "mix_kernels.h"
+#include "pose_mailbox.h"
+#include "pose_predictor.h"
+#include "room_correction.h"
+#include "speaker_delay.h"
+#include "utils.h"
+#include "vbap.h"
+
+// Byte alignment of every planar channel buffer (wide enough for AVX-512).
+#define RENDER_ALIGNMENT    (64)
+
+// Sub-block size the audio callback renders in, whatever the host's buffer size.
+#define RENDER_BLOCK_FRAMES (256)
+
+// How the virtual 5.1 speakers are panned onto the real ones.
+enum class PanningMode
+{
+    Gaussian = 0,   // every virtual speaker feeds every real one, by angular distance
+    Vbap,           // pairwise VBAP: at most two real speakers per virtual one
+    Ambisonic,      // encode to a horizontal B-format bus, rotate it, decode it
+    Count
+};
+
+const char* panningModeName(PanningMode mode);   // "gaussian", "vbap", "ambisonic"
+bool findPanningMode(const char* name, PanningMode& mode);
+
+// Owns the real-time render path for one stream: pans the decoded 5.1 bed
+// onto the speakers of data->layout.
+//
+// The layout-specific stages are implemented once per layout type (see
+// speaker_layout.h) so their channel loops have compile-time trip counts;
+// createRenderEngine() picks the instantiation for data->layout.
+//
+// All scratch memory is allocated by prepare(), before the stream is opened,
+// so render() can run on the audio thread without touching the heap.
+class RenderEngine
+{
+public:
+    virtual ~RenderEngine();
+
+    RenderEngine(const RenderEngine&) = delete;
+    RenderEngine& operator=(const RenderEngine&) = delete;
+
+    // Allocate planar scratch buffers for sub-blocks of up to maxFrames frames,
+    // and start mix worker threads if the engine uses them.
+    virtual bool prepare(unsigned long maxFrames);
+
+    // Worker threads that share the mix with the audio thread, for large
+    // speaker arrays; -1 (the default) picks a count from the layout size.
+    // Takes effect at the next prepare(). Only runtime-sized layouts use them.
+    void setMixThreads(int threads) { m_mixThreads = threads; }
+
+    // Ramp gains per sample after a pose change (default on), across the
+    // first sub-block of the callback: at most maxFrames() frames, however
+    // large the host buffer. With ramping off, pose changes step the gains
+    // at the block boundary.
+    void setGainRamping(bool enabled) { m_gainRamping = enabled; }
+
+    // Switch panning mode; safe to call from another thread while rendering.
+    // Takes effect at the next block, without a ramp.
+    void setPanningMode(PanningMode mode) { m_requestedPanning.store(mode, std::memory_order_relaxed); }
+    PanningMode panningMode() const { return m_requestedPanning.load(std::memory_order_relaxed); }
+
+    // Order (1 to AMBI_MAX_ORDER) of the bus used by PanningMode::Ambisonic;
+    // -1 (the default) picks the highest order the speaker count supports.
+    // Takes effect at the next prepare().
+    void setAmbisonicOrder(int order) { m_ambiRequestedOrder = order; }
+    int ambisonicOrder() const { return m_ambiOrder; }
+
+    // Render to headphones instead of the speakers: each speaker feed is
+    // convolved with the HRIRs for its direction from the listener's head
+    // and the output becomes stereo, BINAURAL_PARTITION_FRAMES later.
+    // nullptr (the default) renders to the speakers. The set must outlive
+    // the engine. Takes effect at the next prepare().
+    void setBinauralOutput(const HrirSet* hrirs) { m_hrirs = hrirs; }
+
+    // Add first- to `order`-order reflections of each virtual speaker off the
+    // walls of the room (data->subjectBounds), each wall keeping wallGain of
+    // the sound. 0 (the default) plays the direct sound only. Takes effect
+    // at the next prepare().
+    void setEarlyReflections(int order, float wallGain = 0.7f)
+    {
+        m_reflectionOrder = std::max(0, std::min(EARLY_REFLECTION_MAX_ORDER, order));
+        m_wallGain = wallGain;
+    }
+    int reflectionTaps() const { return m_reflections.taps(); }
+
+    // Delay each speaker feed so that every speaker's sound reaches the
+    // listener at the same time as the farthest one's, following the
+    // listener as they move (see SpeakerDelays). Off by default, and
+    // ignored with binaural output. Takes effect at the next prepare().
+    void setDistanceDelays(bool enabled) { m_distanceDelays = enabled; }
+
+    // Convolve each speaker feed with its room-correction filter after the
+    // mix, without adding latency (see RoomCorrection). With backgroundTail
+    // off, the whole filter is convolved on the rendering thread, for
+    // rendering faster than real time. nullptr (the default) leaves the
+    // feeds alone, as does binaural output. The filters must outlive the
+    // engine. Takes effect at the next prepare().
+    void setRoomCorrection(const CorrectionFilters* filters, bool backgroundTail = true)
+    {
+        m_correctionFilters = filters;
+        m_correctionBackground = backgroundTail;
+    }
+    // Correction tail partitions dropped because the worker fell behind.
+    unsigned long correctionMisses() const { return m_correction.tailMisses(); }
+
+    // Take the listener's pose from a shared-memory mailbox (see
+    // pose_mailbox.h), read once per callback without a system call, in
+    // place of the one in data->spatial; the rest of the state still comes
+    // from data->spatial. Until the tracker's first pose the listener stays
+    // where data->spatial has it. nullptr (the default) turns it off. The
+    // mailbox must outlive the engine. Set before prepare().
+    void setPoseMailbox(const PoseMailboxReader* mailbox) { m_poseMailbox = mailbox; }
+
+    // Render each callback for the pose the listener will have when it is
+    // heard rather than the last one tracked: tracker poses (those with a
+    // poseArrivalNs) are extrapolated to the output time from the
+    // listener's measured velocity, capped and damped (see PosePredictor).
+    // Off by default. Takes effect at the next prepare().
+    void setPosePrediction(bool enabled) { m_posePrediction = enabled; }
+    // When the first frame of the next render() reaches the DAC, on
+    // poseClockNs(). Set before each render() when predicting; until it is
+    // set, poses are used as tracked.
+    void setOutputTime(uint64_t dacNs) { m_outputTimeNs = dacNs; }
+
+    // Frames of audio between evaluations of the script published with
+    // setAutomation() (see automation.h), while one is running. Sub-blocks
+    // are cut to this length, the script is evaluated for the end of each,
+    // and the gains ramp onto it sample by sample across the sub-block; so
+    // they follow the script through points this far apart, whatever size
+    // of buffer the host asks for. The script's clock counts frames
+    // rendered. Takes effect at the next prepare(); maxFrames() at most.
+    void setAutomationStep(unsigned long frames) { m_automationStepRequest = frames; }
+    unsigned long automationStep() const { return m_automationStep; }
+
+    // Render `frames` interleaved outputChannels()-channel frames into out.
+    // Any frame count is accepted and it may change from call to call; the
+    // work is split into sub-blocks of at most maxFrames() frames, each
+    // starting at the top of the aligned scratch buffers.
+    // Real-time safe: no allocation, no locks.
+    virtual void render(float* out, unsigned long frames) = 0;
+
+    paTestData* data() const { return m_data; }
+    unsigned long maxFrames() const { return m_maxFrames; }
+    int outputChannels() const { return m_hrirs ? 2 : m_outputs; }
+
+    // The stages render() runs, in order. Public so bench/bench_stages.cpp can
+    // time each one on its own; frames must not exceed maxFrames().
+    // First the state the callback renders from: data->spatial's newest,
+    // with the mailbox pose applied, then predicted, then the running
+    // script's tracks. Takes the audio thread's side of data->spatial and
+    // data->automation, so call it only where render() would be called.
+    const SpatialState& acquireState();
+    void readAudio(unsigned long frames);
+    virtual void applyRotation(const SpatialState& state, unsigned long frames) = 0;
+    virtual void interleave(float* out, unsigned long frames) const = 0;
+    // Replaces interleave() when rendering binaurally.
+    void binauralize(const SpatialState& state, float* out, unsigned long frames);
+    // After applyRotation(), with early reflections on.
+    void reflect(const SpatialState& state, unsigned long frames);
+    // Between applyRotation() and interleave(), with distance delays on.
+    void delaySpeakers(const SpatialState& state, unsigned long frames);
+    // After that, when correcting the room.
+    void correctRoom(unsigned long frames);
+
+protected:
+    RenderEngine(paTestData* data, int outputs);
+
+    paTestData* m_data = nullptr;
+    int m_outputs = 0;
+    unsigned long m_maxFrames = 0;
+
+    float* m_storage = nullptr;             // single aligned allocation backing all blocks
+    float* m_input[DECODED_CHANNELS] = {};  // deinterleaved source block, in 5.1 layout order
+    float* m_mixed[MAX_CHANNELS] = {};      // panned block, ready to interleave
+    float* m_streamScratch = nullptr;       // interleaved block read from data->stream
+
+    // Mix kernels picked once at construction from the CPU's feature set.
+    MixKernel m_mixKernel = nullptr;
+    RouteKernel m_routeKernel = nullptr;    // for mixSparse()
+    bool m_gainRamping = true;
+    int m_mixThreads = -1;
+
+    // Rebuild m_sparseGains as VBAP routes for `state`. With ramp set, routes
+    // that are dropped or added fade from or to zero across the next block.
+    void updateVbapGains(const SpatialState& state, bool ramp);
+
+    std::atomic<PanningMode> m_requestedPanning{PanningMode::Gaussian};
+    PanningMode m_panning = PanningMode::Gaussian;   // mode the cached gains are for
+
+    // Two routes per virtual speaker plus the LFE routing, twice over while a
+    // change is ramping (old and new routes).
+    static constexpr int kMaxSparseGains = 2 * (2 * DECODED_CHANNELS + MAX_CHANNELS);
+    SparseGain m_sparseGains[kMaxSparseGains];
+    SparseGain m_nextSparseGains[kMaxSparseGains];
+    int m_sparseCount = 0;
+    VbapRing m_vbapRing;
+
+    // Ambisonic mode. The bus has one extra channel after the harmonics that
+    // carries the LFE input through to the decoder. A yaw change only rotates
+    // the encoder (O(order)); the decoder is rebuilt when the speakers or the
+    // listener position move. Each stage ramps separately.
+    void updateAmbisonicGains(const SpatialState& state, bool ramp);
+    // `ramp` is the block's ramp flag: only the first block after a change ramps.
+    void encodeAmbisonicBus(unsigned long frames, bool ramp);
+    void decodeAmbisonicBus(unsigned long frames, int begin, int end, bool ramp);
+
+    static constexpr int kBusChannels = AMBI_MAX_CHANNELS + 1;
+    int m_ambiRequestedOrder = -1;
+    int m_ambiOrder = 1;
+    float* m_bus[kBusChannels] = {};
+    float m_ambiSources[DECODED_CHANNELS][AMBI_MAX_CHANNELS] = {};   // unrotated encoding
+    float m_ambiEncoder[kBusChannels][DECODED_CHANNELS] = {};        // [bus][input], rotated
+    float m_ambiPrevEncoder[kBusChannels][DECODED_CHANNELS] = {};
+    float m_ambiDecoder[MAX_CHANNELS][kBusChannels] = {};            // [output][bus]
+    float m_ambiPrevDecoder[MAX_CHANNELS][kBusChannels] = {};
+    float m_ambiYaw = 0.0f;
+    Point m_ambiListener = {};
+    Point m_ambiSpeakers[MAX_CHANNELS] = {};
+    bool m_ambiValid = false;
+    bool m_ambiRampEncoder = false;
+    bool m_ambiRampDecoder = false;
+
+    const HrirSet* m_hrirs = nullptr;
+    BinauralRenderer m_binaural;
+
+    // Rebuild the reflection taps if the listener or the speakers moved.
+    void updateReflections(const SpatialState& state);
+
+    int m_reflectionOrder = 0;
+    float m_wallGain = 0.7f;
+    bool m_reflecting = false;
+    bool m_reflectionsValid = false;
+    Point m_reflectionListener = {};
+    float m_reflectionYaw = 0.0f;
+    Point m_reflectionSpeakers[MAX_CHANNELS] = {};
+    VbapRing m_reflectionRing;
+    EarlyReflections m_reflections;
+
+    // Set each speaker's delay target from its distance to the listener.
+    void updateSpeakerDelays(const SpatialState& state);
+
+    bool m_distanceDelays = false;
+    bool m_delaying = false;
+    bool m_delaysValid = false;
+    SpeakerDelays m_delays;
+
+    // The state acquireState() returns when it changes the pose: the
+    // newest from data->spatial, copied only when another thread publishes.
+    SpatialState m_localState = {};
+    unsigned int m_localSourceVersion = 0;
+    bool m_localValid = false;
+    Point m_trackedPosition = {};           // the pose before prediction
+    float m_trackedYaw = 0.0f;
+
+    const PoseMailboxReader* m_poseMailbox = nullptr;
+    MailboxPose m_mailboxPose = {};         // sequence 0 until the tracker's first pose
+
+    bool m_posePrediction = false;
+    bool m_predicting = false;
+    uint64_t m_outputTimeNs = 0;
+    PosePredictor m_predictor;
+
+    // Set the automated tracks of m_localState to where the script has
+    // them `frame` frames in; true if any of them moved.
+    bool applyAutomation(uint64_t frame);
+    // Before rendering a sub-block of `frames`: evaluate the script for its
+    // end, so the stages ramp onto that across it, and move the clock on.
+    void automate(unsigned long frames);
+
+    const Automation* m_automation = nullptr;   // valid until the next acquireState()
+    unsigned int m_automationVersion = 0;       // 0 until a script is published
+    uint64_t m_automationFrame = 0;             // frames rendered since the script started
+    unsigned long m_automationStepRequest = AUTOMATION_STEP_FRAMES;
+    unsigned long m_automationStep = 0;
+    bool m_automating = false;                  // the script has tracks
+
+    const CorrectionFilters* m_correctionFilters = nullptr;
+    bool m_correctionBackground = true;
+    bool m_correcting = false;
+    RoomCorrection m_correction;
+};
+
+// A render engine for data->layout, which must already be set: a
+// compile-time instantiation for the built-in layouts, a runtime-sized one
+// for speaker arrays loaded from a file.
+std::unique_ptr<RenderEngine> createRenderEngine(paTestData* data);
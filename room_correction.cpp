@@ -0,0 +1,459 @@
+#include "room_correction.h"
+#include "utils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sndfile.h>
+#include <string>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const int kHead = CORRECTION_HEAD_FRAMES;
+static const int kTail = CORRECTION_TAIL_FRAMES;
+// The callback convolves taps up to here, so a tail partition has one whole
+// partition of time between its input completing and its output playing.
+static const int kTailStart = 2 * kTail;
+
+static_assert(kTail % kHead == 0, "tail partitions must be whole head partitions");
+
+// As in binaural.cpp: decaying filter tails reach the denormal range, where
+// every multiply by them is many times slower.
+static float flushDenormal(float x)
+{
+    return std::fabs(x) < 1e-20f ? 0.0f : x;
+}
+
+// y[i] += h * x[i]. The direct-form head spends most of its time here.
+static void multiplyAdd(float* y, const float* x, float h, unsigned long n)
+{
+    unsigned long i = 0;
+#ifdef __SSE2__
+    const __m128 gain = _mm_set1_ps(h);
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(gain, _mm_loadu_ps(x + i))));
+#endif
+    for (; i < n; ++i)
+        y[i] += h * x[i];
+}
+
+// re + j im += (aRe + j aIm) * (gRe + j gIm), bin by bin; bins is a
+// multiple of 4.
+static void complexMultiplyAdd(float* re, float* im, const float* aRe, const float* aIm,
+                               const float* gRe, const float* gIm, int bins)
+{
+    int k = 0;
+#ifdef __SSE2__
+    for (; k < bins; k += 4) {
+        __m128 ar = _mm_loadu_ps(aRe + k), ai = _mm_loadu_ps(aIm + k);
+        __m128 gr = _mm_loadu_ps(gRe + k), gi = _mm_loadu_ps(gIm + k);
+        _mm_storeu_ps(re + k, _mm_add_ps(_mm_loadu_ps(re + k),
+                                         _mm_sub_ps(_mm_mul_ps(ar, gr), _mm_mul_ps(ai, gi))));
+        _mm_storeu_ps(im + k, _mm_add_ps(_mm_loadu_ps(im + k),
+                                         _mm_add_ps(_mm_mul_ps(ar, gi), _mm_mul_ps(ai, gr))));
+    }
+#endif
+    for (; k < bins; ++k) {
+        re[k] += aRe[k] * gRe[k] - aIm[k] * gIm[k];
+        im[k] += aRe[k] * gIm[k] + aIm[k] * gRe[k];
+    }
+}
+
+static bool readMonoWav(const std::string& path, std::vector<float>& taps)
+{
+    SF_INFO info = {};
+    SNDFILE* file = sf_open(path.c_str(), SFM_READ, &info);
+    if (!file) {
+        std::fprintf(stderr, "Could not open %s: %s\n", path.c_str(), sf_strerror(nullptr));
+        return false;
+    }
+    if (info.channels != 1 || info.samplerate != SAMPLE_RATE) {
+        std::fprintf(stderr, "%s: expected a mono %d Hz filter, got %d channels at %d Hz\n",
+                     path.c_str(), SAMPLE_RATE, info.channels, info.samplerate);
+        sf_close(file);
+        return false;
+    }
+
+    taps.resize(info.frames);
+    sf_count_t read = sf_readf_float(file, taps.data(), info.frames);
+    sf_close(file);
+    taps.resize(read);
+    return true;
+}
+
+bool CorrectionFilters::load(const char* listPath, const SpeakerLayout& layout)
+{
+    FILE* list = std::fopen(listPath, "r");
+    if (!list) {
+        std::fprintf(stderr, "Could not open correction filter list %s\n", listPath);
+        return false;
+    }
+
+    std::string dir(listPath);
+    size_t slash = dir.find_last_of('/');
+    dir = slash == std::string::npos ? std::string() : dir.substr(0, slash + 1);
+
+    reset(layout.channels);
+
+    char line[512];
+    int lineNumber = 0;
+    bool ok = true;
+    while (ok && std::fgets(line, sizeof(line), list)) {
+        ++lineNumber;
+        if (char* comment = std::strchr(line, '#'))
+            *comment = '\0';
+
+        char name[64];
+        char file[400];
+        int fields = std::sscanf(line, " %63s %399s", name, file);
+        if (fields <= 0)
+            continue;
+        if (fields != 2) {
+            std::fprintf(stderr, "%s:%d: expected <channel> <file.wav>\n", listPath, lineNumber);
+            ok = false;
+            break;
+        }
+
+        int channel = findSpeakerChannel(layout, name);
+        if (channel < 0) {
+            std::fprintf(stderr, "%s:%d: no channel %s in the %s layout\n",
+                         listPath, lineNumber, name, layout.name);
+            ok = false;
+            break;
+        }
+
+        std::string path = file[0] == '/' ? std::string(file) : dir + file;
+        ok = readMonoWav(path, m_taps[channel]);
+    }
+    std::fclose(list);
+
+    if (ok && empty()) {
+        std::fprintf(stderr, "%s: no filters\n", listPath);
+        ok = false;
+    }
+    if (!ok)
+        m_taps.clear();
+    return ok;
+}
+
+void CorrectionFilters::reset(int channels)
+{
+    m_taps.assign(channels, std::vector<float>());
+}
+
+void CorrectionFilters::setFilter(int channel, const float* taps, int count)
+{
+    m_taps[channel].assign(taps, taps + count);
+}
+
+bool CorrectionFilters::empty() const
+{
+    for (const std::vector<float>& taps : m_taps) {
+        if (!taps.empty())
+            return false;
+    }
+    return true;
+}
+
+RoomCorrection::~RoomCorrection()
+{
+    stop();
+}
+
+void RoomCorrection::stop()
+{
+    if (!m_worker.joinable())
+        return;
+    m_running.store(false);
+    m_wake.post();
+    m_worker.join();
+}
+
+// Transform `partitions` partitions of fft.size() / 2 taps from `begin` on,
+// each zero-padded to fft.size().
+static void transformPartitions(const FftPlan& fft, const std::vector<float>& taps,
+                                int begin, int partitions, std::vector<float>& re,
+                                std::vector<float>& im)
+{
+    const int bins = fft.size();
+    const int length = bins / 2;
+    re.assign((size_t)partitions * bins, 0.0f);
+    im.assign((size_t)partitions * bins, 0.0f);
+    for (int p = 0; p < partitions; ++p) {
+        float* pRe = &re[(size_t)p * bins];
+        float* pIm = &im[(size_t)p * bins];
+        int first = begin + p * length;
+        int count = std::min(length, (int)taps.size() - first);
+        if (count > 0)
+            std::copy(taps.begin() + first, taps.begin() + first + count, pRe);
+        fft.forward(pRe, pIm);
+        for (int k = 0; k < bins; ++k) {
+            pRe[k] = flushDenormal(pRe[k]);
+            pIm[k] = flushDenormal(pIm[k]);
+        }
+    }
+}
+
+bool RoomCorrection::prepare(const CorrectionFilters& filters, int channels, bool backgroundTail)
+{
+    stop();
+    if (filters.channels() != channels || filters.empty())
+        return false;
+    if (!m_bodyFft.init(2 * kHead) || !m_tailFft.init(2 * kTail))
+        return false;
+
+    // Every filtered channel shares the partition counts of the longest
+    // filter, so they all step through their delay lines together.
+    int longest = 0;
+    for (int ch = 0; ch < channels; ++ch)
+        longest = std::max(longest, (int)filters.filter(ch).size());
+    int bodyTaps = std::max(0, std::min(longest, kTailStart) - kHead);
+    int tailTaps = std::max(0, longest - kTailStart);
+    m_bodyPartitions = (bodyTaps + kHead - 1) / kHead;
+    m_tailPartitions = (tailTaps + kTail - 1) / kTail;
+
+    m_channels.clear();
+    for (int ch = 0; ch < channels; ++ch) {
+        const std::vector<float>& taps = filters.filter(ch);
+        if (taps.empty())
+            continue;
+
+        Channel c;
+        c.output = ch;
+        c.headTaps = std::min(kHead, (int)taps.size());
+        c.head.assign(taps.begin(), taps.begin() + c.headTaps);
+        c.input.assign(2 * kHead, 0.0f);
+        c.bodyOutput.assign(kHead, 0.0f);
+        transformPartitions(m_bodyFft, taps, kHead, m_bodyPartitions, c.bodyRe, c.bodyIm);
+        c.bodyLineRe.assign(c.bodyRe.size(), 0.0f);
+        c.bodyLineIm.assign(c.bodyIm.size(), 0.0f);
+        transformPartitions(m_tailFft, taps, kTailStart, m_tailPartitions, c.tailRe, c.tailIm);
+        c.tailLineRe.assign(c.tailRe.size(), 0.0f);
+        c.tailLineIm.assign(c.tailIm.size(), 0.0f);
+        c.tailInput.assign(m_tailPartitions > 0 ? 2 * kTail : 0, 0.0f);
+        m_channels.push_back(std::move(c));
+    }
+
+    m_re.assign(2 * kHead, 0.0f);
+    m_im.assign(2 * kHead, 0.0f);
+    m_tailScratchRe.assign(2 * kTail, 0.0f);
+    m_tailScratchIm.assign(2 * kTail, 0.0f);
+    m_bodyNewest = 0;
+    m_tailNewest = 0;
+    m_fill = 0;
+    m_tailFill = 0;
+
+    const size_t ringSize = m_tailPartitions > 0 ? (size_t)kTailSlots * m_channels.size() * kTail : 0;
+    m_tailIn.assign(ringSize, 0.0f);
+    m_tailOut.assign(ringSize, 0.0f);
+    for (int s = 0; s < kTailSlots; ++s) {
+        m_tailInTag[s].store(-1);
+        m_tailOutTag[s].store(-1);
+    }
+    m_tailPushed.store(0);
+    m_tailTaken.store(0);
+    m_tailMisses.store(0);
+    m_tailIndex = 0;
+    m_tailNext = 0;
+    m_tailWritable = false;
+    m_tailPlaying = nullptr;
+
+    m_background = backgroundTail && m_tailPartitions > 0;
+    if (m_background) {
+        m_running.store(true);
+        m_worker = std::thread(&RoomCorrection::workerLoop, this);
+    }
+    return true;
+}
+
+float* RoomCorrection::tailSlot(std::vector<float>& ring, long index, int channel)
+{
+    size_t slot = (size_t)(index % kTailSlots);
+    return &ring[(slot * m_channels.size() + channel) * kTail];
+}
+
+void RoomCorrection::process(float* const* channels, unsigned long frames)
+{
+    unsigned long done = 0;
+    while (done < frames) {
+        // Head partitions tile tail partitions, so stopping at the end of
+        // one also stops at the end of the other.
+        unsigned long n = std::min(frames - done, kHead - m_fill);
+        if (m_tailPartitions > 0 && m_tailFill == 0)
+            beginTailPartition();
+
+        for (size_t c = 0; c < m_channels.size(); ++c) {
+            Channel& channel = m_channels[c];
+            float* x = channels[channel.output] + done;
+            float* in = &channel.input[kHead + m_fill];
+            std::memcpy(in, x, n * sizeof(float));
+            if (m_tailWritable)
+                std::memcpy(tailSlot(m_tailIn, m_tailIndex, (int)c) + m_tailFill, x, n * sizeof(float));
+
+            // Body and tail contributions were computed from earlier input;
+            // the head is applied here, reading back into the previous
+            // partition for the first frames.
+            const float* body = &channel.bodyOutput[m_fill];
+            if (m_tailPlaying) {
+                const float* tail = m_tailPlaying + c * kTail + m_tailFill;
+                for (unsigned long i = 0; i < n; ++i)
+                    x[i] = body[i] + tail[i];
+            } else {
+                std::memcpy(x, body, n * sizeof(float));
+            }
+            for (int k = 0; k < channel.headTaps; ++k)
+                multiplyAdd(x, in - k, channel.head[k], n);
+        }
+
+        m_fill += n;
+        m_tailFill += n;
+        done += n;
+        if (m_fill == (unsigned long)kHead) {
+            processBody();
+            m_fill = 0;
+        }
+        if (m_tailPartitions > 0 && m_tailFill == (unsigned long)kTail) {
+            endTailPartition();
+            m_tailFill = 0;
+        }
+    }
+}
+
+// Pick up the worker's output for the partition starting now, and claim an
+// input slot for it unless the worker is so far behind it still holds one.
+void RoomCorrection::beginTailPartition()
+{
+    long playing = m_tailIndex - 2;
+    m_tailPlaying = nullptr;
+    if (playing >= 0) {
+        if (m_tailOutTag[playing % kTailSlots].load(std::memory_order_acquire) == playing)
+            m_tailPlaying = tailSlot(m_tailOut, playing, 0);
+        else
+            m_tailMisses.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_tailWritable = m_tailIndex - m_tailTaken.load(std::memory_order_acquire) < kTailSlots;
+}
+
+void RoomCorrection::endTailPartition()
+{
+    if (m_tailWritable)
+        m_tailInTag[m_tailIndex % kTailSlots].store(m_tailIndex, std::memory_order_release);
+    ++m_tailIndex;
+    m_tailPushed.store(m_tailIndex, std::memory_order_release);
+
+    if (m_background)
+        m_wake.post();
+    else
+        drainTail();
+}
+
+void RoomCorrection::processBody()
+{
+    const int bins = 2 * kHead;
+    const float scale = 1.0f / bins;
+    if (m_bodyPartitions > 0)
+        m_bodyNewest = (m_bodyNewest + m_bodyPartitions - 1) % m_bodyPartitions;
+
+    for (Channel& channel : m_channels) {
+        float* input = channel.input.data();
+        if (m_bodyPartitions > 0) {
+            float* xRe = &channel.bodyLineRe[(size_t)m_bodyNewest * bins];
+            float* xIm = &channel.bodyLineIm[(size_t)m_bodyNewest * bins];
+            std::memcpy(xRe, input, bins * sizeof(float));
+            std::memset(xIm, 0, bins * sizeof(float));
+            m_bodyFft.forward(xRe, xIm);
+
+            std::fill(m_re.begin(), m_re.end(), 0.0f);
+            std::fill(m_im.begin(), m_im.end(), 0.0f);
+            for (int p = 0; p < m_bodyPartitions; ++p) {
+                int slot = (m_bodyNewest + p) % m_bodyPartitions;
+                const float* aRe = &channel.bodyLineRe[(size_t)slot * bins];
+                const float* aIm = &channel.bodyLineIm[(size_t)slot * bins];
+                const float* gRe = &channel.bodyRe[(size_t)p * bins];
+                const float* gIm = &channel.bodyIm[(size_t)p * bins];
+                complexMultiplyAdd(m_re.data(), m_im.data(), aRe, aIm, gRe, gIm, bins);
+            }
+            m_bodyFft.inverse(m_re.data(), m_im.data());
+            // The body starts kHead taps in, so this partition's result is
+            // heard over the next one.
+            for (int i = 0; i < kHead; ++i)
+                channel.bodyOutput[i] = m_re[kHead + i] * scale;
+        }
+        std::memcpy(input, input + kHead, kHead * sizeof(float));
+    }
+}
+
+void RoomCorrection::workerLoop()
+{
+    for (;;) {
+        m_wake.wait();
+        if (!m_running.load())
+            return;
+        drainTail();
+    }
+}
+
+// Convolve every tail partition the callback has finished. A partition
+// whose slot the callback could not claim restarts the tail from silence.
+void RoomCorrection::drainTail()
+{
+    const long pushed = m_tailPushed.load(std::memory_order_acquire);
+    for (; m_tailNext < pushed; ++m_tailNext) {
+        const long index = m_tailNext;
+        if (m_tailInTag[index % kTailSlots].load(std::memory_order_acquire) != index) {
+            for (Channel& channel : m_channels) {
+                std::fill(channel.tailLineRe.begin(), channel.tailLineRe.end(), 0.0f);
+                std::fill(channel.tailLineIm.begin(), channel.tailLineIm.end(), 0.0f);
+                std::fill(channel.tailInput.begin(), channel.tailInput.end(), 0.0f);
+            }
+            m_tailTaken.store(index + 1, std::memory_order_release);
+            continue;
+        }
+
+        for (size_t c = 0; c < m_channels.size(); ++c) {
+            std::vector<float>& input = m_channels[c].tailInput;
+            std::memcpy(input.data(), input.data() + kTail, kTail * sizeof(float));
+            std::memcpy(input.data() + kTail, tailSlot(m_tailIn, index, (int)c), kTail * sizeof(float));
+        }
+        m_tailTaken.store(index + 1, std::memory_order_release);
+        processTail(index);
+    }
+}
+
+void RoomCorrection::processTail(long index)
+{
+    const int bins = 2 * kTail;
+    const float scale = 1.0f / bins;
+    m_tailNewest = (m_tailNewest + m_tailPartitions - 1) % m_tailPartitions;
+
+    for (size_t c = 0; c < m_channels.size(); ++c) {
+        Channel& channel = m_channels[c];
+        float* xRe = &channel.tailLineRe[(size_t)m_tailNewest * bins];
+        float* xIm = &channel.tailLineIm[(size_t)m_tailNewest * bins];
+        std::memcpy(xRe, channel.tailInput.data(), bins * sizeof(float));
+        std::memset(xIm, 0, bins * sizeof(float));
+        m_tailFft.forward(xRe, xIm);
+
+        float* re = m_tailScratchRe.data();
+        float* im = m_tailScratchIm.data();
+        std::memset(re, 0, bins * sizeof(float));
+        std::memset(im, 0, bins * sizeof(float));
+        for (int p = 0; p < m_tailPartitions; ++p) {
+            int slot = (m_tailNewest + p) % m_tailPartitions;
+            const float* aRe = &channel.tailLineRe[(size_t)slot * bins];
+            const float* aIm = &channel.tailLineIm[(size_t)slot * bins];
+            const float* gRe = &channel.tailRe[(size_t)p * bins];
+            const float* gIm = &channel.tailIm[(size_t)p * bins];
+            complexMultiplyAdd(re, im, aRe, aIm, gRe, gIm, bins);
+        }
+        m_tailFft.inverse(re, im);
+
+        float* out = tailSlot(m_tailOut, index, (int)c);
+        for (int i = 0; i < kTail; ++i)
+            out[i] = re[kTail + i] * scale;
+    }
+    m_tailOutTag[index % kTailSlots].store(index, std::memory_order_release);
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "fft.h"
+#include "rt_semaphore.h"
+#include "speaker_layout.h"
+
+// Taps applied in direct form, and partition length of the part of the
+// filter convolved in the audio callback, in frames.
+#define CORRECTION_HEAD_FRAMES (128)
+// Partition length of the filter tail, convolved on a worker thread.
+#define CORRECTION_TAIL_FRAMES (1024)
+
+// Room-correction FIRs, one per output channel of a layout, at SAMPLE_RATE.
+// Channels without a filter are passed through.
+class CorrectionFilters
+{
+public:
+    // Load from a list file with one "<channel> <mono wav>" line per filtered
+    // output ('#' starts a comment). The channel is one of the layout's
+    // channel names or a 1-based output number; paths are relative to the
+    // list.
+    bool load(const char* listPath, const SpeakerLayout& layout);
+
+    // Drop every filter and size for `channels` outputs.
+    void reset(int channels);
+    void setFilter(int channel, const float* taps, int count);
+
+    int channels() const { return (int)m_taps.size(); }
+    const std::vector<float>& filter(int channel) const { return m_taps[channel]; }
+    bool empty() const;
+
+private:
+    std::vector<std::vector<float>> m_taps;
+};
+
+// Convolves each output channel in place with its correction filter, with
+// no latency: the output of a block depends on that block's input.
+//
+// Non-uniformly partitioned: the first CORRECTION_HEAD_FRAMES taps are
+// applied in direct form, sample by sample. Taps up to twice
+// CORRECTION_TAIL_FRAMES are applied by overlap-save convolution in
+// CORRECTION_HEAD_FRAMES partitions, each computed in the callback as soon
+// as its input is complete and played from the next frame on. The rest, the
+// bulk of a long filter, is convolved in CORRECTION_TAIL_FRAMES partitions
+// on a worker thread. A tail partition is not heard until one whole tail
+// partition after its input is complete, which is the worker's deadline.
+//
+// Input and output tail partitions pass between the callback and the
+// worker through rings of slots tagged with the partition index, so neither
+// side ever waits for the other. If the worker misses its deadline, that
+// partition's tail is dropped and counted in tailMisses().
+//
+// prepare() does all allocation and starts the worker; process() is
+// real-time safe.
+class RoomCorrection
+{
+public:
+    ~RoomCorrection();
+
+    // Transform `filters` for `channels` outputs. With backgroundTail off the
+    // tail is convolved in process() too, which costs the callback more but
+    // never misses; for offline rendering.
+    bool prepare(const CorrectionFilters& filters, int channels, bool backgroundTail = true);
+
+    // Convolve `frames` frames of each planar channel in place. Any frame
+    // count is accepted.
+    void process(float* const* channels, unsigned long frames);
+
+    // Tail partitions dropped because the worker was late.
+    unsigned long tailMisses() const { return m_tailMisses.load(std::memory_order_relaxed); }
+
+private:
+    static const int kTailSlots = 4;
+
+    struct Channel
+    {
+        int output = 0;
+        int headTaps = 0;
+        std::vector<float> head;          // direct-form taps
+        std::vector<float> input;         // last two head partitions of input
+        std::vector<float> bodyRe;        // [partition][bin] filter spectra
+        std::vector<float> bodyIm;
+        std::vector<float> bodyLineRe;    // [partition][bin] input spectra
+        std::vector<float> bodyLineIm;
+        std::vector<float> bodyOutput;    // body convolution for the current partition
+        std::vector<float> tailRe;        // as above, for the tail; worker only
+        std::vector<float> tailIm;
+        std::vector<float> tailLineRe;
+        std::vector<float> tailLineIm;
+        std::vector<float> tailInput;     // last two tail partitions of input
+    };
+
+    void stop();
+    void workerLoop();
+    void beginTailPartition();
+    void endTailPartition();
+    void processBody();
+    void drainTail();
+    void processTail(long index);
+    float* tailSlot(std::vector<float>& ring, long index, int channel);
+
+    std::vector<Channel> m_channels;      // filtered channels only
+    FftPlan m_bodyFft;
+    FftPlan m_tailFft;
+    int m_bodyPartitions = 0;
+    int m_tailPartitions = 0;
+    int m_bodyNewest = 0;
+    int m_tailNewest = 0;
+    std::vector<float> m_re;              // callback transform scratch
+    std::vector<float> m_im;
+    std::vector<float> m_tailScratchRe;   // worker transform scratch
+    std::vector<float> m_tailScratchIm;
+    unsigned long m_fill = 0;             // frames of the head partition received
+    unsigned long m_tailFill = 0;         // frames of the tail partition received
+
+    // Tail hand-off. Slot index % kTailSlots of each ring holds partition
+    // `index` once its tag says so.
+    std::vector<float> m_tailIn;          // [slot][channel][frame], written by the callback
+    std::vector<float> m_tailOut;         // [slot][channel][frame], written by the worker
+    std::atomic<long> m_tailInTag[kTailSlots];
+    std::atomic<long> m_tailOutTag[kTailSlots];
+    std::atomic<long> m_tailPushed{0};    // partitions the callback has finished
+    std::atomic<long> m_tailTaken{0};     // partitions the worker has copied out
+    std::atomic<unsigned long> m_tailMisses{0};
+    long m_tailIndex = 0;                 // partition the callback is filling
+    long m_tailNext = 0;                  // next partition for the worker
+    bool m_tailWritable = false;          // the current partition's input slot is free
+    const float* m_tailPlaying = nullptr; // worker output for the current partition
+
+    bool m_background = false;
+    std::atomic<bool> m_running{false};
+    RtSemaphore m_wake;
+    std::thread m_worker;
+};
@@ -0,0 +1,107 @@
+#include "rt_alloc_check.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#ifdef RT_ALLOC_CHECK
+
+static std::atomic<unsigned long> gRtAllocations{0};
+static thread_local int tRtScopeDepth = 0;
+
+RtAllocScope::RtAllocScope()
+{
+    ++tRtScopeDepth;
+}
+
+RtAllocScope::~RtAllocScope()
+{
+    --tRtScopeDepth;
+}
+
+unsigned long rtAllocationCount()
+{
+    return gRtAllocations.load(std::memory_order_relaxed);
+}
+
+void rtResetAllocationCount()
+{
+    gRtAllocations.store(0, std::memory_order_relaxed);
+}
+
+static void* countedAlloc(std::size_t size, std::size_t alignment)
+{
+    if (tRtScopeDepth > 0)
+        gRtAllocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (size == 0)
+        size = 1;
+
+    if (alignment <= alignof(std::max_align_t))
+        return std::malloc(size);
+
+    // aligned_alloc requires the size to be a multiple of the alignment
+    size = (size + alignment - 1) / alignment * alignment;
+    return std::aligned_alloc(alignment, size);
+}
+
+void* operator new(std::size_t size)
+{
+    void* p = countedAlloc(size, alignof(std::max_align_t));
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    void* p = countedAlloc(size, alignof(std::max_align_t));
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(std::size_t size, std::align_val_t al)
+{
+    void* p = countedAlloc(size, static_cast<std::size_t>(al));
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size, std::align_val_t al)
+{
+    void* p = countedAlloc(size, static_cast<std::size_t>(al));
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return countedAlloc(size, alignof(std::max_align_t));
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return countedAlloc(size, alignof(std::max_align_t));
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+#else
+
+unsigned long rtAllocationCount()
+{
+    return 0;
+}
+
+void rtResetAllocationCount()
+{
+}
+
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+
+// Debug hook for catching heap traffic on the audio thread.
+//
+// Build with RT_ALLOC_CHECK defined (`make RT_ALLOC_CHECK=1`) to replace the
+// global operator new/delete and count every allocation made while an
+// RtAllocScope is alive on the calling thread. Without the define the scope
+// is an empty object and costs nothing.
+#ifdef RT_ALLOC_CHECK
+class RtAllocScope
+{
+public:
+    RtAllocScope();
+    ~RtAllocScope();
+
+    RtAllocScope(const RtAllocScope&) = delete;
+    RtAllocScope& operator=(const RtAllocScope&) = delete;
+};
+#else
+class RtAllocScope
+{
+public:
+    RtAllocScope() {}
+};
+#endif
+
+// Number of allocations observed inside any RtAllocScope since the last reset.
+// Always 0 when RT_ALLOC_CHECK is not defined.
+unsigned long rtAllocationCount();
+
+void rtResetAllocationCount();
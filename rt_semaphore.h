@@ -0,0 +1,61 @@
+#pragma once
+
+#ifdef __APPLE__
+#include <dispatch/dispatch.h>
+#else
+#include <semaphore.h>
+#endif
+
+// Counting semaphore for waking worker threads from the audio thread:
+// post() never blocks and does not allocate.
+class RtSemaphore
+{
+public:
+    RtSemaphore()
+    {
+#ifdef __APPLE__
+        m_sem = dispatch_semaphore_create(0);
+#else
+        sem_init(&m_sem, 0, 0);
+#endif
+    }
+
+    ~RtSemaphore()
+    {
+#ifdef __APPLE__
+        dispatch_release(m_sem);
+#else
+        sem_destroy(&m_sem);
+#endif
+    }
+
+    RtSemaphore(const RtSemaphore&) = delete;
+    RtSemaphore& operator=(const RtSemaphore&) = delete;
+
+    void post()
+    {
+#ifdef __APPLE__
+        dispatch_semaphore_signal(m_sem);
+#else
+        sem_post(&m_sem);
+#endif
+    }
+
+    void wait()
+    {
+#ifdef __APPLE__
+        dispatch_semaphore_wait(m_sem, DISPATCH_TIME_FOREVER);
+#else
+        while (sem_wait(&m_sem) != 0) {
+            // interrupted by a signal; wait again
+        }
+#endif
+    }
+
+private:
+#ifdef __APPLE__
+    dispatch_semaphore_t m_sem;
+#else
+    sem_t m_sem;
+#endif
+};
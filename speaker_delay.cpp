@@ -0,0 +1,166 @@
+#include "speaker_delay.h"
+#include "utils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Lagrange interpolation through x0..x3, the frames 0..3 before the base
+// read position, at `delta` frames before it (1 <= delta < 2), in Farrow
+// form: a cubic in delta whose coefficients depend only on the samples.
+static inline float farrow(float x0, float x1, float x2, float x3, float delta)
+{
+    float c1 = -11.0f / 6.0f * x0 + 3.0f * x1 - 1.5f * x2 + x3 / 3.0f;
+    float c2 = x0 - 2.5f * x1 + 2.0f * x2 - 0.5f * x3;
+    float c3 = 0.5f * (x1 - x2) + (x3 - x0) / 6.0f;
+    return x0 + delta * (c1 + delta * (c2 + delta * c3));
+}
+
+bool SpeakerDelays::prepare(int channels, unsigned long maxFrames)
+{
+    m_maxDelay = SPEAKER_DELAY_MAX_SECONDS * SAMPLE_RATE;
+    // Room for a block, the longest delay, the extra frame and the
+    // interpolator's reach
+    unsigned long needed = maxFrames + (unsigned long)m_maxDelay + 5;
+    m_size = 1;
+    while (m_size < needed)
+        m_size <<= 1;
+    m_mask = m_size - 1;
+    m_guard = maxFrames + 3;
+
+    m_lines.assign(channels, Line());
+    for (Line& line : m_lines)
+        line.ring.assign(m_size + m_guard, 0.0f);
+    return true;
+}
+
+void SpeakerDelays::setDelay(int channel, float frames, bool jump)
+{
+    Line& line = m_lines[channel];
+    line.target = std::max(0.0f, std::min(m_maxDelay, frames));
+    if (jump)
+        line.current = line.target;
+}
+
+// Fixed delay: one set of Lagrange weights for the whole block, applied as a
+// four-tap FIR over contiguous frames.
+static void readFixed(const float* ring, unsigned long mask, unsigned long write,
+                      float delay, float* out, unsigned long frames)
+{
+    float d = delay + 1.0f;
+    long base = (long)d - 1;
+    float delta = d - (float)base;
+    float h0 = -(delta - 1) * (delta - 2) * (delta - 3) / 6;
+    float h1 = delta * (delta - 2) * (delta - 3) / 2;
+    float h2 = -delta * (delta - 1) * (delta - 3) / 2;
+    float h3 = delta * (delta - 1) * (delta - 2) / 6;
+
+    // src[i + 3 - k] is the frame k before output frame i's base position
+    const float* src = ring + ((write - base - 3) & mask);
+    unsigned long i = 0;
+#ifdef __SSE2__
+    const __m128 w0 = _mm_set1_ps(h0), w1 = _mm_set1_ps(h1);
+    const __m128 w2 = _mm_set1_ps(h2), w3 = _mm_set1_ps(h3);
+    for (; i + 4 <= frames; i += 4) {
+        __m128 y = _mm_mul_ps(w0, _mm_loadu_ps(src + i + 3));
+        y = _mm_add_ps(y, _mm_mul_ps(w1, _mm_loadu_ps(src + i + 2)));
+        y = _mm_add_ps(y, _mm_mul_ps(w2, _mm_loadu_ps(src + i + 1)));
+        y = _mm_add_ps(y, _mm_mul_ps(w3, _mm_loadu_ps(src + i)));
+        _mm_storeu_ps(out + i, y);
+    }
+#endif
+    for (; i < frames; ++i)
+        out[i] = h0 * src[i + 3] + h1 * src[i + 2] + h2 * src[i + 1] + h3 * src[i];
+}
+
+// Delay moving linearly from `from` to `to` across the block, reaching `to`
+// on the last frame. Each frame has its own read position and weights.
+static void readMoving(const float* ring, unsigned long mask, unsigned long write,
+                       float from, float to, float* out, unsigned long frames)
+{
+    const float slope = (to - from) / frames;
+    unsigned long i = 0;
+#ifdef __SSE2__
+    // Four frames at a time: the four-frame window behind each one is
+    // loaded as a row, and transposing the rows gives the Farrow inputs
+    // lane by lane.
+    const __m128 lanes = _mm_setr_ps(1, 2, 3, 4);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128i laneOffsets = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i ringMask = _mm_set1_epi32((int)mask);
+    const __m128 k1a = _mm_set1_ps(-11.0f / 6.0f), k1b = _mm_set1_ps(3.0f);
+    const __m128 k1c = _mm_set1_ps(-1.5f), k1d = _mm_set1_ps(1.0f / 3.0f);
+    const __m128 k2b = _mm_set1_ps(-2.5f), k2c = _mm_set1_ps(2.0f), k2d = _mm_set1_ps(-0.5f);
+    const __m128 half = _mm_set1_ps(0.5f), sixth = _mm_set1_ps(1.0f / 6.0f);
+    alignas(16) int index[4];
+
+    for (; i + 4 <= frames; i += 4) {
+        __m128 d = _mm_add_ps(_mm_set1_ps(from + 1.0f),
+                              _mm_mul_ps(_mm_set1_ps(slope), _mm_add_ps(_mm_set1_ps((float)i), lanes)));
+        __m128i whole = _mm_cvttps_epi32(d);
+        __m128 delta = _mm_add_ps(_mm_sub_ps(d, _mm_cvtepi32_ps(whole)), one);
+        // (write + i + lane - (whole - 1) - 3) & mask; 32-bit wrap is fine
+        // as the ring size divides 2^32
+        __m128i start = _mm_add_epi32(_mm_set1_epi32((int)(write + i - 2)), laneOffsets);
+        _mm_store_si128((__m128i*)index, _mm_and_si128(_mm_sub_epi32(start, whole), ringMask));
+
+        __m128 x3 = _mm_loadu_ps(ring + index[0]);
+        __m128 x2 = _mm_loadu_ps(ring + index[1]);
+        __m128 x1 = _mm_loadu_ps(ring + index[2]);
+        __m128 x0 = _mm_loadu_ps(ring + index[3]);
+        _MM_TRANSPOSE4_PS(x3, x2, x1, x0);
+
+        __m128 c1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(k1a, x0), _mm_mul_ps(k1b, x1)),
+                               _mm_add_ps(_mm_mul_ps(k1c, x2), _mm_mul_ps(k1d, x3)));
+        __m128 c2 = _mm_add_ps(_mm_add_ps(x0, _mm_mul_ps(k2b, x1)),
+                               _mm_add_ps(_mm_mul_ps(k2c, x2), _mm_mul_ps(k2d, x3)));
+        __m128 c3 = _mm_add_ps(_mm_mul_ps(half, _mm_sub_ps(x1, x2)),
+                               _mm_mul_ps(sixth, _mm_sub_ps(x3, x0)));
+        __m128 y = _mm_add_ps(c2, _mm_mul_ps(delta, c3));
+        y = _mm_add_ps(c1, _mm_mul_ps(delta, y));
+        y = _mm_add_ps(x0, _mm_mul_ps(delta, y));
+        _mm_storeu_ps(out + i, y);
+    }
+#endif
+    for (; i < frames; ++i) {
+        float d = from + 1.0f + slope * (i + 1);
+        long whole = (long)d;
+        float delta = d - whole + 1.0f;
+        const float* src = ring + ((write + i - whole - 2) & mask);
+        out[i] = farrow(src[3], src[2], src[1], src[0], delta);
+    }
+}
+
+void SpeakerDelays::process(float* const* channels, unsigned long frames, int begin, int end)
+{
+    for (int ch = begin; ch < end; ++ch) {
+        Line& line = m_lines[ch];
+        float* x = channels[ch];
+        float* ring = line.ring.data();
+
+        // Write the block, wrapping at the end of the ring, then refresh
+        // the mirrored start.
+        unsigned long pos = line.write & m_mask;
+        unsigned long first = std::min(frames, m_size - pos);
+        std::memcpy(ring + pos, x, first * sizeof(float));
+        std::memcpy(ring, x + first, (frames - first) * sizeof(float));
+        if (pos < m_guard || first < frames)
+            std::memcpy(ring + m_size, ring, m_guard * sizeof(float));
+
+        float from = line.current;
+        float step = line.target - from;
+        float maxStep = kMaxSlew * frames;
+        step = std::max(-maxStep, std::min(maxStep, step));
+
+        if (step == 0.0f) {
+            readFixed(ring, m_mask, line.write, from, x, frames);
+        } else {
+            readMoving(ring, m_mask, line.write, from, from + step, x, frames);
+            line.current = from + step;
+        }
+        line.write += frames;
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+
+#define SPEED_OF_SOUND (343.0f)             // m/s
+// Longest delay a speaker can be given, in seconds: a 34 m path difference.
+#define SPEAKER_DELAY_MAX_SECONDS (0.1f)
+
+// Per-speaker fractional delay lines, to line up the arrival times of
+// speakers at different distances from the listener.
+//
+// Each channel runs through a power-of-two ring buffer and is read back
+// with third-order Lagrange interpolation, so delays need not be whole
+// frames. The ring is followed by a copy of its start, long enough that
+// every read is contiguous and the interpolator never wraps.
+//
+// A delay change is never applied at once: the delay slews towards its
+// target by at most SpeakerDelays::kMaxSlew frames per frame, a pitch shift
+// of about 35 cents at most, varying smoothly within the block (the
+// interpolator is then evaluated in Farrow form per frame). A listener
+// walking at 1.5 m/s moves delays by a fifth of that.
+//
+// Every channel is one frame later than its delay, so the interpolator
+// always has a frame either side of the read position.
+//
+// prepare() does all allocation; process() is real-time safe.
+class SpeakerDelays
+{
+public:
+    static constexpr float kMaxSlew = 0.02f;
+
+    bool prepare(int channels, unsigned long maxFrames);
+
+    // Target delay of `channel` in frames, clamped to
+    // [0, SPEAKER_DELAY_MAX_SECONDS]. With jump set it takes effect at once,
+    // for the first pose after prepare().
+    void setDelay(int channel, float frames, bool jump = false);
+
+    // Delay `channel` has reached, in frames.
+    float delay(int channel) const { return m_lines[channel].current; }
+
+    // Delay `frames` frames of channels [begin, end) in place. Distinct
+    // channel ranges may be processed on different threads.
+    void process(float* const* channels, unsigned long frames, int begin, int end);
+
+private:
+    struct Line
+    {
+        std::vector<float> ring;    // m_size frames, then m_guard mirrored ones
+        unsigned long write = 0;    // frames written since prepare()
+        float current = 0.0f;
+        float target = 0.0f;
+    };
+
+    std::vector<Line> m_lines;
+    unsigned long m_size = 0;
+    unsigned long m_mask = 0;
+    unsigned long m_guard = 0;
+    float m_maxDelay = 0.0f;
+};
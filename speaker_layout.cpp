@@ -0,0 +1,142 @@
+#include "speaker_layout.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const SpeakerLayout kSpeakerLayouts[(int)SpeakerLayoutId::Count] = {
+    describeLayout<Layout20>(),
+    describeLayout<Layout51>(),
+    describeLayout<Layout71>(),
+    describeLayout<Layout714>(),
+};
+
+const SpeakerLayout& getSpeakerLayout(SpeakerLayoutId id)
+{
+    return kSpeakerLayouts[(int)id];
+}
+
+const SpeakerLayout* findSpeakerLayout(const char* name)
+{
+    for (const SpeakerLayout& layout : kSpeakerLayouts) {
+        if (std::strcmp(layout.name, name) == 0)
+            return &layout;
+    }
+    return nullptr;
+}
+
+const SpeakerLayout& defaultSpeakerLayout()
+{
+    return getSpeakerLayout(SpeakerLayoutId::Surround51);
+}
+
+int findSpeakerChannel(const SpeakerLayout& layout, const char* name)
+{
+    for (int ch = 0; ch < layout.channels; ++ch) {
+        if (std::strcmp(layout.channelNames[ch], name) == 0)
+            return ch;
+    }
+    char* end;
+    long number = std::strtol(name, &end, 10);
+    if (*end == '\0' && number >= 1 && number <= layout.channels)
+        return (int)number - 1;
+    return -1;
+}
+
+SpeakerArrayLayout::SpeakerArrayLayout()
+{
+    updateDescriptor();
+}
+
+void SpeakerArrayLayout::clear()
+{
+    m_names.clear();
+    m_angles.clear();
+    m_radii.clear();
+    m_layout.lfe = -1;
+    m_layout.centre = -1;
+    updateDescriptor();
+}
+
+bool SpeakerArrayLayout::addSpeaker(const std::string& name, float angle, float radius, bool lfe)
+{
+    if ((int)m_names.size() >= MAX_CHANNELS)
+        return false;
+    if (lfe && m_layout.lfe >= 0)
+        return false;
+
+    int channel = (int)m_names.size();
+    m_names.push_back(name);
+    m_angles.push_back(angle);
+    m_radii.push_back(radius);
+
+    if (lfe)
+        m_layout.lfe = channel;
+    else if (angle == 0.0f && m_layout.centre < 0)
+        m_layout.centre = channel;
+
+    updateDescriptor();
+    return true;
+}
+
+// Re-point the descriptor after the vectors may have reallocated.
+void SpeakerArrayLayout::updateDescriptor()
+{
+    m_namePointers.clear();
+    for (const std::string& name : m_names)
+        m_namePointers.push_back(name.c_str());
+
+    m_layout.id = SpeakerLayoutId::Custom;
+    m_layout.name = "custom";
+    m_layout.channels = (int)m_names.size();
+    m_layout.angles = m_angles.data();
+    m_layout.radii = m_radii.data();
+    m_layout.channelNames = m_namePointers.data();
+    if (m_names.empty()) {
+        m_layout.lfe = -1;
+        m_layout.centre = -1;
+    }
+}
+
+bool loadSpeakerLayoutFile(const char* path, SpeakerArrayLayout& layout)
+{
+    FILE* file = std::fopen(path, "r");
+    if (!file) {
+        std::fprintf(stderr, "Could not open speaker layout %s\n", path);
+        return false;
+    }
+
+    layout.clear();
+
+    char line[256];
+    int lineNumber = 0;
+    bool ok = true;
+    while (ok && std::fgets(line, sizeof(line), file)) {
+        ++lineNumber;
+        if (char* comment = std::strchr(line, '#'))
+            *comment = '\0';
+
+        char name[64];
+        float azimuth, radius;
+        char flag[16] = "";
+        int fields = std::sscanf(line, " %63s %f %f %15s", name, &azimuth, &radius, flag);
+        if (fields <= 0)
+            continue;
+
+        bool lfe = fields == 4 && std::strcmp(flag, "lfe") == 0;
+        if (fields < 3 || (fields == 4 && !lfe)) {
+            std::fprintf(stderr, "%s:%d: expected <name> <azimuth> <distance> [lfe]\n", path, lineNumber);
+            ok = false;
+        } else if (!layout.addSpeaker(name, azimuth / 360.0f, radius, lfe)) {
+            std::fprintf(stderr, "%s:%d: too many speakers (max %d) or a second LFE channel\n",
+                         path, lineNumber, MAX_CHANNELS);
+            ok = false;
+        }
+    }
+    std::fclose(file);
+
+    if (ok && layout.layout().channels == 0) {
+        std::fprintf(stderr, "%s: no speakers\n", path);
+        ok = false;
+    }
+    return ok;
+}
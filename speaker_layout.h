@@ -0,0 +1,170 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "six_channel.h"
+
+// Channel capacity of every per-speaker array: the largest speaker array that
+// can be loaded from a layout file.
+#define MAX_CHANNELS        (128)
+
+// Output speaker layouts.
+//
+// Each layout is a type carrying its channel count, LFE channel and the
+// azimuth of every channel as compile-time constants, so RenderEngine can be
+// instantiated per layout with fixed trip counts. The registry in
+// speaker_layout.cpp describes the same types at run time for code that picks
+// a layout at startup (command line, GUI, room setup).
+//
+// Channels are in device output order. Every surround layout starts with the
+// 5.1 order from six_channel.h, so a 7.1 or 7.1.4 stream is a superset of it.
+// Angles are in turns: 0 straight ahead, negative to the left.
+
+enum class SpeakerLayoutId
+{
+    Stereo = 0,
+    Surround51,
+    Surround71,
+    Surround714,
+    Count,      // number of built-in layouts
+    Custom = Count  // a SpeakerArrayLayout built at run time
+};
+
+struct Layout20
+{
+    static constexpr SpeakerLayoutId id = SpeakerLayoutId::Stereo;
+    static constexpr const char* name = "2.0";
+    static constexpr int channels = 2;
+    static constexpr int lfe = -1;
+    static constexpr int centre = -1;
+    static constexpr float angles[channels] = { -0.25f, 0.25f };
+    static constexpr float radii[channels] = { 1.7f, 1.7f };
+    static constexpr const char* channelNames[channels] = { "Left", "Right" };
+};
+
+// Five speakers evenly spaced around the listener, as the original room.
+struct Layout51
+{
+    static constexpr SpeakerLayoutId id = SpeakerLayoutId::Surround51;
+    static constexpr const char* name = "5.1";
+    static constexpr int channels = 6;
+    static constexpr int lfe = Subwoofer;
+    static constexpr int centre = Centre;
+    static constexpr float angles[channels] = {
+        -1 / 5.0f, 1 / 5.0f, -2 / 5.0f, 2 / 5.0f, 0.0f, 0.0f
+    };
+    static constexpr float radii[channels] = { 1.7f, 1.7f, 1.7f, 1.7f, 1.7f, 0.0f };
+    static constexpr const char* channelNames[channels] = {
+        "FrontLeft", "FrontRight", "BackLeft", "BackRight", "Centre", "Subwoofer"
+    };
+};
+
+// 5.1 plus side speakers, seven evenly spaced.
+struct Layout71
+{
+    static constexpr SpeakerLayoutId id = SpeakerLayoutId::Surround71;
+    static constexpr const char* name = "7.1";
+    static constexpr int channels = 8;
+    static constexpr int lfe = Subwoofer;
+    static constexpr int centre = Centre;
+    static constexpr float angles[channels] = {
+        -1 / 7.0f, 1 / 7.0f, -3 / 7.0f, 3 / 7.0f, 0.0f, 0.0f, -2 / 7.0f, 2 / 7.0f
+    };
+    static constexpr float radii[channels] = { 1.7f, 1.7f, 1.7f, 1.7f, 1.7f, 0.0f, 1.7f, 1.7f };
+    static constexpr const char* channelNames[channels] = {
+        "FrontLeft", "FrontRight", "BackLeft", "BackRight", "Centre", "Subwoofer",
+        "SideLeft", "SideRight"
+    };
+};
+
+// 7.1 plus four height speakers. The renderer is 2D, so the heights are
+// placed on an inner ring at the diagonals.
+struct Layout714
+{
+    static constexpr SpeakerLayoutId id = SpeakerLayoutId::Surround714;
+    static constexpr const char* name = "7.1.4";
+    static constexpr int channels = 12;
+    static constexpr int lfe = Subwoofer;
+    static constexpr int centre = Centre;
+    static constexpr float angles[channels] = {
+        -1 / 7.0f, 1 / 7.0f, -3 / 7.0f, 3 / 7.0f, 0.0f, 0.0f, -2 / 7.0f, 2 / 7.0f,
+        -1 / 8.0f, 1 / 8.0f, -3 / 8.0f, 3 / 8.0f
+    };
+    static constexpr float radii[channels] = {
+        1.7f, 1.7f, 1.7f, 1.7f, 1.7f, 0.0f, 1.7f, 1.7f, 1.0f, 1.0f, 1.0f, 1.0f
+    };
+    static constexpr const char* channelNames[channels] = {
+        "FrontLeft", "FrontRight", "BackLeft", "BackRight", "Centre", "Subwoofer",
+        "SideLeft", "SideRight", "TopFrontLeft", "TopFrontRight", "TopBackLeft", "TopBackRight"
+    };
+};
+
+static_assert(Layout714::channels <= MAX_CHANNELS, "MAX_CHANNELS too small");
+
+// Run-time description of one of the layout types above.
+typedef struct
+{
+    SpeakerLayoutId id;
+    const char* name;
+    int channels;
+    int lfe;     // LFE channel, or -1
+    int centre;  // channel the head-tracking camera sits on, or -1
+    const float* angles;
+    const float* radii;
+    const char* const* channelNames;
+} SpeakerLayout;
+
+template <typename Layout>
+constexpr SpeakerLayout describeLayout()
+{
+    return SpeakerLayout{ Layout::id, Layout::name, Layout::channels, Layout::lfe,
+                          Layout::centre, Layout::angles, Layout::radii,
+                          Layout::channelNames };
+}
+
+const SpeakerLayout& getSpeakerLayout(SpeakerLayoutId id);
+
+// The layout called `name` ("2.0", "5.1", "7.1", "7.1.4"), or nullptr.
+const SpeakerLayout* findSpeakerLayout(const char* name);
+
+// 5.1, the layout of the decoded audio.
+const SpeakerLayout& defaultSpeakerLayout();
+
+// Output channel called `name` in layout, or a 1-based channel number;
+// -1 if there is none.
+int findSpeakerChannel(const SpeakerLayout& layout, const char* name);
+
+// A layout whose size is only known at run time, such as an installation's
+// speaker array loaded from a file. Owns the arrays its descriptor points
+// into, so it must outlive any paTestData using it.
+class SpeakerArrayLayout
+{
+public:
+    SpeakerArrayLayout();
+
+    SpeakerArrayLayout(const SpeakerArrayLayout&) = delete;
+    SpeakerArrayLayout& operator=(const SpeakerArrayLayout&) = delete;
+
+    void clear();
+
+    // Append a speaker; `angle` in turns as above. Fails past MAX_CHANNELS or
+    // on a second LFE channel.
+    bool addSpeaker(const std::string& name, float angle, float radius, bool lfe = false);
+
+    const SpeakerLayout& layout() const { return m_layout; }
+
+private:
+    void updateDescriptor();
+
+    std::vector<std::string> m_names;
+    std::vector<const char*> m_namePointers;
+    std::vector<float> m_angles;
+    std::vector<float> m_radii;
+    SpeakerLayout m_layout;
+};
+
+// Load a speaker array from a text file with one speaker per line:
+//     <name> <azimuth in degrees, negative to the left> <distance in metres> [lfe]
+// Blank lines and lines starting with '#' are ignored. The first non-LFE
+// speaker at azimuth 0 becomes the centre.
+bool loadSpeakerLayoutFile(const char* path, SpeakerArrayLayout& layout);
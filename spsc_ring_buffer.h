@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// Lock-free single-producer/single-consumer ring buffer of trivially
+// copyable elements. One thread may call write(), one other thread may call
+// read(); neither ever blocks or allocates after allocate().
+template <typename T>
+class SpscRingBuffer
+{
+public:
+    SpscRingBuffer() = default;
+
+    SpscRingBuffer(const SpscRingBuffer&) = delete;
+    SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+    // Size the buffer to hold at least minCapacity elements (rounded up to a
+    // power of two) and empty it. Not thread-safe; call before either side runs.
+    void allocate(size_t minCapacity)
+    {
+        size_t capacity = 1;
+        while (capacity < minCapacity)
+            capacity <<= 1;
+        m_buffer.assign(capacity, T());
+        m_mask = capacity - 1;
+        reset();
+    }
+
+    // Drop everything buffered. Not thread-safe.
+    void reset()
+    {
+        m_writeIndex.store(0, std::memory_order_relaxed);
+        m_readIndex.store(0, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return m_buffer.size(); }
+
+    // Producer side.
+    size_t writeAvailable() const
+    {
+        return capacity() - (m_writeIndex.load(std::memory_order_relaxed) -
+                             m_readIndex.load(std::memory_order_acquire));
+    }
+
+    size_t write(const T* src, size_t count)
+    {
+        size_t writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+        size_t space = capacity() - (writeIndex - m_readIndex.load(std::memory_order_acquire));
+        if (count > space)
+            count = space;
+
+        copyIn(writeIndex, src, count);
+        m_writeIndex.store(writeIndex + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side.
+    size_t readAvailable() const
+    {
+        return m_writeIndex.load(std::memory_order_acquire) -
+               m_readIndex.load(std::memory_order_relaxed);
+    }
+
+    size_t read(T* dst, size_t count)
+    {
+        size_t readIndex = m_readIndex.load(std::memory_order_relaxed);
+        size_t available = m_writeIndex.load(std::memory_order_acquire) - readIndex;
+        if (count > available)
+            count = available;
+
+        copyOut(readIndex, dst, count);
+        m_readIndex.store(readIndex + count, std::memory_order_release);
+        return count;
+    }
+
+private:
+    // Indices grow without bound and are masked on access, so full and empty
+    // are distinguishable without wasting a slot.
+    void copyIn(size_t index, const T* src, size_t count)
+    {
+        if (count == 0)
+            return;
+        size_t offset = index & m_mask;
+        size_t first = count < capacity() - offset ? count : capacity() - offset;
+        std::memcpy(m_buffer.data() + offset, src, first * sizeof(T));
+        std::memcpy(m_buffer.data(), src + first, (count - first) * sizeof(T));
+    }
+
+    void copyOut(size_t index, T* dst, size_t count) const
+    {
+        if (count == 0)
+            return;
+        size_t offset = index & m_mask;
+        size_t first = count < capacity() - offset ? count : capacity() - offset;
+        std::memcpy(dst, m_buffer.data() + offset, first * sizeof(T));
+        std::memcpy(dst + first, m_buffer.data(), (count - first) * sizeof(T));
+    }
+
+    std::vector<T> m_buffer;
+    size_t m_mask = 0;
+    alignas(64) std::atomic<size_t> m_writeIndex{0};
+    alignas(64) std::atomic<size_t> m_readIndex{0};
+};
@@ -3,90 +3,81 @@
 #include <iostream>
 #include "six_channel.h"
 #include "utils.h"
-#include "portaudio_listener.h"
+#include "audio_engine.h"
+#include "pcm_cache.h"
+#include "streaming_decoder.h"
 
 // Global audio data
 paTestData gData;
 
+// Streaming mode: decode on a background thread instead of loading up front
+static bool gStreamingMode = false;
+static double gLookaheadSeconds = 2.0;
+static StreamingDecoder gStream;
+
+// Output speaker layout, chosen on the command line
+static const SpeakerLayout* gLayout = &defaultSpeakerLayout();
+static SpeakerArrayLayout gArrayLayout;
+
+// Distance attenuation, chosen on the command line
+static AttenuationModel gAttenuation;
+
+void setStreamingMode(bool enabled, double lookaheadSeconds)
+{
+    gStreamingMode = enabled;
+    if (lookaheadSeconds > 0)
+        gLookaheadSeconds = lookaheadSeconds;
+}
+
+bool setSpeakerLayout(const char* name)
+{
+    const SpeakerLayout* layout = findSpeakerLayout(name);
+    if (!layout)
+        return false;
+    gLayout = layout;
+    return true;
+}
+
+bool setSpeakerLayoutFile(const char* path)
+{
+    if (!loadSpeakerLayoutFile(path, gArrayLayout))
+        return false;
+    gLayout = &gArrayLayout.layout();
+    return true;
+}
+
+bool setAttenuation(const char* lawOrCurvePath, float referenceDistance)
+{
+    return gAttenuation.configure(lawOrCurvePath, referenceDistance);
+}
+
 // ============================
 // ROOM + SPEAKER POSITIONS
 // ============================
 static void initRoomAndSpeakers(paTestData& data)
 {
-    // Define room bounds
-    data.subjectBounds[0] = { -3.0f, -3.0f }; // bottom-left
-    data.subjectBounds[1] = {  3.0f,  3.0f }; // top-right
+    data.attenuationModel = gAttenuation;
+    initDefaultRoom(&data, *gLayout);
 
-    if (CHANNEL_COUNT == 2)
-    {
-        data.speakerPositions[0] = { 1, 0 };
-        data.speakerPositions[1] = { -1, 0 };
-    }
-    else if (CHANNEL_COUNT == 6)
+    // Open the audio file using libsndfile: either stream it from disk on a
+    // background thread, or load it whole up front (mapped from the decode
+    // cache after the first run).
+    auto audioFilePath = "assets/audio/flac_5_1.flac";
+    data.readIndex = 0;
+
+    if (gStreamingMode)
     {
-        float radius = 1.7;
-        data.speakerPositions[Centre] = getCircularCoordinates(0 / 5.0 + 0.25, radius);
-        data.speakerPositions[FrontRight] = getCircularCoordinates(-1 / 5.0 + 0.25, radius);
-        data.speakerPositions[BackRight] = getCircularCoordinates(-2 / 5.0 + 0.25, radius);
-        data.speakerPositions[BackLeft] = getCircularCoordinates(-3 / 5.0 + 0.25, radius);
-        data.speakerPositions[FrontLeft] = getCircularCoordinates(-4 / 5.0 + 0.25, radius);
-        data.speakerPositions[Subwoofer] = { 0, 0 };
+        data.audio.clear();
+        data.stream = &gStream;
+        if (!gStream.open(audioFilePath, (unsigned long)(gLookaheadSeconds * SAMPLE_RATE)))
+            std::exit(EXIT_FAILURE);
     }
     else
     {
-        std::exit(EXIT_FAILURE);
-    }
-
-    // Listener begins at origin
-    data.currentListenerPosition = { 0.0, 0.0 };
-    data.listenerYaw = 0.0;
-
-    // set max gain
-    setMaxGain(&data);
-
-    // Open and read the audio file using libsndfile
-    auto audioFilePath = "assets/audio/flac_5_1.flac";
-    SF_INFO sfinfo;
-    SNDFILE* file = sf_open(audioFilePath, SFM_READ, &sfinfo);
-
-    // Allocate output buffer for 5.1
-    data.audio.resize(sfinfo.frames * 6);
-
-    std::vector<float> tempBuffer(sfinfo.frames * 6, 0.0f);
-
-    sf_count_t framesRead = sf_readf_float(file, tempBuffer.data(), sfinfo.frames);
-    if (framesRead != sfinfo.frames) {
-        std::cerr << "Warning: read fewer frames than expected\n";
+        data.stream = nullptr;
+        if (!loadDecodedAudio(audioFilePath, data.audio))
+            std::exit(EXIT_FAILURE);
     }
-
-    // Mix stereo to 5.1
-    if (sfinfo.channels == 2) {
-        for (sf_count_t i = 0; i < framesRead; ++i) {
-            float left  = tempBuffer[i * 2 + 0];
-            float right = tempBuffer[i * 2 + 1];
-
-            data.audio[i * 6 + 0] = left;              // Front Left
-            data.audio[i * 6 + 1] = right;              // Front Right
-            data.audio[i * 6 + 2] = (left * right) * 0.5f;             // Centre
-            data.audio[i * 6 + 3] = (left + right) * 0.25f;       // Subwoofer
-            data.audio[i * 6 + 4] = left * 0.5f;      // Rear Left
-            data.audio[i * 6 + 5] = right * 0.5f; // Rear Right
-        }
-    } else if (sfinfo.channels == 6) {
-        // Copy directly
-        for (sf_count_t i = 0; i < framesRead; ++i) {
-            for (int ch = 0; ch < 6; ++ch) {
-                data.audio[i * 6 + ch] = tempBuffer[i * 6 + ch];
-            }
-        }
-    } else {
-        std::cerr << "Invalid number of channels: " << sfinfo.channels << "\n";
-        exit(EXIT_FAILURE);
-    }
-
-    data.readIndex = 0;
-
-    sf_close(file);
 }
 
 // ============================
@@ -94,7 +85,7 @@ static void initRoomAndSpeakers(paTestData& data)
 // ============================
 static void initChannels(paTestData& data)
 {
-    for (int i = 0; i < CHANNEL_COUNT; i++)
+    for (int i = 0; i < MAX_CHANNELS; i++)
     {
         data.channelGains[i] = 1;
     }
@@ -111,18 +102,13 @@ void initAudioData()
 }
 
 // ============================
-// START AUDIO PLAYBACK
-// (Called by GUI thread)
+// AUDIO ENGINE
+// (Used from the GUI thread)
 // ============================
-int start()
+AudioEngine& audioEngine()
 {
-    // Ensure data is initialized
-    initAudioData();
-
-    PaStream* stream = startPlayback(&gData);
-    if (!stream)
-        return EXIT_FAILURE;
-
-    endPlayback(stream);
-    return EXIT_SUCCESS;
+    // Built on first use, so it is destroyed, closing any stream, before
+    // the portaudio_listener.cpp globals the stream uses
+    static AudioEngine engine(&gData);
+    return engine;
 }
\ No newline at end of file
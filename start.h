@@ -1,5 +1,10 @@
 #ifndef START_H
 #define START_H
-int start();
+class AudioEngine;
+AudioEngine& audioEngine();  // plays gData; load it with initAudioData() first
 void initAudioData();
+void setStreamingMode(bool enabled, double lookaheadSeconds);
+bool setSpeakerLayout(const char* name);  // "2.0", "5.1", "7.1" or "7.1.4"
+bool setSpeakerLayoutFile(const char* path);  // see loadSpeakerLayoutFile
+bool setAttenuation(const char* lawOrCurvePath, float referenceDistance);  // see AttenuationModel::configure
 #endif
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "streaming_decoder.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+StreamingDecoder::~StreamingDecoder()
+{
+    close();
+}
+
+bool StreamingDecoder::open(const char* path, unsigned long lookaheadFrames)
+{
+    close();
+
+    m_info = {};
+    m_file = sf_open(path, SFM_READ, &m_info);
+    if (!m_file) {
+        std::cerr << "Could not open " << path << ": " << sf_strerror(nullptr) << "\n";
+        return false;
+    }
+
+    if (m_info.channels != 2 && m_info.channels != DECODED_CHANNELS) {
+        std::cerr << "Invalid number of channels: " << m_info.channels << "\n";
+        close();
+        return false;
+    }
+
+    // Decode in chunks of a quarter of the lookahead so the ring is topped up
+    // several times before it could drain.
+    m_chunkFrames = lookaheadFrames / 4;
+    if (m_chunkFrames < 256)
+        m_chunkFrames = 256;
+
+    m_decodeBuffer.assign(m_chunkFrames * m_info.channels, 0.0f);
+    m_upmixBuffer.assign(m_chunkFrames * DECODED_CHANNELS, 0.0f);
+    m_ring.allocate((lookaheadFrames + m_chunkFrames) * DECODED_CHANNELS);
+    m_underruns.store(0, std::memory_order_relaxed);
+
+    // Prefill so playback starts with a full lookahead.
+    fill();
+
+    m_running.store(true);
+    m_thread = std::thread(&StreamingDecoder::run, this);
+    return true;
+}
+
+void StreamingDecoder::close()
+{
+    m_running.store(false);
+    if (m_thread.joinable())
+        m_thread.join();
+
+    if (m_file) {
+        sf_close(m_file);
+        m_file = nullptr;
+    }
+}
+
+// Decode chunks until the ring has no room for another one.
+void StreamingDecoder::fill()
+{
+    while (m_ring.writeAvailable() >= m_chunkFrames * DECODED_CHANNELS) {
+        sf_count_t n = sf_readf_float(m_file, m_decodeBuffer.data(), m_chunkFrames);
+        if (n <= 0) {
+            // loop
+            if (sf_seek(m_file, 0, SEEK_SET) < 0 || m_info.frames == 0)
+                return;
+            continue;
+        }
+
+        upmixToSurround(m_decodeBuffer.data(), m_info.channels, m_upmixBuffer.data(), n);
+        m_ring.write(m_upmixBuffer.data(), n * DECODED_CHANNELS);
+    }
+}
+
+void StreamingDecoder::run()
+{
+    while (m_running.load()) {
+        fill();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+}
+
+void StreamingDecoder::read(float* dst, unsigned long frames)
+{
+    size_t wanted = frames * DECODED_CHANNELS;
+    size_t got = m_ring.read(dst, wanted);
+    if (got < wanted) {
+        std::memset(dst + got, 0, (wanted - got) * sizeof(float));
+        m_underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+}
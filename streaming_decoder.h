@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <sndfile.h>
+#include <thread>
+#include <vector>
+#include "audio_file.h"
+#include "spsc_ring_buffer.h"
+
+// Decodes a file on a background thread into a lock-free ring buffer that the
+// audio callback drains, so memory is bounded by the lookahead rather than
+// the length of the file. The file loops: at end of file the reader thread
+// seeks back to the start with sf_seek.
+class StreamingDecoder
+{
+public:
+    StreamingDecoder() = default;
+    ~StreamingDecoder();
+
+    StreamingDecoder(const StreamingDecoder&) = delete;
+    StreamingDecoder& operator=(const StreamingDecoder&) = delete;
+
+    // Open `path`, prefill `lookaheadFrames` frames and start the reader
+    // thread. Closes any file that was already open.
+    bool open(const char* path, unsigned long lookaheadFrames);
+    void close();
+
+    bool isOpen() const { return m_file != nullptr; }
+
+    // Audio thread: copy up to `frames` interleaved 5.1 frames into dst.
+    // If the reader has fallen behind, the missing frames are zeroed and the
+    // underrun counter is incremented. Never blocks.
+    void read(float* dst, unsigned long frames);
+
+    // Reads that came up short since open(); the audio callback counts the
+    // callbacks it bumped as decoder underruns in its CallbackStats.
+    unsigned long underruns() const { return m_underruns.load(std::memory_order_relaxed); }
+
+private:
+    void fill();
+    void run();
+
+    SNDFILE* m_file = nullptr;
+    SF_INFO m_info = {};
+    unsigned long m_chunkFrames = 0;
+
+    std::vector<float> m_decodeBuffer;  // one chunk in the file's channel layout
+    std::vector<float> m_upmixBuffer;   // the same chunk as 5.1
+    SpscRingBuffer<float> m_ring;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    std::atomic<unsigned long> m_underruns{0};
+};
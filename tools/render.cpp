@@ -0,0 +1,313 @@
+// Headless offline renderer: runs the exact RenderEngine pipeline (readAudio
+// + applyRotation) block by block, driven by a recorded pose trace, and
+// writes the speaker feeds (or the binaural mix) to a WAV or FLAC. Runs faster than
+// real time without an audio device, so it doubles as a benchmark and as a
+// golden-file harness on CI machines.
+//
+// usage: audiotest-render <input audio> <pose trace> <output.wav|.flac>
+//                         [--frames N] [--seconds S] [--layout 2.0|5.1|7.1|7.1.4]
+//                         [--layout-file speakers.txt] [--mix-threads N]
+//                         [--panning gaussian|vbap|ambisonic] [--ambisonic-order 1..3]
+//                         [--binaural] [--hrir hrirs.txt]
+//                         [--distance-delay] [--room-correction filters.txt]
+//                         [--attenuation linear|inverse|inverse-square|curve.txt]
+//                         [--reference-distance M] [--reflections 0..3]
+//                         [--automation script.txt] [--automation-step N]
+//
+// Pose trace lines are either "t,x,y,yaw" with t in seconds, or "x,y,yaw" as
+// printed by examples/spin.cpp and examples/move_lr.cpp, taken to be 1 ms
+// apart. Lines starting with '#' are ignored. A script given with
+// --automation (see automation.h) runs from the start, over the trace.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <sndfile.h>
+#include <string>
+#include <vector>
+#include "../audio_file.h"
+#include "../render_engine.h"
+#include "../rt_alloc_check.h"
+#include "../utils.h"
+
+typedef struct
+{
+    double time;  // seconds from the start of the render
+    float x;
+    float y;
+    float yaw;
+} TracePose;
+
+static bool loadPoseTrace(const char* path, std::vector<TracePose>& poses)
+{
+    FILE* file = std::fopen(path, "r");
+    if (!file) {
+        std::fprintf(stderr, "Could not open pose trace %s\n", path);
+        return false;
+    }
+
+    char line[256];
+    while (std::fgets(line, sizeof(line), file)) {
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+
+        TracePose pose;
+        float t;
+        if (std::sscanf(line, "%f,%f,%f,%f", &t, &pose.x, &pose.y, &pose.yaw) == 4) {
+            pose.time = t;
+        } else if (std::sscanf(line, "%f,%f,%f", &pose.x, &pose.y, &pose.yaw) == 3) {
+            pose.time = poses.size() * 0.001;
+        } else {
+            continue;
+        }
+        poses.push_back(pose);
+    }
+
+    std::fclose(file);
+    std::stable_sort(poses.begin(), poses.end(),
+                     [](const TracePose& a, const TracePose& b) { return a.time < b.time; });
+    return true;
+}
+
+static int outputFormatFor(const char* path)
+{
+    const char* ext = std::strrchr(path, '.');
+    if (ext && strcasecmp(ext, ".flac") == 0)
+        return SF_FORMAT_FLAC | SF_FORMAT_PCM_24;
+    return SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+}
+
+static double nowNs()
+{
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+    if (values.empty())
+        return 0.0;
+    size_t index = (size_t)(p * (values.size() - 1) + 0.5);
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+static void printUsage(const char* program)
+{
+    std::fprintf(stderr, "usage: %s <input audio> <pose trace> <output.wav|.flac> "
+                         "[--frames N] [--seconds S] [--layout 2.0|5.1|7.1|7.1.4]\n"
+                         "  [--layout-file speakers.txt] [--mix-threads N]\n"
+                         "  [--panning gaussian|vbap|ambisonic] [--ambisonic-order 1..3]\n"
+                         "  [--binaural] [--hrir hrirs.txt] [--distance-delay]\n"
+                         "  [--room-correction filters.txt]\n"
+                         "  [--attenuation linear|inverse|inverse-square|curve.txt] [--reference-distance M]\n"
+                         "  [--reflections 0..3] [--automation script.txt] [--automation-step N]\n",
+                 program);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 4) {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char* inputPath = argv[1];
+    const char* tracePath = argv[2];
+    const char* outputPath = argv[3];
+    unsigned long frames = 256;
+    double seconds = 0;
+    const SpeakerLayout* layout = &defaultSpeakerLayout();
+    static SpeakerArrayLayout arrayLayout;
+    int mixThreads = -1;
+    PanningMode panning = PanningMode::Gaussian;
+    int ambisonicOrder = -1;
+    static HrirSet hrirs;
+    bool binaural = false;
+    int reflectionOrder = 0;
+    bool distanceDelays = false;
+    const char* correctionPath = nullptr;
+    static CorrectionFilters correction;
+    const char* attenuation = nullptr;
+    float referenceDistance = 1.0f;
+    const char* automationPath = nullptr;
+    unsigned long automationStep = AUTOMATION_STEP_FRAMES;
+
+    for (int i = 4; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frames = std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+            seconds = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--layout") == 0 && i + 1 < argc) {
+            layout = findSpeakerLayout(argv[++i]);
+            if (!layout) {
+                std::fprintf(stderr, "Unknown speaker layout '%s'\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(argv[i], "--layout-file") == 0 && i + 1 < argc) {
+            if (!loadSpeakerLayoutFile(argv[++i], arrayLayout))
+                return EXIT_FAILURE;
+            layout = &arrayLayout.layout();
+        }
+        else if (std::strcmp(argv[i], "--mix-threads") == 0 && i + 1 < argc)
+            mixThreads = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--binaural") == 0) {
+            if (!binaural)
+                hrirs.synthesize();
+            binaural = true;
+        }
+        else if (std::strcmp(argv[i], "--hrir") == 0 && i + 1 < argc) {
+            if (!hrirs.load(argv[++i]))
+                return EXIT_FAILURE;
+            binaural = true;
+        }
+        else if (std::strcmp(argv[i], "--reflections") == 0 && i + 1 < argc)
+            reflectionOrder = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--distance-delay") == 0)
+            distanceDelays = true;
+        else if (std::strcmp(argv[i], "--room-correction") == 0 && i + 1 < argc)
+            correctionPath = argv[++i];
+        else if (std::strcmp(argv[i], "--attenuation") == 0 && i + 1 < argc)
+            attenuation = argv[++i];
+        else if (std::strcmp(argv[i], "--reference-distance") == 0 && i + 1 < argc)
+            referenceDistance = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--automation") == 0 && i + 1 < argc)
+            automationPath = argv[++i];
+        else if (std::strcmp(argv[i], "--automation-step") == 0 && i + 1 < argc)
+            automationStep = std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--ambisonic-order") == 0 && i + 1 < argc)
+            ambisonicOrder = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--panning") == 0 && i + 1 < argc) {
+            if (!findPanningMode(argv[++i], panning)) {
+                std::fprintf(stderr, "Unknown panning mode '%s'\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        else {
+            // An unknown flag, or one whose value is missing at the end
+            std::fprintf(stderr, "Unknown option or missing value '%s'\n", argv[i]);
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (frames == 0) {
+        std::fprintf(stderr, "--frames must be positive\n");
+        return EXIT_FAILURE;
+    }
+    // Channel names in the filter list refer to the final layout
+    if (correctionPath && !correction.load(correctionPath, *layout))
+        return EXIT_FAILURE;
+
+    static paTestData data;
+    if (attenuation && !data.attenuationModel.configure(attenuation, referenceDistance))
+        return EXIT_FAILURE;
+    initDefaultRoom(&data, *layout);
+    for (int i = 0; i < MAX_CHANNELS; i++)
+        data.channelGains[i] = 1;
+
+    std::vector<float> samples;
+    if (!decodeAudioFile(inputPath, samples))
+        return EXIT_FAILURE;
+    data.audio.assign(std::move(samples));
+    data.readIndex = 0;
+
+    std::vector<TracePose> poses;
+    if (!loadPoseTrace(tracePath, poses))
+        return EXIT_FAILURE;
+
+    if (automationPath) {
+        std::unique_ptr<Automation> automation(new Automation());
+        if (!loadAutomation(automationPath, *layout, *automation))
+            return EXIT_FAILURE;
+        setAutomation(&data, *automation);
+    }
+
+    // Default length: the whole trace, or the whole input if the trace is empty
+    if (seconds <= 0)
+        seconds = poses.empty() ? (double)data.audio.size() / DECODED_CHANNELS / SAMPLE_RATE
+                                : poses.back().time;
+
+    std::unique_ptr<RenderEngine> engine = createRenderEngine(&data);
+    if (engine) {
+        engine->setMixThreads(mixThreads);
+        engine->setPanningMode(panning);
+        engine->setAmbisonicOrder(ambisonicOrder);
+        engine->setBinauralOutput(binaural ? &hrirs : nullptr);
+        engine->setEarlyReflections(reflectionOrder);
+        engine->setDistanceDelays(distanceDelays);
+        engine->setAutomationStep(automationStep);
+        // Faster than real time, the correction worker could never keep up
+        engine->setRoomCorrection(correctionPath ? &correction : nullptr, false);
+    }
+    if (!engine || !engine->prepare(frames)) {
+        std::fprintf(stderr, "Failed to allocate render buffers.\n");
+        return EXIT_FAILURE;
+    }
+
+    SF_INFO outInfo = {};
+    outInfo.samplerate = SAMPLE_RATE;
+    outInfo.channels = engine->outputChannels();
+    outInfo.format = outputFormatFor(outputPath);
+    SNDFILE* out = sf_open(outputPath, SFM_WRITE, &outInfo);
+    if (!out) {
+        std::fprintf(stderr, "Could not create %s: %s\n", outputPath, sf_strerror(nullptr));
+        return EXIT_FAILURE;
+    }
+
+    const long blocks = (long)(seconds * SAMPLE_RATE / frames + 0.5);
+    std::vector<float> block(frames * engine->outputChannels());
+    std::vector<double> blockNs;
+    blockNs.reserve(blocks);
+    size_t nextPose = 0;
+
+    rtResetAllocationCount();
+    double renderStart = nowNs();
+    for (long b = 0; b < blocks; ++b) {
+        // Apply the newest pose that has arrived by the start of this block,
+        // as the live stdin loop would have.
+        double blockTime = (double)b * frames / SAMPLE_RATE;
+        bool havePose = false;
+        TracePose pose;
+        while (nextPose < poses.size() && poses[nextPose].time <= blockTime) {
+            pose = poses[nextPose++];
+            havePose = true;
+        }
+        if (havePose)
+            applyTrackerPose(&data, pose.x, pose.y, pose.yaw);
+
+        double start = nowNs();
+        {
+            RtAllocScope allocScope;
+            engine->render(block.data(), frames);
+        }
+        blockNs.push_back(nowNs() - start);
+
+        sf_writef_float(out, block.data(), frames);
+    }
+    double wallNs = nowNs() - renderStart;
+    sf_close(out);
+
+    double renderedSeconds = (double)blocks * frames / SAMPLE_RATE;
+    double renderNs = 0;
+    for (double ns : blockNs)
+        renderNs += ns;
+    double budgetNs = frames * 1e9 / SAMPLE_RATE;
+
+    std::printf("rendered %.2f s (%ld blocks of %lu frames, %s%s%s) to %s\n",
+                renderedSeconds, blocks, frames, layout->name,
+                binaural ? " binaural" : "", correctionPath ? " room corrected" : "", outputPath);
+    std::printf("  speed: %.1fx real time (render only), %.1fx including file I/O\n",
+                renderedSeconds * 1e9 / renderNs, renderedSeconds * 1e9 / wallNs);
+    std::printf("  block cost: p50 %.1f us  p90 %.1f us  p99 %.1f us  max %.1f us  "
+                "(budget %.1f us)\n",
+                percentile(blockNs, 0.50) / 1e3, percentile(blockNs, 0.90) / 1e3,
+                percentile(blockNs, 0.99) / 1e3, percentile(blockNs, 1.0) / 1e3,
+                budgetNs / 1e3);
+    std::printf("  audio-path allocations: %lu\n", rtAllocationCount());
+
+    return rtAllocationCount() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
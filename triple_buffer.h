@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+// Lock-free handoff of a value from control threads to the audio thread.
+//
+// Writers publish complete copies of T; the single reader (the audio
+// callback) picks up the newest published copy with one atomic exchange and
+// never blocks. Writers are serialised among themselves by a mutex the reader
+// never touches, so any number of non-audio threads may publish.
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() : m_middle(1), m_back(2), m_front(0) {}
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Writer side: apply `edit` to a copy of the last published value, then
+    // publish the result as a whole.
+    template <typename Fn>
+    void update(Fn&& edit)
+    {
+        std::lock_guard<std::mutex> lock(m_writerMutex);
+        edit(m_working);
+        m_buffers[m_back] = m_working;
+        m_back = m_middle.exchange(m_back | kFresh, std::memory_order_acq_rel) & kIndexMask;
+    }
+
+    // Writer side: a copy of the last published value (for drawing etc.).
+    T latest() const
+    {
+        std::lock_guard<std::mutex> lock(m_writerMutex);
+        return m_working;
+    }
+
+    // Reader side, single consumer only. Wait-free. The returned reference
+    // stays valid and unchanged until the next call to acquire().
+    const T& acquire()
+    {
+        if (m_middle.load(std::memory_order_relaxed) & kFresh)
+            m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & kIndexMask;
+        return m_buffers[m_front];
+    }
+
+private:
+    static const unsigned int kIndexMask = 3;
+    static const unsigned int kFresh = 4;  // middle holds a value the reader has not seen
+
+    T m_buffers[3] = {};
+    T m_working = {};
+    std::atomic<unsigned int> m_middle;
+    unsigned int m_back;   // owned by writers
+    unsigned int m_front;  // owned by the reader
+    mutable std::mutex m_writerMutex;
+};
@@ -1,19 +1,21 @@
 #include <algorithm>
 #include <array>
 #include <cmath>
+#include <cstdlib>
 #include <string>
 #include "utils.h"
 #include "six_channel.h"
 
 
 // distance from listener to each speaker
-std::array<float, CHANNEL_COUNT>
+std::array<float, MAX_CHANNELS>
 calculateSpeakerDistances(Point subjectPosition,
-                          const Point speakerPositions[CHANNEL_COUNT])
+                          const Point speakerPositions[MAX_CHANNELS],
+                          int speakerCount)
 {
-    std::array<float, CHANNEL_COUNT> distances{};
+    std::array<float, MAX_CHANNELS> distances{};
 
-    for (int i = 0; i < CHANNEL_COUNT; ++i)
+    for (int i = 0; i < speakerCount; ++i)
     {
         Point currentSpeaker = speakerPositions[i];
         float xDiff = subjectPosition.x - currentSpeaker.x;
@@ -24,13 +26,11 @@ calculateSpeakerDistances(Point subjectPosition,
     return distances;
 }
 
-float distanceToGain(float distance) {
-    return distance;
-}
-
 /**
- * Calculates the maximum possible gain that can be applied to each 
- * speaker, and sets data->maxGain to that value.
+ * Finds the farthest the listener can be from any speaker while inside
+ * subjectBounds, and bakes data->attenuationModel over that range into the
+ * spatial state's attenuation table, normalised to the loudest reachable
+ * gain. Call again after moving speakers or changing the model.
  */
 void setMaxGain(paTestData* data) {
     float minX = data->subjectBounds[0].x;
@@ -44,19 +44,84 @@ void setMaxGain(paTestData* data) {
         Point {maxX, maxY}, 
     };
 
+    SpatialState state = data->spatial.latest();
+    int speakerCount = data->layout->channels;
     float maxDistance = 0;
     for (auto corner : corners) {
-        auto cornerDistances = calculateSpeakerDistances(corner, data->speakerPositions);
-        auto maxCornerDistance = *std::max_element(cornerDistances.begin(), cornerDistances.end());
+        auto cornerDistances = calculateSpeakerDistances(corner, state.speakerPositions, speakerCount);
+        auto maxCornerDistance = *std::max_element(cornerDistances.begin(),
+                                                   cornerDistances.begin() + speakerCount);
 
         if (maxCornerDistance > maxDistance) maxDistance = maxCornerDistance;
     }
 
-    float maxGain = distanceToGain(maxDistance);
-    data->maxGain = maxGain;
+    updateSpatialState(data, [&](SpatialState& s) {
+        buildAttenuationTable(data->attenuationModel, maxDistance, s.attenuation);
+    });
 }
 
 
+/**
+ * Sets up the default room for `layout`: bounds, speakers at the layout's
+ * angles around the origin, and the listener at the origin facing front.
+ */
+void initDefaultRoom(paTestData* data, const SpeakerLayout& layout)
+{
+    data->layout = &layout;
+
+    // Define room bounds
+    data->subjectBounds[0] = { -3.0f, -3.0f }; // bottom-left
+    data->subjectBounds[1] = {  3.0f,  3.0f }; // top-right
+
+    updateSpatialState(data, [&layout](SpatialState& state) {
+        for (int i = 0; i < MAX_CHANNELS; ++i)
+            state.speakerPositions[i] = { 0, 0 };
+
+        // Layout angles run clockwise from the front; circular positions run
+        // anticlockwise from the +x axis.
+        for (int i = 0; i < layout.channels; ++i)
+            state.speakerPositions[i] = getCircularCoordinates(0.25f - layout.angles[i], layout.radii[i]);
+
+        // Listener begins at origin
+        state.currentListenerPosition = { 0.0, 0.0 };
+        state.listenerYaw = 0.0;
+        state.poseArrivalNs = 0;
+    });
+
+    // bake the attenuation table
+    setMaxGain(data);
+}
+
+void setAutomation(paTestData* data, const Automation& automation)
+{
+    data->automation.update([&](Automation& published) {
+        unsigned int version = published.version;
+        published = automation;
+        published.version = version + 1;
+    });
+}
+
+/**
+ * Publishes a pose from the head tracker. Tracker coordinates are relative to
+ * the camera, which is assumed to sit at the centre speaker (or the origin
+ * for layouts without one). arrivalNs is when the pose was read, if known.
+ */
+void applyTrackerPose(paTestData* data, float x, float y, float yaw, uint64_t arrivalNs)
+{
+    updateSpatialState(data, [&](SpatialState& s) {
+        setTrackerPose(s, *data->layout, x, y, yaw, arrivalNs);
+    });
+}
+
+void setTrackerPose(SpatialState& state, const SpeakerLayout& layout, float x, float y, float yaw,
+                    uint64_t arrivalNs)
+{
+    Point cameraPosition = layout.centre >= 0 ? state.speakerPositions[layout.centre] : Point { 0, 0 };
+    state.currentListenerPosition = Point { x + cameraPosition.x, y + cameraPosition.y };
+    state.listenerYaw = yaw;
+    state.poseArrivalNs = arrivalNs;
+}
+
 // Get the point in 2D space that corresponds to a single-value position
 // around the circle's circumference.
 Point getCircularCoordinates(float circularPosition, float radius)
@@ -1,13 +1,17 @@
 #pragma once
 #include <array>
+#include <cstdint>
 #include <sndfile.h>
 #include <string>
 #include <vector>
+#include "attenuation.h"
+#include "automation.h"
+#include "pcm_cache.h"
+#include "speaker_layout.h"
+#include "triple_buffer.h"
 #define TABLE_SIZE          (SAMPLE_RATE / TONE_HZ)
 #define TONE_HZ             (200)
 #define SAMPLE_RATE         (44100)
-#define CHANNEL_COUNT       (6)
-// (0) FL, (1) FR, (2) LR, (3) BR, (4) CEN, (5) SUB
 
 
 typedef struct {
@@ -15,27 +19,65 @@ typedef struct {
     float y;
 } Point;
 
+// Everything the renderer needs to pan one block. Published as a whole so the
+// audio thread never sees a position from one update with a yaw from another.
 typedef struct
 {
-    float channelGains[CHANNEL_COUNT]; // the gain on each channel, from 0 to 1.
     Point currentListenerPosition; // currently targeted coordinates relative to subjectBounds, in offset metres.
     float listenerYaw; // the yaw of the listener's head, with 0 pointing towards the centre speaker and 0.2 pointing towards the front-left speaker.
+    Point speakerPositions[MAX_CHANNELS]; // the position of each speaker relative to subjectBounds, in offset metres.
+    AttenuationTable attenuation; // distance to speaker gain, normalised over every distance the listener can reach.
+    uint64_t poseArrivalNs; // when the tracker pose in use was read (see poseClockNs in pose_clock.h); 0 if it did not come from a tracker.
+    unsigned int version; // incremented on every publish.
+} SpatialState;
+
+class StreamingDecoder;
+
+typedef struct
+{
+    const SpeakerLayout* layout; // output speakers, chosen at startup; sizes every per-speaker array below.
+    float channelGains[MAX_CHANNELS]; // the gain on each channel, from 0 to 1.
     Point subjectBounds[2]; // bounds for the listener, in metres. (0) bottom left - min x and y, (1) top right - max x and y.
-    Point speakerPositions[CHANNEL_COUNT]; // the position of each speaker relative to subjectBounds, in offset metres.
-    float maxGain; // the maximum gain that can be applied to the signal of each speaker.
-    std::vector<float> audio;
+    AttenuationModel attenuationModel; // baked into spatial.attenuation by setMaxGain; never read by the audio thread.
+    TripleBuffer<SpatialState> spatial; // written by the control and GUI threads, read once per block by the audio thread.
+    TripleBuffer<Automation> automation; // keyframed moves the audio thread applies on top of spatial; see setAutomation.
+    PcmBuffer audio; // fully decoded interleaved 5.1 (in memory or mapped from the cache), used unless stream is set.
     unsigned long readIndex;
+    StreamingDecoder* stream; // when set, audio is streamed from here instead of from `audio`.
 } paTestData;
 
-std::array<float, CHANNEL_COUNT> calculateSpeakerDistances(
+// Edit and publish the spatial state. Call from any thread except the audio thread.
+template <typename Fn>
+void updateSpatialState(paTestData* data, Fn&& edit)
+{
+    data->spatial.update([&](SpatialState& state) {
+        edit(state);
+        state.version++;
+    });
+}
+
+// Publish a script (see automation.h) for the engine to run from the next
+// block on, from time 0; one with no tracks stops the running one. Call from
+// any thread except the audio thread.
+void setAutomation(paTestData* data, const Automation& automation);
+
+std::array<float, MAX_CHANNELS> calculateSpeakerDistances(
     Point subjectPosition, 
-    const Point speakerPositions[CHANNEL_COUNT]
+    const Point speakerPositions[MAX_CHANNELS],
+    int speakerCount
 );
 
-float distanceToGain(float distance);
-
 void setMaxGain(paTestData* data);
 
+void initDefaultRoom(paTestData* data, const SpeakerLayout& layout);
+
+void applyTrackerPose(paTestData* data, float x, float y, float yaw, uint64_t arrivalNs = 0);
+
+// The edit applyTrackerPose() publishes, for code that holds its own copy
+// of the state.
+void setTrackerPose(SpatialState& state, const SpeakerLayout& layout, float x, float y, float yaw,
+                    uint64_t arrivalNs);
+
 Point getCircularCoordinates(float circularPosition, float radius);
 
 std::string getSixChannelName(int channel);
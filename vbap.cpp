@@ -0,0 +1,76 @@
+#include "vbap.h"
+#include <algorithm>
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI (3.14159265)
+#endif
+
+void vbapSetSpeakers(VbapRing& ring, const float* angles, int count, int lfe)
+{
+    ring.count = 0;
+    for (int r = 0; r < count; ++r) {
+        if (r != lfe)
+            ring.speakers[ring.count++] = r;
+    }
+
+    std::sort(ring.speakers, ring.speakers + ring.count,
+              [angles](int a, int b) { return angles[a] < angles[b]; });
+    for (int i = 0; i < ring.count; ++i)
+        ring.angles[i] = angles[ring.speakers[i]];
+}
+
+int vbapPan(const VbapRing& ring, float angle, int speakers[2], float gains[2])
+{
+    const float TWO_PI = 2 * M_PI;
+
+    if (ring.count == 0)
+        return 0;
+    if (ring.count == 1) {
+        speakers[0] = ring.speakers[0];
+        gains[0] = 1.0f;
+        return 1;
+    }
+
+    // Bring the source into [first, first + 2pi) and find the arc holding it;
+    // the last arc wraps from the highest angle round to the lowest.
+    while (angle < ring.angles[0]) angle += TWO_PI;
+    while (angle >= ring.angles[0] + TWO_PI) angle -= TWO_PI;
+
+    int i = ring.count - 1;
+    for (int k = 0; k + 1 < ring.count; ++k) {
+        if (angle < ring.angles[k + 1]) {
+            i = k;
+            break;
+        }
+    }
+    int j = (i + 1) % ring.count;
+    float a = ring.angles[i];
+    float b = j == 0 ? ring.angles[0] + TWO_PI : ring.angles[j];
+
+    float g1, g2;
+    float arc = b - a;
+    if (arc < M_PI - 1e-3f) {
+        // Solve p = g1 * l1 + g2 * l2 for the unit vectors of the pair
+        float det = std::sin(arc);
+        g1 = std::sin(b - angle) / det;
+        g2 = std::sin(angle - a) / det;
+        g1 = std::max(g1, 0.0f);
+        g2 = std::max(g2, 0.0f);
+        float norm = std::sqrt(g1 * g1 + g2 * g2);
+        g1 /= norm;
+        g2 /= norm;
+    } else {
+        // The pair spans half the circle or more (e.g. stereo) and has no
+        // usable inverse: constant-power crossfade along the arc instead.
+        float t = (angle - a) / arc;
+        g1 = std::cos(t * 0.5f * M_PI);
+        g2 = std::sin(t * 0.5f * M_PI);
+    }
+
+    speakers[0] = ring.speakers[i];
+    gains[0] = g1;
+    speakers[1] = ring.speakers[j];
+    gains[1] = g2;
+    return 2;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "speaker_layout.h"
+
+// Pairwise two-dimensional vector base amplitude panning (Pulkki, 1997).
+// A source is panned between the two speakers either side of it on the
+// horizontal ring, so at most two outputs get a non-zero gain.
+//
+// Angles are in radians, in the same convention as the panning in
+// render_engine.cpp. The ring is rebuilt whenever the speakers move.
+
+typedef struct
+{
+    int count;                     // speakers on the ring (LFE excluded)
+    int speakers[MAX_CHANNELS];    // output channel of each, sorted by angle
+    float angles[MAX_CHANNELS];    // their angles, ascending in [-pi, pi]
+} VbapRing;
+
+// Sort the `count` speakers by angle, leaving out channel `lfe` (or -1).
+void vbapSetSpeakers(VbapRing& ring, const float* angles, int count, int lfe);
+
+// Gains for a source at `angle`: fills up to two (speaker, gain) pairs with
+// unit total power and returns how many were filled.
+int vbapPan(const VbapRing& ring, float angle, int speakers[2], float gains[2]);